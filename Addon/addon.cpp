@@ -7,158 +7,93 @@
 
 #include "addon.hpp"
 #include "cloud_overlay.hpp"
+#include "gpu_timing.hpp"
+#include "injection.hpp"
+#include "pass_scheduler.hpp"
+#include "quality_controller.hpp"
+#include "temporal.hpp"
 #include "reshade_data.hpp"
+#include "trace_source.hpp"
+#include "uniform_capture.hpp"
+#include "startup_report.hpp"
 
 using namespace reshade::api;
 
-constexpr size_t MAX_UNIFORM_NAME = 48;
-
 static DataSource* data_source;
+static DataSource* game_source; // The live game source when data_source wraps it for a trace
 static pv::clouds::CloudsState cloud_state;
-std::unordered_map<std::string, UniformType> staged_uniforms;
-
 
 /**
-* Uniform injection
+* Uniform capture
 **/
 
-template <typename T>
-void stage_uniform(const std::string& annotation, const T& value)
-{
-	staged_uniforms[annotation] = UniformType(value);
-}
+// Set by an effect reload, the next effects pass (which also runs the noise generation technique) is timed
+static bool time_next_effects = true;
+static std::unique_ptr<StartupReport::Phase> effects_phase;
 
-template<>
-void stage_uniform<Float4x4>(const std::string& annotation, const Float4x4& value)
-{
-	staged_uniforms[annotation + "__r1"] = value.r1;
-	staged_uniforms[annotation + "__r2"] = value.r2;
-	staged_uniforms[annotation + "__r3"] = value.r3;
-	staged_uniforms[annotation + "__r4"] = value.r4;
-}
+static UniformCapture::Writer uniform_capture;
+static std::string golden_uniforms_path;
+static std::string uniform_tolerances_path;
 
-template<>
-void stage_uniform<TimeCycle::WeatherFrame>(const std::string& annotation, const TimeCycle::WeatherFrame& value)
+// Closes the capture and, when a golden capture is configured, logs how the two compare
+static void finish_uniform_capture()
 {
-	for (const auto& variable : value.floats) {
-		staged_uniforms[annotation + "_" + variable.first] = variable.second;
-	}
-
-	for (const auto& variable : value.colors) {
-		staged_uniforms[annotation + "_" + variable.first] = variable.second;
+	if (!uniform_capture.is_open())
+	{
+		return;
 	}
-}
 
-struct UniformInjectionVisitor {
-	effect_runtime* runtime;
-	effect_uniform_variable& variable;
+	uniform_capture.close();
 
-	void operator()(bool value) const {
-		runtime->set_uniform_value_bool(variable, value);
+	if (golden_uniforms_path.empty())
+	{
+		return;
 	}
 
-	void operator()(int value) const {
-		runtime->set_uniform_value_int(variable, value);
+	UniformCapture::Tolerances tolerances;
+	if (!uniform_tolerances_path.empty() && !tolerances.load(uniform_tolerances_path))
+	{
+		reshade::log::message(reshade::log::level::warning, ("Could not read uniform tolerances from " + uniform_tolerances_path).c_str());
 	}
 
-	void operator()(float value) const {
-		runtime->set_uniform_value_float(variable, value);
-	}
+	const UniformCapture::DiffResult result = UniformCapture::diff(golden_uniforms_path, uniform_capture.get_path(), tolerances);
+	const auto level = result.ok && result.match ? reshade::log::level::info : reshade::log::level::warning;
 
-	void operator()(const Float2& value) const {
-		runtime->set_uniform_value_float(variable, value.v, 2);
-	}
+	reshade::log::message(level, ("Uniform capture vs golden: " + result.message).c_str());
+}
 
-	void operator()(const Float3& value) const {
-		runtime->set_uniform_value_float(variable, value.v, 3);
-	}
+static void inject_uniforms(effect_runtime* runtime, command_list* cmd_list, resource_view rtv, resource_view rtv_srgb)
+{
+	// Drains the zones of the previous frame before this one starts adding its own
+	Profiler::collect();
 
-	void operator()(const Float4& value) const {
-		runtime->set_uniform_value_float(variable, value.v, 4);
-	}
+	PV_PROFILE_ZONE("inject_uniforms");
 
-	void operator()(const Float4x4& value) const {
-		reshade::log::message(reshade::log::level::error, "Tried to inject Float4x4 without marshalling!");
-	}
+	GpuTiming::begin_effects(runtime, cmd_list);
 
-	void operator()(const TimeCycle::WeatherFrame& value) const {
-		reshade::log::message(reshade::log::level::error, "Tried to inject WeatherFrame without marshalling!");
+	if (time_next_effects) {
+		time_next_effects = false;
+		effects_phase = std::make_unique<StartupReport::Phase>("first effects pass");
 	}
 
-	void operator()(const UniformType& value) const
-	{
-		reshade::log::message(reshade::log::level::error, "Tried to inject unknown uniform type!");
-	}
-};
+	const auto now = std::chrono::high_resolution_clock::now();
+	const double now_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(now.time_since_epoch()).count();
 
-static void inject_uniform(effect_runtime* runtime, effect_uniform_variable& variable, const UniformType& value)
-{
-	std::visit(UniformInjectionVisitor{ runtime, variable }, value);
-}
-
-static void commit_uniforms(effect_runtime* runtime)
-{
-	runtime->enumerate_uniform_variables(nullptr, [](effect_runtime* runtime, effect_uniform_variable variable) {
-		char annotation[MAX_UNIFORM_NAME] = { 0 };
+	const bool enabled = Injection::inject_frame(runtime, cloud_state, now_seconds, uniform_capture);
 
-		if (runtime->get_annotation_string_from_uniform_variable(variable, "source", annotation))
-		{
-			std::string annotation_needle = annotation;
-
-			auto uniform_iter = staged_uniforms.find(annotation_needle);
-			if (uniform_iter != staged_uniforms.end()) {
-				inject_uniform(runtime, variable, uniform_iter->second);
-			}
-		}
-		});
+	if (uniform_capture.is_full()) {
+		finish_uniform_capture();
+	}
 
-	staged_uniforms.clear();
+	if (enabled) {
+		StartupReport::mark_first_frame();
+	}
 }
 
-static void inject_uniforms(effect_runtime* runtime, command_list* cmd_list, resource_view rtv, resource_view rtv_srgb)
+static void finish_effects(effect_runtime* runtime, command_list* cmd_list, resource_view rtv, resource_view rtv_srgb)
 {
-	if (cloud_state.has_runtime) {
-		const auto now = std::chrono::high_resolution_clock::now();
-		const double now_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(now.time_since_epoch()).count();
-		pv::clouds::tick(cloud_state, now_seconds);
-	}
-
-	const bool enabled = DataReader::get_enabled();
-	stage_uniform("enabled", enabled);
-
-	if (enabled) {
-		DataReader::fast_update();
-
-		stage_uniform("depth_reversed", DataReader::get_depth_reversed());
-		stage_uniform("view_matrix", DataReader::get_view_matrix());
-		stage_uniform("projection_matrix", DataReader::get_proj_matrix());
-		stage_uniform("inverse_view_matrix", DataReader::get_inv_view_matrix());
-		stage_uniform("inverse_projection_matrix", DataReader::get_inv_proj_matrix());
-		stage_uniform("previous_view_matrix", DataReader::get_prev_view_matrix());
-		stage_uniform("previous_projection_matrix", DataReader::get_prev_proj_matrix());
-		stage_uniform("previous_inverse_view_matrix", DataReader::get_prev_inv_view_matrix());
-		stage_uniform("previous_inverse_projection_matrix", DataReader::get_prev_inv_proj_matrix());
-		stage_uniform("camera_position", DataReader::get_camera_pos());
-		stage_uniform("camera_rotation", DataReader::get_camera_rot());
-		stage_uniform("delta_camera_position", DataReader::get_delta_camera_pos());
-		stage_uniform("delta_camera_rotation", DataReader::get_delta_camera_rot());
-		stage_uniform("near_clip", DataReader::get_near_clip());
-		stage_uniform("far_clip", DataReader::get_far_clip());
-		stage_uniform("camera_fov", DataReader::get_camera_fov());
-		stage_uniform("wind_direction", DataReader::get_wind_dir());
-		stage_uniform("wind_speed", DataReader::get_wind_speed());
-		stage_uniform("wind_position", DataReader::get_wind_pos());
-		stage_uniform("time_of_day", DataReader::get_time_of_day());
-		stage_uniform("game_timer", DataReader::get_timer());
-		stage_uniform("from_weather_type", (int)DataReader::get_from_weather_type());
-		stage_uniform("to_weather_type", (int)DataReader::get_to_weather_type());
-		stage_uniform("weather_transition", DataReader::get_weather_transition());
-		stage_uniform("wf", DataReader::get_weather_frame());
-		stage_uniform("aurora_visibility", DataReader::get_aurora_visibility());
-		stage_uniform("moon_dir", DataReader::get_moon_dir());
-	}
-
-	commit_uniforms(runtime);
+	GpuTiming::finish_effects(runtime);
+	effects_phase.reset();
 }
 
 struct DebugWatchVisitor {
@@ -204,9 +139,32 @@ struct DebugWatchVisitor {
 	}
 };
 
+// Binds the clouds UI to the first runtime and loads its presets. The effects are not compiled yet,
+// their uniforms are discovered once they are (shaders_reloaded).
+static void runtime_initialized(effect_runtime* runtime)
+{
+	if (cloud_state.has_runtime) {
+		return;
+	}
+
+	cloud_state.rt = runtime;
+	cloud_state.has_runtime = true;
+
+	StartupReport::Phase phase("preset INI load");
+	const auto path = pv::clouds::derive_presets_path(cloud_state.rt);
+	if (cloud_state.store.load(path)) {
+		cloud_state.writer.mark_clean(cloud_state.store);
+	}
+}
+
 static void shaders_reloaded(effect_runtime* runtime)
 {
-	pv::clouds::on_effect_reload(cloud_state);
+	if (cloud_state.has_runtime) {
+		StartupReport::Phase phase("uniform discovery");
+		pv::clouds::on_effect_reload(cloud_state);
+	}
+	GpuTiming::on_effects_reloaded(runtime);
+	time_next_effects = true;
 	char dummy[1] = { 0 };
 #if defined RFX_GAME_GTAV
 	if (!runtime->get_preprocessor_definition("GTAV", dummy)) {
@@ -221,8 +179,15 @@ static void shaders_reloaded(effect_runtime* runtime)
 #endif;
 }
 
+static void runtime_destroyed(effect_runtime* runtime)
+{
+	pv::clouds::on_runtime_destroyed(cloud_state, runtime);
+	GpuTiming::on_runtime_destroyed(runtime);
+}
+
 static void reload_timecycle()
 {
+	StartupReport::Phase phase("reload_timecycle");
 	reshade::log::message(reshade::log::level::info, "(Re)loading timecycle xml!");
 	data_source->load_timecycle();
 }
@@ -230,14 +195,6 @@ static void reload_timecycle()
 // Print the uniforms to the addon page for debugging
 static void draw_uniforms(reshade::api::effect_runtime* runtime)
 {
-	if (!cloud_state.has_runtime) {
-		cloud_state.rt = runtime;
-		cloud_state.has_runtime = true;
-		const auto path = pv::clouds::derive_presets_path(cloud_state.rt);
-		cloud_state.store.load(path);
-		pv::clouds::discover_uniforms(cloud_state.rt, cloud_state.ucache);
-	}
-
 	const bool enabled = DataReader::get_enabled();
 
 	if (!enabled || data_source == NULL) {
@@ -365,6 +322,69 @@ static void draw_uniforms(reshade::api::effect_runtime* runtime)
 		}
 	}
 
+	if (ImGui::CollapsingHeader("Startup"))
+	{
+		StartupReport::draw_overlay();
+	}
+
+	if (ImGui::CollapsingHeader("Injection"))
+	{
+		const auto& injection_stats = Injection::get_stats();
+		const auto& march_budget = Injection::get_march_budget();
+
+		ImGui::Text("Averaged over %u frames", Injection::STATS_WINDOW);
+		ImGui::Text("Cloud tick: %.2f us", injection_stats.avg_tick_us);
+		ImGui::Text("Stage: %.2f us", injection_stats.avg_stage_us);
+		ImGui::Text("Commit: %.2f us", injection_stats.avg_commit_us);
+		ImGui::Text("Total: %.2f us", injection_stats.avg_tick_us + injection_stats.avg_stage_us + injection_stats.avg_commit_us);
+		ImGui::Text("Variables scanned / frame: %.1f", injection_stats.avg_variables_scanned);
+		ImGui::Text("Values set / frame: %.1f", injection_stats.avg_values_set);
+		ImGui::Text("March budget: %.0f%% samples, %d light steps", march_budget.sample_scale * 100.0f, march_budget.light_steps);
+	}
+
+	if (ImGui::CollapsingHeader("GPU Time"))
+	{
+		GpuTiming::draw_overlay();
+	}
+
+	if (ImGui::CollapsingHeader("Adaptive Quality"))
+	{
+		QualityController::draw_overlay();
+	}
+
+	if (ImGui::CollapsingHeader("Pass Scheduling"))
+	{
+		PassScheduler::draw_overlay();
+	}
+
+	if (ImGui::CollapsingHeader("Temporal"))
+	{
+		Temporal::draw_overlay();
+	}
+
+#if PULSEV_PROFILE
+	if (ImGui::CollapsingHeader("Profiler"))
+	{
+		if (!Profiler::is_capturing()) {
+			if (ImGui::Button("Start trace capture")) {
+				Profiler::start_capture();
+			}
+		}
+		else if (ImGui::Button("Stop and save trace")) {
+			Profiler::stop_capture(get_reshade_base_path() + "\\PulseV_trace.json");
+		}
+
+		Profiler::draw_overlay();
+	}
+#endif
+
+#if defined RFX_GAME_GTAV
+	if (ImGui::CollapsingHeader("Depth"))
+	{
+		draw_depth_overlay(runtime);
+	}
+#endif
+
 	const auto& watchlist = data_source->debug_get_watch_list();
 
 	if (!watchlist.empty() && ImGui::CollapsingHeader("Debug")) {
@@ -393,14 +413,75 @@ static void startup(device* device)
 	reload_timecycle();
 }
 
+static std::string get_config_string(const char *section, const char *key)
+{
+	char value[512] = "";
+	size_t value_size = sizeof(value);
+
+	if (!reshade::get_config_value(nullptr, section, key, value, &value_size))
+	{
+		return std::string();
+	}
+
+	return std::string(value);
+}
+
 static void register_addon(HMODULE hModule)
 {
+	StartupReport::Phase phase("register_addon");
+
 	reshade::log::message(reshade::log::level::info, "Loading game data");
 
 #if defined RFX_GAME_GTAV
-	data_source = new GTAV::GTAVSource();
+	game_source = new GTAV::GTAVSource();
 #elif defined RFX_GAME_RDR1
-	data_source = new RDR1::RDR1Source();
+	game_source = new RDR1::RDR1Source();
+#endif
+	data_source = game_source;
+
+	// [PULSEV] ReplayTrace feeds a recorded session back instead of the live game values,
+	// RecordTrace captures the live values for later replay
+	if (const std::string replay_path = get_config_string("PULSEV", "ReplayTrace"); !replay_path.empty())
+	{
+		bool realtime = true;
+		reshade::get_config_value(nullptr, "PULSEV", "ReplayRealtime", realtime);
+
+		auto replay = new Trace::ReplayDataSource(replay_path, realtime, game_source);
+		if (replay->is_open()) data_source = replay;
+		else delete replay;
+	}
+	else if (const std::string record_path = get_config_string("PULSEV", "RecordTrace"); !record_path.empty())
+	{
+		auto recording = new Trace::RecordingDataSource(game_source, record_path);
+		if (recording->is_open()) data_source = recording;
+		else delete recording;
+	}
+
+	// [PULSEV] CaptureUniforms writes the values injected each frame, for CaptureFrames frames (0 = until unload).
+	// With GoldenUniforms set the finished capture is diffed against it using the [Tolerance] section of UniformTolerances.
+	if (const std::string capture_path = get_config_string("PULSEV", "CaptureUniforms"); !capture_path.empty())
+	{
+		uint32_t capture_frames = 0;
+		reshade::get_config_value(nullptr, "PULSEV", "CaptureFrames", capture_frames);
+
+		golden_uniforms_path = get_config_string("PULSEV", "GoldenUniforms");
+		uniform_tolerances_path = get_config_string("PULSEV", "UniformTolerances");
+		uniform_capture.open(capture_path, capture_frames);
+	}
+
+	// [PULSEV] QualityBudgetMs / FrameBudgetMs let the cloud quality drop to hold a time budget
+	QualityController::configure();
+	// [PULSEV] CloudInterleave = 4 or 16 marches one cloud pixel in that many per frame (needs CLOUD_INTERLEAVE=1 in the effect)
+	Temporal::configure();
+
+#if PULSEV_TRACK_ALLOCATIONS
+	// [PULSEV] AllocationBudget holds the per-frame injection path to that many allocations once warmed up
+	if (uint32_t allocation_budget = 0; reshade::get_config_value(nullptr, "PULSEV", "AllocationBudget", allocation_budget))
+	{
+		Profiler::set_allocation_budget("inject_uniforms", allocation_budget);
+		Profiler::set_allocation_budget("commit_uniforms", allocation_budget);
+		Profiler::set_allocation_budget("DataReader::fast_update", allocation_budget);
+	}
 #endif
 
 	DataReader::register_data_reader(hModule, data_source);
@@ -410,9 +491,19 @@ static void register_addon(HMODULE hModule)
 
 static void unregister_addon(HMODULE hModule)
 {
+	finish_uniform_capture();
+
+	// Destroying the runtime already stopped the preset writer. If it never was, the process is exiting
+	// and the worker is gone, and joining it under the loader lock here could only deadlock.
+	cloud_state.writer.detach();
+
 	DataReader::unregister_data_reader(hModule);
 
-	delete data_source;
+	if (data_source != game_source)
+	{
+		delete data_source;
+	}
+	delete game_source;
 }
 
 // Metadata for addon
@@ -425,6 +516,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 	switch (fdwReason)
 	{
 	case DLL_PROCESS_ATTACH:
+	{
+		StartupReport::mark_attach();
+		StartupReport::Phase phase("DLL attach");
+
 		if (!reshade::register_addon(hModule))
 		{
 			return false;
@@ -434,7 +529,12 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 		reshade::register_event<reshade::addon_event::init_device>(startup);
 		reshade::register_event<reshade::addon_event::init_swapchain>(on_init_swapchain);
 		reshade::register_event<reshade::addon_event::reshade_begin_effects>(inject_uniforms);
+		reshade::register_event<reshade::addon_event::reshade_finish_effects>(finish_effects);
+		reshade::register_event<reshade::addon_event::reshade_render_technique>(GpuTiming::on_render_technique);
+		reshade::register_event<reshade::addon_event::present>(QualityController::on_present);
+		reshade::register_event<reshade::addon_event::init_effect_runtime>(runtime_initialized);
 		reshade::register_event<reshade::addon_event::reshade_reloaded_effects>(shaders_reloaded);
+		reshade::register_event<reshade::addon_event::destroy_effect_runtime>(runtime_destroyed);
 		reshade::register_overlay(nullptr, draw_uniforms);
 
 #if defined RFX_GAME_GTAV
@@ -444,13 +544,19 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 		register_addon(hModule);
 
 		break;
+	}
 	case DLL_PROCESS_DETACH:
 		// Unregister addon events
 		reshade::unregister_addon(hModule);
 		reshade::unregister_event<reshade::addon_event::init_device>(startup);
 		reshade::unregister_event<reshade::addon_event::init_swapchain>(on_init_swapchain);
 		reshade::unregister_event<reshade::addon_event::reshade_begin_effects>(inject_uniforms);
+		reshade::unregister_event<reshade::addon_event::reshade_finish_effects>(finish_effects);
+		reshade::unregister_event<reshade::addon_event::reshade_render_technique>(GpuTiming::on_render_technique);
+		reshade::unregister_event<reshade::addon_event::present>(QualityController::on_present);
+		reshade::unregister_event<reshade::addon_event::init_effect_runtime>(runtime_initialized);
 		reshade::unregister_event<reshade::addon_event::reshade_reloaded_effects>(shaders_reloaded);
+		reshade::unregister_event<reshade::addon_event::destroy_effect_runtime>(runtime_destroyed);
 
 #if defined RFX_GAME_GTAV
 		unregister_depth_switcher();
@@ -30,6 +30,16 @@ static const char* weather_to_string(Weather w) {
 }
 
 
+static void lerp_layer(CloudLayer& r, const CloudLayer& b, float t) {
+    auto L = [&](float& x, float y) { x = x + (y - x) * t; };
+    L(r.scale, b.scale); L(r.detailScale, b.detailScale); L(r.stretch, b.stretch);
+    L(r.baseCurl, b.baseCurl); L(r.detailCurl, b.detailCurl); L(r.baseCurlScale, b.baseCurlScale); L(r.detailCurlScale, b.detailCurlScale);
+    L(r.smoothness, b.smoothness); L(r.softness, b.softness); L(r.bottom, b.bottom); L(r.top, b.top);
+    L(r.cover, b.cover); L(r.extinction, b.extinction); L(r.ambientAmount, b.ambientAmount); L(r.absorption, b.absorption); L(r.luminance, b.luminance);
+    L(r.sunLightPower, b.sunLightPower); L(r.moonLightPower, b.moonLightPower); L(r.skyLightPower, b.skyLightPower);
+    L(r.bottomDensity, b.bottomDensity); L(r.middleDensity, b.middleDensity); L(r.topDensity, b.topDensity);
+}
+
 static CloudPreset lerp(const CloudPreset& a, const CloudPreset& b, float t) {
     CloudPreset r = a; auto L = [&](float& x, float y) { x = x + (y - x) * t; };
     L(r.cloudScale, b.cloudScale); L(r.cloudDetailScale, b.cloudDetailScale); L(r.cloudStretch, b.cloudStretch);
@@ -43,6 +53,7 @@ static CloudPreset lerp(const CloudPreset& a, const CloudPreset& b, float t) {
     L(r.cloudSunLightPower, b.cloudSunLightPower); L(r.cloudMoonLightPower, b.cloudMoonLightPower);
     r.MoonColor.x += (b.MoonColor.x - r.MoonColor.x) * t; r.MoonColor.y += (b.MoonColor.y - r.MoonColor.y) * t; r.MoonColor.z += (b.MoonColor.z - r.MoonColor.z) * t;
     L(r.MoonlightBoost, b.MoonlightBoost); L(r.cloudSkyLightPower, b.cloudSkyLightPower); L(r.cloudDenoise, b.cloudDenoise); L(r.cloudDepthEdgeFar, b.cloudDepthEdgeFar); L(r.cloudDepthEdgeThreshold, b.cloudDepthEdgeThreshold);
+    lerp_layer(r.bottomLayer, b.bottomLayer, t); lerp_layer(r.topLayer, b.topLayer, t);
     return r;
 }
 
@@ -55,10 +66,37 @@ std::string pv::clouds::derive_presets_path(reshade::api::effect_runtime* rt) {
     return pv::path::fallback_appdata_path("PulseV_Volumetrics/PulseV_Clouds.ini");
 }
 
+// Preset for a weather/time with the same fallbacks tick() has always used
+static const CloudPreset& resolve_preset(const CloudsState& S, Weather w, const TimeBucket& b) {
+    const CloudPreset* P = S.store.try_get(w, b);
+
+    if (!P) {
+        // Fallback 1: same weather at 00:00
+        TimeBucket b00{ b.h, 0 };
+        P = S.store.try_get(w, b00);
+    }
+    if (!P) {
+        // Fallback 2: whatever the user is editing
+        P = S.store.try_get(S.edit.weather, S.edit.bucket);
+    }
+    if (!P) {
+        // Fallback 3: stick with last applied or safe defaults
+        P = &S.last_applied;
+    }
+    return *P;
+}
+
 void pv::clouds::on_effect_reload(CloudsState& S) {
     if (!S.rt) return; discover_uniforms(S.rt, S.ucache);
 }
 
+void pv::clouds::on_runtime_destroyed(CloudsState& S, reshade::api::effect_runtime* rt) {
+    if (S.rt != rt) return;
+    // Finish any queued saves before the runtime the paths came from goes away
+    S.writer.stop();
+    S.rt = nullptr; S.has_runtime = false; S.ucache = UniformCache{};
+}
+
 void pv::clouds::tick(CloudsState& S, double now) {
     if (!S.rt) return;
     if (!S.ucache.valid) { discover_uniforms(S.rt, S.ucache); }
@@ -74,21 +112,7 @@ void pv::clouds::tick(CloudsState& S, double now) {
     TimeBucket render_b = (autoApply && shv) ? nearest_bucket(live.hour, live.minute) : S.edit.bucket;
 
     // 1) Apply to the rendered weather (with robust fallbacks)
-    const CloudPreset* P_render = S.store.try_get(render_w, render_b);
-
-    if (!P_render) {
-        // Fallback 1: same weather at 00:00
-        TimeBucket b00{ render_b.h, 0 };
-        P_render = S.store.try_get(render_w, b00);
-    }
-    if (!P_render) {
-        // Fallback 2: whatever the user is editing
-        P_render = S.store.try_get(S.edit.weather, S.edit.bucket);
-    }
-    if (!P_render) {
-        // Fallback 3: stick with last applied or safe defaults
-        P_render = &S.last_applied;
-    }
+    const CloudPreset* P_render = &resolve_preset(S, render_w, render_b);
 
     float t = 1.0f;
     if (S.store.globals.blendSeconds > 0.0f) {
@@ -96,7 +120,26 @@ void pv::clouds::tick(CloudsState& S, double now) {
         t = (float)std::min(1.0, dt / S.store.globals.blendSeconds);
     }
     CloudPreset cur = lerp(S.last_applied, *P_render, t);
-    apply_preset_for_weather(S.rt, S.ucache, cur, render_w);
+    if (S.ucache.packed_layers) {
+        // Packed mode: the effect has no per-weather uniforms and blends the game's
+        // from/to weathers itself, so it gets both presets in one table. Both fade in
+        // from the last applied preset after a change the same way 'cur' does.
+        apply_preset(S.rt, S.ucache, cur);
+        if (autoApply && shv) {
+            const CloudPreset from = lerp(S.last_applied, resolve_preset(S, live.from_weather, render_b), t);
+            const CloudPreset to = lerp(S.last_applied, resolve_preset(S, live.to_weather, render_b), t);
+            apply_packed_layers(S.rt, S.ucache, from, to, live.transition);
+            S.slab = layer_slab(from, to, live.transition);
+        }
+        else {
+            apply_packed_layers(S.rt, S.ucache, cur, cur, 0.0f);
+            S.slab = layer_slab(cur, cur, 0.0f);
+        }
+    }
+    else {
+        apply_preset_for_weather(S.rt, S.ucache, cur, render_w);
+        S.slab = layer_slab(cur, cur, 0.0f);
+    }
     if (t >= 1.0f) S.last_applied = *P_render;
 }
 
@@ -235,19 +278,25 @@ void pv::clouds::draw_overlay(CloudsState& S) {
         }
 
         if (ImGui::Button("Save Preset")) {
-            auto path = derive_presets_path(S.rt); S.store.save(path);
+            auto path = derive_presets_path(S.rt); S.writer.enqueue_one(path, PresetStore::make_key(S.edit.weather, S.edit.bucket), p);
         }
         ImGui::SameLine();
         if (ImGui::Button("Save All")) {
-            auto path = derive_presets_path(S.rt); S.store.save(path);
+            auto path = derive_presets_path(S.rt); S.writer.enqueue_all(path, S.store);
         }
         ImGui::SameLine();
         if (ImGui::Button("Reload")) {
-            auto path = derive_presets_path(S.rt); S.store.load(path); S.last_change_time = 0.0;
+            auto path = derive_presets_path(S.rt); S.writer.flush(); if (S.store.load(path)) S.writer.mark_clean(S.store); S.last_change_time = 0.0;
         }
         ImGui::SameLine();
         if (ImGui::Button("Revert")) {
-            auto path = derive_presets_path(S.rt); PresetStore tmp; if (tmp.load(path)) S.store = tmp; S.last_change_time = 0.0;
+            auto path = derive_presets_path(S.rt); S.writer.flush(); PresetStore tmp; if (tmp.load(path)) { S.store = tmp; S.writer.mark_clean(S.store); } S.last_change_time = 0.0;
+        }
+        if (S.writer.busy()) {
+            ImGui::SameLine(); ImGui::TextDisabled("Saving...");
+        }
+        else if (S.writer.last_failed()) {
+            ImGui::SameLine(); ImGui::TextDisabled("Save failed, see log");
         }
 
         if (live.shv_available) {
@@ -5,6 +5,8 @@
 // Must come first so TimeBucket / Weather / PresetStore are defined here
 #include "cloud_presets.hpp"
 #include "cloud_uniforms.hpp"
+#include "march_budget.hpp"
+#include "preset_writer.hpp"
 
 namespace pv::clouds {
 
@@ -17,6 +19,7 @@ namespace pv::clouds {
 
     struct CloudsState {
         PresetStore                 store;
+        PresetWriter                writer;
         UniformCache                ucache;
         ActiveContext               edit{};
         bool                        ui_open = true;
@@ -24,11 +27,13 @@ namespace pv::clouds {
         reshade::api::effect_runtime* rt = nullptr;
         CloudPreset                 last_applied{};
         double                      last_change_time = 0.0; // seconds timeline
+        LayerSlab                   slab{};                 // layers last pushed to the effect
     };
 
     void draw_overlay(CloudsState& S);
     void tick(CloudsState& S, double now_seconds);
     void on_effect_reload(CloudsState& S);
+    void on_runtime_destroyed(CloudsState& S, reshade::api::effect_runtime* rt);
     std::string derive_presets_path(reshade::api::effect_runtime* rt);
 
 } // namespace pv::clouds
@@ -1,13 +1,16 @@
 #include "cloud_presets.hpp"
+#include "util/IniLite.hpp"
 #include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <cstring>
+#include <charconv>
+#include <string_view>
 #include <unordered_map>
 #include <string>
 
 
-#include <regex>
+#include <array>
 #include <sstream>
 #include <vector>
 using namespace pv::clouds;
@@ -62,47 +65,149 @@ namespace {
         return v;
     }
 
+    // One macro argument with whitespace and comments stripped
+    struct Arg {
+        char buf[64];
+        size_t len = 0;
+        bool gap = false; // whitespace seen after the first token
+        bool bad = false; // more than one token, or too long
+        void push(char c) {
+            if (gap || len == sizeof(buf)) { bad = true; return; }
+            buf[len++] = c;
+        }
+        std::string_view view() const { return std::string_view(buf, len); }
+    };
+
     struct ParsedLayerPreset {
         pv::clouds::Weather w;
         float values[44];
     };
 
+    // Single pass over the file: comments, string literals and preprocessor lines (with
+    // continuations) are skipped, so the CLOUD_LAYER_PRESET #define itself is never matched.
+    class FxhScanner {
+    public:
+        explicit FxhScanner(std::string_view text) : s(text) {}
+
+        // Advance to the next "CLOUD_LAYER_PRESET(" at file scope; false at end of input
+        bool next_invocation() {
+            bool line_start = true;
+            while (i < s.size()) {
+                const char c = s[i];
+                if (c == '\n') { line_start = true; ++i; continue; }
+                if (c == ' ' || c == '\t' || c == '\r') { ++i; continue; }
+                if (line_start && c == '#') { skip_directive(); continue; }
+                line_start = false;
+                if (skip_comment() || skip_string()) continue;
+                if (is_ident_start(c)) {
+                    const size_t b = i;
+                    while (i < s.size() && is_ident(s[i])) ++i;
+                    if (s.substr(b, i - b) != "CLOUD_LAYER_PRESET") continue;
+                    skip_space_and_comments();
+                    if (i < s.size() && s[i] == '(') { ++i; return true; }
+                    continue;
+                }
+                ++i;
+            }
+            return false;
+        }
+
+        // Split the invocation's arguments at top-level commas, with whitespace and comments
+        // removed. Returns false on malformed input or when there are not exactly 'max_args'.
+        template <size_t max_args>
+        bool read_args(std::array<Arg, max_args>& args) {
+            size_t n = 0; int depth = 0;
+            Arg cur;
+            while (i < s.size()) {
+                if (skip_comment() || skip_string()) { cur.gap = cur.len > 0; continue; }
+                const char c = s[i++];
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') { cur.gap = cur.len > 0; continue; }
+                if (depth == 0 && (c == ',' || c == ')')) {
+                    if (n == max_args || cur.bad || cur.len == 0) return false;
+                    args[n++] = cur; cur = Arg{};
+                    if (c == ')') return n == max_args;
+                    continue;
+                }
+                if (c == '(') ++depth;
+                else if (c == ')') --depth;
+                cur.push(c);
+            }
+            return false;
+        }
+
+    private:
+        static bool is_ident_start(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'; }
+        static bool is_ident(char c) { return is_ident_start(c) || (c >= '0' && c <= '9'); }
+
+        bool skip_comment() {
+            if (i + 1 >= s.size() || s[i] != '/') return false;
+            if (s[i + 1] == '/') { const size_t e = s.find('\n', i); i = (e == std::string_view::npos) ? s.size() : e; return true; }
+            if (s[i + 1] == '*') { const size_t e = s.find("*/", i + 2); i = (e == std::string_view::npos) ? s.size() : e + 2; return true; }
+            return false;
+        }
+
+        bool skip_string() {
+            if (s[i] != '"') return false;
+            for (++i; i < s.size() && s[i] != '"' && s[i] != '\n'; ++i) {
+                if (s[i] == '\\') ++i;
+            }
+            if (i < s.size()) ++i;
+            return true;
+        }
+
+        void skip_space_and_comments() {
+            while (i < s.size()) {
+                const char c = s[i];
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') { ++i; continue; }
+                if (!skip_comment()) break;
+            }
+        }
+
+        void skip_directive() {
+            while (i < s.size()) {
+                if (s[i] == '\\' && (s.compare(i + 1, 1, "\n") == 0 || s.compare(i + 1, 2, "\r\n") == 0)) {
+                    i += (s[i + 1] == '\r') ? 3 : 2; continue;
+                }
+                if (s[i] == '\n') return;
+                if (!skip_comment()) ++i;
+            }
+        }
+
+        std::string_view s;
+        size_t i = 0;
+    };
+
+    static bool parse_number(const Arg& a, float& out) {
+        const char* first = a.buf;
+        const char* last = a.buf + a.len;
+        if (first < last && *first == '+') ++first;
+        if (last > first && (last[-1] == 'f' || last[-1] == 'F')) --last;
+        const auto r = std::from_chars(first, last, out);
+        return r.ec == std::errc() && r.ptr == last;
+    }
+
     static std::unordered_map<pv::clouds::Weather, ParsedLayerPreset>
         parse_weathers_fxh(const std::string& path) {
         std::unordered_map<pv::clouds::Weather, ParsedLayerPreset> out;
         const std::string text = slurp_file(path);
         if (text.empty()) return out;
 
-        const std::regex call_re(R"(CLOUD_LAYER_PRESET\s*\(\s*([A-Za-z_]\w*)\s*,([\s\S]*?)\))");
-        auto it = std::sregex_iterator(text.begin(), text.end(), call_re);
-        const auto end = std::sregex_iterator();
-
-        for (; it != end; ++it) {
-            const std::string name = (*it)[1].str();
-            if (name == "PRESET") continue;
+        FxhScanner scan(text);
+        std::array<Arg, 45> args;
+        while (scan.next_invocation()) {
+            if (!scan.read_args(args)) continue;
 
             pv::clouds::Weather w;
-            if (!parse_weather_token(name, w)) {
+            if (!parse_weather_token(std::string(args[0].view()), w)) {
                 continue;
             }
 
-            std::string args = (*it)[2].str();
-
-            static const std::regex cmt_re(R"(\/\/[^\n\r]*)");
-            args = std::regex_replace(args, cmt_re, std::string());
-
-            static const std::regex num_re(R"([+-]?(?:\d+\.\d*|\.\d+|\d+))");
-            std::vector<float> nums;
-            for (auto jt = std::sregex_iterator(args.begin(), args.end(), num_re);
-                jt != std::sregex_iterator(); ++jt) {
-                nums.push_back(std::strtof((*jt).str().c_str(), nullptr));
-            }
-            if (nums.size() != 44) {
+            ParsedLayerPreset P; P.w = w;
+            bool ok = true;
+            for (size_t k = 0; k < 44 && ok; ++k) ok = parse_number(args[k + 1], P.values[k]);
+            if (!ok) {
                 continue;
             }
-
-            ParsedLayerPreset P; P.w = w;
-            for (size_t i = 0; i < 44; ++i) P.values[i] = nums[i];
             out[w] = P;
         }
         return out;
@@ -118,96 +223,6 @@ namespace {
 
 
 
-// --- Minimal INI shim (used if your project doesn't provide util/IniLite.hpp) ---
-namespace pv {
-    namespace clouds {
-        struct IniLite {
-            struct Section {
-                std::unordered_map<std::string, std::string> kv;
-                float get_float(const char* key, float def) const {
-                    std::unordered_map<std::string, std::string>::const_iterator it = kv.find(std::string(key));
-                    if (it == kv.end()) return def;
-                    const std::string& s = it->second;
-                    char* endp = 0;
-                    float v = std::strtof(s.c_str(), &endp);
-                    return (endp == s.c_str()) ? def : v;
-                }
-                void set(const char* key, float v) {
-                    char buf[64];
-                    std::snprintf(buf, sizeof(buf), "%.6g", v);
-                    kv[std::string(key)] = std::string(buf);
-                }
-                void set(const char* key, const std::string& v) {
-                    kv[std::string(key)] = v;
-                }
-            };
-            std::unordered_map<std::string, Section> sections;
-
-            static std::string trim(const std::string& s) {
-                size_t a = 0, b = s.size();
-                while (a < b && (s[a] == ' ' || s[a] == '\t' || s[a] == '\r')) ++a;
-                while (b > a && (s[b - 1] == ' ' || s[b - 1] == '\t' || s[b - 1] == '\r')) --b;
-                return s.substr(a, b - a);
-            }
-            static bool starts_with(const std::string& s, const char* pfx) {
-                size_t n = std::strlen(pfx);
-                return s.size() >= n && s.compare(0, n, pfx) == 0;
-            }
-
-            bool load(const std::string& path) {
-                sections.clear();
-                std::ifstream f(path.c_str());
-                if (!f.is_open()) return false;
-                std::string line;
-                std::string current;
-                while (std::getline(f, line)) {
-                    // strip comments ; or #
-                    size_t sc = line.find(';');
-                    size_t hc = line.find('#');
-                    size_t cpos = std::string::npos;
-                    if (sc != std::string::npos && hc != std::string::npos) cpos = (sc < hc ? sc : hc);
-                    else if (sc != std::string::npos) cpos = sc;
-                    else if (hc != std::string::npos) cpos = hc;
-                    if (cpos != std::string::npos) line = line.substr(0, cpos);
-
-                    line = trim(line);
-                    if (line.empty()) continue;
-
-                    if (line[0] == '[' && line.size() > 2 && line[line.size() - 1] == ']') {
-                        current = trim(line.substr(1, line.size() - 2));
-                        (void)sections[current]; // ensure section exists
-                        continue;
-                    }
-                    size_t eq = line.find('=');
-                    if (eq == std::string::npos) continue;
-                    std::string key = trim(line.substr(0, eq));
-                    std::string val = trim(line.substr(eq + 1));
-                    if (!current.empty()) {
-                        sections[current].kv[key] = val;
-                    }
-                }
-                return true;
-            }
-
-            bool save(const std::string& path) const {
-                std::ofstream f(path.c_str());
-                if (!f.is_open()) return false;
-                for (std::unordered_map<std::string, Section>::const_iterator it = sections.begin();
-                    it != sections.end(); ++it) {
-                    f << "[" << it->first << "]\n";
-                    const Section& s = it->second;
-                    for (std::unordered_map<std::string, std::string>::const_iterator kv = s.kv.begin();
-                        kv != s.kv.end(); ++kv) {
-                        f << kv->first << "=" << kv->second << "\n";
-                    }
-                    f << "\n";
-                }
-                return true;
-            }
-        };
-    }
-} // namespace pv::clouds
-// --- end INI shim ---
 
 
 
@@ -216,17 +231,24 @@ static const char* kWeatherNames[] = {
   "SMOG","FOGGY","XMAS","SNOW","SNOWLIGHT","BLIZZARD","HALLOWEEN","NEUTRAL"
 };
 
-static std::string two(int v) { char b[8]; std::snprintf(b, sizeof(b), "%02d", v); return b; }
 
-std::string PresetStore::make_key(Weather w, const TimeBucket& b) {
+// "WEATHER_HH:MM" into 'out', which try_get looks up every frame without allocating
+static std::string_view format_key(Weather w, const TimeBucket& b, char (&out)[32]) {
     int wi = static_cast<int>(w);
     if (wi < 0) wi = 0;
     if (wi >= static_cast<int>(Weather::COUNT)) wi = static_cast<int>(Weather::COUNT) - 1;
-    return std::string(kWeatherNames[wi]) + "_" + two(b.h) + ":" + two(b.m);
+    const int n = std::snprintf(out, sizeof(out), "%s_%02d:%02d", kWeatherNames[wi], b.h, b.m);
+    return std::string_view(out, n > 0 ? std::min<size_t>(n, sizeof(out) - 1) : 0);
+}
+
+std::string PresetStore::make_key(Weather w, const TimeBucket& b) {
+    char key[32];
+    return std::string(format_key(w, b, key));
 }
 
 const CloudPreset* PresetStore::try_get(Weather w, const TimeBucket& b) const {
-    std::unordered_map<std::string, CloudPreset>::const_iterator it = map.find(make_key(w, b));
+    char key[32];
+    const auto it = map.find(format_key(w, b, key));
     return (it == map.end()) ? NULL : &it->second;
 }
 
@@ -235,22 +257,21 @@ CloudPreset& PresetStore::get_or_create(Weather w, const TimeBucket& b) {
 }
 
 bool PresetStore::load(const std::string& ini_path) {
-    IniLite ini;
+    pv::ini::Ini ini(pv::ini::PRESET_COMMENTS);
     if (!ini.load(ini_path)) return false;
 
     map.clear();
+    map.reserve(ini.sections().size());
 
-    for (std::unordered_map<std::string, decltype(ini.sections)::mapped_type>::iterator it = ini.sections.begin();
-        it != ini.sections.end(); ++it)
+    for (const pv::ini::Section& kv : ini.sections())
     {
-        const std::string& sec_name = it->first;
-        auto& kv = it->second;
+        const std::string_view sec_name = kv.name;
 
         // Parse "WEATHER_HH:MM"
-        std::string::size_type us = sec_name.find('_');
-        if (us == std::string::npos) continue;
-        std::string weather_str = sec_name.substr(0, us);
-        std::string time_str = sec_name.substr(us + 1);
+        std::string_view::size_type us = sec_name.find('_');
+        if (us == std::string_view::npos) continue;
+        const std::string_view weather_str = sec_name.substr(0, us);
+        const std::string_view time_str = sec_name.substr(us + 1);
 
         // Weather to index
         int wi = -1;
@@ -264,8 +285,11 @@ bool PresetStore::load(const std::string& ini_path) {
         b.h = 12; b.m = 0;
         if (time_str.size() >= 4) {
             int hh = 12, mm = 0;
-            const int parsed = std::sscanf(time_str.c_str(), "%d:%d", &hh, &mm);
-            if (parsed == 2) {
+            const char* first = time_str.data();
+            const char* last = first + time_str.size();
+            const auto rh = std::from_chars(first, last, hh);
+            if (rh.ec == std::errc() && rh.ptr < last && *rh.ptr == ':'
+                && std::from_chars(rh.ptr + 1, last, mm).ec == std::errc()) {
                 // Clamp to sane ranges
                 if (hh < 0) hh = 0; else if (hh > 23) hh = 23;
                 if (mm < 0) mm = 0; else if (mm > 59) mm = 59;
@@ -310,31 +334,38 @@ bool PresetStore::load(const std::string& ini_path) {
         const char* whiches[2] = { "Bottom", "Top" };
         CloudLayer* layers[2] = { &p.bottomLayer, &p.topLayer };
         for (int li = 0; li < 2; ++li) {
-            const char* which = whiches[li];
             CloudLayer& L = *layers[li];
-            std::string W(which);
-            L.scale = kv.get_float((W + "Scale").c_str(), L.scale);
-            L.detailScale = kv.get_float((W + "DetailScale").c_str(), L.detailScale);
-            L.stretch = kv.get_float((W + "Stretch").c_str(), L.stretch);
-            L.baseCurl = kv.get_float((W + "BaseCurl").c_str(), L.baseCurl);
-            L.detailCurl = kv.get_float((W + "DetailCurl").c_str(), L.detailCurl);
-            L.baseCurlScale = kv.get_float((W + "BaseCurlScale").c_str(), L.baseCurlScale);
-            L.detailCurlScale = kv.get_float((W + "DetailCurlScale").c_str(), L.detailCurlScale);
-            L.smoothness = kv.get_float((W + "Smoothness").c_str(), L.smoothness);
-            L.softness = kv.get_float((W + "Softness").c_str(), L.softness);
-            L.bottom = kv.get_float((W + "Bottom").c_str(), L.bottom);
-            L.top = kv.get_float((W + "Top").c_str(), L.top);
-            L.cover = kv.get_float((W + "Cover").c_str(), L.cover);
-            L.extinction = kv.get_float((W + "Extinction").c_str(), L.extinction);
-            L.ambientAmount = kv.get_float((W + "AmbientAmount").c_str(), L.ambientAmount);
-            L.absorption = kv.get_float((W + "Absorption").c_str(), L.absorption);
-            L.luminance = kv.get_float((W + "Luminance").c_str(), L.luminance);
-            L.sunLightPower = kv.get_float((W + "SunLightPower").c_str(), L.sunLightPower);
-            L.moonLightPower = kv.get_float((W + "MoonLightPower").c_str(), L.moonLightPower);
-            L.skyLightPower = kv.get_float((W + "SkyLightPower").c_str(), L.skyLightPower);
-            L.bottomDensity = kv.get_float((W + "BottomDensity").c_str(), L.bottomDensity);
-            L.middleDensity = kv.get_float((W + "MiddleDensity").c_str(), L.middleDensity);
-            L.topDensity = kv.get_float((W + "TopDensity").c_str(), L.topDensity);
+            // Builds "<Bottom|Top><Field>" in a stack buffer instead of a heap string per key
+            char name[64];
+            const size_t prefix = std::strlen(whiches[li]);
+            std::memcpy(name, whiches[li], prefix);
+            auto W = [&](const char* field) {
+                const size_t n = std::strlen(field);
+                std::memcpy(name + prefix, field, n);
+                return std::string_view(name, prefix + n);
+            };
+            L.scale = kv.get_float(W("Scale"), L.scale);
+            L.detailScale = kv.get_float(W("DetailScale"), L.detailScale);
+            L.stretch = kv.get_float(W("Stretch"), L.stretch);
+            L.baseCurl = kv.get_float(W("BaseCurl"), L.baseCurl);
+            L.detailCurl = kv.get_float(W("DetailCurl"), L.detailCurl);
+            L.baseCurlScale = kv.get_float(W("BaseCurlScale"), L.baseCurlScale);
+            L.detailCurlScale = kv.get_float(W("DetailCurlScale"), L.detailCurlScale);
+            L.smoothness = kv.get_float(W("Smoothness"), L.smoothness);
+            L.softness = kv.get_float(W("Softness"), L.softness);
+            L.bottom = kv.get_float(W("Bottom"), L.bottom);
+            L.top = kv.get_float(W("Top"), L.top);
+            L.cover = kv.get_float(W("Cover"), L.cover);
+            L.extinction = kv.get_float(W("Extinction"), L.extinction);
+            L.ambientAmount = kv.get_float(W("AmbientAmount"), L.ambientAmount);
+            L.absorption = kv.get_float(W("Absorption"), L.absorption);
+            L.luminance = kv.get_float(W("Luminance"), L.luminance);
+            L.sunLightPower = kv.get_float(W("SunLightPower"), L.sunLightPower);
+            L.moonLightPower = kv.get_float(W("MoonLightPower"), L.moonLightPower);
+            L.skyLightPower = kv.get_float(W("SkyLightPower"), L.skyLightPower);
+            L.bottomDensity = kv.get_float(W("BottomDensity"), L.bottomDensity);
+            L.middleDensity = kv.get_float(W("MiddleDensity"), L.middleDensity);
+            L.topDensity = kv.get_float(W("TopDensity"), L.topDensity);
         }
 
         map[make_key(static_cast<Weather>(wi), b)] = p;
@@ -343,78 +374,100 @@ bool PresetStore::load(const std::string& ini_path) {
     return true;
 }
 
-bool PresetStore::save(const std::string& ini_path) const {
-    IniLite ini;
-    for (std::unordered_map<std::string, CloudPreset>::const_iterator it = map.begin();
-        it != map.end(); ++it)
-    {
-        const std::string& key = it->first;
-        const CloudPreset& p = it->second;
-        auto& sec = ini.sections[key];
-
-        // Global
-        sec.set("cloudScale", p.cloudScale);
-        sec.set("cloudDetailScale", p.cloudDetailScale);
-        sec.set("cloudStretch", p.cloudStretch);
-        sec.set("cloudHeightOffset", p.cloudHeightOffset);
-        sec.set("cloudBaseCurl", p.cloudBaseCurl);
-        sec.set("cloudDetailCurl", p.cloudDetailCurl);
-        sec.set("cloudBaseCurlScale", p.cloudBaseCurlScale);
-        sec.set("cloudDetailCurlScale", p.cloudDetailCurlScale);
-        sec.set("cloudYFade", p.cloudYFade);
-        sec.set("cloudCover", p.cloudCover);
-        sec.set("cloudThreshold", p.cloudThreshold);
-        sec.set("cloudJitter", p.cloudJitter);
-        sec.set("cloudExtinction", p.cloudExtinction);
-        sec.set("cloudAmbientAmount", p.cloudAmbientAmount);
-        sec.set("cloudAbsorption", p.cloudAbsorption);
-        sec.set("cloudForwardScatter", p.cloudForwardScatter);
-        sec.set("cloudLightStepFactor", p.cloudLightStepFactor);
-        sec.set("cloudContrast", p.cloudContrast);
-        sec.set("cloudLuminanceMultiplier", p.cloudLuminanceMultiplier);
-        sec.set("cloudSunLightPower", p.cloudSunLightPower);
-        sec.set("cloudMoonLightPower", p.cloudMoonLightPower);
-        sec.set("MoonColor.x", p.MoonColor.x);
-        sec.set("MoonColor.y", p.MoonColor.y);
-        sec.set("MoonColor.z", p.MoonColor.z);
-        sec.set("MoonlightBoost", p.MoonlightBoost);
-        sec.set("cloudSkyLightPower", p.cloudSkyLightPower);
-        sec.set("cloudDenoise", p.cloudDenoise);
-        sec.set("cloudDepthEdgeFar", p.cloudDepthEdgeFar);
-        sec.set("cloudDepthEdgeThreshold", p.cloudDepthEdgeThreshold);
+PresetFields pv::clouds::preset_fields(const CloudPreset& p) {
+    PresetFields out;
+    out.reserve(29 + 2 * 22);
+    auto set = [&out](std::string key, float v) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.6g", v);
+        out.emplace_back(std::move(key), std::string(buf));
+    };
 
-        // Layers
-        const char* whiches[2] = { "Bottom", "Top" };
-        const CloudLayer* layers[2] = { &p.bottomLayer, &p.topLayer };
-        for (int li = 0; li < 2; ++li) {
-            const char* which = whiches[li];
-            const CloudLayer& L = *layers[li];
-            std::string W(which);
-            sec.set((W + "Scale").c_str(), L.scale);
-            sec.set((W + "DetailScale").c_str(), L.detailScale);
-            sec.set((W + "Stretch").c_str(), L.stretch);
-            sec.set((W + "BaseCurl").c_str(), L.baseCurl);
-            sec.set((W + "DetailCurl").c_str(), L.detailCurl);
-            sec.set((W + "BaseCurlScale").c_str(), L.baseCurlScale);
-            sec.set((W + "DetailCurlScale").c_str(), L.detailCurlScale);
-            sec.set((W + "Smoothness").c_str(), L.smoothness);
-            sec.set((W + "Softness").c_str(), L.softness);
-            sec.set((W + "Bottom").c_str(), L.bottom);
-            sec.set((W + "Top").c_str(), L.top);
-            sec.set((W + "Cover").c_str(), L.cover);
-            sec.set((W + "Extinction").c_str(), L.extinction);
-            sec.set((W + "AmbientAmount").c_str(), L.ambientAmount);
-            sec.set((W + "Absorption").c_str(), L.absorption);
-            sec.set((W + "Luminance").c_str(), L.luminance);
-            sec.set((W + "SunLightPower").c_str(), L.sunLightPower);
-            sec.set((W + "MoonLightPower").c_str(), L.moonLightPower);
-            sec.set((W + "SkyLightPower").c_str(), L.skyLightPower);
-            sec.set((W + "BottomDensity").c_str(), L.bottomDensity);
-            sec.set((W + "MiddleDensity").c_str(), L.middleDensity);
-            sec.set((W + "TopDensity").c_str(), L.topDensity);
+    // Global
+    set("cloudScale", p.cloudScale);
+    set("cloudDetailScale", p.cloudDetailScale);
+    set("cloudStretch", p.cloudStretch);
+    set("cloudHeightOffset", p.cloudHeightOffset);
+    set("cloudBaseCurl", p.cloudBaseCurl);
+    set("cloudDetailCurl", p.cloudDetailCurl);
+    set("cloudBaseCurlScale", p.cloudBaseCurlScale);
+    set("cloudDetailCurlScale", p.cloudDetailCurlScale);
+    set("cloudYFade", p.cloudYFade);
+    set("cloudCover", p.cloudCover);
+    set("cloudThreshold", p.cloudThreshold);
+    set("cloudJitter", p.cloudJitter);
+    set("cloudExtinction", p.cloudExtinction);
+    set("cloudAmbientAmount", p.cloudAmbientAmount);
+    set("cloudAbsorption", p.cloudAbsorption);
+    set("cloudForwardScatter", p.cloudForwardScatter);
+    set("cloudLightStepFactor", p.cloudLightStepFactor);
+    set("cloudContrast", p.cloudContrast);
+    set("cloudLuminanceMultiplier", p.cloudLuminanceMultiplier);
+    set("cloudSunLightPower", p.cloudSunLightPower);
+    set("cloudMoonLightPower", p.cloudMoonLightPower);
+    set("MoonColor.x", p.MoonColor.x);
+    set("MoonColor.y", p.MoonColor.y);
+    set("MoonColor.z", p.MoonColor.z);
+    set("MoonlightBoost", p.MoonlightBoost);
+    set("cloudSkyLightPower", p.cloudSkyLightPower);
+    set("cloudDenoise", p.cloudDenoise);
+    set("cloudDepthEdgeFar", p.cloudDepthEdgeFar);
+    set("cloudDepthEdgeThreshold", p.cloudDepthEdgeThreshold);
+
+    // Layers
+    const char* whiches[2] = { "Bottom", "Top" };
+    const CloudLayer* layers[2] = { &p.bottomLayer, &p.topLayer };
+    for (int li = 0; li < 2; ++li) {
+        const CloudLayer& L = *layers[li];
+        std::string W(whiches[li]);
+        set(W + "Scale", L.scale);
+        set(W + "DetailScale", L.detailScale);
+        set(W + "Stretch", L.stretch);
+        set(W + "BaseCurl", L.baseCurl);
+        set(W + "DetailCurl", L.detailCurl);
+        set(W + "BaseCurlScale", L.baseCurlScale);
+        set(W + "DetailCurlScale", L.detailCurlScale);
+        set(W + "Smoothness", L.smoothness);
+        set(W + "Softness", L.softness);
+        set(W + "Bottom", L.bottom);
+        set(W + "Top", L.top);
+        set(W + "Cover", L.cover);
+        set(W + "Extinction", L.extinction);
+        set(W + "AmbientAmount", L.ambientAmount);
+        set(W + "Absorption", L.absorption);
+        set(W + "Luminance", L.luminance);
+        set(W + "SunLightPower", L.sunLightPower);
+        set(W + "MoonLightPower", L.moonLightPower);
+        set(W + "SkyLightPower", L.skyLightPower);
+        set(W + "BottomDensity", L.bottomDensity);
+        set(W + "MiddleDensity", L.middleDensity);
+        set(W + "TopDensity", L.topDensity);
+    }
+    return out;
+}
+
+bool pv::clouds::preset_equal(const CloudPreset& a, const CloudPreset& b) {
+    // CloudPreset is all floats, so a byte compare is an exact "unchanged" test
+    return std::memcmp(&a, &b, sizeof(CloudPreset)) == 0;
+}
+
+bool PresetStore::save(const std::string& ini_path) const {
+    // Sections are written sorted so the file is stable between saves
+    std::vector<std::string> keys;
+    keys.reserve(map.size());
+    for (const auto& kv : map) keys.push_back(kv.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::ofstream f(ini_path.c_str());
+    if (!f.is_open()) return false;
+    for (const auto& key : keys) {
+        f << "[" << key << "]\n";
+        for (const auto& field : preset_fields(map.at(key))) {
+            f << field.first << "=" << field.second << "\n";
         }
+        f << "\n";
     }
-    return ini.save(ini_path);
+    return f.good();
 }
 
 bool PresetStore::load_from_weathers_file(const std::string& shaders_folder) {
@@ -1,7 +1,10 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <cstdint>
+#include "util/StringHash.hpp"
 
 // Avoid Windows macro collisions
 #ifdef CLEAR
@@ -100,7 +103,7 @@ struct GlobalConfig {
     float blendSeconds = 1.0f;
 };
 
-using PresetMap = std::unordered_map<std::string, CloudPreset>;
+using PresetMap = pv::StringMap<CloudPreset>;
 
 struct PresetStore {
     GlobalConfig globals{};
@@ -117,4 +120,9 @@ struct PresetStore {
 
 TimeBucket nearest_bucket(int h, int m);
 
+// Ordered "key=value" pairs for one INI section, in the order they are written to disk
+using PresetFields = std::vector<std::pair<std::string, std::string>>;
+PresetFields preset_fields(const CloudPreset& p);
+bool preset_equal(const CloudPreset& a, const CloudPreset& b);
+
 } // namespace pv::clouds
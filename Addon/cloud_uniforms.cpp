@@ -1,9 +1,15 @@
 #include "cloud_uniforms.hpp"
+#include "uniform_capture.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <string>
 
 using namespace pv::clouds;
 
+static uint64_t uniform_writes = 0;
+static UniformCapture::Writer* uniform_capture = nullptr;
+
 static bool is_float_scalar(const UniformHandle& h) {
     return (h.format == reshade::api::format::r32_float) && h.rows == 1 && h.columns == 1 && h.elements <= 1;
 }
@@ -12,7 +18,7 @@ static bool is_float3(const UniformHandle& h) {
 }
 
 void pv::clouds::discover_uniforms(reshade::api::effect_runtime* rt, UniformCache& c) {
-    c.by_name.clear(); c.valid = false;
+    c.by_name.clear(); c.packed_layers = nullptr; c.valid = false;
     rt->enumerate_uniform_variables(nullptr, [&](reshade::api::effect_runtime* runtime, reshade::api::effect_uniform_variable v) {
         char name[128] = {}; runtime->get_uniform_variable_name(v, name);
         reshade::api::format fmt = reshade::api::format::unknown; uint32_t cols = 0, rows = 0, elems = 0;
@@ -20,24 +26,41 @@ void pv::clouds::discover_uniforms(reshade::api::effect_runtime* rt, UniformCach
         UniformHandle h; h.var = v; h.format = fmt; h.columns = cols; h.rows = rows; h.elements = elems;
         c.by_name.emplace(name, h);
     });
+    const auto packed = c.by_name.find("cloudPackedLayers");
+    c.packed_layers = (packed != c.by_name.end() && packed->second.elements >= kPackedLayerFloat4s) ? &packed->second : nullptr;
     c.valid = !c.by_name.empty();
 }
 
+uint64_t pv::clouds::get_uniform_write_count() {
+    return uniform_writes;
+}
+
+void pv::clouds::set_uniform_capture(UniformCapture::Writer* capture) {
+    uniform_capture = capture;
+}
+
+// Every write to the effect goes through here so it is counted and captured
+static void write_floats(reshade::api::effect_runtime* rt, const char* name, const UniformHandle& h, const float* values, size_t count) {
+    ++uniform_writes;
+    rt->set_uniform_value_float(h.var, values, count, 0 /*array_index*/);
+    if (uniform_capture) uniform_capture->record_floats(name, values, count);
+}
+
 static void set_scalar(reshade::api::effect_runtime* rt, const UniformCache& c, const char* n, float v) {
     auto it = c.by_name.find(n);
     if (it == c.by_name.end()) return;
     const auto& h = it->second;
     if (!is_float_scalar(h)) return;
-    rt->set_uniform_value_float(h.var, &v, 1 /*count*/, 0 /*array_index*/);
+    write_floats(rt, n, h, &v, 1);
 }
 
-static void set_float3(reshade::api::effect_runtime* rt, const UniformCache& c, const char* n, const Float3& v) {
+static void set_float3(reshade::api::effect_runtime* rt, const UniformCache& c, const char* n, const pv::clouds::Float3& v) {
     auto it = c.by_name.find(n);
     if (it == c.by_name.end()) return;
     const auto& h = it->second;
     if (!is_float3(h)) return;
     const float a[3] = { v.x, v.y, v.z };
-    rt->set_uniform_value_float(h.var, a, 3 /*count*/, 0 /*array_index*/);
+    write_floats(rt, n, h, a, 3);
 }
 
 void pv::clouds::apply_preset(reshade::api::effect_runtime* rt, const UniformCache& c, const CloudPreset& p) {
@@ -97,36 +120,65 @@ static void apply_layer_for(reshade::api::effect_runtime* rt,
                             const char* which,   // "Bottom" or "Top"
                             const CloudLayer& L)
 {
-    const std::string P = std::string(W) + which;
-
-    set_scalar(rt, c, (P + "Scale").c_str(),           L.scale);
-    set_scalar(rt, c, (P + "DetailScale").c_str(),     L.detailScale);
-    set_scalar(rt, c, (P + "Stretch").c_str(),         L.stretch);
-
-    set_scalar(rt, c, (P + "BaseCurl").c_str(),        L.baseCurl);
-    set_scalar(rt, c, (P + "DetailCurl").c_str(),      L.detailCurl);
-    set_scalar(rt, c, (P + "BaseCurlScale").c_str(),   L.baseCurlScale);
-    set_scalar(rt, c, (P + "DetailCurlScale").c_str(), L.detailCurlScale);
-
-    set_scalar(rt, c, (P + "Smoothness").c_str(),      L.smoothness);
-    set_scalar(rt, c, (P + "Softness").c_str(),        L.softness);
-
-    set_scalar(rt, c, (P + "Bottom").c_str(),          L.bottom);
-    set_scalar(rt, c, (P + "Top").c_str(),             L.top);
+    // Names are built in place, this runs every frame
+    char name[64];
+    const size_t prefix = (size_t)std::snprintf(name, sizeof(name), "%s%s", W, which);
+    const auto field = [&](const char* suffix) {
+        const size_t n = std::min(std::strlen(suffix), sizeof(name) - 1 - prefix);
+        std::memcpy(name + prefix, suffix, n);
+        name[prefix + n] = '\0';
+        return name;
+    };
+
+    set_scalar(rt, c, field("Scale"),           L.scale);
+    set_scalar(rt, c, field("DetailScale"),     L.detailScale);
+    set_scalar(rt, c, field("Stretch"),         L.stretch);
+
+    set_scalar(rt, c, field("BaseCurl"),        L.baseCurl);
+    set_scalar(rt, c, field("DetailCurl"),      L.detailCurl);
+    set_scalar(rt, c, field("BaseCurlScale"),   L.baseCurlScale);
+    set_scalar(rt, c, field("DetailCurlScale"), L.detailCurlScale);
+
+    set_scalar(rt, c, field("Smoothness"),      L.smoothness);
+    set_scalar(rt, c, field("Softness"),        L.softness);
+
+    set_scalar(rt, c, field("Bottom"),          L.bottom);
+    set_scalar(rt, c, field("Top"),             L.top);
+
+    set_scalar(rt, c, field("Cover"),           L.cover);
+    set_scalar(rt, c, field("Extinction"),      L.extinction);
+    set_scalar(rt, c, field("AmbientAmount"),   L.ambientAmount);
+    set_scalar(rt, c, field("Absorption"),      L.absorption);
+    set_scalar(rt, c, field("Luminance"),       L.luminance);
+
+    set_scalar(rt, c, field("SunLightPower"),   L.sunLightPower);
+    set_scalar(rt, c, field("MoonLightPower"),  L.moonLightPower);
+    set_scalar(rt, c, field("SkyLightPower"),   L.skyLightPower);
+
+    set_scalar(rt, c, field("BottomDensity"),   L.bottomDensity);
+    set_scalar(rt, c, field("MiddleDensity"),   L.middleDensity);
+    set_scalar(rt, c, field("TopDensity"),      L.topDensity);
+}
 
-    set_scalar(rt, c, (P + "Cover").c_str(),           L.cover);
-    set_scalar(rt, c, (P + "Extinction").c_str(),      L.extinction);
-    set_scalar(rt, c, (P + "AmbientAmount").c_str(),   L.ambientAmount);
-    set_scalar(rt, c, (P + "Absorption").c_str(),      L.absorption);
-    set_scalar(rt, c, (P + "Luminance").c_str(),       L.luminance);
+bool pv::clouds::apply_packed_layers(reshade::api::effect_runtime* rt,
+                                     const UniformCache& c,
+                                     const CloudPreset& from,
+                                     const CloudPreset& to,
+                                     float blend)
+{
+    static_assert(sizeof(CloudLayer) == 22 * sizeof(float), "CloudLayer must stay a flat list of floats to be packed");
+    if (!c.packed_layers) return false;
 
-    set_scalar(rt, c, (P + "SunLightPower").c_str(),   L.sunLightPower);
-    set_scalar(rt, c, (P + "MoonLightPower").c_str(),  L.moonLightPower);
-    set_scalar(rt, c, (P + "SkyLightPower").c_str(),   L.skyLightPower);
+    float table[kPackedLayerFloat4s * 4] = {};
+    const CloudLayer* layers[4] = { &from.bottomLayer, &from.topLayer, &to.bottomLayer, &to.topLayer };
+    for (int i = 0; i < 4; ++i) {
+        std::memcpy(table + i * kPackedFloat4sPerLayer * 4, layers[i], sizeof(CloudLayer));
+    }
+    table[4 * kPackedFloat4sPerLayer * 4] = blend;
 
-    set_scalar(rt, c, (P + "BottomDensity").c_str(),   L.bottomDensity);
-    set_scalar(rt, c, (P + "MiddleDensity").c_str(),   L.middleDensity);
-    set_scalar(rt, c, (P + "TopDensity").c_str(),      L.topDensity);
+    // One upload for all four layers instead of 88 scalar writes
+    write_floats(rt, "cloudPackedLayers", *c.packed_layers, table, kPackedLayerFloat4s * 4);
+    return true;
 }
 
 void pv::clouds::apply_preset_for_weather(reshade::api::effect_runtime* rt,
@@ -3,6 +3,9 @@
 #include <unordered_map>
 #include <reshade.hpp>
 #include "cloud_presets.hpp"
+#include "util/StringHash.hpp"
+
+namespace UniformCapture { class Writer; }
 
 namespace pv::clouds {
 
@@ -13,10 +16,23 @@ struct UniformHandle {
 };
 
 struct UniformCache {
-    std::unordered_map<std::string, UniformHandle> by_name;
+    pv::StringMap<UniformHandle> by_name;
+    const UniformHandle* packed_layers = nullptr; // set when the effect was built with PACKED_LAYERS=1
     bool valid = false;
 };
 
+// Layout of the packed layer table ("cloudPackedLayers" in the effect): 6 float4 per layer
+// holding the CloudLayer fields in declaration order, for from-bottom, from-top, to-bottom
+// and to-top, followed by one float4 whose x is the from -> to blend factor.
+constexpr uint32_t kPackedFloat4sPerLayer = 6;
+constexpr uint32_t kPackedLayerFloat4s = 4 * kPackedFloat4sPerLayer + 1;
+
+// Number of uniform writes this module has made, the injection stats count them per frame.
+uint64_t get_uniform_write_count();
+
+// Records every value written from now on into 'capture' under the uniform's name, nullptr stops.
+void set_uniform_capture(UniformCapture::Writer* capture);
+
 // Discover all uniform variables in the active effect into 'out_cache'.
 void discover_uniforms(reshade::api::effect_runtime* rt, UniformCache& out_cache);
 
@@ -29,4 +45,12 @@ void apply_preset_for_weather(reshade::api::effect_runtime* rt,
                               const CloudPreset& p,
                               Weather w);
 
+// Write the layers of both presets and the blend factor into the packed table.
+// Returns false when the effect has no packed table.
+bool apply_packed_layers(reshade::api::effect_runtime* rt,
+                         const UniformCache& cache,
+                         const CloudPreset& from,
+                         const CloudPreset& to,
+                         float blend);
+
 } // namespace pv::clouds
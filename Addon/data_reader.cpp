@@ -6,6 +6,7 @@
  */
 
 #include "data_reader.hpp"
+#include "profiler.hpp"
 
 constexpr int ROT_ZXY = 2; // Rotation order as used by GTA V (native enum)
 constexpr int AURORA_CHANCE = 4;
@@ -23,10 +24,27 @@ constexpr float WIND_SPEED_DIST_BETA = 5.0f;
 constexpr float WIND_TRANSITION_TIME = 5.0f;
 
 static DataSource *data_source;
-static std::default_random_engine random;
+// Beta(a, b) from two gamma draws; std::_Beta_distribution is MSVC-only
+class BetaDistribution {
+public:
+	BetaDistribution(float alpha, float beta) : x(alpha, 1.0f), y(beta, 1.0f) {}
+
+	template <class Engine>
+	float operator()(Engine &engine) {
+		const float a = x(engine);
+		const float b = y(engine);
+		return (a + b) > 0.0f ? a / (a + b) : 0.5f;
+	}
+
+private:
+	std::gamma_distribution<float> x;
+	std::gamma_distribution<float> y;
+};
+
+static std::default_random_engine random_engine;
 static std::uniform_real_distribution<float> angle_randomizer(0.0f, M_PI * 2.0f);
-static std::_Beta_distribution<float> wind_forecast_randomizer(WIND_CHANGE_INTERVAL_DIST, WIND_CHANGE_INTERVAL_DIST);
-static std::_Beta_distribution<float> wind_speed_randomizer(WIND_SPEED_DIST_ALPHA, WIND_SPEED_DIST_BETA);
+static BetaDistribution wind_forecast_randomizer(WIND_CHANGE_INTERVAL_DIST, WIND_CHANGE_INTERVAL_DIST);
+static BetaDistribution wind_speed_randomizer(WIND_SPEED_DIST_ALPHA, WIND_SPEED_DIST_BETA);
 static std::uniform_int_distribution<int> aurora_randomizer(0, AURORA_CHANCE);
 
 /**
@@ -191,7 +209,7 @@ static Eigen::Matrix4f create_projection_matrix(float fov_y, float aspect_ratio,
 
 static void change_wind()
 {
-	float new_angle = angle_randomizer(random);
+	float new_angle = angle_randomizer(random_engine);
 
 	_wind_angle = std::fmod(_wind_angle, M_PI * 2.0f);
 	_wind_angle = _wind_angle < 0 ? _wind_angle + M_PI * 2.0f : _wind_angle;
@@ -202,8 +220,8 @@ static void change_wind()
 	_last_wind_speed = _wind_speed;
 	_last_wind_angle = _wind_angle;
 	_next_wind_angle = _wind_angle + angle_delta * WIND_ANGLE_CHANGE_FACTOR;
-	_next_wind_speed = MIN_WIND_SPEED + wind_speed_randomizer(random) * RANGE_WIND_SPEED;
-	_next_wind_forecast = _timer + MIN_WIND_CHANGE_INTERVAL + wind_forecast_randomizer(random) * RANGE_WIND_CHANGE_INTERVAL;
+	_next_wind_speed = MIN_WIND_SPEED + wind_speed_randomizer(random_engine) * RANGE_WIND_SPEED;
+	_next_wind_forecast = _timer + MIN_WIND_CHANGE_INTERVAL + wind_forecast_randomizer(random_engine) * RANGE_WIND_CHANGE_INTERVAL;
 }
 
 static void update_wind(float delta)
@@ -234,7 +252,7 @@ static void startup()
 {
 	_depth_reversed = data_source->get_depth_reversed();
 	_enabled = true;
-	random.seed(std::chrono::system_clock::now().time_since_epoch().count());
+	random_engine.seed(std::chrono::system_clock::now().time_since_epoch().count());
 
 	change_wind();
 
@@ -249,6 +267,8 @@ static void startup()
 
 static void update_camera()
 {
+	PV_PROFILE_ZONE("DataReader::update_camera");
+
 	UInt2 res = data_source->get_resolution();
 	Float3 pos = data_source->get_cam_pos();
 	Float3 rot = data_source->get_cam_rot();
@@ -302,6 +322,8 @@ static void update_camera()
 // Main loop that reads the game data every frame and stores the state
 void DataReader::fast_update()
 {
+	PV_PROFILE_ZONE("DataReader::fast_update");
+
 #if defined RFX_GAME_GTAV
 	_time_scale = data_source->get_time_scale();
 #elif defined RFX_GAME_RDR1
@@ -328,6 +350,8 @@ void DataReader::fast_update()
 
 static void update()
 {
+	PV_PROFILE_ZONE("DataReader::update");
+
 	data_source->update();
 
 #if defined RFX_GAME_GTAV
@@ -368,7 +392,7 @@ static void update()
 		_current_weather_type = _to_weather_type;
 		aurora_transition = 0.0f;
 		_last_aurora_forecast = current_time;
-		_aurora_visible = data_source->get_aurora_visibility() || aurora_randomizer(random) == 0;
+		_aurora_visible = data_source->get_aurora_visibility() || aurora_randomizer(random_engine) == 0;
 		_last_aurora_visibility = _aurora_visibility;
 	}
 	else {
@@ -388,7 +412,10 @@ static void update()
 		}
 	}
 
-	_weather_frame = data_source->get_weather_frame(from_weather, to_weather, clock_time, _weather_transition);
+	{
+		PV_PROFILE_ZONE("DataSource::get_weather_frame");
+		_weather_frame = data_source->get_weather_frame(from_weather, to_weather, clock_time, _weather_transition);
+	}
 
 	_last_clock_time = clock_time;
 }
@@ -406,6 +433,15 @@ void DataReader::script_main()
 	}
 }
 
+void DataReader::step()
+{
+	if (!_enabled) {
+		startup();
+	}
+
+	update();
+}
+
 /**
 * Getters for state data
 **/
@@ -52,6 +52,9 @@ namespace DataReader {
 
 	void fast_update();
 	void script_main();
+	// One iteration of script_main's loop on the calling thread (the first call also starts up),
+	// for hosts that drive the reader themselves instead of through a script thread
+	void step();
 	void register_data_reader(HMODULE hModule, DataSource *source);
 	void unregister_data_reader(HMODULE hModule);
 	bool is_registered();
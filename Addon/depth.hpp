@@ -8,12 +8,19 @@
 #include <imgui.h>
 #include <reshade.hpp>
 #include <vector>
+#include <utility> // std::pair
+#include <atomic>
+#include <chrono>
 #include <shared_mutex>
 #include <unordered_map>
 #include <cmath> // std::abs, std::modf
 #include <cstring> // std::strcmp
 #include <algorithm> // std::find_if, std::remove, std::sort
+#include <cassert> // assert
+#include <limits> // std::numeric_limits
+#include <mutex> // std::unique_lock
 #include <Unknwn.h>
+#include "profiler.hpp"
 
 using namespace reshade::api;
 
@@ -44,6 +51,26 @@ static aspect_ratio_heuristic s_aspect_ratio_heuristic = aspect_ratio_heuristic:
 // Enable or disable the format check from 'check_depth_format' in the detection heuristic
 static unsigned int s_format_filtering = 0;
 static unsigned int s_custom_resolution_filtering[2] = {};
+// Amount of memory unused backup textures may occupy before the least recently used ones are destroyed (in megabytes)
+static unsigned int s_backup_pool_budget_mb = 128;
+// Number of consecutive frames the same depth-stencil has to be selected before locking onto it (zero disables locking)
+static unsigned int s_lock_after_frames = 30;
+// Number of consecutive presents the locked depth-stencil may go unused before falling back to full tracking
+static constexpr uint32_t s_lock_max_missed_frames = 3;
+
+// Factor the selection score of each depth-stencil is multiplied with every frame
+static constexpr float s_selection_score_decay = 0.9f;
+// Score the current selection needs to keep to not be replaced immediately
+static constexpr float s_selection_min_score = 1.0f;
+// Amount another depth-stencil has to score above the current selection to replace it
+static constexpr float s_selection_switch_margin = 2.0f;
+// Number of frames a selection is kept at least before it may be replaced by a higher scoring depth-stencil
+static constexpr uint32_t s_selection_min_dwell_frames = 30;
+
+// The depth-stencil statistics are gathered for while locked, or zero when tracking all depth-stencils
+static std::atomic<uint64_t> s_locked_depth_stencil = 0;
+// Enable or disable measuring the time spent in the draw, bind and clear callbacks
+static std::atomic<bool> s_measure_callback_time = false;
 
 enum class clear_op : uint8_t
 {
@@ -86,8 +113,51 @@ struct depth_stencil_frame_stats
 	std::vector<clear_stats> clears;
 	bool copied_during_frame = false;
 	bool reversed_clear_value = false;
+
+	void reset()
+	{
+		total_stats = {};
+		current_stats = {};
+		clears.clear(); // Keeps the capacity, so that the next frame can record its clears without allocating
+		copied_during_frame = false;
+		reversed_clear_value = false;
+	}
 };
 
+// Description of the depth-stencil that was last locked onto, saved to the config so that a matching resource can be selected right away after a restart or resize
+struct depth_stencil_fingerprint
+{
+	format depth_format = format::unknown;
+	// Dimensions relative to the back buffer, in thousandths
+	uint32_t width_ratio = 0;
+	uint32_t height_ratio = 0;
+	uint32_t drawcalls = 0;
+	uint32_t vertices = 0;
+	bool reversed_clear_value = false;
+
+	static uint32_t ratio(uint32_t size, uint32_t back_buffer_size)
+	{
+		return back_buffer_size != 0 ? static_cast<uint32_t>((static_cast<uint64_t>(size) * 1000 + back_buffer_size / 2) / back_buffer_size) : 0;
+	}
+
+	bool matches_desc(const resource_desc &desc, uint32_t back_buffer_width, uint32_t back_buffer_height) const
+	{
+		return depth_format != format::unknown && desc.texture.format == depth_format &&
+			ratio(desc.texture.width, back_buffer_width) == width_ratio && ratio(desc.texture.height, back_buffer_height) == height_ratio;
+	}
+	bool matches_stats(const draw_stats &stats, bool reversed) const
+	{
+		return stats.drawcalls == drawcalls && stats.vertices == vertices && reversed == reversed_clear_value;
+	}
+
+	bool operator==(const depth_stencil_fingerprint &other) const
+	{
+		return depth_format == other.depth_format && width_ratio == other.width_ratio && height_ratio == other.height_ratio && drawcalls == other.drawcalls && vertices == other.vertices && reversed_clear_value == other.reversed_clear_value;
+	}
+};
+
+static depth_stencil_fingerprint s_fingerprint;
+
 struct resource_hash
 {
 	size_t operator()(resource value) const
@@ -99,47 +169,110 @@ struct resource_hash
 
 struct __declspec(uuid("43319e83-387c-448e-881c-7e68fc2e52c4")) state_tracking
 {
+	static constexpr uint32_t no_counters = std::numeric_limits<uint32_t>::max();
+
 	const bool is_queue;
 	viewport current_viewport = {};
 	resource current_depth_stencil = { 0 };
-	std::unordered_map<resource, depth_stencil_frame_stats, resource_hash> counters_per_used_depth_stencil;
+	// Only a handful of depth-stencils are used per frame, so a flat list is faster to search than a hash map
+	// Only the first 'num_used_counters' entries are valid, the rest are kept around from earlier frames to be reused without allocating
+	std::vector<std::pair<resource, depth_stencil_frame_stats>> counters_per_used_depth_stencil;
+	uint32_t num_used_counters = 0;
+	// Index of the counters of 'current_depth_stencil' in the list above, or 'no_counters' if not resolved yet
+	uint32_t current_counters_index = no_counters;
 	bool first_draw_since_bind = true;
 	draw_stats best_copy_stats;
+	// Time spent in callbacks since the last reset (only updated while 's_measure_callback_time' is set)
+	std::atomic<uint64_t> callback_time = 0;
+	std::atomic<uint32_t> callback_calls = 0;
 
 	state_tracking(bool is_queue) : is_queue(is_queue)
 	{
-		// Reserve some space upfront to avoid rehashing during command recording
-		counters_per_used_depth_stencil.reserve(32);
+		// Reserve some space upfront to avoid reallocating during command recording
+		counters_per_used_depth_stencil.reserve(16);
+	}
+
+	uint32_t find_counters(resource depth_stencil) const
+	{
+		for (uint32_t i = 0; i < num_used_counters; ++i)
+			if (counters_per_used_depth_stencil[i].first == depth_stencil)
+				return i;
+		return no_counters;
+	}
+	uint32_t add_counters(resource depth_stencil)
+	{
+		if (num_used_counters == counters_per_used_depth_stencil.size())
+			counters_per_used_depth_stencil.emplace_back();
+
+		// Entries past the used ones were already reset in 'clear_counters'
+		counters_per_used_depth_stencil[num_used_counters].first = depth_stencil;
+		return num_used_counters++;
+	}
+	depth_stencil_frame_stats &counters_for(resource depth_stencil)
+	{
+		uint32_t index = find_counters(depth_stencil);
+		if (index == no_counters)
+			index = add_counters(depth_stencil);
+		return counters_per_used_depth_stencil[index].second;
+	}
+	depth_stencil_frame_stats &current_counters()
+	{
+		assert(current_depth_stencil != 0);
+
+		// Entries are only ever appended between resets, so a resolved index stays valid until then
+		if (current_counters_index == no_counters)
+		{
+			current_counters_index = find_counters(current_depth_stencil);
+			if (current_counters_index == no_counters)
+				current_counters_index = add_counters(current_depth_stencil);
+		}
+
+		assert(counters_per_used_depth_stencil[current_counters_index].first == current_depth_stencil);
+		return counters_per_used_depth_stencil[current_counters_index].second;
+	}
+
+	void clear_counters()
+	{
+		for (uint32_t i = 0; i < num_used_counters; ++i)
+			counters_per_used_depth_stencil[i].second.reset();
+		num_used_counters = 0;
+		current_counters_index = no_counters;
 	}
 
 	void reset()
 	{
 		best_copy_stats = { 0, 0 };
-		counters_per_used_depth_stencil.clear();
+		clear_counters();
 		current_depth_stencil = { 0 };
+		callback_time = 0;
+		callback_calls = 0;
 	}
 	void reset_on_present()
 	{
 		assert(is_queue);
 		best_copy_stats = { 0, 0 };
-		counters_per_used_depth_stencil.clear();
+		clear_counters();
+		callback_time = 0;
+		callback_calls = 0;
 	}
 
 	void merge(const state_tracking &source)
 	{
 		// Executing a command list in a different command list inherits state
 		current_depth_stencil = source.current_depth_stencil;
+		current_counters_index = no_counters;
 
 		if (source.best_copy_stats.vertices >= best_copy_stats.vertices)
 			best_copy_stats = source.best_copy_stats;
 
-		if (source.counters_per_used_depth_stencil.empty())
-			return;
+		callback_time.fetch_add(source.callback_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		callback_calls.fetch_add(source.callback_calls.load(std::memory_order_relaxed), std::memory_order_relaxed);
 
-		counters_per_used_depth_stencil.reserve(source.counters_per_used_depth_stencil.size());
-		for (const auto &[depth_stencil_handle, source_counters] : source.counters_per_used_depth_stencil)
+		for (uint32_t i = 0; i < source.num_used_counters; ++i)
 		{
-			depth_stencil_frame_stats &counters = counters_per_used_depth_stencil[depth_stencil_handle];
+			const auto &[depth_stencil_handle, source_counters] = source.counters_per_used_depth_stencil[i];
+
+			depth_stencil_frame_stats &counters = counters_for(depth_stencil_handle);
 			counters.total_stats.vertices += source_counters.total_stats.vertices;
 			counters.total_stats.drawcalls += source_counters.total_stats.drawcalls;
 			counters.total_stats.drawcalls_indirect += source_counters.total_stats.drawcalls_indirect;
@@ -169,6 +302,46 @@ struct __declspec(uuid("7c6363c7-f94e-437a-9160-141782c44a98")) generic_depth_da
 
 	// True when the shader resource view was created from the backup resource, false when it was created from the original depth-stencil
 	bool using_backup_texture = false;
+
+	// Number of consecutive frames 'lock_candidate' was selected
+	resource lock_candidate = { 0 };
+	uint32_t lock_streak = 0;
+
+	// Value of 'generic_depth_device_data::retire_count' when retired depth-stencils were last checked
+	uint64_t handled_retire_count = 0;
+
+	// Exponentially decayed score of each depth-stencil that recently passed selection, so that candidates winning in alternating frames do not cause the selection to flip every frame
+	std::vector<std::pair<resource, float>> selection_scores;
+	uint32_t frames_since_selection_change = 0;
+
+	// Number of selection changes and shader resource view creations, counted over a window of a couple of seconds for the overlay
+	std::chrono::steady_clock::time_point rate_window_start = std::chrono::steady_clock::now();
+	uint32_t window_selection_changes = 0;
+	uint32_t window_view_creations = 0;
+	float selection_changes_per_minute = 0.0f;
+	float view_creations_per_minute = 0.0f;
+
+	float &selection_score(resource depth_stencil)
+	{
+		for (auto &[resource, score] : selection_scores)
+			if (resource == depth_stencil)
+				return score;
+		return selection_scores.emplace_back(depth_stencil, 0.0f).second;
+	}
+	float find_selection_score(resource depth_stencil) const
+	{
+		for (const auto &[resource, score] : selection_scores)
+			if (resource == depth_stencil)
+				return score;
+		return 0.0f;
+	}
+	void decay_selection_scores()
+	{
+		for (auto &[resource, score] : selection_scores)
+			score *= s_selection_score_decay;
+		selection_scores.erase(std::remove_if(selection_scores.begin(), selection_scores.end(),
+			[](const std::pair<resource, float> &entry) { return entry.second < 0.05f; }), selection_scores.end());
+	}
 };
 
 struct depth_stencil_backup
@@ -177,10 +350,15 @@ struct depth_stencil_backup
 	uint32_t references = 1;
 
 	// Index of the frame after which the backup resource may be destroyed (used to delay destruction until resource is no longer in use)
+	// Unused backups are kept in a pool after that until it exceeds its budget, so this also orders them by when they were last used
 	uint64_t destroy_after_frame = std::numeric_limits<uint64_t>::max();
 
 	// A resource used as target for a backup copy of this depth-stencil
 	resource backup_texture = { 0 };
+	// Description the backup texture was created with and its hash (see 'backup_desc_key'), used to find a matching one in the pool
+	resource_desc desc;
+	uint64_t desc_key = 0;
+	uint64_t size_in_bytes = 0;
 
 	// The depth-stencil that should be copied from
 	resource depth_stencil_resource = { 0 };
@@ -194,6 +372,21 @@ struct depth_stencil_backup
 	uint32_t current_clear_index = 0;
 };
 
+static uint64_t backup_desc_key(const resource_desc &desc)
+{
+	uint64_t key = 14695981039346656037ull;
+	for (const uint64_t value : { static_cast<uint64_t>(desc.texture.width), static_cast<uint64_t>(desc.texture.height), static_cast<uint64_t>(desc.texture.format), static_cast<uint64_t>(desc.usage) })
+		key = (key ^ value) * 1099511628211ull;
+	return key;
+}
+// The key only covers the fields that usually differ, so a pooled texture with the same key may still differ in e.g. its layers or levels
+static bool backup_desc_equal(const resource_desc &a, const resource_desc &b)
+{
+	return a.type == b.type && a.heap == b.heap && a.usage == b.usage && a.flags == b.flags &&
+		a.texture.width == b.texture.width && a.texture.height == b.texture.height && a.texture.depth_or_layers == b.texture.depth_or_layers &&
+		a.texture.levels == b.texture.levels && a.texture.format == b.texture.format && a.texture.samples == b.texture.samples;
+}
+
 struct depth_stencil_resource
 {
 	depth_stencil_frame_stats last_counters;
@@ -201,12 +394,61 @@ struct depth_stencil_resource
 	// Index of the frame in which the depth-stencil was last/first seen used in
 	uint64_t last_used_in_frame = std::numeric_limits<uint64_t>::max();
 	uint64_t first_used_in_frame = std::numeric_limits<uint64_t>::max();
+
+	// True when the resource matched the saved fingerprint on creation
+	bool fingerprint_match = false;
+};
+
+// Compact copy of the selection relevant parts of a 'depth_stencil_resource'
+struct depth_stencil_candidate
+{
+	resource depth_stencil = { 0 };
+	draw_stats total_stats;
+	bool copied_during_frame = false;
+	bool reversed_clear_value = false;
+	bool fingerprint_match = false;
+	uint64_t last_used_in_frame = 0;
+	uint64_t first_used_in_frame = 0;
+};
+
+// List of candidates published at present, which effect runtimes read without holding 's_mutex'
+// A snapshot is never modified while it is published or while a reader still holds it
+struct depth_stencil_snapshot
+{
+	uint64_t frame_index = 0;
+	std::vector<depth_stencil_candidate> candidates;
+	std::atomic<uint32_t> readers = 0;
 };
 
 struct __declspec(uuid("e006e162-33ac-4b9f-b10f-0e15335c7bdb")) generic_depth_device_data
 {
 	uint64_t frame_index = 0;
 
+	// Number of consecutive presents in which the locked depth-stencil was not used
+	uint32_t locked_missed_frames = 0;
+
+	// Depth-stencils that were destroyed while an effect runtime may still have had them selected
+	// Effect runtimes check this list at their next 'reshade_begin_effects' and drop their selection, which delays destruction of the backup texture
+	struct retired_depth_stencil
+	{
+		resource depth_stencil;
+		uint64_t retire_index; // Value of 'retire_count' after this was added
+		uint64_t frame_index;
+	};
+	std::vector<retired_depth_stencil> retired_depth_stencils;
+	uint64_t retire_count = 0;
+
+	// Size of the back buffer of the last initialized swap chain
+	uint32_t back_buffer_width = 0;
+	uint32_t back_buffer_height = 0;
+
+	// Depth-stencils whose description matched the saved fingerprint when they were created
+	std::vector<resource> fingerprint_matches;
+
+	// Moving average of the time spent in the draw, bind and clear callbacks per frame, with full tracking [0] and while locked [1]
+	float callback_time_us[2] = {};
+	float callback_calls[2] = {};
+
 	// List of queues created for this device
 	std::vector<command_queue *> queues;
 
@@ -214,8 +456,61 @@ struct __declspec(uuid("e006e162-33ac-4b9f-b10f-0e15335c7bdb")) generic_depth_de
 	std::unordered_map<resource, depth_stencil_resource, resource_hash> depth_stencil_resources;
 
 	// List of depth-stencils that should be tracked throughout each frame and potentially be backed up during clear operations
+	// This doubles as pool of backup textures, since entries that are no longer referenced are kept around to be reused (see 's_backup_pool_budget_mb')
 	std::vector<depth_stencil_backup> depth_stencil_backups;
 
+	// Statistics of the backup texture pool
+	uint32_t backup_pool_hits = 0;
+	uint32_t backup_pool_misses = 0;
+	uint64_t backup_resident_bytes = 0;
+	uint64_t backup_pooled_bytes = 0;
+
+	// State of all graphics queues merged at present, kept around so that its lists can be reused every frame
+	state_tracking present_state { true };
+
+	// Three slots, so that there is always one to write to while one is published and one may still be read from
+	depth_stencil_snapshot snapshots[3];
+	std::atomic<uint32_t> published_snapshot = 0;
+
+	// Copies the current list of depth-stencils into a free snapshot slot and publishes it (must be called with 's_mutex' held exclusively)
+	void publish_snapshot()
+	{
+		const uint32_t published = published_snapshot.load();
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			if (i == published || snapshots[i].readers.load() != 0)
+				continue;
+
+			depth_stencil_snapshot &snapshot = snapshots[i];
+			snapshot.frame_index = frame_index;
+			snapshot.candidates.clear();
+			for (const auto &[resource, info] : depth_stencil_resources)
+				snapshot.candidates.push_back({ resource, info.last_counters.total_stats, info.last_counters.copied_during_frame, info.last_counters.reversed_clear_value, info.fingerprint_match, info.last_used_in_frame, info.first_used_in_frame });
+
+			published_snapshot.store(i);
+			return;
+		}
+
+		// All other slots are still being read, so keep the previous snapshot for another frame
+	}
+
+	const depth_stencil_snapshot &acquire_snapshot()
+	{
+		while (true)
+		{
+			const uint32_t index = published_snapshot.load();
+			snapshots[index].readers.fetch_add(1);
+			// The slot may have been unpublished and picked up for writing before the reader count was incremented, so check again
+			if (published_snapshot.load() == index)
+				return snapshots[index];
+			snapshots[index].readers.fetch_sub(1);
+		}
+	}
+	void release_snapshot(const depth_stencil_snapshot &snapshot)
+	{
+		snapshots[&snapshot - snapshots].readers.fetch_sub(1);
+	}
+
 	depth_stencil_backup *find_depth_stencil_backup(resource resource)
 	{
 		for (depth_stencil_backup &backup : depth_stencil_backups)
@@ -265,35 +560,45 @@ struct __declspec(uuid("e006e162-33ac-4b9f-b10f-0e15335c7bdb")) generic_depth_de
 		else if (api != device_api::opengl && api != device_api::vulkan)
 			desc.texture.format = format_to_typeless(desc.texture.format);
 
-		// First try to revive a backup resource that was previously enqueued for delayed destruction
+		const uint64_t desc_key = backup_desc_key(desc);
+
+		// First try to revive a backup resource from the pool of unused ones, preferring the most recently used
+		depth_stencil_backup *pooled_backup = nullptr;
 		for (depth_stencil_backup &backup : depth_stencil_backups)
 		{
-			if (backup.depth_stencil_resource != 0)
+			if (backup.depth_stencil_resource != 0 || backup.desc_key != desc_key || !backup_desc_equal(backup.desc, desc))
 				continue;
 
 			assert(backup.references == 0 && backup.destroy_after_frame != std::numeric_limits<uint64_t>::max());
 
-			const resource_desc existing_desc = device->get_resource_desc(backup.backup_texture);
-			if (desc.texture.width == existing_desc.texture.width &&
-				desc.texture.height == existing_desc.texture.height &&
-				desc.texture.format == existing_desc.texture.format &&
-				desc.usage == existing_desc.usage)
-			{
-				backup.references++;
-				backup.depth_stencil_resource = resource;
-				backup.destroy_after_frame = std::numeric_limits<uint64_t>::max();
+			if (pooled_backup == nullptr || backup.destroy_after_frame > pooled_backup->destroy_after_frame)
+				pooled_backup = &backup;
+		}
 
-				return &backup;
-			}
+		if (pooled_backup != nullptr)
+		{
+			pooled_backup->references++;
+			pooled_backup->depth_stencil_resource = resource;
+			pooled_backup->destroy_after_frame = std::numeric_limits<uint64_t>::max();
+
+			backup_pool_hits++;
+
+			return pooled_backup;
 		}
 
 		depth_stencil_backup &backup = depth_stencil_backups.emplace_back();
 		backup.depth_stencil_resource = resource;
+		backup.desc = desc;
+		backup.desc_key = desc_key;
+		backup.size_in_bytes = static_cast<uint64_t>(format_slice_pitch(desc.texture.format, format_row_pitch(desc.texture.format, desc.texture.width), desc.texture.height)) * desc.texture.depth_or_layers;
 
 		if (device->create_resource(desc, nullptr, resource_usage::copy_dest, &backup.backup_texture))
 		{
 			device->set_resource_name(backup.backup_texture, "ReShade depth backup texture");
 
+			backup_pool_misses++;
+			backup_resident_bytes += backup.size_in_bytes;
+
 			return &backup;
 		}
 		else
@@ -318,7 +623,7 @@ struct __declspec(uuid("e006e162-33ac-4b9f-b10f-0e15335c7bdb")) generic_depth_de
 		backup.depth_stencil_resource = { 0 };
 
 		// Do not destroy backup texture immediately since it may still be referenced by a command list that is in flight or was prerecorded
-		// Instead mark it for delayed destruction in the future
+		// Instead return it to the pool, from which it is destroyed when the pool exceeds its budget, but not before this number of frames passed
 		backup.destroy_after_frame = frame_index + 50; // Destroy after 50 frames
 
 		const device_api api = device->get_api();
@@ -372,6 +677,34 @@ static bool check_aspect_ratio(float width_to_check, float height_to_check, floa
 		(s_aspect_ratio_heuristic == aspect_ratio_heuristic::multiples_of_resolution && std::modf(w_ratio, &w_ratio) <= 0.02f && std::modf(h_ratio, &h_ratio) <= 0.02f));
 }
 
+// While locked onto a depth-stencil, statistics are gathered for that one only
+static bool is_ignored_while_locked(resource depth_stencil)
+{
+	const uint64_t locked = s_locked_depth_stencil.load(std::memory_order_relaxed);
+	return locked != 0 && depth_stencil.handle != locked;
+}
+
+struct callback_timer
+{
+	state_tracking &state;
+	const bool enabled;
+	std::chrono::steady_clock::time_point start;
+
+	explicit callback_timer(state_tracking &state) : state(state), enabled(s_measure_callback_time.load(std::memory_order_relaxed))
+	{
+		if (enabled)
+			start = std::chrono::steady_clock::now();
+	}
+	~callback_timer()
+	{
+		if (!enabled)
+			return;
+
+		state.callback_time.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+		state.callback_calls.fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
 static void on_clear_depth_impl(command_list *cmd_list, state_tracking &state, resource depth_stencil, clear_op op)
 {
 	if (depth_stencil == 0)
@@ -389,7 +722,7 @@ static void on_clear_depth_impl(command_list *cmd_list, state_tracking &state, r
 		lock.lock();
 
 	bool do_copy = true;
-	depth_stencil_frame_stats &counters = state.counters_per_used_depth_stencil[depth_stencil];
+	depth_stencil_frame_stats &counters = state.counters_for(depth_stencil);
 
 	// Ignore clears when there was no meaningful workload (e.g. at the start of a frame)
 	// Don't do this in Vulkan, to handle common case of DXVK flushing its immediate command buffer and thus resetting its stats during the frame
@@ -500,6 +833,16 @@ static void on_init_device(device *device)
 	reshade::get_config_value(nullptr, "DEPTH", "FilterResolutionWidth", s_custom_resolution_filtering[0]);
 	reshade::get_config_value(nullptr, "DEPTH", "FilterResolutionHeight", s_custom_resolution_filtering[1]);
 
+	reshade::get_config_value(nullptr, "DEPTH", "LockAfterFrames", s_lock_after_frames);
+	reshade::get_config_value(nullptr, "DEPTH", "BackupPoolBudgetMB", s_backup_pool_budget_mb);
+
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintFormat", reinterpret_cast<uint32_t &>(s_fingerprint.depth_format));
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintWidthRatio", s_fingerprint.width_ratio);
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintHeightRatio", s_fingerprint.height_ratio);
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintDrawCalls", s_fingerprint.drawcalls);
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintVertices", s_fingerprint.vertices);
+	reshade::get_config_value(nullptr, "DEPTH", "FingerprintReversedClear", s_fingerprint.reversed_clear_value);
+
 	if (s_aspect_ratio_heuristic > aspect_ratio_heuristic::match_custom_resolution_exactly)
 		s_aspect_ratio_heuristic = aspect_ratio_heuristic::similar_aspect_ratio;
 }
@@ -542,6 +885,23 @@ static void on_destroy_command_queue(command_queue *cmd_queue)
 	device_data->queues.erase(std::remove(device_data->queues.begin(), device_data->queues.end(), cmd_queue), device_data->queues.end());
 }
 
+static void on_init_depth_swapchain(swapchain *swapchain, bool)
+{
+	device *const device = swapchain->get_device();
+	generic_depth_device_data *const device_data = device->get_private_data<generic_depth_device_data>();
+
+	// The swap chain may belong to a device that was created before the add-on was loaded
+	if (device_data == nullptr)
+		return;
+
+	const resource_desc desc = device->get_resource_desc(swapchain->get_current_back_buffer());
+
+	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+	device_data->back_buffer_width = desc.texture.width;
+	device_data->back_buffer_height = desc.texture.height;
+}
+
 static void on_init_effect_runtime(effect_runtime *runtime)
 {
 	runtime->create_private_data<generic_depth_data>();
@@ -643,6 +1003,22 @@ static bool on_create_resource_view(device *device, resource resource, resource_
 
 	return true;
 }
+static void on_init_resource(device *device, const resource_desc &desc, const subresource_data *, resource_usage, resource resource)
+{
+	if ((desc.usage & resource_usage::depth_stencil) == 0 || (desc.type != resource_type::surface && desc.type != resource_type::texture_2d))
+		return;
+
+	generic_depth_device_data *const device_data = device->get_private_data<generic_depth_device_data>();
+	if (device_data == nullptr)
+		return;
+
+	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+	// Remember resources that look like the depth-stencil selected in an earlier session, so that they can be selected on the first frame they are used
+	if (s_fingerprint.matches_desc(desc, device_data->back_buffer_width, device_data->back_buffer_height))
+		device_data->fingerprint_matches.push_back(resource);
+}
+
 static void on_destroy_resource(device *device, resource resource)
 {
 	generic_depth_device_data *const device_data = device->get_private_data<generic_depth_device_data>();
@@ -652,8 +1028,14 @@ static void on_destroy_resource(device *device, resource resource)
 	if (device_data == nullptr)
 		return;
 
+	// Fall back to full tracking when the locked depth-stencil goes away (e.g. because the game resized its buffers)
+	uint64_t locked = resource.handle;
+	s_locked_depth_stencil.compare_exchange_strong(locked, 0);
+
 	std::unique_lock<std::shared_mutex> lock(s_mutex);
 
+	device_data->fingerprint_matches.erase(std::remove(device_data->fingerprint_matches.begin(), device_data->fingerprint_matches.end(), resource), device_data->fingerprint_matches.end());
+
 	// Remove this destroyed resource from the list of tracked depth-stencil resources
 	if (const auto it = device_data->depth_stencil_resources.find(resource);
 		it != device_data->depth_stencil_resources.end())
@@ -663,13 +1045,13 @@ static void on_destroy_resource(device *device, resource resource)
 		// A backup resource is always created in D3D12 and Vulkan, so to find out if an effect runtime references this depth-stencil resource, can simply check if a backup resource was created for it
 		if (device_data->find_depth_stencil_backup(resource) != nullptr)
 		{
+			// Do not block the thread the application destroys resources from, instead retire the depth-stencil and let effect runtimes drop it at their next 'reshade_begin_effects'
+			// Since it is no longer in the list of depth-stencils above, it will not be selected or copied from again, and the backup texture stays alive for a number of frames after being untracked
+			device_data->retired_depth_stencils.push_back({ resource, ++device_data->retire_count, device_data->frame_index });
+
 			lock.unlock();
 
 			reshade::log::message(reshade::log::level::warning, "A depth-stencil resource was destroyed while still in use.");
-
-			// This is bad ... the resource may still be in use by an effect on the GPU and destroying it would crash it
-			// Try to mitigate that somehow by delaying this thread a little to hopefully give the GPU enough time to catch up before the resource memory is deallocated
-			Sleep(500);
 		}
 	}
 }
@@ -677,8 +1059,12 @@ static void on_destroy_resource(device *device, resource resource)
 static bool on_draw(command_list *cmd_list, uint32_t vertices, uint32_t instances, uint32_t, uint32_t)
 {
 	auto &state = *cmd_list->get_private_data<state_tracking>();
+	const callback_timer timer(state);
+
 	if (state.current_depth_stencil == 0)
 		return false; // This is a draw call with no depth-stencil bound
+	if (is_ignored_while_locked(state.current_depth_stencil))
+		return false;
 
 	// Check if this draw call likely represets a fullscreen rectangle (two triangles), which would clear the depth-stencil
 	const bool fullscreen_draw = vertices == 6 && instances == 1;
@@ -696,7 +1082,7 @@ static bool on_draw(command_list *cmd_list, uint32_t vertices, uint32_t instance
 
 	state.first_draw_since_bind = false;
 
-	depth_stencil_frame_stats &counters = state.counters_per_used_depth_stencil[state.current_depth_stencil];
+	depth_stencil_frame_stats &counters = state.current_counters();
 	counters.total_stats.vertices += vertices * instances;
 	counters.total_stats.drawcalls += 1;
 	counters.current_stats.vertices += vertices * instances;
@@ -720,15 +1106,19 @@ static bool on_draw_indirect(command_list *cmd_list, indirect_command type, reso
 		return false;
 
 	auto &state = *cmd_list->get_private_data<state_tracking>();
+	const callback_timer timer(state);
+
 	if (state.current_depth_stencil == 0)
 		return false; // This is a draw call with no depth-stencil bound
+	if (is_ignored_while_locked(state.current_depth_stencil))
+		return false;
 
 	// If this is queue state (happens if this is a immediate command list), need to protect access to it, since another thread may be in a present call, which can reset it
 	std::shared_lock<std::shared_mutex> lock(s_mutex, std::defer_lock);
 	if (state.is_queue)
 		lock.lock();
 
-	depth_stencil_frame_stats &counters = state.counters_per_used_depth_stencil[state.current_depth_stencil];
+	depth_stencil_frame_stats &counters = state.current_counters();
 	counters.total_stats.drawcalls += draw_count;
 	counters.total_stats.drawcalls_indirect += draw_count;
 	counters.current_stats.drawcalls += draw_count;
@@ -749,6 +1139,7 @@ static void on_bind_viewport(command_list *cmd_list, uint32_t first, uint32_t co
 static void on_bind_depth_stencil(command_list *cmd_list, uint32_t, const resource_view *, resource_view depth_stencil_view)
 {
 	auto &state = *cmd_list->get_private_data<state_tracking>();
+	const callback_timer timer(state);
 
 	const resource depth_stencil = (depth_stencil_view != 0) ? cmd_list->get_device()->get_resource_from_view(depth_stencil_view) : resource{ 0 };
 
@@ -762,9 +1153,16 @@ static void on_bind_depth_stencil(command_list *cmd_list, uint32_t, const resour
 			state.current_depth_stencil != 0 && depth_stencil == 0 &&
 			(cmd_list->get_device()->get_api() == device_api::d3d12 || cmd_list->get_device()->get_api() == device_api::vulkan))
 			on_clear_depth_impl(cmd_list, state, state.current_depth_stencil, clear_op::unbind_depth_stencil_view);
-	}
 
-	state.current_depth_stencil = depth_stencil;
+		// Resolve the counters of the new depth-stencil once here, so that draw calls only have to add to them
+		// If it was not drawn to yet this frame, the entry is added on the first draw call instead (see 'current_counters')
+		std::shared_lock<std::shared_mutex> lock(s_mutex, std::defer_lock);
+		if (state.is_queue)
+			lock.lock();
+
+		state.current_depth_stencil = depth_stencil;
+		state.current_counters_index = (depth_stencil != 0 && !is_ignored_while_locked(depth_stencil)) ? state.find_counters(depth_stencil) : state_tracking::no_counters;
+	}
 }
 static bool on_clear_depth_stencil(command_list *cmd_list, resource_view dsv, const float *depth, const uint8_t *, uint32_t, const rect *)
 {
@@ -772,8 +1170,11 @@ static bool on_clear_depth_stencil(command_list *cmd_list, resource_view dsv, co
 	if (depth != nullptr)
 	{
 		auto &state = *cmd_list->get_private_data<state_tracking>();
+		const callback_timer timer(state);
 
 		const resource depth_stencil = cmd_list->get_device()->get_resource_from_view(dsv);
+		if (is_ignored_while_locked(depth_stencil))
+			return false;
 
 		// Note: This does not work when called from 'vkCmdClearAttachments', since it is invalid to copy a resource inside an active render pass
 		if (s_preserve_depth_buffers)
@@ -785,7 +1186,7 @@ static bool on_clear_depth_stencil(command_list *cmd_list, resource_view dsv, co
 			if (state.is_queue)
 				lock.lock();
 
-			state.counters_per_used_depth_stencil[depth_stencil].reversed_clear_value = true;
+			state.counters_for(depth_stencil).reversed_clear_value = true;
 		}
 	}
 
@@ -800,6 +1201,7 @@ static void on_begin_render_pass_with_depth_stencil(command_list *cmd_list, uint
 		// Prevent 'on_bind_depth_stencil' from copying depth buffer again
 		auto &state = *cmd_list->get_private_data<state_tracking>();
 		state.current_depth_stencil = { 0 };
+		state.current_counters_index = state_tracking::no_counters;
 	}
 
 	// If render pass has depth store operation set to 'discard', any copy performed after the render pass will likely contain broken data, so can only hope that the depth buffer can be copied before that ...
@@ -833,7 +1235,7 @@ static void on_execute_secondary(command_list *cmd_list, command_list *secondary
 	const auto &source_state = *secondary_cmd_list->get_private_data<state_tracking>();
 
 	// If this is a secondary command list that was recorded without a depth-stencil binding, but is now executed using a depth-stencil binding, handle it as if an indirect draw call was performed to ensure the depth-stencil is tracked
-	if (target_state.current_depth_stencil != 0 && source_state.current_depth_stencil == 0 && source_state.counters_per_used_depth_stencil.empty())
+	if (target_state.current_depth_stencil != 0 && source_state.current_depth_stencil == 0 && source_state.num_used_counters == 0)
 	{
 		target_state.current_viewport = source_state.current_viewport;
 
@@ -852,12 +1254,16 @@ static void on_execute_secondary(command_list *cmd_list, command_list *secondary
 
 static void on_present(command_queue *, swapchain *swapchain, const rect *, const rect *, uint32_t, const rect *)
 {
+	PV_PROFILE_ZONE("depth::on_present");
+
 	device *const device = swapchain->get_device();
 	generic_depth_device_data *const device_data = device->get_private_data<generic_depth_device_data>();
 
-	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+	std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+	state_tracking &queue_state = device_data->present_state;
+	queue_state.reset_on_present();
 
-	state_tracking queue_state(true);
 	// Merge state from all graphics queues
 	for (command_queue *const queue : device_data->queues)
 	{
@@ -867,12 +1273,35 @@ static void on_present(command_queue *, swapchain *swapchain, const rect *, cons
 		state.reset_on_present();
 	}
 
+	// Forget about retired depth-stencils once every effect runtime had a couple of frames to notice them
+	device_data->retired_depth_stencils.erase(std::remove_if(device_data->retired_depth_stencils.begin(), device_data->retired_depth_stencils.end(),
+		[device_data](const generic_depth_device_data::retired_depth_stencil &retired) { return device_data->frame_index > (retired.frame_index + 10); }), device_data->retired_depth_stencils.end());
+
+	const uint64_t locked = s_locked_depth_stencil.load(std::memory_order_relaxed);
+
+	if (s_measure_callback_time.load(std::memory_order_relaxed))
+	{
+		const size_t mode = locked != 0 ? 1 : 0;
+		device_data->callback_time_us[mode] += (queue_state.callback_time / 1000.0f - device_data->callback_time_us[mode]) * 0.05f;
+		device_data->callback_calls[mode] += (queue_state.callback_calls - device_data->callback_calls[mode]) * 0.05f;
+	}
+
+	// Fall back to full tracking when the locked depth-stencil stops being used
+	if (locked != 0)
+	{
+		if (queue_state.find_counters(resource { locked }) != state_tracking::no_counters)
+			device_data->locked_missed_frames = 0;
+		else if (++device_data->locked_missed_frames >= s_lock_max_missed_frames)
+			s_locked_depth_stencil.store(0, std::memory_order_relaxed);
+	}
+
 	// Only update device list if there are any depth-stencils, otherwise this may be a second present call (at which point 'reset_on_present' already cleared out the queue list in the first present call)
-	if (queue_state.counters_per_used_depth_stencil.empty())
+	if (queue_state.num_used_counters == 0)
 		return;
 
 	// Also skip update when there has been very little activity (special case for emulators like PCSX2 which may present more often than they render a frame)
-	if (queue_state.counters_per_used_depth_stencil.size() == 1 && queue_state.counters_per_used_depth_stencil.begin()->second.total_stats.drawcalls <= 8)
+	// This does not apply while locked, since then only the locked depth-stencil is tracked and it is expected to see very few draw calls
+	if (locked == 0 && queue_state.num_used_counters == 1 && queue_state.counters_per_used_depth_stencil[0].second.total_stats.drawcalls <= 8)
 		return;
 
 	device_data->frame_index++;
@@ -881,7 +1310,7 @@ static void on_present(command_queue *, swapchain *swapchain, const rect *, cons
 	{
 		depth_stencil_resource &info = it->second;
 
-		if (queue_state.counters_per_used_depth_stencil.find(it->first) == queue_state.counters_per_used_depth_stencil.end() && device_data->frame_index > (info.last_used_in_frame + 30))
+		if (queue_state.find_counters(it->first) == state_tracking::no_counters && device_data->frame_index > (info.last_used_in_frame + 30))
 		{
 			// Remove from list when not used for a couple of frames (e.g. because the resource was actually destroyed since)
 			it = device_data->depth_stencil_resources.erase(it);
@@ -891,8 +1320,10 @@ static void on_present(command_queue *, swapchain *swapchain, const rect *, cons
 		++it;
 	}
 
-	for (const auto &[resource, counters] : queue_state.counters_per_used_depth_stencil)
+	for (uint32_t i = 0; i < queue_state.num_used_counters; ++i)
 	{
+		const auto &[resource, counters] = queue_state.counters_per_used_depth_stencil[i];
+
 		// Save to current list of depth-stencils on the device, so that it can be displayed in the GUI
 		// This might add a resource again that was destroyed during the frame, so need to add a grace period of a couple of frames before using it to be sure
 		depth_stencil_resource &info = device_data->depth_stencil_resources[resource];
@@ -901,30 +1332,87 @@ static void on_present(command_queue *, swapchain *swapchain, const rect *, cons
 		info.last_used_in_frame = device_data->frame_index;
 
 		if (std::numeric_limits<uint64_t>::max() == info.first_used_in_frame)
+		{
 			info.first_used_in_frame = device_data->frame_index;
+			info.fingerprint_match = std::find(device_data->fingerprint_matches.begin(), device_data->fingerprint_matches.end(), resource) != device_data->fingerprint_matches.end();
+		}
 	}
 
-	// Destroy resources that were enqueued for delayed destruction and have reached the targeted number of passed frames
-	for (auto it = device_data->depth_stencil_backups.begin(); it != device_data->depth_stencil_backups.end();)
-	{
-		if (device_data->frame_index >= it->destroy_after_frame)
-		{
-			assert(it->references == 0);
+	device_data->publish_snapshot();
 
-			device->destroy_resource(it->backup_texture);
-			it = device_data->depth_stencil_backups.erase(it);
-			continue;
-		}
+	uint64_t pooled_bytes = 0;
+	for (depth_stencil_backup &backup : device_data->depth_stencil_backups)
+	{
+		if (backup.references == 0)
+			pooled_bytes += backup.size_in_bytes;
 
 		// Reset current clear index
-		it->current_clear_index = 0;
+		backup.current_clear_index = 0;
+	}
 
-		++it;
+	// Destroy the least recently used backup resources while the pool is over budget, skipping those that have not reached the targeted number of passed frames since they were last used
+	// This is rare, so only allocates when there is something to destroy
+	std::vector<resource> backups_to_destroy;
+	while (pooled_bytes > static_cast<uint64_t>(s_backup_pool_budget_mb) * 1024 * 1024)
+	{
+		auto lru = device_data->depth_stencil_backups.end();
+		for (auto it = device_data->depth_stencil_backups.begin(); it != device_data->depth_stencil_backups.end(); ++it)
+			if (it->references == 0 && device_data->frame_index >= it->destroy_after_frame && (lru == device_data->depth_stencil_backups.end() || it->destroy_after_frame < lru->destroy_after_frame))
+				lru = it;
+		if (lru == device_data->depth_stencil_backups.end())
+			break;
+
+		pooled_bytes -= lru->size_in_bytes;
+		device_data->backup_resident_bytes -= lru->size_in_bytes;
+
+		backups_to_destroy.push_back(lru->backup_texture);
+		device_data->depth_stencil_backups.erase(lru);
+	}
+
+	device_data->backup_pooled_bytes = pooled_bytes;
+
+	if (backups_to_destroy.empty())
+		return;
+
+	// Destroy outside the lock, since this calls into the device (see comment in 'on_clear_depth_impl')
+	lock.unlock();
+
+	for (const resource backup_texture : backups_to_destroy)
+		device->destroy_resource(backup_texture);
+}
+
+// Saves what the selected depth-stencil looks like, so that it can be found again right away next time
+static void save_fingerprint(const resource_desc &desc, const depth_stencil_candidate &candidate, uint32_t frame_width, uint32_t frame_height)
+{
+	depth_stencil_fingerprint fingerprint;
+	fingerprint.depth_format = desc.texture.format;
+	fingerprint.width_ratio = depth_stencil_fingerprint::ratio(desc.texture.width, frame_width);
+	fingerprint.height_ratio = depth_stencil_fingerprint::ratio(desc.texture.height, frame_height);
+	fingerprint.drawcalls = candidate.total_stats.drawcalls;
+	fingerprint.vertices = candidate.total_stats.vertices;
+	fingerprint.reversed_clear_value = candidate.reversed_clear_value;
+
+	{
+		// 'on_init_resource' compares new depth-stencils against it from the threads of the application
+		const std::unique_lock<std::shared_mutex> lock(s_mutex);
+		if (fingerprint == s_fingerprint)
+			return;
+
+		s_fingerprint = fingerprint;
 	}
+
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintFormat", static_cast<uint32_t>(fingerprint.depth_format));
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintWidthRatio", fingerprint.width_ratio);
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintHeightRatio", fingerprint.height_ratio);
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintDrawCalls", fingerprint.drawcalls);
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintVertices", fingerprint.vertices);
+	reshade::set_config_value(nullptr, "DEPTH", "FingerprintReversedClear", fingerprint.reversed_clear_value);
 }
 
 static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_list, resource_view, resource_view)
 {
+	PV_PROFILE_ZONE("depth::on_begin_render_effects");
+
 	device *const device = runtime->get_device();
 	generic_depth_device_data *const device_data = device->get_private_data<generic_depth_device_data>();
 
@@ -935,28 +1423,92 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 
 	resource best_match = { 0 };
 	resource_desc best_match_desc;
-	const depth_stencil_frame_stats *best_snapshot = nullptr;
+	depth_stencil_candidate best_candidate;
+
+	// The current selection, if it passed the same checks as every other candidate this frame
+	bool selected_eligible = false;
+	resource_desc selected_desc;
+	depth_stencil_candidate selected_candidate;
 
 	uint32_t frame_width, frame_height;
 	runtime->get_screenshot_width_and_height(&frame_width, &frame_height);
 
-	std::shared_lock<std::shared_mutex> lock(s_mutex);
-	const std::unordered_map<resource, depth_stencil_resource, resource_hash> current_depth_stencil_resources = device_data->depth_stencil_resources;
-	// Unlock while calling into device below, since device may hold a lock itself and that then can deadlock another thread that calls into 'on_destroy_resource' from the device holding that lock
-	lock.unlock();
+	// Only hold 's_mutex' for short checks below and not while calling into the device, since device may hold a lock itself and that then can deadlock another thread that calls into 'on_destroy_resource' from the device holding that lock
+	std::shared_lock<std::shared_mutex> lock(s_mutex, std::defer_lock);
+
+	// Resources may have been destroyed since the snapshot was published, so check they are still tracked before querying the device about them
+	const auto is_alive = [&](resource resource) {
+		lock.lock();
+		const bool alive = device_data->depth_stencil_resources.find(resource) != device_data->depth_stencil_resources.end();
+		lock.unlock();
+		return alive;
+	};
+
+	// Drop the selection if its depth-stencil was destroyed in the meantime, so that it is not mistaken for a new resource that happens to reuse the same handle
+	if (data.handled_retire_count != device_data->retire_count)
+	{
+		bool selected_retired = false;
+
+		lock.lock();
+		for (const auto &retired : device_data->retired_depth_stencils)
+		{
+			if (retired.retire_index <= data.handled_retire_count)
+				continue;
 
-	for (auto &[resource, info] : current_depth_stencil_resources)
+			if (retired.depth_stencil == data.selected_depth_stencil)
+				selected_retired = true;
+			if (retired.depth_stencil == data.override_depth_stencil)
+				data.override_depth_stencil = { 0 };
+		}
+		data.handled_retire_count = device_data->retire_count;
+		lock.unlock();
+
+		// Keep the shader resource view for now, it is replaced (or destroyed) further below once a new depth-stencil was selected
+		if (selected_retired)
+		{
+			device_data->untrack_depth_stencil(device, data.selected_depth_stencil);
+
+			data.using_backup_texture = false;
+			data.selected_depth_stencil = { 0 };
+		}
+	}
+
+	// Update the selection change statistics shown in the overlay
+	if (const auto now = std::chrono::steady_clock::now(); now - data.rate_window_start >= std::chrono::seconds(10))
 	{
-		bool candidate_1 = info.last_counters.total_stats.drawcalls == 1 && info.last_counters.total_stats.vertices == 6;
-		bool candidate_2 = info.last_counters.total_stats.drawcalls == 2 && info.last_counters.total_stats.vertices == 12;
+		const float minutes = std::chrono::duration<float>(now - data.rate_window_start).count() / 60.0f;
+		data.selection_changes_per_minute = data.window_selection_changes / minutes;
+		data.view_creations_per_minute = data.window_view_creations / minutes;
+		data.window_selection_changes = 0;
+		data.window_view_creations = 0;
+		data.rate_window_start = now;
+	}
+
+	data.decay_selection_scores();
+	data.frames_since_selection_change++;
+
+	const depth_stencil_snapshot &snapshot = device_data->acquire_snapshot();
+
+	for (const depth_stencil_candidate &candidate : snapshot.candidates)
+	{
+		bool candidate_1 = candidate.total_stats.drawcalls == 1 && candidate.total_stats.vertices == 6;
+		bool candidate_2 = candidate.total_stats.drawcalls == 2 && candidate.total_stats.vertices == 12;
 
 		if (!candidate_1 && !candidate_2)
 			continue; // GTA V Heuristic
 
-		if (info.last_used_in_frame < device_data->frame_index || device_data->frame_index <= (info.first_used_in_frame + 1))
-			continue; // Skip resources not used this frame or those that only just appeared for the first time
+		if (candidate.last_used_in_frame < snapshot.frame_index)
+			continue; // Skip resources not used this frame
+
+		// Resources that were seen being created and match the saved fingerprint are known to be alive, so do not need the grace period
+		const bool fingerprint_match = candidate.fingerprint_match && s_fingerprint.matches_stats(candidate.total_stats, candidate.reversed_clear_value);
+		if (!fingerprint_match && snapshot.frame_index <= (candidate.first_used_in_frame + 1))
+			continue; // Skip resources that only just appeared for the first time
+
+		if (!is_alive(candidate.depth_stencil))
+			continue;
 
-		const resource_desc desc = device->get_resource_desc(resource);
+		const resource_desc desc = device->get_resource_desc(candidate.depth_stencil);
 
 		if (desc.texture.width != frame_width || desc.texture.height != frame_height)
 			continue; // Only match exact resolution
@@ -967,27 +1519,88 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 		if (s_format_filtering != 0 && !check_depth_format(desc.texture.format))
 			continue;
 
-		const depth_stencil_frame_stats &snapshot = info.last_counters;
-		if (best_snapshot == nullptr ||
-			snapshot.total_stats > best_snapshot->total_stats)
+		data.selection_score(candidate.depth_stencil) += 1.0f;
+
+		if (candidate.depth_stencil == data.selected_depth_stencil)
 		{
-			best_match = resource;
+			selected_eligible = true;
+			selected_desc = desc;
+			selected_candidate = candidate;
+		}
+
+		if (best_match == 0 ||
+			candidate.total_stats > best_candidate.total_stats)
+		{
+			best_match = candidate.depth_stencil;
 			best_match_desc = desc;
-			best_snapshot = &snapshot;
+			best_candidate = candidate;
+			best_candidate.fingerprint_match = fingerprint_match;
+		}
+	}
+
+	// The winner of this frame scores extra
+	if (best_match != 0)
+		data.selection_score(best_match) += 1.0f;
+
+	// Stick with the current selection while it is still scoring, unless it was only just selected or another depth-stencil has clearly been winning
+	// A selection that failed any of the checks above this frame (not drawn to, resized, ...) is never kept
+	if (selected_eligible && best_match != data.selected_depth_stencil && !best_candidate.fingerprint_match)
+	{
+		const float selected_score = data.find_selection_score(data.selected_depth_stencil);
+		const float best_score = (best_match != 0) ? data.find_selection_score(best_match) : 0.0f;
+
+		if (selected_score >= s_selection_min_score &&
+			(data.frames_since_selection_change < s_selection_min_dwell_frames || best_score < selected_score + s_selection_switch_margin))
+		{
+			best_match = selected_candidate.depth_stencil;
+			best_match_desc = selected_desc;
+			best_candidate = selected_candidate;
+			best_candidate.fingerprint_match = false;
 		}
 	}
 
 	if (data.override_depth_stencil != 0)
 	{
-		const auto it = current_depth_stencil_resources.find(data.override_depth_stencil);
-		if (it != current_depth_stencil_resources.end())
+		const auto it = std::find_if(snapshot.candidates.begin(), snapshot.candidates.end(),
+			[&data](const depth_stencil_candidate &candidate) { return candidate.depth_stencil == data.override_depth_stencil; });
+		if (it != snapshot.candidates.end() && is_alive(it->depth_stencil))
 		{
-			best_match = it->first;
-			best_match_desc = device->get_resource_desc(it->first);
-			best_snapshot = &it->second.last_counters;
+			best_match = it->depth_stencil;
+			best_match_desc = device->get_resource_desc(it->depth_stencil);
+			best_candidate = *it;
 		}
 	}
 
+	device_data->release_snapshot(snapshot);
+
+	// Lock onto the selected depth-stencil once it won for enough frames in a row (or right away if it matches the saved fingerprint), or fall back to full tracking when it stopped winning
+	if (best_match != 0 && best_candidate.fingerprint_match && data.override_depth_stencil == 0)
+	{
+		data.lock_candidate = best_match;
+		data.lock_streak = s_lock_after_frames;
+	}
+	else if (best_match == data.lock_candidate && best_match != 0)
+		data.lock_streak = std::min(data.lock_streak + 1, s_lock_after_frames);
+	else
+	{
+		data.lock_candidate = best_match;
+		data.lock_streak = (best_match != 0) ? 1 : 0;
+	}
+
+	if (const uint64_t locked = s_locked_depth_stencil.load(std::memory_order_relaxed); locked != 0)
+	{
+		if (best_match.handle != locked || data.override_depth_stencil != 0)
+			s_locked_depth_stencil.store(0, std::memory_order_relaxed);
+	}
+	else if (s_lock_after_frames != 0 && data.override_depth_stencil == 0 && data.lock_streak >= s_lock_after_frames)
+	{
+		device_data->locked_missed_frames = 0;
+		s_locked_depth_stencil.store(best_match.handle, std::memory_order_relaxed);
+
+		save_fingerprint(best_match_desc, best_candidate, frame_width, frame_height);
+	}
+
+	const resource prev_depth_stencil = data.selected_depth_stencil;
 	const resource_view prev_shader_resource = data.selected_shader_resource;
 
 	if (best_match != 0) do
@@ -1037,6 +1650,8 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 
 					if (!device->create_resource_view(depth_stencil_backup->backup_texture, resource_usage::shader_resource, srv_desc, &data.selected_shader_resource))
 						break;
+
+					data.window_view_creations++;
 				}
 
 				data.using_backup_texture = true;
@@ -1046,6 +1661,8 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 				if (!device->create_resource_view(best_match, resource_usage::shader_resource, srv_desc, &data.selected_shader_resource))
 					break;
 
+				data.window_view_creations++;
+
 				assert(!data.using_backup_texture);
 			}
 
@@ -1054,11 +1671,11 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 
 		if (data.using_backup_texture)
 		{
-			assert(depth_stencil_backup != nullptr && depth_stencil_backup->backup_texture != 0 && best_snapshot != nullptr);
+			assert(depth_stencil_backup != nullptr && depth_stencil_backup->backup_texture != 0);
 			const resource backup_texture = depth_stencil_backup->backup_texture;
 
 			// Copy to backup texture unless already copied during the current frame
-			if (!best_snapshot->copied_during_frame && (best_match_desc.usage & (resource_usage::copy_source | resource_usage::resolve_source)) != 0 && (s_preserve_depth_buffers != 2 || !(api == device_api::d3d12 || api == device_api::vulkan)))
+			if (!best_candidate.copied_during_frame && (best_match_desc.usage & (resource_usage::copy_source | resource_usage::resolve_source)) != 0 && (s_preserve_depth_buffers != 2 || !(api == device_api::d3d12 || api == device_api::vulkan)))
 			{
 				bool do_copy = true;
 				// Ensure barriers are not created with 'D3D12_RESOURCE_STATE_[...]_SHADER_RESOURCE' when resource has 'D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE' flag set
@@ -1066,9 +1683,10 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 
 				lock.lock();
 				// Indicate that the copy is now being done, so it is not repeated in case effects are rendered by another runtime (e.g. when there are multiple present calls in a frame)
+				// The snapshot does not see this, so check the flag here again in case another runtime already did the copy since it was published
 				if (const auto it = device_data->depth_stencil_resources.find(best_match);
 					it != device_data->depth_stencil_resources.end())
-					it->second.last_counters.copied_during_frame = true;
+					do_copy = !std::exchange(it->second.last_counters.copied_during_frame, true);
 				else
 					// Resource disappeared from the current depth-stencil list between earlier in this function and now, which indicates that it was destroyed in the meantime
 					do_copy = false;
@@ -1110,15 +1728,24 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 	{
 		// Untrack any existing depth-stencil selected in previous frames
 		if (data.selected_depth_stencil != 0)
-		{
 			device_data->untrack_depth_stencil(device, data.selected_depth_stencil);
 
-			data.using_backup_texture = false;
-			data.selected_depth_stencil = { 0 };
-			data.selected_shader_resource = { 0 };
-		}
+		// The depth-stencil may already have been untracked above because it was retired, but the shader resource view is still around in that case
+		data.using_backup_texture = false;
+		data.selected_depth_stencil = { 0 };
+		data.selected_shader_resource = { 0 };
 	} while (0);
 
+	if (prev_depth_stencil != data.selected_depth_stencil)
+	{
+		data.window_selection_changes++;
+		data.frames_since_selection_change = 0;
+
+		// Also save the fingerprint of a new selection, so that there is one when locking is disabled
+		if (data.selected_depth_stencil != 0 && data.override_depth_stencil == 0)
+			save_fingerprint(best_match_desc, best_candidate, frame_width, frame_height);
+	}
+
 	if (prev_shader_resource != data.selected_shader_resource)
 	{
 		update_effect_runtime(runtime);
@@ -1172,11 +1799,51 @@ static const char *const format_to_string(format format)
 	}
 }
 
+static void draw_depth_overlay(effect_runtime *runtime)
+{
+	generic_depth_device_data *const device_data = runtime->get_device()->get_private_data<generic_depth_device_data>();
+	const generic_depth_data *const data = runtime->get_private_data<generic_depth_data>();
+	if (device_data == nullptr || data == nullptr)
+		return;
+
+	ImGui::Text("Selected depth-stencil: 0x%016llx", data->selected_depth_stencil.handle);
+
+	if (const uint64_t locked = s_locked_depth_stencil.load(std::memory_order_relaxed); locked != 0)
+		ImGui::Text("Locked onto 0x%016llx", locked);
+	else if (s_lock_after_frames != 0)
+		ImGui::Text("Full tracking (%u of %u frames until lock)", data->lock_streak, s_lock_after_frames);
+	else
+		ImGui::TextUnformatted("Full tracking (locking disabled)");
+
+	ImGui::Text("Selection changes: %.1f per minute, view creations: %.1f per minute", data->selection_changes_per_minute, data->view_creations_per_minute);
+
+	{
+		const std::shared_lock<std::shared_mutex> lock(s_mutex);
+
+		ImGui::Text("Backup pool: %u hits, %u misses, %.1f MB resident (%.1f MB unused, budget %u MB)",
+			device_data->backup_pool_hits, device_data->backup_pool_misses,
+			device_data->backup_resident_bytes / (1024.0 * 1024.0), device_data->backup_pooled_bytes / (1024.0 * 1024.0), s_backup_pool_budget_mb);
+	}
+
+	bool measure = s_measure_callback_time.load(std::memory_order_relaxed);
+	if (ImGui::Checkbox("Measure callback time", &measure))
+		s_measure_callback_time.store(measure, std::memory_order_relaxed);
+
+	if (measure)
+	{
+		const std::shared_lock<std::shared_mutex> lock(s_mutex);
+
+		ImGui::Text("Full tracking: %.1f us in %.0f callbacks per frame", device_data->callback_time_us[0], device_data->callback_calls[0]);
+		ImGui::Text("Locked: %.1f us in %.0f callbacks per frame", device_data->callback_time_us[1], device_data->callback_calls[1]);
+	}
+}
+
 extern void register_depth_switcher()
 {
 	reshade::register_event<reshade::addon_event::init_device>(on_init_device);
 	reshade::register_event<reshade::addon_event::init_command_list>(on_init_command_list);
 	reshade::register_event<reshade::addon_event::init_command_queue>(on_init_command_queue);
+	reshade::register_event<reshade::addon_event::init_swapchain>(on_init_depth_swapchain);
 	reshade::register_event<reshade::addon_event::init_effect_runtime>(on_init_effect_runtime);
 	reshade::register_event<reshade::addon_event::destroy_device>(on_destroy_device);
 	reshade::register_event<reshade::addon_event::destroy_command_list>(on_destroy_command_list);
@@ -1185,6 +1852,7 @@ extern void register_depth_switcher()
 
 	reshade::register_event<reshade::addon_event::create_resource>(on_create_resource);
 	reshade::register_event<reshade::addon_event::create_resource_view>(on_create_resource_view);
+	reshade::register_event<reshade::addon_event::init_resource>(on_init_resource);
 	reshade::register_event<reshade::addon_event::destroy_resource>(on_destroy_resource);
 
 	reshade::register_event<reshade::addon_event::draw>(on_draw);
@@ -1212,6 +1880,7 @@ extern void unregister_depth_switcher()
 	reshade::unregister_event<reshade::addon_event::init_device>(on_init_device);
 	reshade::unregister_event<reshade::addon_event::init_command_list>(on_init_command_list);
 	reshade::unregister_event<reshade::addon_event::init_command_queue>(on_init_command_queue);
+	reshade::unregister_event<reshade::addon_event::init_swapchain>(on_init_depth_swapchain);
 	reshade::unregister_event<reshade::addon_event::init_effect_runtime>(on_init_effect_runtime);
 	reshade::unregister_event<reshade::addon_event::destroy_device>(on_destroy_device);
 	reshade::unregister_event<reshade::addon_event::destroy_command_list>(on_destroy_command_list);
@@ -1220,6 +1889,7 @@ extern void unregister_depth_switcher()
 
 	reshade::unregister_event<reshade::addon_event::create_resource>(on_create_resource);
 	reshade::unregister_event<reshade::addon_event::create_resource_view>(on_create_resource_view);
+	reshade::unregister_event<reshade::addon_event::init_resource>(on_init_resource);
 	reshade::unregister_event<reshade::addon_event::destroy_resource>(on_destroy_resource);
 
 	reshade::unregister_event<reshade::addon_event::draw>(on_draw);
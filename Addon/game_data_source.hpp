@@ -9,6 +9,8 @@
 
 struct DataSource
 {
+	virtual ~DataSource() = default;
+
 	const virtual std::string_view get_region_name(int region) = 0;
 	const virtual std::string_view get_weather_name(int weather) = 0;
 
@@ -0,0 +1,322 @@
+#include "gpu_timing.hpp"
+#include "imgui.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace reshade::api;
+
+namespace GpuTiming
+{
+	// Resolved frames averaged before the overlay numbers are refreshed
+	constexpr uint32_t STATS_WINDOW = 60;
+
+	struct Slot
+	{
+		uint32_t count = 0;   // Timestamps written
+		bool pending = false; // Written and not read back yet
+		std::array<uint32_t, MAX_TIMESTAMPS> technique = {}; // Index into 'techniques' of the technique ending at each timestamp
+	};
+
+	struct TechniqueStats
+	{
+		std::string name;
+		bool pulsev = false;
+
+		// Accumulated over the current window
+		double sum_ms = 0.0;
+		double max_ms = 0.0;
+		uint32_t samples = 0;
+
+		// Last completed window
+		float avg_ms = -1.0f;
+		float peak_ms = 0.0f;
+	};
+
+	static effect_runtime *owner = nullptr;
+	static bool unavailable = false;
+	static query_heap heap = { 0 };
+	static double ticks_to_ms = 0.0;
+
+	static std::array<Slot, FRAMES_IN_FLIGHT> slots;
+	static uint32_t frame = 0;
+	static bool in_frame = false;
+
+	static std::unordered_map<uint64_t, uint32_t> technique_index;
+	static std::vector<TechniqueStats> techniques;
+
+	static uint32_t window_frames = 0;
+	static double window_total_ms = 0.0;
+	static float avg_total_ms = -1.0f;
+	static uint64_t resolved_frames = 0;
+	static uint64_t missed_frames = 0;
+	static uint64_t reordered_samples = 0;
+	static uint64_t window_count = 0;
+
+	static bool create_heap(effect_runtime *runtime)
+	{
+		device *const device = runtime->get_device();
+		const uint64_t frequency = runtime->get_command_queue()->get_timestamp_frequency();
+
+		if (frequency == 0 || !device->create_query_heap(query_type::timestamp, FRAMES_IN_FLIGHT * MAX_TIMESTAMPS, &heap))
+		{
+			reshade::log::message(reshade::log::level::warning, "Timestamp queries are not available, GPU pass timing is disabled");
+			unavailable = true;
+			return false;
+		}
+
+		owner = runtime;
+		ticks_to_ms = 1000.0 / static_cast<double>(frequency);
+		return true;
+	}
+
+	static void discard_pending()
+	{
+		for (Slot &slot : slots)
+		{
+			slot.pending = false;
+		}
+
+		in_frame = false;
+	}
+
+	static uint32_t get_technique(effect_runtime *runtime, effect_technique technique)
+	{
+		const auto it = technique_index.find(technique.handle);
+
+		if (it != technique_index.end())
+		{
+			return it->second;
+		}
+
+		TechniqueStats &stats = techniques.emplace_back();
+		char name[128] = "";
+		char effect_name[128] = "";
+		runtime->get_technique_name(technique, name);
+		runtime->get_technique_effect_name(technique, effect_name);
+
+		stats.name = name;
+		stats.pulsev = std::string_view(effect_name).starts_with("PulseV");
+
+		const uint32_t index = static_cast<uint32_t>(techniques.size() - 1);
+		technique_index.emplace(technique.handle, index);
+		return index;
+	}
+
+	static void resolve(Slot &slot)
+	{
+		if (!slot.pending)
+		{
+			return;
+		}
+
+		slot.pending = false;
+
+		const uint32_t base = static_cast<uint32_t>(&slot - slots.data()) * MAX_TIMESTAMPS;
+		std::array<uint64_t, MAX_TIMESTAMPS> timestamps;
+
+		if (slot.count < 2 || !owner->get_device()->get_query_heap_results(heap, base, slot.count, timestamps.data(), sizeof(uint64_t)))
+		{
+			missed_frames += slot.count < 2 ? 0 : 1;
+			return;
+		}
+
+		double frame_ms = 0.0;
+
+		for (uint32_t i = 1; i < slot.count; i++)
+		{
+			// Timestamps are unsigned, one going backwards (a GPU clock that does not count across the
+			// command lists, a disjoint period) would wrap around to an enormous time
+			if (timestamps[i] < timestamps[i - 1])
+			{
+				reordered_samples++;
+				continue;
+			}
+
+			TechniqueStats &stats = techniques[slot.technique[i]];
+			const double ms = static_cast<double>(timestamps[i] - timestamps[i - 1]) * ticks_to_ms;
+
+			stats.sum_ms += ms;
+			stats.max_ms = std::max(stats.max_ms, ms);
+			stats.samples++;
+			frame_ms += ms;
+		}
+
+		window_total_ms += frame_ms;
+		resolved_frames++;
+
+		if (++window_frames < STATS_WINDOW)
+		{
+			return;
+		}
+
+		for (TechniqueStats &stats : techniques)
+		{
+			if (stats.samples != 0)
+			{
+				stats.avg_ms = static_cast<float>(stats.sum_ms / stats.samples);
+				stats.peak_ms = static_cast<float>(stats.max_ms);
+			}
+
+			stats.sum_ms = stats.max_ms = 0.0;
+			stats.samples = 0;
+		}
+
+		avg_total_ms = static_cast<float>(window_total_ms / window_frames);
+		window_total_ms = 0.0;
+		window_frames = 0;
+		window_count++;
+	}
+
+	void begin_effects(effect_runtime *runtime, command_list *cmd_list)
+	{
+		if (owner == nullptr && (unavailable || !create_heap(runtime)))
+		{
+			return;
+		}
+
+		// Only the first runtime is timed, a second one (VR, a second swap chain) would share the slots
+		if (runtime != owner)
+		{
+			return;
+		}
+
+		frame++;
+		Slot &slot = slots[frame % FRAMES_IN_FLIGHT];
+
+		// The slot was written FRAMES_IN_FLIGHT frames ago, its results are read before it is overwritten
+		resolve(slot);
+
+		slot.count = 1;
+		in_frame = true;
+		cmd_list->end_query(heap, query_type::timestamp, (frame % FRAMES_IN_FLIGHT) * MAX_TIMESTAMPS);
+	}
+
+	void on_render_technique(effect_runtime *runtime, effect_technique technique, command_list *cmd_list, resource_view, resource_view)
+	{
+		if (runtime != owner || !in_frame)
+		{
+			return;
+		}
+
+		Slot &slot = slots[frame % FRAMES_IN_FLIGHT];
+
+		if (slot.count >= MAX_TIMESTAMPS)
+		{
+			return;
+		}
+
+		slot.technique[slot.count] = get_technique(runtime, technique);
+		cmd_list->end_query(heap, query_type::timestamp, (frame % FRAMES_IN_FLIGHT) * MAX_TIMESTAMPS + slot.count);
+		slot.count++;
+	}
+
+	void finish_effects(effect_runtime *runtime)
+	{
+		if (runtime != owner || !in_frame)
+		{
+			return;
+		}
+
+		in_frame = false;
+		slots[frame % FRAMES_IN_FLIGHT].pending = true;
+	}
+
+	void on_effects_reloaded(effect_runtime *runtime)
+	{
+		if (runtime != owner)
+		{
+			return;
+		}
+
+		discard_pending();
+		technique_index.clear();
+		techniques.clear();
+		window_frames = 0;
+		window_total_ms = 0.0;
+	}
+
+	void on_runtime_destroyed(effect_runtime *runtime)
+	{
+		if (runtime != owner)
+		{
+			return;
+		}
+
+		discard_pending();
+		technique_index.clear();
+		techniques.clear();
+		window_frames = 0;
+		window_total_ms = 0.0;
+		avg_total_ms = -1.0f;
+
+		runtime->get_device()->destroy_query_heap(heap);
+		heap = { 0 };
+		owner = nullptr;
+	}
+
+	float get_technique_ms(const char *technique_name)
+	{
+		for (const TechniqueStats &stats : techniques)
+		{
+			if (stats.pulsev && stats.name == technique_name)
+			{
+				return stats.avg_ms;
+			}
+		}
+
+		return -1.0f;
+	}
+
+	uint64_t get_window_count()
+	{
+		return window_count;
+	}
+
+	void draw_overlay()
+	{
+		if (owner == nullptr)
+		{
+			ImGui::Text("Timestamp queries are not available");
+			return;
+		}
+
+		if (avg_total_ms < 0.0f)
+		{
+			ImGui::Text("Waiting for results...");
+			return;
+		}
+
+		ImGui::Text("Averaged over %u frames, read back %u frames late", STATS_WINDOW, FRAMES_IN_FLIGHT);
+		ImGui::Text("All effects: %.3f ms", avg_total_ms);
+
+		float other_ms = avg_total_ms;
+
+		for (const TechniqueStats &stats : techniques)
+		{
+			if (!stats.pulsev || stats.avg_ms < 0.0f)
+			{
+				continue;
+			}
+
+			ImGui::Text("%s: %.3f ms (peak %.3f ms)", stats.name.c_str(), stats.avg_ms, stats.peak_ms);
+			other_ms -= stats.avg_ms;
+		}
+
+		ImGui::Text("Other techniques: %.3f ms", std::max(other_ms, 0.0f));
+
+		if (missed_frames != 0)
+		{
+			ImGui::Text("Frames dropped waiting on the GPU: %llu of %llu", (unsigned long long)missed_frames, (unsigned long long)(missed_frames + resolved_frames));
+		}
+
+		if (reordered_samples != 0)
+		{
+			ImGui::Text("Samples dropped, timestamps out of order: %llu", (unsigned long long)reordered_samples);
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <reshade.hpp>
+
+// GPU time of each effect technique, measured with timestamp queries.
+//
+// One timestamp is written when the effects begin and one after every technique, so a
+// technique's time is the difference to the timestamp before it. The addon API only reports
+// technique boundaries, the passes inside a technique (aurora, clouds_low, ...) are timed
+// together. Each frame writes into its own slot of a ring of FRAMES_IN_FLIGHT slots and a slot
+// is read back only when it comes round again, results that are still not available by then
+// are dropped instead of waiting on the GPU.
+namespace GpuTiming
+{
+	// Frames between writing a slot's timestamps and reading them back
+	constexpr uint32_t FRAMES_IN_FLIGHT = 4;
+	// Timestamps per frame, the start of the effects plus one per technique
+	constexpr uint32_t MAX_TIMESTAMPS = 64;
+
+	void begin_effects(reshade::api::effect_runtime *runtime, reshade::api::command_list *cmd_list);
+	void on_render_technique(reshade::api::effect_runtime *runtime, reshade::api::effect_technique technique, reshade::api::command_list *cmd_list, reshade::api::resource_view rtv, reshade::api::resource_view rtv_srgb);
+	void finish_effects(reshade::api::effect_runtime *runtime);
+
+	// Technique handles are not stable across reloads, in-flight results are discarded
+	void on_effects_reloaded(reshade::api::effect_runtime *runtime);
+	void on_runtime_destroyed(reshade::api::effect_runtime *runtime);
+
+	// Average GPU milliseconds of a PulseV technique over the last window, or a negative value if it has not been timed
+	float get_technique_ms(const char *technique_name);
+	// Incremented every time the averages are refreshed
+	uint64_t get_window_count();
+
+	void draw_overlay();
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2025 Matthew Burrows (anti-matt-er)
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ *
+ * Description: Per-frame staging and injection of the game data into effect uniforms
+ */
+
+#include "injection.hpp"
+#include "data_reader.hpp"
+#include "pass_scheduler.hpp"
+#include "profiler.hpp"
+#include "quality_controller.hpp"
+#include "temporal.hpp"
+#include "util/StringHash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <variant>
+
+using namespace reshade::api;
+
+constexpr size_t MAX_UNIFORM_NAME = 48;
+
+struct StagedUniform {
+	UniformType value;
+	uint32_t frame = 0;
+};
+
+// Names stay in the map between frames so staging reuses them instead of allocating every frame,
+// only the values staged in the current frame are injected
+static pv::StringMap<StagedUniform> staged_uniforms;
+static uint32_t staging_frame = 0;
+static Injection::Stats stats;
+static pv::clouds::MarchBudget march_budget;
+
+/**
+* Injection statistics
+**/
+
+void Injection::Stats::end_frame()
+{
+	window.tick_ns += frame.tick_ns;
+	window.stage_ns += frame.stage_ns;
+	window.commit_ns += frame.commit_ns;
+	window.variables_scanned += frame.variables_scanned;
+	window.values_set += frame.values_set;
+
+	if (++frames < STATS_WINDOW)
+		return;
+
+	avg_tick_us = window.tick_ns / 1000.0 / frames;
+	avg_stage_us = window.stage_ns / 1000.0 / frames;
+	avg_commit_us = window.commit_ns / 1000.0 / frames;
+	avg_variables_scanned = (double)window.variables_scanned / frames;
+	avg_values_set = (double)window.values_set / frames;
+
+	window = {};
+	frames = 0;
+}
+
+const Injection::Stats &Injection::get_stats()
+{
+	return stats;
+}
+
+const pv::clouds::MarchBudget &Injection::get_march_budget()
+{
+	return march_budget;
+}
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point since)
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+/**
+* Uniform staging
+**/
+
+static void stage_value(std::string_view annotation, const UniformType& value)
+{
+	auto it = staged_uniforms.find(annotation);
+	if (it == staged_uniforms.end()) {
+		it = staged_uniforms.emplace(std::string(annotation), StagedUniform{}).first;
+	}
+
+	it->second.value = value;
+	it->second.frame = staging_frame;
+}
+
+template <typename T>
+void stage_uniform(std::string_view annotation, const T& value)
+{
+	stage_value(annotation, UniformType(value));
+}
+
+template<>
+void stage_uniform<Float4x4>(std::string_view annotation, const Float4x4& value)
+{
+	const Float4* rows[] = { &value.r1, &value.r2, &value.r3, &value.r4 };
+	char name[MAX_UNIFORM_NAME];
+
+	for (int i = 0; i < 4; i++) {
+		const int length = std::snprintf(name, sizeof(name), "%.*s__r%d", (int)annotation.size(), annotation.data(), i + 1);
+		stage_value(std::string_view(name, std::min<size_t>(length, sizeof(name) - 1)), *rows[i]);
+	}
+}
+
+template<>
+void stage_uniform<TimeCycle::WeatherFrame>(std::string_view annotation, const TimeCycle::WeatherFrame& value)
+{
+	char name[MAX_UNIFORM_NAME];
+
+	for (const auto& variable : value.floats) {
+		const int length = std::snprintf(name, sizeof(name), "%.*s_%s", (int)annotation.size(), annotation.data(), variable.first.c_str());
+		stage_value(std::string_view(name, std::min<size_t>(length, sizeof(name) - 1)), variable.second);
+	}
+
+	for (const auto& variable : value.colors) {
+		const int length = std::snprintf(name, sizeof(name), "%.*s_%s", (int)annotation.size(), annotation.data(), variable.first.c_str());
+		stage_value(std::string_view(name, std::min<size_t>(length, sizeof(name) - 1)), variable.second);
+	}
+}
+
+// Stages every value of the frame, returns whether the reader is enabled
+static bool stage_frame(const pv::clouds::CloudsState& cloud_state)
+{
+	staging_frame++;
+
+	const bool enabled = DataReader::get_enabled();
+	stage_uniform("enabled", enabled);
+
+	QualityController::update();
+	stage_uniform("quality_scale", QualityController::get_quality_scale());
+	stage_uniform("distance_scale", QualityController::get_distance_scale());
+
+	if (!enabled) {
+		return false;
+	}
+
+	DataReader::fast_update();
+
+	stage_uniform("depth_reversed", DataReader::get_depth_reversed());
+	stage_uniform("view_matrix", DataReader::get_view_matrix());
+	stage_uniform("projection_matrix", DataReader::get_proj_matrix());
+	stage_uniform("inverse_view_matrix", DataReader::get_inv_view_matrix());
+	stage_uniform("inverse_projection_matrix", DataReader::get_inv_proj_matrix());
+	stage_uniform("previous_view_matrix", DataReader::get_prev_view_matrix());
+	stage_uniform("previous_projection_matrix", DataReader::get_prev_proj_matrix());
+	stage_uniform("previous_inverse_view_matrix", DataReader::get_prev_inv_view_matrix());
+	stage_uniform("previous_inverse_projection_matrix", DataReader::get_prev_inv_proj_matrix());
+	stage_uniform("camera_position", DataReader::get_camera_pos());
+	stage_uniform("camera_rotation", DataReader::get_camera_rot());
+	stage_uniform("delta_camera_position", DataReader::get_delta_camera_pos());
+	stage_uniform("delta_camera_rotation", DataReader::get_delta_camera_rot());
+	stage_uniform("near_clip", DataReader::get_near_clip());
+	stage_uniform("far_clip", DataReader::get_far_clip());
+	stage_uniform("camera_fov", DataReader::get_camera_fov());
+	stage_uniform("wind_direction", DataReader::get_wind_dir());
+	stage_uniform("wind_speed", DataReader::get_wind_speed());
+	stage_uniform("wind_position", DataReader::get_wind_pos());
+	stage_uniform("time_of_day", DataReader::get_time_of_day());
+	stage_uniform("game_timer", DataReader::get_timer());
+	stage_uniform("from_weather_type", (int)DataReader::get_from_weather_type());
+	stage_uniform("to_weather_type", (int)DataReader::get_to_weather_type());
+	stage_uniform("weather_transition", DataReader::get_weather_transition());
+	stage_uniform("wf", DataReader::get_weather_frame());
+	stage_uniform("aurora_visibility", DataReader::get_aurora_visibility());
+	stage_uniform("moon_dir", DataReader::get_moon_dir());
+
+	// Only known when the addon drives the cloud presets, otherwise the effect marches at full budget
+	if (cloud_state.slab.valid) {
+		march_budget = pv::clouds::compute_march_budget(cloud_state.slab,
+			DataReader::get_camera_pos().v[1], DataReader::get_camera_rot().v[0], DataReader::get_camera_fov());
+	}
+	stage_uniform("march_sample_scale", march_budget.sample_scale);
+	stage_uniform("march_light_steps", march_budget.light_steps);
+
+	PassScheduler::update(DataReader::get_aurora_visibility(), DataReader::get_time_of_day(), cloud_state.slab);
+	stage_uniform("aurora_gate", PassScheduler::get_aurora_gate());
+	stage_uniform("clouds_gate", PassScheduler::get_clouds_gate());
+
+	const Temporal::Frame &temporal = Temporal::update(DataReader::get_camera_pos(), DataReader::get_delta_camera_pos(),
+		DataReader::get_delta_camera_rot(), DataReader::get_prev_view_matrix(), DataReader::get_prev_proj_matrix());
+	stage_uniform("frame_index", (int)temporal.index);
+	stage_uniform("interleave_size", temporal.interleave_size);
+	stage_uniform("interleave_offset", temporal.interleave_offset);
+	stage_uniform("jitter", temporal.jitter);
+	stage_uniform("camera_cut", temporal.camera_cut);
+	stage_uniform("previous_view_projection", temporal.previous_view_projection);
+
+	return true;
+}
+
+/**
+* Uniform injection
+**/
+
+struct UniformInjectionVisitor {
+	effect_runtime* runtime;
+	effect_uniform_variable& variable;
+
+	void operator()(bool value) const {
+		runtime->set_uniform_value_bool(variable, value);
+	}
+
+	void operator()(int value) const {
+		runtime->set_uniform_value_int(variable, value);
+	}
+
+	void operator()(float value) const {
+		runtime->set_uniform_value_float(variable, value);
+	}
+
+	void operator()(const Float2& value) const {
+		runtime->set_uniform_value_float(variable, value.v, 2);
+	}
+
+	void operator()(const Float3& value) const {
+		runtime->set_uniform_value_float(variable, value.v, 3);
+	}
+
+	void operator()(const Float4& value) const {
+		runtime->set_uniform_value_float(variable, value.v, 4);
+	}
+
+	void operator()(const Float4x4& value) const {
+		reshade::log::message(reshade::log::level::error, "Tried to inject Float4x4 without marshalling!");
+	}
+
+	void operator()(const TimeCycle::WeatherFrame& value) const {
+		reshade::log::message(reshade::log::level::error, "Tried to inject WeatherFrame without marshalling!");
+	}
+
+	void operator()(const UniformType& value) const
+	{
+		reshade::log::message(reshade::log::level::error, "Tried to inject unknown uniform type!");
+	}
+};
+
+static void inject_uniform(effect_runtime* runtime, effect_uniform_variable& variable, const UniformType& value)
+{
+	stats.frame.values_set++;
+	std::visit(UniformInjectionVisitor{ runtime, variable }, value);
+}
+
+static void commit_uniforms(effect_runtime* runtime, UniformCapture::Writer& capture)
+{
+	PV_PROFILE_ZONE("commit_uniforms");
+
+	runtime->enumerate_uniform_variables(nullptr, [&capture](effect_runtime* runtime, effect_uniform_variable variable) {
+		char annotation[MAX_UNIFORM_NAME] = { 0 };
+
+		stats.frame.variables_scanned++;
+
+		if (runtime->get_annotation_string_from_uniform_variable(variable, "source", annotation))
+		{
+			auto uniform_iter = staged_uniforms.find(std::string_view(annotation));
+			if (uniform_iter != staged_uniforms.end() && uniform_iter->second.frame == staging_frame) {
+				inject_uniform(runtime, variable, uniform_iter->second.value);
+				capture.record(uniform_iter->first, uniform_iter->second.value);
+			}
+		}
+		});
+}
+
+bool Injection::inject_frame(effect_runtime *runtime, pv::clouds::CloudsState &cloud_state, double now_seconds, UniformCapture::Writer &capture)
+{
+	stats.frame = {};
+
+	// The capture holds both the preset values pv::clouds writes and the staged ones
+	capture.begin_frame();
+
+	auto section_start = std::chrono::steady_clock::now();
+
+	if (cloud_state.has_runtime) {
+		PV_PROFILE_ZONE("pv::clouds::tick");
+		const uint64_t writes = pv::clouds::get_uniform_write_count();
+		pv::clouds::set_uniform_capture(&capture);
+		pv::clouds::tick(cloud_state, now_seconds);
+		pv::clouds::set_uniform_capture(nullptr);
+		stats.frame.values_set += pv::clouds::get_uniform_write_count() - writes;
+	}
+
+	stats.frame.tick_ns = elapsed_ns(section_start);
+	section_start = std::chrono::steady_clock::now();
+
+	const bool enabled = stage_frame(cloud_state);
+
+	stats.frame.stage_ns = elapsed_ns(section_start);
+	section_start = std::chrono::steady_clock::now();
+
+	commit_uniforms(runtime, capture);
+	capture.end_frame();
+
+	stats.frame.commit_ns = elapsed_ns(section_start);
+	stats.end_frame();
+
+	return enabled;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <reshade.hpp>
+#include "cloud_overlay.hpp"
+#include "march_budget.hpp"
+#include "uniform_capture.hpp"
+
+// The per-frame uniform injection: ticks the cloud presets, stages every game value under the
+// "source" annotation it binds to, then writes the staged values into the effect uniforms.
+// Nothing here registers with ReShade, addon.cpp calls inject_frame() from reshade_begin_effects
+// and the tests drive it against a mock effect runtime.
+namespace Injection
+{
+	// Number of frames averaged before the overlay numbers are refreshed
+	constexpr uint32_t STATS_WINDOW = 120;
+
+	struct Counts
+	{
+		uint64_t tick_ns = 0;
+		uint64_t stage_ns = 0;
+		uint64_t commit_ns = 0;
+		uint64_t variables_scanned = 0;
+		uint64_t values_set = 0; // Including the cloud preset writes
+	};
+
+	struct Stats
+	{
+		Counts frame;  // The last frame
+		Counts window; // Accumulated over the current window
+		uint32_t frames = 0;
+
+		// Per-frame averages of the last completed window
+		double avg_tick_us = 0.0;
+		double avg_stage_us = 0.0;
+		double avg_commit_us = 0.0;
+		double avg_variables_scanned = 0.0;
+		double avg_values_set = 0.0;
+
+		void end_frame();
+	};
+
+	// Runs one frame of injection into 'runtime' and records what was written into 'capture'
+	// when it is open. Returns whether game data was available (the reader is enabled).
+	bool inject_frame(reshade::api::effect_runtime *runtime, pv::clouds::CloudsState &cloud_state, double now_seconds, UniformCapture::Writer &capture);
+
+	const Stats &get_stats();
+	const pv::clouds::MarchBudget &get_march_budget();
+}
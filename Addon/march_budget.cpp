@@ -0,0 +1,62 @@
+#include "march_budget.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace pv::clouds;
+
+// Matches CLOUD_MIN_HEIGHT in the effect, a layer is never thinner than this
+constexpr float kMinLayerHeight = 100.0f;
+
+static float mix(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+// 0 for a layer the effect cannot render, 1 for one dense enough to need every sample.
+// The effect's density grows with the square root of the cover, so the budget does too.
+static float coverage(float cover) {
+    if (cover <= kMinCover) return 0.0f;
+    return std::min(std::sqrt((cover - kMinCover) / (kFullCover - kMinCover)), 1.0f);
+}
+
+LayerSlab pv::clouds::layer_slab(const CloudPreset& from, const CloudPreset& to, float blend) {
+    const CloudLayer& fb = from.bottomLayer; const CloudLayer& ft = from.topLayer;
+    const CloudLayer& tb = to.bottomLayer; const CloudLayer& tt = to.topLayer;
+    const float cover = mix(from.cloudCover, to.cloudCover, blend);
+    const float offset = mix(from.cloudHeightOffset, to.cloudHeightOffset, blend);
+
+    LayerSlab s;
+    s.valid = true;
+    s.cover_bottom = cover * mix(fb.cover, tb.cover, blend);
+    s.cover_top = cover * mix(ft.cover, tt.cover, blend);
+
+    const float bottom_bottom = std::max(mix(fb.bottom, tb.bottom, blend) + offset, 0.0f);
+    const float top_bottom = std::max(mix(ft.bottom, tt.bottom, blend) + offset, 0.0f);
+    s.bottom = std::min(bottom_bottom, top_bottom);
+    s.top = std::max({ mix(fb.top, tb.top, blend) + offset, mix(ft.top, tt.top, blend) + offset,
+        bottom_bottom + kMinLayerHeight, top_bottom + kMinLayerHeight });
+    return s;
+}
+
+MarchBudget pv::clouds::compute_march_budget(const LayerSlab& slab, float camera_altitude, float pitch, float fov_y) {
+    const float content = std::max(coverage(slab.cover_bottom), coverage(slab.cover_top));
+
+    // Share of the vertical field of view that points towards the slab
+    const float half_fov = std::max(fov_y, 1.0f) * 0.5f;
+    float view = 1.0f;
+    if (camera_altitude < slab.bottom) {
+        view = std::clamp((pitch + half_fov) / (2.0f * half_fov), 0.0f, 1.0f);
+    }
+    else if (camera_altitude > slab.top) {
+        view = std::clamp((half_fov - pitch) / (2.0f * half_fov), 0.0f, 1.0f);
+    }
+
+    // The scale applies to every pixel, including the ones that do see clouds, so it only drops
+    // once little of the view can reach the slab
+    const float visible = std::min(view * 4.0f, 1.0f);
+
+    MarchBudget b;
+    b.sample_scale = kMinSampleScale + (1.0f - kMinSampleScale) * content * visible;
+    // Light rays through thin cover barely attenuate, half the steps are enough there
+    b.light_steps = std::clamp((int)std::lround(mix((float)kMinLightSteps, (float)kMaxLightSteps, content)), kMinLightSteps, kMaxLightSteps);
+    return b;
+}
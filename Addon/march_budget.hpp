@@ -0,0 +1,37 @@
+#pragma once
+#include "cloud_presets.hpp"
+
+namespace pv::clouds {
+
+// Light samples the effect is built with (CLOUD_LIGHT_SAMPLES), the most the budget asks for
+constexpr int kMaxLightSteps = 4;
+constexpr int kMinLightSteps = 2;
+// Fraction of the preset's samples marched when nothing can be visible
+constexpr float kMinSampleScale = 0.25f;
+// Effective cover (cloudCover * layer cover) below which the effect renders nothing (MIN_COVER)
+constexpr float kMinCover = 0.005f;
+// Effective cover from which a layer is treated as needing every sample
+constexpr float kFullCover = 0.25f;
+
+// Covers and vertical extent of the layers being rendered, blended like the effect blends them
+struct LayerSlab {
+    float cover_bottom = 0.0f; // Effective covers
+    float cover_top = 0.0f;
+    float bottom = 0.0f;       // Meters, with the height offset applied
+    float top = 0.0f;
+    bool valid = false;        // Set once the addon has pushed layers to the effect
+};
+
+struct MarchBudget {
+    float sample_scale = 1.0f;
+    int light_steps = kMaxLightSteps;
+};
+
+LayerSlab layer_slab(const CloudPreset& from, const CloudPreset& to, float blend);
+
+// Recommended share of the march for the current clouds and view. Sparse covers and views that
+// cannot see the slab (below it looking down, above it looking up) get fewer samples.
+// 'pitch' and 'fov_y' are in degrees, pitch positive looking up.
+MarchBudget compute_march_budget(const LayerSlab& slab, float camera_altitude, float pitch, float fov_y);
+
+} // namespace pv::clouds
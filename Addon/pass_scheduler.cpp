@@ -0,0 +1,79 @@
+#include "pass_scheduler.hpp"
+#include "imgui.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace PassScheduler
+{
+	// Night as the effect sees it (NIGHT_DAWN_END and NIGHT_DUSK_START in gtav.fxh), outside of it the aurora is never drawn
+	constexpr float NIGHT_END = 5.0f / 24.0f;
+	constexpr float NIGHT_START = 21.75f / 24.0f;
+
+	// Effective cover a layer needs before the clouds are marched again, and below which they stop
+	constexpr float CLOUDS_ON_COVER = pv::clouds::kMinCover * 2.0f;
+	constexpr float CLOUDS_OFF_COVER = pv::clouds::kMinCover;
+
+	static Gate aurora;
+	static Gate clouds;
+
+	void Gate::update(bool needed, float delta_seconds)
+	{
+		if (needed)
+		{
+			wanted = true;
+			unneeded_seconds = 0.0f;
+		}
+		else if ((unneeded_seconds += delta_seconds) >= GATE_HOLD_SECONDS)
+		{
+			wanted = false;
+		}
+
+		const float step = delta_seconds / GATE_FADE_SECONDS;
+		weight = wanted ? std::min(weight + step, 1.0f) : std::max(weight - step, 0.0f);
+
+		frames++;
+		skipped_frames += weight == 0.0f ? 1 : 0;
+	}
+
+	void update(float aurora_visibility, float time_of_day, const pv::clouds::LayerSlab &slab)
+	{
+		static std::chrono::steady_clock::time_point last_update = std::chrono::steady_clock::now();
+
+		const auto now = std::chrono::steady_clock::now();
+		// Long stalls (loading screens) should not skip the fade
+		const float delta_seconds = std::min(std::chrono::duration<float>(now - last_update).count(), 0.1f);
+		last_update = now;
+
+		const bool night = time_of_day < NIGHT_END || time_of_day > NIGHT_START;
+		aurora.update(night && aurora_visibility > 0.0f, delta_seconds);
+
+		// Without presets from the addon the effect uses its own covers, which are not known here
+		const float cover = std::max(slab.cover_bottom, slab.cover_top);
+		const bool clouds_needed = !slab.valid || cover > (clouds.wanted ? CLOUDS_OFF_COVER : CLOUDS_ON_COVER);
+		// The aurora is composited by the cloud passes, they keep running while it is on screen
+		clouds.update(clouds_needed || aurora.weight > 0.0f, delta_seconds);
+	}
+
+	float get_aurora_gate()
+	{
+		return aurora.weight;
+	}
+
+	float get_clouds_gate()
+	{
+		return clouds.weight;
+	}
+
+	static void draw_gate(const char *name, const Gate &gate)
+	{
+		const double skipped = gate.frames != 0 ? 100.0 * gate.skipped_frames / gate.frames : 0.0;
+		ImGui::Text("%s: %s, weight %.2f, skipped %llu frames (%.1f%%)", name, gate.wanted ? "on" : "off", gate.weight, (unsigned long long)gate.skipped_frames, skipped);
+	}
+
+	void draw_overlay()
+	{
+		draw_gate("Aurora", aurora);
+		draw_gate("Clouds", clouds);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "march_budget.hpp"
+
+#include <cstdint>
+
+// Decides each frame whether the aurora and cloud passes have anything to draw.
+//
+// A gate opens as soon as its pass is needed and closes only after it has not been needed for
+// GATE_HOLD_SECONDS, then fades over GATE_FADE_SECONDS so nothing pops. The effect reads the
+// gates through the 'aurora_gate' and 'clouds_gate' uniforms and skips a pass at 0. The passes
+// are gated with uniforms rather than set_technique_state, since they share one technique with
+// the passes that still have to run, and toggling it would also change the user's preset.
+namespace PassScheduler
+{
+	constexpr float GATE_HOLD_SECONDS = 2.0f;
+	constexpr float GATE_FADE_SECONDS = 1.0f;
+
+	struct Gate
+	{
+		float weight = 1.0f;         // Passed to the effect, 0 skips the pass
+		bool wanted = true;          // Target after hysteresis
+		float unneeded_seconds = 0.0f;
+		uint64_t frames = 0;
+		uint64_t skipped_frames = 0;
+
+		void update(bool needed, float delta_seconds);
+	};
+
+	// 'time_of_day' is the 0-1 value injected as time_of_day
+	void update(float aurora_visibility, float time_of_day, const pv::clouds::LayerSlab &slab);
+
+	float get_aurora_gate();
+	float get_clouds_gate();
+
+	void draw_overlay();
+}
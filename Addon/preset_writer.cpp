@@ -0,0 +1,234 @@
+#include "preset_writer.hpp"
+#include "util/IniLite.hpp"
+#include <reshade.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+using namespace pv::clouds;
+
+// Saves arriving closer together than this are merged into one write
+static constexpr std::chrono::milliseconds kCoalesceDelay(250);
+
+namespace {
+    // Offset just past the line containing 'pos'
+    static size_t line_end(std::string_view src, size_t pos) {
+        const size_t nl = src.find('\n', pos);
+        return (nl == std::string_view::npos) ? src.size() : nl + 1;
+    }
+
+    static bool ends_with_blank_line(const std::string& s) {
+        const size_t n = s.size();
+        return n == 0
+            || (n >= 2 && s.compare(n - 2, 2, "\n\n") == 0)
+            || (n >= 4 && s.compare(n - 4, 4, "\r\n\r\n") == 0);
+    }
+} // anonymous namespace
+
+void PresetWriter::start_locked() {
+    if (!thread.joinable()) {
+        stopping = false;
+        thread = std::thread(&PresetWriter::worker, this);
+    }
+}
+
+void PresetWriter::enqueue_all(const std::string& ini_path, const PresetStore& store) {
+    PresetMap snapshot = store.map;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) pending.swap(snapshot);
+        else for (auto& kv : snapshot) pending[kv.first] = std::move(kv.second);
+        pending_path = ini_path;
+        last_enqueue = std::chrono::steady_clock::now();
+        busy_flag.store(true, std::memory_order_relaxed);
+        start_locked();
+    }
+    cv.notify_all();
+}
+
+void PresetWriter::enqueue_one(const std::string& ini_path, const std::string& key, const CloudPreset& preset) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[key] = preset;
+        pending_path = ini_path;
+        last_enqueue = std::chrono::steady_clock::now();
+        busy_flag.store(true, std::memory_order_relaxed);
+        start_locked();
+    }
+    cv.notify_all();
+}
+
+void PresetWriter::mark_clean(const PresetStore& store) {
+    PresetMap snapshot = store.map;
+    std::lock_guard<std::mutex> lock(mutex);
+    persisted.swap(snapshot);
+}
+
+void PresetWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!thread.joinable()) return;
+    hurry = true;
+    cv.notify_all();
+    const uint32_t failures = failed_writes;
+    idle_cv.wait(lock, [&] { return (pending.empty() || failed_writes != failures) && !writing; });
+}
+
+void PresetWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!thread.joinable()) return;
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void PresetWriter::detach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thread.joinable()) thread.detach();
+}
+
+void PresetWriter::worker() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv.wait(lock, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) break;
+
+        // Wait for the burst of saves to settle before touching the disk
+        while (!stopping && !hurry && std::chrono::steady_clock::now() < last_enqueue + kCoalesceDelay) {
+            cv.wait_until(lock, last_enqueue + kCoalesceDelay);
+        }
+        hurry = false;
+
+        PresetMap batch;
+        batch.swap(pending);
+        const std::string path = pending_path;
+
+        // Anything identical to what is already on disk does not need rewriting
+        for (auto it = batch.begin(); it != batch.end();) {
+            const auto on_disk = persisted.find(it->first);
+            if (on_disk != persisted.end() && preset_equal(on_disk->second, it->second)) it = batch.erase(it);
+            else ++it;
+        }
+
+        writing = true;
+        lock.unlock();
+        const bool ok = batch.empty() || write_file(path, batch);
+        lock.lock();
+        writing = false;
+
+        if (ok) {
+            for (auto& kv : batch) persisted[kv.first] = std::move(kv.second);
+        }
+        else if (!stopping) {
+            // The file may only be locked for a moment (a virus scanner, an editor), so try again after the
+            // coalesce delay. Saves queued in the meantime are newer and win over the failed ones.
+            for (auto& kv : batch) pending.try_emplace(kv.first, std::move(kv.second));
+            last_enqueue = std::chrono::steady_clock::now();
+            ++failed_writes;
+            idle_cv.notify_all();
+        }
+        failed.store(!ok, std::memory_order_relaxed);
+        if (pending.empty()) {
+            busy_flag.store(false, std::memory_order_relaxed);
+            idle_cv.notify_all();
+        }
+    }
+    busy_flag.store(false, std::memory_order_relaxed);
+    idle_cv.notify_all();
+}
+
+bool PresetWriter::write_file(const std::string& path, const PresetMap& dirty) {
+    pv::ini::Ini ini(pv::ini::PRESET_COMMENTS);
+    ini.load(path); // a missing file just means every section is new
+    const std::string_view src = ini.source();
+    const char* eol = (src.find("\r\n") != std::string_view::npos) ? "\r\n" : "\n";
+
+    std::string out;
+    out.reserve(src.size() + dirty.size() * 2048);
+    size_t copied = 0; // everything in src before this has been emitted
+
+    for (const pv::ini::Section& sec : ini.sections()) {
+        const auto it = dirty.find(sec.name);
+        if (it == dirty.end()) continue;
+        // A section given more than once is loaded as one, so every occurrence of a key gets the new
+        // value and keys that none of them has go into the last occurrence
+        const bool last = ini.find(sec.name) == &sec;
+
+        const PresetFields fields = preset_fields(it->second);
+        std::vector<bool> done(fields.size(), false);
+
+        // Keys missing from the section get inserted after its last key line (or the header)
+        size_t insert_at = line_end(src, sec.begin);
+        for (uint32_t i = 0; i < sec.count; ++i) {
+            const pv::ini::Entry& e = sec.entries[i];
+            const auto field = std::find_if(fields.begin(), fields.end(),
+                [&](const auto& f) { return e.key == f.first; });
+            const size_t vbegin = ini.offset_of(e.value);
+            const size_t vend = vbegin + e.value.size();
+            if (field != fields.end()) {
+                // Only the value itself is replaced; indentation and trailing comments stay
+                out.append(src.substr(copied, vbegin - copied));
+                out += field->second;
+                copied = vend;
+                done[field - fields.begin()] = true;
+            }
+            insert_at = line_end(src, vend);
+        }
+        if (!last) continue;
+
+        out.append(src.substr(copied, insert_at - copied));
+        copied = insert_at;
+        if (!out.empty() && out.back() != '\n') out += eol;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (!done[i] && !(sec.previous && sec.previous->has(fields[i].first))) out += fields[i].first + "=" + fields[i].second + eol;
+        }
+    }
+    out.append(src.substr(copied));
+
+    // Sections that were not in the file yet go at the end, sorted for a stable layout
+    std::vector<const std::string*> added;
+    for (const auto& kv : dirty) {
+        if (!ini.find(kv.first)) added.push_back(&kv.first);
+    }
+    std::sort(added.begin(), added.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+    for (const std::string* key : added) {
+        if (!ends_with_blank_line(out)) out += eol;
+        out += "[" + *key + "]" + eol;
+        for (const auto& field : preset_fields(dirty.at(*key))) {
+            out += field.first + "=" + field.second + eol;
+        }
+    }
+    if (!added.empty()) out += eol;
+
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    const std::filesystem::path tmp(path + ".tmp");
+    if (target.has_parent_path()) std::filesystem::create_directories(target.parent_path(), ec);
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) {
+            reshade::log::message(reshade::log::level::error, ("Failed to open " + tmp.string() + " for writing").c_str());
+            return false;
+        }
+        f.write(out.data(), static_cast<std::streamsize>(out.size()));
+        f.flush();
+        if (!f.good()) {
+            reshade::log::message(reshade::log::level::error, ("Failed to write " + tmp.string()).c_str());
+            f.close();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+    // Replaces the target in one step, so a crash mid-save never leaves a truncated INI behind
+    std::filesystem::rename(tmp, target, ec);
+    if (ec) {
+        reshade::log::message(reshade::log::level::error, ("Failed to replace " + path + ": " + ec.message()).c_str());
+        std::error_code ignored;
+        std::filesystem::remove(tmp, ignored);
+        return false;
+    }
+    return true;
+}
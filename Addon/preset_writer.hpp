@@ -0,0 +1,67 @@
+#pragma once
+#include <cassert>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+
+#include "cloud_presets.hpp"
+
+namespace pv::clouds {
+
+// Writes PresetStore snapshots to disk on a background thread.
+// Saves are coalesced, only sections that changed since the last write are rewritten
+// (everything else in the file is kept byte for byte), and the result is written to a
+// temp file that is then renamed over the target.
+class PresetWriter {
+public:
+    PresetWriter() = default;
+    // The owner calls stop() or detach() first: joining the worker from a static destructor would run under the loader lock
+    ~PresetWriter() { assert(!thread.joinable()); }
+    PresetWriter(const PresetWriter&) = delete;
+    PresetWriter& operator=(const PresetWriter&) = delete;
+
+    // Queue a save of every preset in 'store'
+    void enqueue_all(const std::string& ini_path, const PresetStore& store);
+    // Queue a save of a single preset
+    void enqueue_one(const std::string& ini_path, const std::string& key, const CloudPreset& preset);
+    // Record 'store' as what is currently on disk, so unchanged sections are skipped
+    void mark_clean(const PresetStore& store);
+
+    // Block until every queued save has been written, or a write failed and is waiting to be retried
+    void flush();
+    // Flush and join the worker thread
+    void stop();
+    // Let go of a worker that is still running without waiting for it, where it cannot be joined
+    void detach();
+
+    bool busy() const { return busy_flag.load(std::memory_order_relaxed); }
+    bool last_failed() const { return failed.load(std::memory_order_relaxed); }
+
+private:
+    void start_locked();
+    void worker();
+    bool write_file(const std::string& path, const PresetMap& dirty);
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idle_cv;
+
+    // Protected by 'mutex'
+    bool stopping = false;
+    bool hurry = false;
+    bool writing = false;
+    uint32_t failed_writes = 0;
+    std::string pending_path;
+    PresetMap pending;
+    PresetMap persisted;
+    std::chrono::steady_clock::time_point last_enqueue{};
+
+    std::atomic<bool> busy_flag{ false };
+    std::atomic<bool> failed{ false };
+};
+
+} // namespace pv::clouds
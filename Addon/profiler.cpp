@@ -0,0 +1,437 @@
+#include "profiler.hpp"
+#include "imgui.h"
+#include <reshade.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <vector>
+
+namespace Profiler
+{
+	// Zones a thread can have in flight between two collect() calls before new ones are dropped
+	constexpr uint32_t RING_SIZE = 4096;
+	// Durations kept per zone for the rolling statistics and graph
+	constexpr uint32_t HISTORY_SIZE = 240;
+	// Upper bound on a capture, roughly a minute of every zone at 60 fps
+	constexpr size_t MAX_CAPTURED_EVENTS = 1 << 20;
+	// Frames a zone runs before its allocation budget applies, so startup and warm-up caches do not count
+	constexpr uint64_t BUDGET_WARMUP_FRAMES = 120;
+
+	struct Event
+	{
+		const char *name;
+		uint64_t start_ns;
+		uint64_t end_ns;
+		uint32_t allocations;
+		uint64_t allocated_bytes;
+	};
+
+	// Written only by its owning thread, read only by collect()
+	struct ThreadRing
+	{
+		std::array<Event, RING_SIZE> events;
+		std::atomic<uint32_t> head { 0 };
+		std::atomic<uint32_t> tail { 0 };
+		std::atomic<uint32_t> dropped { 0 };
+		uint32_t thread_id = 0;
+	};
+
+	struct ZoneStats
+	{
+		std::array<float, HISTORY_SIZE> history_us = {};
+		uint32_t next = 0;
+		uint32_t count = 0;
+		uint32_t thread_id = 0;
+
+		// Allocations of the frame being collected, and of the last complete one
+		uint32_t pending_allocations = 0;
+		uint64_t pending_bytes = 0;
+		uint32_t frame_allocations = 0;
+		uint64_t frame_bytes = 0;
+		uint64_t total_allocations = 0;
+		uint64_t frames = 0;
+		uint32_t budget = UINT32_MAX;
+		bool budget_reported = false;
+	};
+
+	struct CapturedEvent
+	{
+		const char *name;
+		uint32_t thread_id;
+		uint64_t start_ns;
+		uint64_t end_ns;
+	};
+
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	static std::mutex rings_mutex;
+	static std::vector<std::unique_ptr<ThreadRing>> rings;
+
+	// Protected by 'collect_mutex'
+	static std::mutex collect_mutex;
+	static std::map<std::string_view, ZoneStats> zones;
+	static std::vector<CapturedEvent> captured;
+	static std::atomic<bool> capturing { false };
+	static uint64_t total_dropped = 0;
+	// Budgets set before their zone first ran
+	static std::map<std::string, uint32_t, std::less<>> pending_budgets;
+
+	static thread_local Zone *active_zone = nullptr;
+	static thread_local uint64_t thread_allocations = 0;
+	static thread_local uint64_t thread_allocated_bytes = 0;
+
+	uint64_t now_ns()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	static ThreadRing &thread_ring()
+	{
+		thread_local ThreadRing *ring = nullptr;
+
+		if (ring == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(rings_mutex);
+			// Rings stay alive until unload, collect() may still be draining one whose thread has exited
+			rings.push_back(std::make_unique<ThreadRing>());
+			ring = rings.back().get();
+			ring->thread_id = static_cast<uint32_t>(rings.size());
+		}
+
+		return *ring;
+	}
+
+	Zone *enter(Zone *zone)
+	{
+		Zone *const parent = active_zone;
+		active_zone = zone;
+		return parent;
+	}
+
+	void leave(Zone *parent)
+	{
+		active_zone = parent;
+	}
+
+	void record(const char *name, uint64_t start_ns, uint64_t end_ns, uint32_t allocations, uint64_t allocated_bytes)
+	{
+		ThreadRing &ring = thread_ring();
+		const uint32_t head = ring.head.load(std::memory_order_relaxed);
+
+		if (head - ring.tail.load(std::memory_order_acquire) >= RING_SIZE)
+		{
+			ring.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		ring.events[head % RING_SIZE] = { name, start_ns, end_ns, allocations, allocated_bytes };
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+
+	void collect()
+	{
+		// Kept between calls so a steady-state collect does not allocate
+		static thread_local std::vector<ThreadRing *> snapshot;
+		snapshot.clear();
+		{
+			std::lock_guard<std::mutex> lock(rings_mutex);
+			snapshot.reserve(rings.size());
+			for (const auto &ring : rings)
+			{
+				snapshot.push_back(ring.get());
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(collect_mutex);
+		const bool capture = capturing.load(std::memory_order_relaxed);
+
+		for (ThreadRing *ring : snapshot)
+		{
+			const uint32_t head = ring->head.load(std::memory_order_acquire);
+			uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+
+			for (; tail != head; tail++)
+			{
+				const Event &event = ring->events[tail % RING_SIZE];
+				const auto [it, inserted] = zones.try_emplace(event.name);
+				ZoneStats &stats = it->second;
+
+				if (inserted)
+				{
+					if (const auto budget = pending_budgets.find(it->first); budget != pending_budgets.end())
+					{
+						stats.budget = budget->second;
+						pending_budgets.erase(budget);
+					}
+				}
+
+				stats.history_us[stats.next] = static_cast<float>(event.end_ns - event.start_ns) / 1000.0f;
+				stats.next = (stats.next + 1) % HISTORY_SIZE;
+				stats.count = std::min(stats.count + 1, HISTORY_SIZE);
+				stats.thread_id = ring->thread_id;
+				stats.pending_allocations += event.allocations;
+				stats.pending_bytes += event.allocated_bytes;
+
+				if (capture && captured.size() < MAX_CAPTURED_EVENTS)
+				{
+					captured.push_back({ event.name, ring->thread_id, event.start_ns, event.end_ns });
+				}
+			}
+
+			ring->tail.store(tail, std::memory_order_release);
+			total_dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+		}
+
+		// Every collect() closes a frame, zones that did not run in it allocated nothing
+		for (auto &[name, stats] : zones)
+		{
+			stats.frame_allocations = stats.pending_allocations;
+			stats.frame_bytes = stats.pending_bytes;
+			stats.total_allocations += stats.pending_allocations;
+			stats.frames++;
+			stats.pending_allocations = 0;
+			stats.pending_bytes = 0;
+
+			if (stats.frames > BUDGET_WARMUP_FRAMES && stats.frame_allocations > stats.budget && !stats.budget_reported)
+			{
+				stats.budget_reported = true;
+				reshade::log::message(reshade::log::level::warning, std::format("Zone '{}' made {} allocations in one frame, over its budget of {}", name, stats.frame_allocations, stats.budget).c_str());
+			}
+		}
+	}
+
+	uint32_t get_frame_allocations(std::string_view zone)
+	{
+		std::lock_guard<std::mutex> lock(collect_mutex);
+		const auto it = zones.find(zone);
+		return it != zones.end() ? it->second.frame_allocations : 0;
+	}
+
+	uint64_t get_thread_allocations()
+	{
+		return thread_allocations;
+	}
+
+	uint64_t get_thread_allocated_bytes()
+	{
+		return thread_allocated_bytes;
+	}
+
+	void set_allocation_budget(std::string_view zone, uint32_t per_frame)
+	{
+		std::lock_guard<std::mutex> lock(collect_mutex);
+		const auto it = zones.find(zone);
+
+		if (it == zones.end())
+		{
+			// The key has to outlive the map, budgets for zones that have not run yet wait for their first event
+			pending_budgets[std::string(zone)] = per_frame;
+			return;
+		}
+
+		it->second.budget = per_frame;
+		it->second.budget_reported = false;
+	}
+
+	void start_capture()
+	{
+		std::lock_guard<std::mutex> lock(collect_mutex);
+		captured.clear();
+		captured.reserve(MAX_CAPTURED_EVENTS / 16);
+		capturing.store(true, std::memory_order_relaxed);
+	}
+
+	bool is_capturing()
+	{
+		return capturing.load(std::memory_order_relaxed);
+	}
+
+	bool stop_capture(const std::string &path)
+	{
+		std::vector<CapturedEvent> events;
+		{
+			std::lock_guard<std::mutex> lock(collect_mutex);
+			capturing.store(false, std::memory_order_relaxed);
+			events.swap(captured);
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			reshade::log::message(reshade::log::level::error, ("Failed to open " + path + " for the profiler trace").c_str());
+			return false;
+		}
+
+		// Complete ('X') events with microsecond timestamps, which is what chrome://tracing and Perfetto expect
+		std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		out.reserve(out.size() + events.size() * 96);
+
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			const CapturedEvent &event = events[i];
+
+			out += std::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}{}\n",
+				event.name, event.thread_id, event.start_ns / 1000.0, (event.end_ns - event.start_ns) / 1000.0, i + 1 < events.size() ? "," : "");
+		}
+
+		out += "]}\n";
+		file.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+		if (!file.good())
+		{
+			reshade::log::message(reshade::log::level::error, ("Failed to write the profiler trace to " + path).c_str());
+			return false;
+		}
+
+		reshade::log::message(reshade::log::level::info, std::format("Wrote {} profiler zones to {}", events.size(), path).c_str());
+		return true;
+	}
+
+	void draw_overlay()
+	{
+		std::lock_guard<std::mutex> lock(collect_mutex);
+
+		if (total_dropped != 0)
+		{
+			ImGui::Text("Dropped zones: %llu", (unsigned long long)total_dropped);
+		}
+
+		std::array<float, HISTORY_SIZE> sorted;
+		std::array<float, HISTORY_SIZE> ordered;
+
+		for (const auto &[name, stats] : zones)
+		{
+			if (stats.count == 0)
+			{
+				continue;
+			}
+
+			// Oldest first, so the graph scrolls from left to right
+			const uint32_t first = stats.count < HISTORY_SIZE ? 0 : stats.next;
+			for (uint32_t i = 0; i < stats.count; i++)
+			{
+				ordered[i] = stats.history_us[(first + i) % HISTORY_SIZE];
+			}
+
+			std::copy_n(ordered.begin(), stats.count, sorted.begin());
+			std::sort(sorted.begin(), sorted.begin() + stats.count);
+
+			float sum = 0.0f;
+			for (uint32_t i = 0; i < stats.count; i++)
+			{
+				sum += sorted[i];
+			}
+
+			const float min_us = sorted[0];
+			const float avg_us = sum / stats.count;
+			const float p99_us = sorted[std::min(stats.count - 1, (stats.count * 99) / 100)];
+
+			ImGui::Text("%.*s (thread %u)", (int)name.size(), name.data(), stats.thread_id);
+			ImGui::Text("  min %.1f us, avg %.1f us, p99 %.1f us", min_us, avg_us, p99_us);
+#if PULSEV_TRACK_ALLOCATIONS
+			if (stats.frames != 0)
+			{
+				ImGui::Text("  allocations/frame %u (%llu bytes), avg %.2f%s", stats.frame_allocations, (unsigned long long)stats.frame_bytes,
+					(double)stats.total_allocations / stats.frames, stats.budget_reported ? ", over budget" : "");
+			}
+#endif
+
+			ImGui::PushID(name.data());
+			ImGui::PlotLines("##history", ordered.data(), (int)stats.count, 0, nullptr, 0.0f, p99_us * 1.25f, ImVec2(0.0f, 32.0f));
+			ImGui::PopID();
+		}
+	}
+}
+
+#if PULSEV_TRACK_ALLOCATIONS
+/**
+* Allocation tracking
+*
+* Replacing these inside the addon only affects allocations the addon itself makes, the game and
+* ReShade keep their own allocators. Frees are not attributed, a zone that frees what another
+* one allocated would otherwise look like it was giving memory back.
+**/
+
+namespace Profiler
+{
+	static void count_allocation(size_t size)
+	{
+		thread_allocations++;
+		thread_allocated_bytes += size;
+
+		if (Zone *const zone = active_zone)
+		{
+			zone->allocations++;
+			zone->allocated_bytes += size;
+		}
+	}
+}
+
+void *operator new(size_t size)
+{
+	Profiler::count_allocation(size);
+
+	if (void *const pointer = std::malloc(size != 0 ? size : 1))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	Profiler::count_allocation(size);
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+	std::free(pointer);
+}
+#endif
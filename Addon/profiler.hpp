@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Scoped timing zones for the addon's per-frame work.
+//
+// PV_PROFILE_ZONE("name") times the rest of the enclosing scope. Each thread pushes its zones
+// into its own single-producer ring, and Profiler::collect() (called once per frame from the
+// present thread) drains every ring into rolling per-zone statistics and, while a capture is
+// running, into a buffer that can be written out as Chrome trace JSON for Perfetto.
+// Building with PULSEV_PROFILE=0 removes the zones entirely.
+//
+// PULSEV_TRACK_ALLOCATIONS=1 additionally replaces the addon's global operator new/delete and
+// attributes every allocation to the innermost zone active on the allocating thread, so the
+// overlay can show allocations per frame by zone and hot paths can be held to a budget.
+#ifndef PULSEV_PROFILE
+#define PULSEV_PROFILE 1
+#endif
+
+#ifndef PULSEV_TRACK_ALLOCATIONS
+#define PULSEV_TRACK_ALLOCATIONS 0
+#endif
+
+namespace Profiler
+{
+	// Nanoseconds since the profiler's epoch (first use in the process)
+	uint64_t now_ns();
+
+	struct Zone;
+
+	// Records a finished zone on the calling thread. 'name' must outlive the profiler (a string literal).
+	void record(const char *name, uint64_t start_ns, uint64_t end_ns, uint32_t allocations = 0, uint64_t allocated_bytes = 0);
+
+	// Makes 'zone' the calling thread's innermost zone and returns the one it replaces
+	Zone *enter(Zone *zone);
+	void leave(Zone *parent);
+
+	// Allocations made inside 'zone' during the last collected frame (0 unless PULSEV_TRACK_ALLOCATIONS)
+	uint32_t get_frame_allocations(std::string_view zone);
+	// Allocations the calling thread has made so far, inside a zone or not (0 unless PULSEV_TRACK_ALLOCATIONS)
+	uint64_t get_thread_allocations();
+	// Bytes of those allocations
+	uint64_t get_thread_allocated_bytes();
+	// Logs a warning the first time a steady-state frame allocates more than 'per_frame' times inside 'zone'
+	void set_allocation_budget(std::string_view zone, uint32_t per_frame);
+
+	// Drains all thread rings, call once per frame
+	void collect();
+
+	void start_capture();
+	// Stops a running capture and writes it as Chrome trace JSON, returns false if nothing could be written
+	bool stop_capture(const std::string &path);
+	bool is_capturing();
+
+	// ImGui table and graphs of the rolling zone statistics
+	void draw_overlay();
+
+	struct Zone
+	{
+		const char *name;
+		uint64_t start_ns;
+		Zone *parent;
+		uint32_t allocations = 0; // Not counting nested zones
+		uint64_t allocated_bytes = 0;
+
+		explicit Zone(const char *name) : name(name), start_ns(now_ns()), parent(enter(this)) {}
+		~Zone()
+		{
+			leave(parent);
+			record(name, start_ns, now_ns(), allocations, allocated_bytes);
+		}
+
+		Zone(const Zone &) = delete;
+		Zone &operator=(const Zone &) = delete;
+	};
+}
+
+#if PULSEV_PROFILE
+#define PV_PROFILE_CONCAT_(a, b) a##b
+#define PV_PROFILE_CONCAT(a, b) PV_PROFILE_CONCAT_(a, b)
+#define PV_PROFILE_ZONE(name) ::Profiler::Zone PV_PROFILE_CONCAT(pv_profile_zone_, __LINE__)(name)
+#else
+#define PV_PROFILE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,176 @@
+#include "quality_controller.hpp"
+#include "gpu_timing.hpp"
+#include "imgui.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace QualityController
+{
+	// Largest step down in one update, and the fixed step up
+	constexpr float MAX_STEP_DOWN = 0.2f;
+	constexpr float MIN_STEP_DOWN = 0.02f;
+	constexpr float STEP_UP = 0.05f;
+	// How far the ceiling rises per update, so a level that went over budget is only retried after a while
+	constexpr float CEILING_RECOVERY = 0.01f;
+	// Presents averaged into one frame time measurement when there is no GPU timing
+	constexpr uint32_t FRAME_TIME_WINDOW = 30;
+	// Updates without a new GPU measurement (four GPU timing windows) before falling back to the frame time
+	constexpr uint32_t GPU_STALE_UPDATES = 240;
+
+	static float budget_ms = 0.0f;
+	static float frame_budget_ms = 0.0f;
+	static Controller controller;
+	static uint64_t last_gpu_window = 0;
+	static float measured_ms = 0.0f;
+	static bool measuring_gpu = false;
+	static uint32_t updates_since_gpu = 0;
+
+	// Written by the present thread
+	static std::atomic<float> frame_time_ms { 0.0f };
+	static std::atomic<uint32_t> frame_time_windows { 0 };
+	static uint32_t last_frame_time_window = 0;
+
+	bool Controller::step(float measured_ms, float budget_ms)
+	{
+		const float ratio = measured_ms / budget_ms;
+		const float previous = level;
+
+		ceiling = std::min(ceiling + CEILING_RECOVERY, 1.0f);
+
+		if (ratio > UPPER_BAND)
+		{
+			// Going over right after stepping up means the step overshot, do not go back there for a while
+			if (last_step_up)
+			{
+				ceiling = std::max(level - STEP_UP, 0.0f);
+			}
+
+			level = std::max(level - std::clamp((ratio - 1.0f) * 0.5f, MIN_STEP_DOWN, MAX_STEP_DOWN), 0.0f);
+		}
+		else if (ratio < LOWER_BAND)
+		{
+			level = std::min(level + STEP_UP, ceiling);
+		}
+
+		level = std::max(level, 0.0f);
+		last_step_up = level > previous;
+		return level != previous;
+	}
+
+	void Controller::reset()
+	{
+		*this = Controller();
+	}
+
+	float Controller::quality_scale() const
+	{
+		return MIN_QUALITY_SCALE + (1.0f - MIN_QUALITY_SCALE) * level;
+	}
+
+	float Controller::distance_scale() const
+	{
+		return MIN_DISTANCE_SCALE + (1.0f - MIN_DISTANCE_SCALE) * std::min(level * 2.0f, 1.0f);
+	}
+
+	void configure()
+	{
+		reshade::get_config_value(nullptr, "PULSEV", "QualityBudgetMs", budget_ms);
+		reshade::get_config_value(nullptr, "PULSEV", "FrameBudgetMs", frame_budget_ms);
+	}
+
+	void on_present(reshade::api::command_queue *, reshade::api::swapchain *, const reshade::api::rect *, const reshade::api::rect *, uint32_t, const reshade::api::rect *)
+	{
+		static std::chrono::steady_clock::time_point last_present = std::chrono::steady_clock::now();
+		static double window_ms = 0.0;
+		static uint32_t window_presents = 0;
+
+		const auto now = std::chrono::steady_clock::now();
+		window_ms += std::chrono::duration<double, std::milli>(now - last_present).count();
+		last_present = now;
+
+		if (++window_presents < FRAME_TIME_WINDOW)
+		{
+			return;
+		}
+
+		frame_time_ms.store(static_cast<float>(window_ms / window_presents), std::memory_order_relaxed);
+		frame_time_windows.fetch_add(1, std::memory_order_release);
+		window_ms = 0.0;
+		window_presents = 0;
+	}
+
+	void update()
+	{
+		// Each measurement is acted on once, the next one then already reflects the new level
+		if (budget_ms > 0.0f && GpuTiming::get_window_count() != last_gpu_window)
+		{
+			last_gpu_window = GpuTiming::get_window_count();
+
+			const float clouds_ms = GpuTiming::get_technique_ms("PulseV_VolumetricClouds");
+			if (clouds_ms >= 0.0f)
+			{
+				measuring_gpu = true;
+				updates_since_gpu = 0;
+				measured_ms = clouds_ms;
+				controller.step(measured_ms, budget_ms);
+				return;
+			}
+
+			// The technique was not timed in that window (disabled, or timing unavailable)
+			measuring_gpu = false;
+		}
+
+		// The GPU measurements stop when the budget is cleared or the timing stops, the frame time takes over
+		if (measuring_gpu && (budget_ms <= 0.0f || ++updates_since_gpu > GPU_STALE_UPDATES))
+		{
+			measuring_gpu = false;
+		}
+
+		if (measuring_gpu || frame_budget_ms <= 0.0f)
+		{
+			return;
+		}
+
+		const uint32_t windows = frame_time_windows.load(std::memory_order_acquire);
+		if (windows != last_frame_time_window)
+		{
+			last_frame_time_window = windows;
+			measured_ms = frame_time_ms.load(std::memory_order_relaxed);
+			controller.step(measured_ms, frame_budget_ms);
+		}
+	}
+
+	float get_quality_scale()
+	{
+		return controller.quality_scale();
+	}
+
+	float get_distance_scale()
+	{
+		return controller.distance_scale();
+	}
+
+	void draw_overlay()
+	{
+		bool changed = ImGui::DragFloat("Clouds GPU budget (ms)", &budget_ms, 0.05f, 0.0f, 50.0f, "%.2f");
+		changed |= ImGui::DragFloat("Frame budget (ms)", &frame_budget_ms, 0.1f, 0.0f, 100.0f, "%.1f");
+
+		if (changed)
+		{
+			controller.reset();
+			measuring_gpu = false;
+		}
+
+		if (budget_ms <= 0.0f && frame_budget_ms <= 0.0f)
+		{
+			ImGui::Text("Disabled, set a budget to enable");
+			return;
+		}
+
+		ImGui::Text("Measuring: %s, %.3f ms", measuring_gpu ? "clouds GPU time" : "frame time", measured_ms);
+		ImGui::Text("Level: %.2f (ceiling %.2f)", controller.level, controller.ceiling);
+		ImGui::Text("Samples: %.0f%%, render distance: %.0f%%", controller.quality_scale() * 100.0f, controller.distance_scale() * 100.0f);
+	}
+}
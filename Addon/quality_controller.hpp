@@ -0,0 +1,48 @@
+#pragma once
+
+#include <reshade.hpp>
+
+// Lowers the cloud march quality, and past a point the render distance, to hold a time budget.
+//
+// With GPU timing available the controller holds the PulseV_VolumetricClouds technique to
+// [PULSEV] QualityBudgetMs, otherwise it falls back to holding the present-to-present frame
+// time to FrameBudgetMs. Both are off when unset. The result reaches the shader through the
+// 'quality_scale' and 'distance_scale' uniforms, the preset's own settings are left alone.
+namespace QualityController
+{
+	// Over this fraction of the budget the level steps down, under LOWER_BAND it steps up, in between it holds
+	constexpr float UPPER_BAND = 1.05f;
+	constexpr float LOWER_BAND = 0.85f;
+
+	// Cloud samples at level 0, as a fraction of the quality preset's
+	constexpr float MIN_QUALITY_SCALE = 0.25f;
+	// Render distance at level 0, only reduced once the level drops below 0.5
+	constexpr float MIN_DISTANCE_SCALE = 0.5f;
+
+	// The control law on its own, fed one measurement at a time
+	struct Controller
+	{
+		float level = 1.0f;   // 1 is the preset's quality, 0 the lowest the controller goes
+		float ceiling = 1.0f; // Level it last went over budget at, approached again slowly
+		bool last_step_up = false;
+
+		// Returns true if the level changed
+		bool step(float measured_ms, float budget_ms);
+		void reset();
+
+		float quality_scale() const;
+		float distance_scale() const;
+	};
+
+	// Reads the budgets from the config
+	void configure();
+
+	void on_present(reshade::api::command_queue *queue, reshade::api::swapchain *swapchain, const reshade::api::rect *, const reshade::api::rect *, uint32_t, const reshade::api::rect *);
+
+	// Call once per frame before the uniforms are staged
+	void update();
+	float get_quality_scale();
+	float get_distance_scale();
+
+	void draw_overlay();
+}
@@ -1,6 +1,7 @@
 #include "scripthook_bridge.hpp"
 #include "data_reader.hpp"
-#include "gtav_timecycle.hpp"
+
+#include <algorithm>
 
 using pv::clouds::Weather;
 
@@ -34,6 +35,9 @@ pv::clouds::LiveState pv::clouds::poll_live_state()
 
     int current_w = (pct < 0.5f) ? from_w : to_w;
     s.weather = map_weather_int_to_pv(current_w);
+    s.from_weather = map_weather_int_to_pv(from_w);
+    s.to_weather = map_weather_int_to_pv(to_w);
+    s.transition = std::max(0.0f, std::min(1.0f, pct));
 
     // SHV is considered available once the DataReader loop is active.
     // We expose that via a lightweight registration flag.
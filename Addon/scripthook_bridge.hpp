@@ -9,6 +9,9 @@ struct LiveState {
     int hour = 12;
     int minute = 0;
     Weather weather = Weather::CLEAR;
+    Weather from_weather = Weather::CLEAR;
+    Weather to_weather = Weather::CLEAR;
+    float transition = 0.0f;
     bool shv_available = false;
 };
 
@@ -0,0 +1,187 @@
+#include "startup_report.hpp"
+#include "imgui.h"
+#include <reshade.hpp>
+
+#include <format>
+#include <mutex>
+
+#include <Windows.h>
+#include <psapi.h>
+
+namespace StartupReport
+{
+	// Reload phases kept for the overlay, older ones are dropped
+	constexpr size_t MAX_RELOAD_PHASES = 32;
+
+	static std::chrono::steady_clock::time_point attach_time = std::chrono::steady_clock::now();
+	static uint64_t startup_ns = 0;
+	static bool complete = false;
+	static std::mutex mutex;
+	static std::vector<PhaseRecord> phases;
+
+#if !PULSEV_TRACK_ALLOCATIONS
+	static int64_t private_bytes()
+	{
+		PROCESS_MEMORY_COUNTERS_EX counters = {};
+
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&counters), sizeof(counters)))
+		{
+			return 0;
+		}
+
+		return static_cast<int64_t>(counters.PrivateUsage);
+	}
+#endif
+
+	static uint64_t since_attach_ns(std::chrono::steady_clock::time_point time)
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time - attach_time).count();
+	}
+
+	static std::string format_phase(const PhaseRecord &phase)
+	{
+#if PULSEV_TRACK_ALLOCATIONS
+		return std::format("  {:<28} at {:>9.2f} ms took {:>8.2f} ms, {} allocations ({:.1f} KiB)",
+			phase.name, phase.start_ns / 1e6, phase.duration_ns / 1e6, phase.allocations, phase.allocated_bytes / 1024.0);
+#else
+		return std::format("  {:<28} at {:>9.2f} ms took {:>8.2f} ms, {:+.1f} KiB private",
+			phase.name, phase.start_ns / 1e6, phase.duration_ns / 1e6, phase.private_bytes / 1024.0);
+#endif
+	}
+
+	void mark_attach()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		attach_time = std::chrono::steady_clock::now();
+		startup_ns = 0;
+		complete = false;
+		phases.clear();
+	}
+
+	void mark_first_frame()
+	{
+		std::string report;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (complete)
+			{
+				return;
+			}
+
+			complete = true;
+			startup_ns = since_attach_ns(std::chrono::steady_clock::now());
+
+			report = std::format("Startup took {:.2f} ms from DLL attach to the first injected frame:", startup_ns / 1e6);
+			for (const PhaseRecord &phase : phases)
+			{
+				report += "\n" + format_phase(phase);
+			}
+		}
+
+		reshade::log::message(reshade::log::level::info, report.c_str());
+	}
+
+	bool is_complete()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return complete;
+	}
+
+	void draw_overlay()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (complete)
+		{
+			ImGui::Text("DLL attach to first injected frame: %.2f ms", startup_ns / 1e6);
+		}
+		else
+		{
+			ImGui::Text("Waiting for the first injected frame...");
+		}
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const bool reloads = pass == 1;
+
+			if (reloads)
+			{
+				ImGui::Separator();
+				ImGui::Text("Since startup");
+			}
+
+			for (const PhaseRecord &phase : phases)
+			{
+				if (phase.after_startup != reloads)
+				{
+					continue;
+				}
+
+#if PULSEV_TRACK_ALLOCATIONS
+				ImGui::Text("%s: %.2f ms, %llu allocations, %.1f KiB (at %.2f s)", phase.name.c_str(), phase.duration_ns / 1e6, (unsigned long long)phase.allocations, phase.allocated_bytes / 1024.0, phase.start_ns / 1e9);
+#else
+				ImGui::Text("%s: %.2f ms, %+.1f KiB (at %.2f s)", phase.name.c_str(), phase.duration_ns / 1e6, phase.private_bytes / 1024.0, phase.start_ns / 1e9);
+#endif
+			}
+		}
+	}
+
+	Phase::Phase(const char *name) :
+		name(name), start(std::chrono::steady_clock::now()),
+#if PULSEV_TRACK_ALLOCATIONS
+		start_allocations(Profiler::get_thread_allocations()), start_allocated_bytes(Profiler::get_thread_allocated_bytes()),
+#else
+		start_private_bytes(private_bytes()),
+#endif
+		after_startup(is_complete())
+	{
+	}
+
+	Phase::~Phase()
+	{
+		const auto end = std::chrono::steady_clock::now();
+
+		PhaseRecord record;
+		record.name = name;
+		record.start_ns = since_attach_ns(start);
+		record.duration_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+#if PULSEV_TRACK_ALLOCATIONS
+		record.allocations = Profiler::get_thread_allocations() - start_allocations;
+		record.allocated_bytes = Profiler::get_thread_allocated_bytes() - start_allocated_bytes;
+#else
+		record.private_bytes = private_bytes() - start_private_bytes;
+#endif
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		record.after_startup = after_startup;
+
+		if (record.after_startup)
+		{
+			// Only the most recent reloads are kept, startup phases are never dropped
+			size_t reload_phases = 0;
+			for (const PhaseRecord &phase : phases)
+			{
+				reload_phases += phase.after_startup ? 1 : 0;
+			}
+
+			if (reload_phases >= MAX_RELOAD_PHASES)
+			{
+				for (auto it = phases.begin(); it != phases.end(); ++it)
+				{
+					if (it->after_startup)
+					{
+						phases.erase(it);
+						break;
+					}
+				}
+			}
+
+			reshade::log::message(reshade::log::level::info, ("Reload phase:" + format_phase(record).substr(1)).c_str());
+		}
+
+		phases.push_back(std::move(record));
+	}
+}
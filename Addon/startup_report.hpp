@@ -0,0 +1,58 @@
+#pragma once
+
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Wall time and memory cost of the addon's startup phases, from DLL_PROCESS_ATTACH up to the
+// first frame whose uniforms carry real game data. Phases that run again afterwards (effect
+// reloads, device re-creation) are kept separately so reload cost can be tracked too.
+// Memory is what the addon allocated on the phase's thread when built with
+// PULSEV_TRACK_ALLOCATIONS (see profiler.hpp), otherwise the change in process private bytes
+// over the phase, which includes what the game or ReShade allocated on other threads meanwhile.
+namespace StartupReport
+{
+	struct PhaseRecord
+	{
+		std::string name;
+		uint64_t start_ns = 0;    // Since DLL attach
+		uint64_t duration_ns = 0;
+		int64_t private_bytes = 0;
+		uint64_t allocations = 0;     // With PULSEV_TRACK_ALLOCATIONS
+		uint64_t allocated_bytes = 0;
+		bool after_startup = false;
+	};
+
+	// Call first thing in DLL_PROCESS_ATTACH, everything else is measured relative to it
+	void mark_attach();
+	// Logs the startup breakdown the first time it is called, later calls do nothing
+	void mark_first_frame();
+	bool is_complete();
+
+	void draw_overlay();
+
+	// Times a phase for as long as it is in scope
+	class Phase
+	{
+	public:
+		explicit Phase(const char *name);
+		~Phase();
+
+		Phase(const Phase &) = delete;
+		Phase &operator=(const Phase &) = delete;
+
+	private:
+		const char *name;
+		std::chrono::steady_clock::time_point start;
+#if PULSEV_TRACK_ALLOCATIONS
+		uint64_t start_allocations;
+		uint64_t start_allocated_bytes;
+#else
+		int64_t start_private_bytes;
+#endif
+		bool after_startup; // A phase belongs to startup if it began before the first injected frame
+	};
+}
@@ -0,0 +1,164 @@
+#include "temporal.hpp"
+#include "imgui.h"
+
+#include <cmath>
+
+namespace Temporal
+{
+	static int interleave_size = 1;
+	static Frame frame;
+	static uint64_t camera_cuts = 0;
+
+	static float *row(Float4x4 &m, int i)
+	{
+		Float4 *const rows[] = { &m.r1, &m.r2, &m.r3, &m.r4 };
+		return rows[i]->v;
+	}
+
+	static const float *row(const Float4x4 &m, int i)
+	{
+		const Float4 *const rows[] = { &m.r1, &m.r2, &m.r3, &m.r4 };
+		return rows[i]->v;
+	}
+
+	// Wraps a difference of two angles in degrees into [-180, 180]
+	static float wrap_degrees(float degrees)
+	{
+		return degrees - 360.0f * std::floor((degrees + 180.0f) / 360.0f);
+	}
+
+	void configure()
+	{
+		int pixels = 1;
+		reshade::get_config_value(nullptr, "PULSEV", "CloudInterleave", pixels);
+
+		interleave_size = pixels >= 16 ? 4 : pixels >= 4 ? 2 : 1;
+		frame = {};
+	}
+
+	float halton(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f;
+
+		for (; index != 0; index /= base)
+		{
+			fraction /= static_cast<float>(base);
+			result += fraction * static_cast<float>(index % base);
+		}
+
+		return result;
+	}
+
+	uint32_t bayer_rank(uint32_t x, uint32_t y, uint32_t size)
+	{
+		uint32_t rank = 0;
+
+		// Each level of the recursive matrix contributes two bits, the finest level the most significant
+		// ones, so that neighbouring cells are marched far apart in time
+		for (uint32_t bit = 1; bit < size; bit <<= 1)
+		{
+			const uint32_t bx = (x & bit) != 0;
+			const uint32_t by = (y & bit) != 0;
+			rank = (rank << 2) | ((bx ^ by) << 1 | by);
+		}
+
+		return rank;
+	}
+
+	bool is_camera_cut(const Float3 &delta_position, const Float3 &delta_rotation)
+	{
+		const float distance = std::sqrt(
+			delta_position.v[0] * delta_position.v[0] +
+			delta_position.v[1] * delta_position.v[1] +
+			delta_position.v[2] * delta_position.v[2]);
+
+		if (distance > CUT_DISTANCE)
+		{
+			return true;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (std::fabs(wrap_degrees(delta_rotation.v[i])) > CUT_DEGREES)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	Float4x4 multiply(const Float4x4 &a, const Float4x4 &b)
+	{
+		Float4x4 result = {};
+
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += row(a, r)[k] * row(b, k)[c];
+				}
+				row(result, r)[c] = sum;
+			}
+		}
+
+		return result;
+	}
+
+	const Frame &update(const Float3 &camera_position, const Float3 &delta_camera_position, const Float3 &delta_camera_rotation,
+		const Float4x4 &previous_view_matrix, const Float4x4 &previous_projection_matrix)
+	{
+		// The first frame, and any frame after the pattern changed, has no usable history
+		const bool first = frame.index == 0 || frame.interleave_size != interleave_size;
+
+		frame.index++;
+		frame.interleave_size = interleave_size;
+
+		const uint32_t cells = static_cast<uint32_t>(interleave_size * interleave_size);
+		const uint32_t step = frame.index % cells;
+		for (uint32_t y = 0; y < static_cast<uint32_t>(interleave_size); y++)
+		{
+			for (uint32_t x = 0; x < static_cast<uint32_t>(interleave_size); x++)
+			{
+				if (bayer_rank(x, y, interleave_size) == step)
+				{
+					frame.interleave_offset = { static_cast<float>(x), static_cast<float>(y) };
+				}
+			}
+		}
+
+		// Skips index 0 of the sequence, which would always be the pixel corner
+		const uint32_t phase = frame.index % JITTER_PHASES + 1;
+		frame.jitter = { halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f };
+
+		frame.camera_cut = first || is_camera_cut(delta_camera_position, delta_camera_rotation);
+		camera_cuts += frame.camera_cut ? 1 : 0;
+
+		// World -> previous view: move the previous camera to the origin, then rotate with the previous
+		// view matrix (translation in its last column, which the row-vector product must not see)
+		Float4x4 translation = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+		for (int i = 0; i < 3; i++)
+		{
+			translation.r4.v[i] = -(camera_position.v[i] - delta_camera_position.v[i]);
+		}
+
+		Float4x4 rotation = previous_view_matrix;
+		rotation.r1.v[3] = rotation.r2.v[3] = rotation.r3.v[3] = 0.0f;
+		rotation.r4 = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		frame.previous_view_projection = multiply(multiply(translation, rotation), previous_projection_matrix);
+
+		return frame;
+	}
+
+	void draw_overlay()
+	{
+		ImGui::Text("Frame %u, interleave %dx%d at (%.0f, %.0f)", frame.index, frame.interleave_size, frame.interleave_size, frame.interleave_offset.v[0], frame.interleave_offset.v[1]);
+		ImGui::Text("Jitter: (%.3f, %.3f)", frame.jitter.v[0], frame.jitter.v[1]);
+		ImGui::Text("Camera cuts: %llu%s", (unsigned long long)camera_cuts, frame.camera_cut ? " (this frame)" : "");
+	}
+}
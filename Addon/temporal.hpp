@@ -0,0 +1,49 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+
+// Per-frame state for marching only part of the clouds each frame and reprojecting the rest.
+//
+// Every frame gets an index, the cell of the interleave pattern to march (cycling through an
+// NxN block in ordered-dither order so consecutive frames are spread out), a Halton (2, 3)
+// sub-pixel jitter, a camera-cut flag for when history cannot be trusted, and the matrix that
+// takes a world position to the previous frame's clip space. [PULSEV] CloudInterleave picks the
+// pattern: 1 (every pixel every frame), 4 (one pixel in 2x2) or 16 (one pixel in 4x4). The effect
+// only uses it when built with CLOUD_INTERLEAVE=1.
+namespace Temporal
+{
+	// A frame-to-frame camera move past either of these invalidates history
+	constexpr float CUT_DISTANCE = 10.0f; // Meters
+	constexpr float CUT_DEGREES = 30.0f;
+	// Length of the jitter sequence
+	constexpr uint32_t JITTER_PHASES = 16;
+
+	struct Frame
+	{
+		uint32_t index = 0;
+		int interleave_size = 1;           // Side of the pattern block, the effect marches one cell of each block
+		Float2 interleave_offset = {};     // Cell of the block marched this frame
+		Float2 jitter = {};                // In low resolution pixels, within [-0.5, 0.5]
+		bool camera_cut = true;
+		Float4x4 previous_view_projection = {};
+	};
+
+	// Reads the pattern from the config and starts a new sequence
+	void configure();
+
+	// Call once per injected frame after the camera has been updated
+	const Frame &update(const Float3 &camera_position, const Float3 &delta_camera_position, const Float3 &delta_camera_rotation,
+		const Float4x4 &previous_view_matrix, const Float4x4 &previous_projection_matrix);
+
+	// Value 'index' of the radical inverse sequence in 'base', in [0, 1)
+	float halton(uint32_t index, uint32_t base);
+	// Rank of a cell in an ordered-dither (Bayer) matrix of side 'size', a power of two
+	uint32_t bayer_rank(uint32_t x, uint32_t y, uint32_t size);
+	bool is_camera_cut(const Float3 &delta_position, const Float3 &delta_rotation);
+	// Row-vector product, 'a' applied first, matching mul(v, m) in the effect
+	Float4x4 multiply(const Float4x4 &a, const Float4x4 &b);
+
+	void draw_overlay();
+}
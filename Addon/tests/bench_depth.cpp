@@ -0,0 +1,188 @@
+// Cost of one frame of depth-stencil tracking (recording, queue merge, present and the selection at
+// the start of the effects) replaying a GTA V-like command stream against the stub device. Besides
+// the time per frame it reports the time spent in present and the heap allocations per frame.
+
+#include <benchmark/benchmark.h>
+
+#include "depth_host.hpp"
+#include "profiler.hpp"
+#include "reshade_host.hpp"
+#include "stub_device.hpp"
+
+#include <chrono>
+#include <memory>
+
+namespace
+{
+	enum class recorded_op
+	{
+		bind,
+		clear,
+		draw,
+	};
+
+	struct RecordedCommand
+	{
+		recorded_op op;
+		uint32_t depth_stencil; // Index into DEPTH_STENCILS
+		uint32_t drawcalls;
+		uint32_t vertices;
+	};
+
+	struct RecordedDepthStencil
+	{
+		uint32_t width;
+		uint32_t height;
+		format depth_format;
+	};
+
+	// What the game renders its depth into each frame, at a 1920x1080 back buffer
+	const RecordedDepthStencil DEPTH_STENCILS[] = {
+		{ 1920, 1080, format::d32_float_s8_uint }, // Scene, written by the fullscreen passes after the lighting
+		{ 1920, 1080, format::d32_float_s8_uint }, // G-buffer
+		{ 1024, 4096, format::d32_float },         // Shadow cascades, stacked vertically
+		{ 960, 540, format::d32_float_s8_uint },   // Water reflection
+		{ 256, 256, format::d24_unorm_s8_uint },   // Vehicle reflection paraboloids
+		{ 480, 270, format::d32_float },           // Particles at quarter resolution
+		{ 1920, 1080, format::d24_unorm_s8_uint }, // Mirror
+	};
+
+	// One frame of the game, a pass starting at each bind. Depth is cleared to 0.0 (reversed Z), the scene
+	// depth gets the two fullscreen passes the GTA V heuristic looks for.
+	const RecordedCommand FRAME[] = {
+		{ recorded_op::bind, 2, 0, 0 }, { recorded_op::clear, 2, 0, 0 }, { recorded_op::draw, 2, 900, 240 },
+		{ recorded_op::bind, 4, 0, 0 }, { recorded_op::clear, 4, 0, 0 }, { recorded_op::draw, 4, 120, 180 }, { recorded_op::clear, 4, 0, 0 }, { recorded_op::draw, 4, 120, 180 },
+		{ recorded_op::bind, 3, 0, 0 }, { recorded_op::clear, 3, 0, 0 }, { recorded_op::draw, 3, 350, 300 },
+		{ recorded_op::bind, 1, 0, 0 }, { recorded_op::clear, 1, 0, 0 }, { recorded_op::draw, 1, 2400, 420 },
+		{ recorded_op::bind, 6, 0, 0 }, { recorded_op::clear, 6, 0, 0 }, { recorded_op::draw, 6, 200, 360 },
+		{ recorded_op::bind, 0, 0, 0 }, { recorded_op::clear, 0, 0, 0 }, { recorded_op::draw, 0, 2, 6 },
+		{ recorded_op::bind, 5, 0, 0 }, { recorded_op::clear, 5, 0, 0 }, { recorded_op::draw, 5, 600, 4 },
+	};
+
+	class DepthReplay
+	{
+	public:
+		DepthReplay(uint32_t command_lists) : cmd_lists(command_lists)
+		{
+			on_init_device(&runtime.stub_device);
+			on_init_command_queue(&runtime.stub_queue);
+			on_init_command_list(&runtime.stub_cmd_list);
+			on_init_depth_swapchain(&runtime.stub_swapchain, false);
+			on_init_effect_runtime(&runtime);
+
+			for (Harness::StubCommandList &cmd_list : cmd_lists)
+			{
+				cmd_list.owner = &runtime.stub_device;
+				on_init_command_list(&cmd_list);
+			}
+
+			for (const RecordedDepthStencil &depth_stencil : DEPTH_STENCILS)
+			{
+				const resource_desc desc(depth_stencil.width, depth_stencil.height, 1, 1, depth_stencil.depth_format, 1, memory_heap::gpu_only, resource_usage::depth_stencil | resource_usage::copy_source);
+				const resource resource = runtime.stub_device.add_resource(desc);
+				on_init_resource(&runtime.stub_device, desc, nullptr, resource_usage::depth_stencil_write, resource);
+				dsvs.push_back(runtime.stub_device.add_view(resource));
+			}
+		}
+		~DepthReplay()
+		{
+			for (Harness::StubCommandList &cmd_list : cmd_lists)
+				on_destroy_command_list(&cmd_list);
+
+			on_destroy_effect_runtime(&runtime);
+			on_destroy_command_list(&runtime.stub_cmd_list);
+			on_destroy_command_queue(&runtime.stub_queue);
+			on_destroy_device(&runtime.stub_device);
+		}
+
+		// Records the passes of the frame round-robin into the command lists, executes them, presents and
+		// renders the effects
+		void frame()
+		{
+			command_list *cmd_list = nullptr;
+			uint32_t pass = 0;
+			for (const RecordedCommand &command : FRAME)
+			{
+				const resource_view dsv = dsvs[command.depth_stencil];
+				switch (command.op)
+				{
+				case recorded_op::bind:
+					cmd_list = &cmd_lists[pass++ % cmd_lists.size()];
+					on_bind_depth_stencil(cmd_list, 0, nullptr, dsv);
+					break;
+				case recorded_op::clear:
+				{
+					const float depth = 0.0f;
+					on_clear_depth_stencil(cmd_list, dsv, &depth, nullptr, 0, nullptr);
+					break;
+				}
+				case recorded_op::draw:
+					for (uint32_t i = 0; i < command.drawcalls; ++i)
+						on_draw_indexed(cmd_list, command.vertices, 1, 0, 0, 0);
+					break;
+				}
+			}
+
+			for (Harness::StubCommandList &cmd_list : cmd_lists)
+				on_bind_depth_stencil(&cmd_list, 0, nullptr, { 0 });
+
+			for (Harness::StubCommandList &cmd_list : cmd_lists)
+			{
+				on_execute_primary(&runtime.stub_queue, &cmd_list);
+				on_reset(&cmd_list);
+			}
+
+			const auto present_start = std::chrono::steady_clock::now();
+			on_present(&runtime.stub_queue, &runtime.stub_swapchain, nullptr, nullptr, 0, nullptr);
+			present_time += std::chrono::steady_clock::now() - present_start;
+
+			on_begin_render_effects(&runtime, &runtime.stub_cmd_list, { 0 }, { 0 });
+			on_finish_render_effects(&runtime, &runtime.stub_cmd_list, { 0 }, { 0 });
+		}
+
+		resource selected() const
+		{
+			const effect_runtime &base = runtime;
+			return base.get_private_data<generic_depth_data>()->selected_depth_stencil;
+		}
+		resource scene() const
+		{
+			return runtime.stub_device.get_resource_from_view(dsvs[0]);
+		}
+
+		Harness::StubEffectRuntime runtime;
+		std::vector<Harness::StubCommandList> cmd_lists;
+		std::vector<resource_view> dsvs;
+		std::chrono::steady_clock::duration present_time = {};
+	};
+}
+
+static void replay(benchmark::State &state, uint32_t command_lists, uint32_t lock_after_frames)
+{
+	Harness::set_config("DEPTH", "LockAfterFrames", std::to_string(lock_after_frames));
+	s_fingerprint = {};
+	s_locked_depth_stencil.store(0);
+
+	const auto replay = std::make_unique<DepthReplay>(command_lists);
+
+	// Warm-up, selects the scene depth-stencil and grows the reused lists to the size of a frame
+	for (int i = 0; i < 60; ++i)
+		replay->frame();
+	if (replay->selected() != replay->scene())
+		state.SkipWithError("The scene depth-stencil was not selected");
+
+	const uint64_t allocations = Profiler::get_thread_allocations();
+	replay->present_time = {};
+
+	for (auto _ : state)
+		replay->frame();
+
+	state.counters["present_us"] = benchmark::Counter(std::chrono::duration<double, std::micro>(replay->present_time).count(), benchmark::Counter::kAvgIterations);
+	state.counters["allocations"] = benchmark::Counter((double)(Profiler::get_thread_allocations() - allocations), benchmark::Counter::kAvgIterations);
+
+	Harness::clear_config();
+}
+
+BENCHMARK_CAPTURE(replay, one_list, 1, 0);
+BENCHMARK_CAPTURE(replay, four_lists, 4, 0);
+BENCHMARK_CAPTURE(replay, four_lists_locked, 4, 30);
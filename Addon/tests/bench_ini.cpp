@@ -0,0 +1,69 @@
+// Cost of reading a fully edited PulseV_Clouds.ini, every weather at every hour: parsing it with
+// pv::ini alone and loading it into a PresetStore. Besides the time per load it reports the heap
+// allocations per load.
+
+#include <benchmark/benchmark.h>
+
+#include "cloud_presets.hpp"
+#include "profiler.hpp"
+#include "util/IniLite.hpp"
+
+#include <filesystem>
+
+using namespace pv::clouds;
+
+namespace
+{
+	// Writes the file once per benchmark and removes it again
+	struct PresetsFile
+	{
+		PresetsFile()
+		{
+			PresetStore store;
+			for (uint8_t w = 0; w < static_cast<uint8_t>(Weather::COUNT); ++w)
+				for (int h = 0; h < 24; ++h)
+					store.get_or_create(static_cast<Weather>(w), TimeBucket { h, 0 }).cloudCover = 0.01f * h;
+			store.save(path);
+			sections = store.map.size();
+		}
+		~PresetsFile()
+		{
+			std::filesystem::remove(path);
+		}
+
+		const std::string path = (std::filesystem::temp_directory_path() / "pulsev_bench_ini.ini").string();
+		size_t sections = 0;
+	};
+}
+
+static void parse_presets(benchmark::State &state)
+{
+	const PresetsFile file;
+	const uint64_t allocations = Profiler::get_thread_allocations();
+
+	for (auto _ : state)
+	{
+		pv::ini::Ini ini(pv::ini::PRESET_COMMENTS);
+		benchmark::DoNotOptimize(ini.load(file.path));
+		benchmark::DoNotOptimize(ini.sections().data());
+	}
+
+	state.counters["allocations"] = benchmark::Counter((double)(Profiler::get_thread_allocations() - allocations), benchmark::Counter::kAvgIterations);
+	state.counters["sections"] = (double)file.sections;
+}
+
+static void load_presets(benchmark::State &state)
+{
+	const PresetsFile file;
+	PresetStore store;
+	const uint64_t allocations = Profiler::get_thread_allocations();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(store.load(file.path));
+
+	state.counters["allocations"] = benchmark::Counter((double)(Profiler::get_thread_allocations() - allocations), benchmark::Counter::kAvgIterations);
+	state.counters["presets"] = (double)store.map.size();
+}
+
+BENCHMARK(parse_presets);
+BENCHMARK(load_presets);
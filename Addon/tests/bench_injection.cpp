@@ -0,0 +1,58 @@
+// Cost of one frame of uniform injection (cloud preset tick, staging and commit) against a mock
+// runtime declaring the shipped effect's uniforms. Besides the time per frame it reports the calls
+// made into ReShade, the uniform writes and the heap allocations per frame.
+
+#include <benchmark/benchmark.h>
+
+#include "data_reader.hpp"
+#include "injection.hpp"
+#include "mock_runtime.hpp"
+#include "profiler.hpp"
+#include "scripted_source.hpp"
+
+static void inject(benchmark::State &state, bool packed_layers, uint32_t extra_effects)
+{
+	Harness::ScriptedSource source;
+	Harness::MockEffectRuntime runtime;
+	Harness::populate_pulsev_effect(runtime, packed_layers, extra_effects);
+
+	DataReader::register_data_reader(nullptr, &source);
+	DataReader::step();
+
+	pv::clouds::CloudsState clouds;
+	clouds.rt = &runtime;
+	clouds.has_runtime = true;
+
+	UniformCapture::Writer capture;
+	double now = 0.0;
+
+	// Warm-up, the first frames discover the uniforms and fill the caches
+	for (int i = 0; i < 8; ++i)
+	{
+		Profiler::collect();
+		Injection::inject_frame(&runtime, clouds, now += 1.0 / 60.0, capture);
+	}
+
+	const uint64_t calls = runtime.total_calls();
+	const uint64_t writes = runtime.uniform_writes;
+	const uint64_t allocations = Profiler::get_thread_allocations();
+
+	for (auto _ : state)
+	{
+		Profiler::collect();
+		benchmark::DoNotOptimize(Injection::inject_frame(&runtime, clouds, now += 1.0 / 60.0, capture));
+	}
+
+	state.counters["reshade_calls"] = benchmark::Counter((double)(runtime.total_calls() - calls), benchmark::Counter::kAvgIterations);
+	state.counters["values_set"] = benchmark::Counter((double)(runtime.uniform_writes - writes), benchmark::Counter::kAvgIterations);
+	state.counters["allocations"] = benchmark::Counter((double)(Profiler::get_thread_allocations() - allocations), benchmark::Counter::kAvgIterations);
+	state.counters["uniforms"] = (double)runtime.get_uniforms().size();
+
+	DataReader::unregister_data_reader(nullptr);
+}
+
+BENCHMARK_CAPTURE(inject, per_weather_layers, false, 0);
+BENCHMARK_CAPTURE(inject, packed_layers, true, 0);
+BENCHMARK_CAPTURE(inject, per_weather_layers_4_effects, false, 3);
+
+BENCHMARK_MAIN();
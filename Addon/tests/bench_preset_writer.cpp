@@ -0,0 +1,101 @@
+// Cost of saving the cloud presets of every weather and time of day: what "Save All" takes on the
+// overlay callback synchronously and queued on the PresetWriter, and how long the writer then takes
+// to rewrite the file when one or every preset changed.
+
+#include <benchmark/benchmark.h>
+
+#include "cloud_presets.hpp"
+#include "preset_writer.hpp"
+
+#include <filesystem>
+
+using namespace pv::clouds;
+
+namespace
+{
+	// Every weather at a preset every three hours, as a fully edited PulseV_Clouds.ini holds
+	PresetStore full_store()
+	{
+		PresetStore store;
+		for (uint8_t w = 0; w < static_cast<uint8_t>(Weather::COUNT); ++w)
+			for (int h = 0; h < 24; h += 3)
+				store.get_or_create(static_cast<Weather>(w), TimeBucket { h, 0 }).cloudCover = 0.1f * (w % 10);
+		return store;
+	}
+
+	std::string presets_path()
+	{
+		return (std::filesystem::temp_directory_path() / "pulsev_bench_presets.ini").string();
+	}
+}
+
+static void save_all_synchronously(benchmark::State &state)
+{
+	const std::string path = presets_path();
+	const PresetStore store = full_store();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(store.save(path));
+
+	state.counters["presets"] = (double)store.map.size();
+	std::filesystem::remove(path);
+}
+
+static void save_all_enqueued(benchmark::State &state)
+{
+	const std::string path = presets_path();
+	const PresetStore store = full_store();
+	PresetWriter writer;
+
+	// Only the queueing happens on the caller, the saves coalesce into one write on the worker
+	for (auto _ : state)
+		writer.enqueue_all(path, store);
+
+	writer.stop();
+	state.counters["presets"] = (double)store.map.size();
+	std::filesystem::remove(path);
+}
+
+// Time until a change to one or to every preset is on disk, in wall time since the write happens on the
+// worker
+static void write_changed(benchmark::State &state, bool all)
+{
+	const std::string path = presets_path();
+	PresetStore store = full_store();
+	store.save(path);
+
+	PresetWriter writer;
+	writer.mark_clean(store);
+
+	const std::string key = PresetStore::make_key(Weather::RAIN, TimeBucket { 12, 0 });
+	float cover = 0.0f;
+
+	for (auto _ : state)
+	{
+		// A different value every time, the writer skips presets identical to those on disk
+		cover += 0.001f;
+		if (all)
+		{
+			for (auto &kv : store.map)
+				kv.second.cloudCover = cover;
+			writer.enqueue_all(path, store);
+		}
+		else
+		{
+			store.map[key].cloudCover = cover;
+			writer.enqueue_one(path, key, store.map[key]);
+		}
+		writer.flush();
+	}
+
+	writer.stop();
+	if (writer.last_failed())
+		state.SkipWithError("The writer failed to save the presets");
+	state.counters["bytes"] = (double)std::filesystem::file_size(path);
+	std::filesystem::remove(path);
+}
+
+BENCHMARK(save_all_synchronously);
+BENCHMARK(save_all_enqueued);
+BENCHMARK_CAPTURE(write_changed, one_preset, false)->UseRealTime();
+BENCHMARK_CAPTURE(write_changed, every_preset, true)->UseRealTime();
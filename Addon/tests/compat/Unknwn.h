@@ -0,0 +1,7 @@
+#pragma once
+
+struct IUnknown
+{
+	virtual unsigned long AddRef() = 0;
+	virtual unsigned long Release() = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+// The few Win32 types and functions the addon's platform-independent code and ReShade's headers use
+
+#include <cstddef>
+#include <cstdint>
+
+typedef void *HMODULE;
+typedef void *HANDLE;
+typedef void *HWND;
+typedef void *LPVOID;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned long DWORD;
+typedef DWORD *LPDWORD;
+typedef long LONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long long DWORD64;
+typedef unsigned long long UINT64;
+typedef UINT64 *PUINT64;
+typedef unsigned int UINT;
+typedef char CHAR;
+typedef unsigned char UCHAR;
+typedef unsigned short USHORT;
+typedef const char *LPCSTR;
+typedef wchar_t WCHAR;
+typedef const wchar_t *LPCWSTR;
+
+#define TRUE 1
+#define FALSE 0
+#define APIENTRY
+#define WINAPI
+#define MAX_PATH 260
+#define MAXDWORD 0xffffffff
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+
+inline void Sleep(DWORD) {}
+inline HANDLE GetCurrentProcess() { return nullptr; }
+inline void OutputDebugStringA(const char *) {}
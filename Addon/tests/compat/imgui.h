@@ -0,0 +1,55 @@
+#pragma once
+
+// Headless ImGui: the overlay code compiles and runs, every widget reports that nothing was
+// interacted with and nothing is drawn
+
+#define IM_ARRAYSIZE(a) ((int)(sizeof(a) / sizeof(*(a))))
+
+struct ImVec2
+{
+	float x = 0.0f, y = 0.0f;
+	ImVec2() = default;
+	ImVec2(float x, float y) : x(x), y(y) {}
+};
+
+enum
+{
+	ImGuiTreeNodeFlags_None = 0,
+	ImGuiColorEditFlags_NoOptions = 1 << 3,
+	ImGuiColorEditFlags_NoPicker = 1 << 2,
+	ImGuiColorEditFlags_NoLabel = 1 << 7,
+	ImGuiColorEditFlags_NoDragDrop = 1 << 9,
+	ImGuiColorEditFlags_AlphaPreviewHalf = 1 << 18,
+	ImGuiColorEditFlags_HDR = 1 << 19,
+	ImGuiColorEditFlags_Float = 1 << 24,
+};
+
+#define PULSEV_HEADLESS_WIDGET(name) template <typename... Args> inline bool name(Args &&...) { return false; }
+
+namespace ImGui
+{
+	PULSEV_HEADLESS_WIDGET(BeginDisabled)
+	PULSEV_HEADLESS_WIDGET(Button)
+	PULSEV_HEADLESS_WIDGET(Checkbox)
+	PULSEV_HEADLESS_WIDGET(CollapsingHeader)
+	PULSEV_HEADLESS_WIDGET(ColorEdit3)
+	PULSEV_HEADLESS_WIDGET(ColorEdit4)
+	PULSEV_HEADLESS_WIDGET(Combo)
+	PULSEV_HEADLESS_WIDGET(DragFloat)
+	PULSEV_HEADLESS_WIDGET(EndDisabled)
+	PULSEV_HEADLESS_WIDGET(PlotLines)
+	PULSEV_HEADLESS_WIDGET(PopID)
+	PULSEV_HEADLESS_WIDGET(PushID)
+	PULSEV_HEADLESS_WIDGET(SameLine)
+	PULSEV_HEADLESS_WIDGET(Separator)
+	PULSEV_HEADLESS_WIDGET(SeparatorText)
+	PULSEV_HEADLESS_WIDGET(SetNextItemWidth)
+	PULSEV_HEADLESS_WIDGET(SliderFloat)
+	PULSEV_HEADLESS_WIDGET(Text)
+	PULSEV_HEADLESS_WIDGET(TextDisabled)
+	PULSEV_HEADLESS_WIDGET(TextUnformatted)
+
+	inline float GetWindowWidth() { return 0.0f; }
+}
+
+#undef PULSEV_HEADLESS_WIDGET
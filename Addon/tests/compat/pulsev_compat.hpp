@@ -0,0 +1,41 @@
+#pragma once
+
+// Force-included into every translation unit of the Linux test build (see ../CMakeLists.txt) so the
+// addon's platform-independent sources compile with GCC and Clang. Never part of the addon itself.
+
+#include <cmath>
+
+#define __declspec(x)
+#define __stdcall
+#define __cdecl
+
+// MSVC gives every type a GUID through __declspec(uuid), ReShade only needs it to be unique per
+// type to key private data, which the address of a per-type variable already is
+namespace pulsev_compat
+{
+	struct guid
+	{
+		unsigned char bytes[16];
+	};
+
+	template <typename T>
+	struct uuid_of
+	{
+		static inline guid value = {};
+	};
+}
+
+#define __uuidof(T) (::pulsev_compat::uuid_of<T>::value)
+
+// The <cmath> float overloads MSVC also declares in namespace std
+namespace std
+{
+	using ::ceilf;
+	using ::cosf;
+	using ::fabsf;
+	using ::floorf;
+	using ::fmodf;
+	using ::powf;
+	using ::sinf;
+	using ::sqrtf;
+}
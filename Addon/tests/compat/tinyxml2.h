@@ -0,0 +1,7 @@
+#pragma once
+
+// Only what the timecycle declarations need, timecycle.cpp itself is not part of the Linux build
+namespace tinyxml2
+{
+	class XMLDocument;
+}
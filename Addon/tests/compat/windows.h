@@ -0,0 +1 @@
+#include "Windows.h"
@@ -0,0 +1,29 @@
+#pragma once
+
+// Brings the depth-stencil selection of ../depth.hpp into a test. Its callbacks are static, so every
+// translation unit including this gets its own copy of the module and its state.
+//
+// reshade::register_event casts the callback with static_cast<void *>, which only MSVC accepts for a
+// function pointer, so register_depth_switcher's calls are redirected to an equivalent that does not.
+
+#include <reshade.hpp>
+
+namespace reshade
+{
+	template <addon_event ev>
+	inline void register_event_for_tests(typename addon_event_traits<ev>::decl callback)
+	{
+		ReShadeRegisterEvent(ev, reinterpret_cast<void *>(callback));
+	}
+	template <addon_event ev>
+	inline void unregister_event_for_tests(typename addon_event_traits<ev>::decl callback)
+	{
+		ReShadeUnregisterEvent(ev, reinterpret_cast<void *>(callback));
+	}
+}
+
+#define register_event register_event_for_tests
+#define unregister_event unregister_event_for_tests
+#include "depth.hpp"
+#undef register_event
+#undef unregister_event
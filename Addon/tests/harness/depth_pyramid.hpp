@@ -0,0 +1,133 @@
+#pragma once
+
+// CPU references of the depth passes of PulseV_Volumetrics.fx, computed texel by texel the way the
+// shaders do so the tests can check what the cloud march relies on without a GPU
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace Harness
+{
+	// An RG16F depth target of the effect: x = nearest, y = farthest, divided by the far clip
+	struct DepthLevel
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<float> nearest;
+		std::vector<float> farthest;
+
+		DepthLevel() = default;
+		DepthLevel(uint32_t width, uint32_t height) : width(width), height(height), nearest(width * height, 1.0f), farthest(width * height, 0.0f) {}
+
+		size_t index(uint32_t x, uint32_t y) const { return y * width + x; }
+
+		// What a POINT sampler returns at 'u', 'v'
+		size_t sample(float u, float v) const
+		{
+			const uint32_t x = std::min(static_cast<uint32_t>(u * width), width - 1);
+			const uint32_t y = std::min(static_cast<uint32_t>(v * height), height - 1);
+			return index(x, y);
+		}
+	};
+
+	// The scene's depth-stencil as ReShade::DepthBuffer reads it
+	struct DepthBuffer
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<float> depth;
+		bool reversed = false;
+	};
+
+	// texelFootprint: each target texel covers the source texels from floor(t * ratio) to
+	// ceil((t + 1) * ratio) of the actual size ratio. Calls 'texel' with each of them.
+	template <typename F>
+	void for_each_texel_under(uint32_t tx, uint32_t ty, uint32_t source_width, uint32_t source_height, uint32_t target_width, uint32_t target_height, F texel)
+	{
+		const float ratio_x = static_cast<float>(source_width) / static_cast<float>(target_width);
+		const float ratio_y = static_cast<float>(source_height) / static_cast<float>(target_height);
+		const int first_x = static_cast<int>(std::floor(tx * ratio_x));
+		const int first_y = static_cast<int>(std::floor(ty * ratio_y));
+		const int last_x = std::min(static_cast<int>(std::ceil((tx + 1) * ratio_x)), static_cast<int>(source_width)) - 1;
+		const int last_y = std::min(static_cast<int>(std::ceil((ty + 1) * ratio_y)), static_cast<int>(source_height)) - 1;
+
+		for (int y = first_y; y <= last_y; ++y)
+			for (int x = first_x; x <= last_x; ++x)
+				texel(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+	}
+
+	// Size of LinearDepthTexture on a back buffer of the given size
+	inline uint32_t linear_depth_size(uint32_t buffer_size, float render_scale)
+	{
+		return static_cast<uint32_t>(buffer_size * render_scale);
+	}
+
+	// PS_LinearDepth: the nearest and farthest linear depth under each render scale texel, divided by
+	// the far clip, sky is exactly 1.0
+	inline DepthLevel linearize_depth(const DepthBuffer &source, uint32_t buffer_width, uint32_t buffer_height, float render_scale, float near_clip, float far_clip)
+	{
+		DepthLevel target(linear_depth_size(buffer_width, render_scale), linear_depth_size(buffer_height, render_scale));
+		const float inv_far = 1.0f / std::max(far_clip, 0.00001f);
+
+		for (uint32_t ty = 0; ty < target.height; ++ty)
+		{
+			for (uint32_t tx = 0; tx < target.width; ++tx)
+			{
+				const size_t t = target.index(tx, ty);
+				for_each_texel_under(tx, ty, source.width, source.height, target.width, target.height, [&](uint32_t x, uint32_t y) {
+					float depth = source.depth[y * source.width + x];
+					if (source.reversed)
+						depth = 1.0f - depth;
+
+					const float linear = near_clip * far_clip / (far_clip + depth * (near_clip - far_clip));
+					const float scene = depth < 1.0f ? std::clamp(linear * inv_far, 0.0f, 1.0f) : 1.0f;
+					target.nearest[t] = std::min(target.nearest[t], scene);
+					target.farthest[t] = std::max(target.farthest[t], scene);
+				});
+			}
+		}
+
+		return target;
+	}
+
+	// reduceDepthMinMax: the nearest and farthest of the source texels under each target texel
+	inline DepthLevel reduce_depth_min_max(const DepthLevel &source, uint32_t width, uint32_t height)
+	{
+		DepthLevel target(width, height);
+
+		for (uint32_t ty = 0; ty < height; ++ty)
+		{
+			for (uint32_t tx = 0; tx < width; ++tx)
+			{
+				const size_t t = target.index(tx, ty);
+				for_each_texel_under(tx, ty, source.width, source.height, width, height, [&](uint32_t x, uint32_t y) {
+					const size_t s = source.index(x, y);
+					target.nearest[t] = std::min(target.nearest[t], source.nearest[s]);
+					target.farthest[t] = std::max(target.farthest[t], source.farthest[s]);
+				});
+			}
+		}
+
+		return target;
+	}
+
+	// Divisors of the screen size of HiZ4Texture to HiZ32Texture
+	constexpr uint32_t HIZ_DIVISORS[] = { 4, 8, 16, 32 };
+
+	// The passes hiz_4 to hiz_32 over 'linear_depth' (LinearDepthTexture) on a back buffer of the given size
+	inline std::vector<DepthLevel> build_hiz_pyramid(const DepthLevel &linear_depth, uint32_t buffer_width, uint32_t buffer_height)
+	{
+		std::vector<DepthLevel> levels;
+		levels.reserve(std::size(HIZ_DIVISORS));
+		const DepthLevel *source = &linear_depth;
+		for (const uint32_t divisor : HIZ_DIVISORS)
+		{
+			levels.push_back(reduce_depth_min_max(*source, buffer_width / divisor, buffer_height / divisor));
+			source = &levels.back();
+		}
+		return levels;
+	}
+}
@@ -0,0 +1,565 @@
+#include "mock_runtime.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+
+using namespace Harness;
+
+// ReShade's convention for returning strings: the size is queried with a null buffer, otherwise
+// as much as fits is copied and the size updated
+static void copy_string(const std::string &source, char *value, size_t *value_size)
+{
+	if (value_size == nullptr)
+		return;
+
+	if (value == nullptr)
+	{
+		*value_size = source.size() + 1;
+		return;
+	}
+
+	if (*value_size == 0)
+		return;
+
+	const size_t length = std::min(source.size(), *value_size - 1);
+	std::memcpy(value, source.data(), length);
+	value[length] = '\0';
+	*value_size = length + 1;
+}
+
+float MockUniform::get_float(size_t index) const
+{
+	float value = 0.0f;
+	if (index < data.size())
+		std::memcpy(&value, &data[index], sizeof(value));
+	return value;
+}
+
+int32_t MockUniform::get_int(size_t index) const
+{
+	return index < data.size() ? (int32_t)data[index] : 0;
+}
+
+MockEffectRuntime::MockEffectRuntime()
+{
+	owner = &device;
+	queue.owner = &device;
+	cmd_list.owner = &device;
+}
+
+size_t MockEffectRuntime::add_uniform(const std::string &effect, const std::string &name, format base_type, uint32_t rows, uint32_t columns, uint32_t array_length, const std::string &source)
+{
+	MockUniform uniform;
+	uniform.effect = effect;
+	uniform.name = name;
+	uniform.base_type = base_type;
+	uniform.rows = rows;
+	uniform.columns = columns;
+	uniform.array_length = array_length;
+	uniform.data.resize((size_t)rows * columns * std::max(array_length, 1u));
+	if (!source.empty())
+		uniform.string_annotations.emplace_back("source", source);
+
+	uniforms.push_back(std::move(uniform));
+	return uniforms.size() - 1;
+}
+
+size_t MockEffectRuntime::add_technique(const std::string &effect, const std::string &name)
+{
+	techniques.push_back({ effect, name, true });
+	return techniques.size() - 1;
+}
+
+MockUniform *MockEffectRuntime::find(const std::string &name)
+{
+	const auto it = std::find_if(uniforms.begin(), uniforms.end(), [&name](const MockUniform &uniform) { return uniform.name == name; });
+	return it != uniforms.end() ? &*it : nullptr;
+}
+
+const MockUniform *MockEffectRuntime::find(const std::string &name) const
+{
+	const auto it = std::find_if(uniforms.begin(), uniforms.end(), [&name](const MockUniform &uniform) { return uniform.name == name; });
+	return it != uniforms.end() ? &*it : nullptr;
+}
+
+MockUniform *MockEffectRuntime::get(effect_uniform_variable variable)
+{
+	return variable.handle != 0 && variable.handle <= uniforms.size() ? &uniforms[variable.handle - 1] : nullptr;
+}
+
+const MockUniform *MockEffectRuntime::get(effect_uniform_variable variable) const
+{
+	return variable.handle != 0 && variable.handle <= uniforms.size() ? &uniforms[variable.handle - 1] : nullptr;
+}
+
+command_queue *MockEffectRuntime::get_command_queue()
+{
+	++calls;
+	return &queue;
+}
+
+void MockEffectRuntime::enumerate_uniform_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_uniform_variable variable, void *user_data), void *user_data)
+{
+	++calls;
+	for (size_t i = 0; i < uniforms.size(); ++i)
+	{
+		if (effect_name == nullptr || uniforms[i].effect == effect_name)
+			callback(this, { i + 1 }, user_data);
+	}
+}
+
+effect_uniform_variable MockEffectRuntime::find_uniform_variable(const char *effect_name, const char *variable_name) const
+{
+	++calls;
+	for (size_t i = 0; i < uniforms.size(); ++i)
+	{
+		if ((effect_name == nullptr || uniforms[i].effect == effect_name) && uniforms[i].name == variable_name)
+			return { i + 1 };
+	}
+	return { 0 };
+}
+
+void MockEffectRuntime::get_uniform_variable_type(effect_uniform_variable variable, format *out_base_type, uint32_t *out_rows, uint32_t *out_columns, uint32_t *out_array_length) const
+{
+	++calls;
+	const MockUniform *const uniform = get(variable);
+	if (out_base_type != nullptr)
+		*out_base_type = uniform != nullptr ? uniform->base_type : format::unknown;
+	if (out_rows != nullptr)
+		*out_rows = uniform != nullptr ? uniform->rows : 0;
+	if (out_columns != nullptr)
+		*out_columns = uniform != nullptr ? uniform->columns : 0;
+	if (out_array_length != nullptr)
+		*out_array_length = uniform != nullptr ? uniform->array_length : 0;
+}
+
+void MockEffectRuntime::get_uniform_variable_name(effect_uniform_variable variable, char *name, size_t *name_size) const
+{
+	++calls;
+	const MockUniform *const uniform = get(variable);
+	copy_string(uniform != nullptr ? uniform->name : std::string(), name, name_size);
+}
+
+void MockEffectRuntime::get_uniform_variable_effect_name(effect_uniform_variable variable, char *effect_name, size_t *effect_name_size) const
+{
+	++calls;
+	const MockUniform *const uniform = get(variable);
+	copy_string(uniform != nullptr ? uniform->effect : std::string(), effect_name, effect_name_size);
+}
+
+bool MockEffectRuntime::get_annotation_string_from_uniform_variable(effect_uniform_variable variable, const char *name, char *value, size_t *value_size) const
+{
+	++calls;
+	if (const MockUniform *const uniform = get(variable))
+	{
+		for (const auto &annotation : uniform->string_annotations)
+		{
+			if (annotation.first == name)
+			{
+				copy_string(annotation.second, value, value_size);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void MockEffectRuntime::write(effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index)
+{
+	++calls;
+	++uniform_writes;
+
+	MockUniform *const uniform = get(variable);
+	if (uniform == nullptr)
+		return;
+
+	uniform->writes++;
+
+	const size_t first = array_index * uniform->rows * uniform->columns;
+	for (size_t i = 0; i < count && first + i < uniform->data.size(); ++i)
+		uniform->data[first + i] = values[i];
+}
+
+void MockEffectRuntime::read(effect_uniform_variable variable, uint32_t *values, size_t count, size_t array_index) const
+{
+	++calls;
+
+	const MockUniform *const uniform = get(variable);
+	const size_t first = uniform != nullptr ? array_index * uniform->rows * uniform->columns : 0;
+	for (size_t i = 0; i < count; ++i)
+		values[i] = uniform != nullptr && first + i < uniform->data.size() ? uniform->data[first + i] : 0;
+}
+
+void MockEffectRuntime::get_uniform_value_bool(effect_uniform_variable variable, bool *values, size_t count, size_t array_index) const
+{
+	uint32_t stored[16] = {};
+	count = std::min(count, std::size(stored));
+	read(variable, stored, count, array_index);
+	for (size_t i = 0; i < count; ++i)
+		values[i] = stored[i] != 0;
+}
+
+void MockEffectRuntime::get_uniform_value_float(effect_uniform_variable variable, float *values, size_t count, size_t array_index) const
+{
+	static_assert(sizeof(float) == sizeof(uint32_t));
+	read(variable, reinterpret_cast<uint32_t *>(values), count, array_index);
+}
+
+void MockEffectRuntime::get_uniform_value_int(effect_uniform_variable variable, int32_t *values, size_t count, size_t array_index) const
+{
+	read(variable, reinterpret_cast<uint32_t *>(values), count, array_index);
+}
+
+void MockEffectRuntime::get_uniform_value_uint(effect_uniform_variable variable, uint32_t *values, size_t count, size_t array_index) const
+{
+	read(variable, values, count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_bool(effect_uniform_variable variable, const bool *values, size_t count, size_t array_index)
+{
+	uint32_t converted[16] = {};
+	count = std::min(count, std::size(converted));
+	for (size_t i = 0; i < count; ++i)
+		converted[i] = values[i] ? 1 : 0;
+	write(variable, converted, count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_float(effect_uniform_variable variable, const float *values, size_t count, size_t array_index)
+{
+	write(variable, reinterpret_cast<const uint32_t *>(values), count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_int(effect_uniform_variable variable, const int32_t *values, size_t count, size_t array_index)
+{
+	write(variable, reinterpret_cast<const uint32_t *>(values), count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_uint(effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index)
+{
+	write(variable, values, count, array_index);
+}
+
+void MockEffectRuntime::enumerate_techniques(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_technique technique, void *user_data), void *user_data)
+{
+	++calls;
+	for (size_t i = 0; i < techniques.size(); ++i)
+	{
+		if (effect_name == nullptr || techniques[i].effect == effect_name)
+			callback(this, { i + 1 }, user_data);
+	}
+}
+
+effect_technique MockEffectRuntime::find_technique(const char *effect_name, const char *technique_name)
+{
+	++calls;
+	for (size_t i = 0; i < techniques.size(); ++i)
+	{
+		if ((effect_name == nullptr || techniques[i].effect == effect_name) && techniques[i].name == technique_name)
+			return { i + 1 };
+	}
+	return { 0 };
+}
+
+void MockEffectRuntime::get_technique_name(effect_technique technique, char *name, size_t *name_size) const
+{
+	++calls;
+	copy_string(technique.handle != 0 && technique.handle <= techniques.size() ? techniques[technique.handle - 1].name : std::string(), name, name_size);
+}
+
+void MockEffectRuntime::get_technique_effect_name(effect_technique technique, char *effect_name, size_t *effect_name_size) const
+{
+	++calls;
+	copy_string(technique.handle != 0 && technique.handle <= techniques.size() ? techniques[technique.handle - 1].effect : std::string(), effect_name, effect_name_size);
+}
+
+bool MockEffectRuntime::get_technique_state(effect_technique technique) const
+{
+	++calls;
+	return technique.handle != 0 && technique.handle <= techniques.size() && techniques[technique.handle - 1].enabled;
+}
+
+void MockEffectRuntime::set_technique_state(effect_technique technique, bool enabled)
+{
+	++calls;
+	if (technique.handle != 0 && technique.handle <= techniques.size())
+		techniques[technique.handle - 1].enabled = enabled;
+}
+
+bool MockEffectRuntime::get_preprocessor_definition(const char *name, char *value, size_t *value_size) const
+{
+	++calls;
+	for (const auto &definition : definitions)
+	{
+		if (definition.first == name)
+		{
+			copy_string(definition.second, value, value_size);
+			return true;
+		}
+	}
+	return false;
+}
+
+void MockEffectRuntime::set_preprocessor_definition(const char *name, const char *value)
+{
+	++calls;
+	for (auto &definition : definitions)
+	{
+		if (definition.first == name)
+		{
+			definition.second = value;
+			return;
+		}
+	}
+	definitions.emplace_back(name, value);
+}
+
+/**
+* The shipped effect
+**/
+
+static std::string read_shader(const char *file)
+{
+	std::ifstream stream(std::string(PULSEV_SHADER_DIR) + "/" + file, std::ios::binary);
+	std::stringstream contents;
+	contents << stream.rdbuf();
+	return contents.str();
+}
+
+static bool parse_type(const std::string &type, format &base_type, uint32_t &rows, uint32_t &columns)
+{
+	static const std::regex pattern(R"((bool|int|uint|float)([1-4])?(?:x([1-4]))?)");
+
+	std::smatch match;
+	if (!std::regex_match(type, match, pattern))
+		return false;
+
+	base_type = match[1] == "bool" ? format::r32_typeless : match[1] == "int" ? format::r32_sint : match[1] == "uint" ? format::r32_uint : format::r32_float;
+	rows = match[2].matched ? (uint32_t)std::stoul(match[2]) : 1;
+	columns = match[3].matched ? (uint32_t)std::stoul(match[3]) : 1;
+	return true;
+}
+
+// Adds every plain "uniform type name" declaration of 'source', returns the annotated ones
+static std::vector<size_t> add_declared_uniforms(MockEffectRuntime &runtime, const std::string &effect, const std::string &source)
+{
+	static const std::regex declaration(R"(^\s*uniform\s+(\w+)\s+(\w+)\s*(\[[^\]]*\])?\s*(<[^>]*>)?)", std::regex::multiline);
+	static const std::regex source_annotation(R"re(string\s+source\s*=\s*"([^"]*)")re");
+
+	std::vector<size_t> annotated;
+	for (auto it = std::sregex_iterator(source.begin(), source.end(), declaration); it != std::sregex_iterator(); ++it)
+	{
+		format base_type;
+		uint32_t rows, columns;
+		if (!parse_type((*it)[1], base_type, rows, columns))
+			continue;
+
+		std::string source_name;
+		std::smatch match;
+		const std::string annotations = (*it)[4];
+		if (std::regex_search(annotations, match, source_annotation))
+			source_name = match[1];
+
+		const size_t index = runtime.add_uniform(effect, (*it)[2], base_type, rows, columns, 0, source_name);
+		if (!source_name.empty())
+			annotated.push_back(index);
+	}
+	return annotated;
+}
+
+void Harness::populate_pulsev_effect(MockEffectRuntime &runtime, bool packed_layers, uint32_t extra_effects)
+{
+	const std::string effect = "PulseV_Volumetrics.fx";
+
+	std::vector<size_t> annotated = add_declared_uniforms(runtime, effect, read_shader("PulseV_Volumetrics.fx"));
+	const std::vector<size_t> gtav = add_declared_uniforms(runtime, effect, read_shader("gtav.fxh"));
+	annotated.insert(annotated.end(), gtav.begin(), gtav.end());
+
+	const std::string weathers = read_shader("weathers.fxh");
+	if (packed_layers)
+	{
+		// PACKED_LAYER_BLEND + 1 float4
+		runtime.add_uniform(effect, "cloudPackedLayers", format::r32_float, 4, 1, 25);
+	}
+	else
+	{
+		static const std::regex field(R"(uniform float PRESET##(\w+))");
+		static const std::regex preset(R"(^CLOUD_LAYER_PRESET\((\w+),)", std::regex::multiline);
+
+		std::vector<std::string> fields;
+		for (auto it = std::sregex_iterator(weathers.begin(), weathers.end(), field); it != std::sregex_iterator(); ++it)
+			fields.push_back((*it)[1]);
+
+		for (auto it = std::sregex_iterator(weathers.begin(), weathers.end(), preset); it != std::sregex_iterator(); ++it)
+		{
+			for (const std::string &name : fields)
+				runtime.add_uniform(effect, (*it)[1].str() + name, format::r32_float, 1);
+		}
+	}
+
+	for (uint32_t i = 0; i < extra_effects; ++i)
+	{
+		const std::string other = "Other" + std::to_string(i) + ".fx";
+		for (const size_t index : annotated)
+		{
+			const MockUniform uniform = runtime.get_uniforms()[index];
+			runtime.add_uniform(other, uniform.name, uniform.base_type, uniform.rows, uniform.columns, uniform.array_length, uniform.string_annotations.front().second);
+		}
+	}
+}
+
+/**
+* The shipped effect's passes
+**/
+
+// True when 'expression' holds for 'definitions'. Only what the effect's conditions use is
+// understood: names, numbers, '!' and '&&'.
+static bool evaluate_condition(const std::string &expression, const std::map<std::string, std::string> &definitions)
+{
+	std::stringstream terms(std::regex_replace(expression, std::regex("&&"), "\n"));
+	std::string term;
+	while (std::getline(terms, term))
+	{
+		term = std::regex_replace(term, std::regex(R"(^\s+|\s+$)"), "");
+		const bool negate = !term.empty() && term[0] == '!';
+		if (negate)
+			term = std::regex_replace(term.substr(1), std::regex(R"(^\s+)"), "");
+
+		const auto it = definitions.find(term);
+		const std::string value = it != definitions.end() ? it->second : term;
+		const bool set = std::regex_match(value, std::regex(R"([0-9.]+)")) ? std::stod(value) != 0.0 : false;
+		if (set == negate)
+			return false;
+	}
+	return true;
+}
+
+// The lines of 'source' the preprocessor keeps, applying the #defines it meets along the way
+static std::vector<std::string> preprocess(const std::string &source, std::map<std::string, std::string> definitions)
+{
+	static const std::regex directive(R"(^\s*#\s*(\w+)\s*(.*?)\s*$)");
+	static const std::regex define(R"((\w+)\s*(.*))");
+
+	std::vector<std::string> lines;
+	std::vector<std::pair<bool, bool>> conditions; // Whether the branch is active, whether the enclosing one is
+	const auto active = [&conditions]() { return conditions.empty() || (conditions.back().first && conditions.back().second); };
+
+	std::stringstream stream(source);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		std::smatch match;
+		if (!std::regex_match(line, match, directive))
+		{
+			if (active())
+				lines.push_back(line);
+			continue;
+		}
+
+		const std::string name = match[1];
+		const std::string argument = match[2];
+		if (name == "if" || name == "ifdef" || name == "ifndef")
+		{
+			const bool condition = name == "if" ? evaluate_condition(argument, definitions) : (definitions.count(argument) != 0) == (name == "ifdef");
+			conditions.emplace_back(condition, active());
+		}
+		else if (name == "else" && !conditions.empty())
+			conditions.back().first = !conditions.back().first;
+		else if (name == "endif" && !conditions.empty())
+			conditions.pop_back();
+		else if (name == "define" && active() && std::regex_match(argument, match, define))
+			definitions.emplace(match[1], match[2]);
+	}
+	return lines;
+}
+
+std::vector<EffectPass> Harness::read_technique_passes(const std::string &technique, const std::vector<std::pair<std::string, std::string>> &definitions)
+{
+	static const std::regex function(R"(^\w+\s+(\w+)\s*\(.*\)[^;]*$)");
+	static const std::regex sampler(R"(^sampler\w*\s+(\w+))");
+	static const std::regex sampler_texture(R"(^\s*Texture\s*=\s*(\w+)\s*;)");
+	static const std::regex identifier(R"(\w+)");
+	static const std::regex pass(R"(^\s*pass\s+(\w+))");
+	static const std::regex shader(R"(^\s*(?:PixelShader|ComputeShader)\s*=\s*(\w+)\s*;)");
+	static const std::regex render_target(R"(^\s*RenderTarget0?\s*=\s*(\w+)\s*;)");
+	const std::regex technique_start("^technique\\s+" + technique + "\\b");
+
+	const std::vector<std::string> lines = preprocess(read_shader("PulseV_Volumetrics.fx"), std::map<std::string, std::string>(definitions.begin(), definitions.end()));
+
+	// The identifiers in the body of every function, and the texture of every sampler
+	std::map<std::string, std::set<std::string>> functions;
+	std::map<std::string, std::string> samplers;
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		std::smatch match;
+		if (std::regex_match(lines[i], match, function) && i + 1 < lines.size() && lines[i + 1] == "{")
+		{
+			std::set<std::string> &body = functions[match[1]];
+			for (++i; i < lines.size() && lines[i] != "}"; ++i)
+			{
+				for (auto it = std::sregex_iterator(lines[i].begin(), lines[i].end(), identifier); it != std::sregex_iterator(); ++it)
+					body.insert(it->str());
+			}
+		}
+		else if (std::regex_search(lines[i], match, sampler))
+		{
+			const std::string name = match[1];
+			for (++i; i < lines.size() && lines[i] != "};"; ++i)
+			{
+				if (std::regex_search(lines[i], match, sampler_texture))
+					samplers[name] = match[1];
+			}
+		}
+	}
+
+	const std::function<void(const std::string &, std::set<std::string> &, std::set<std::string> &)> collect_textures =
+		[&](const std::string &name, std::set<std::string> &visited, std::set<std::string> &textures) {
+			if (!visited.insert(name).second)
+				return;
+			for (const std::string &used : functions[name])
+			{
+				if (const auto it = samplers.find(used); it != samplers.end())
+					textures.insert(it->second);
+				else if (functions.count(used) != 0)
+					collect_textures(used, visited, textures);
+			}
+		};
+
+	std::vector<EffectPass> passes;
+	size_t i = 0;
+	while (i < lines.size() && !std::regex_search(lines[i], technique_start))
+		++i;
+
+	int depth = 0;
+	for (; i < lines.size(); ++i)
+	{
+		depth += static_cast<int>(std::count(lines[i].begin(), lines[i].end(), '{'));
+		depth -= static_cast<int>(std::count(lines[i].begin(), lines[i].end(), '}'));
+
+		std::smatch match;
+		if (std::regex_search(lines[i], match, pass))
+			passes.push_back({ match[1] });
+		else if (!passes.empty() && std::regex_search(lines[i], match, shader))
+		{
+			passes.back().shader = match[1];
+
+			std::set<std::string> visited, textures;
+			collect_textures(passes.back().shader, visited, textures);
+			passes.back().textures.assign(textures.begin(), textures.end());
+		}
+		else if (!passes.empty() && std::regex_search(lines[i], match, render_target))
+			passes.back().render_target = match[1];
+
+		if (depth == 0 && lines[i].find('}') != std::string::npos)
+			break;
+	}
+	return passes;
+}
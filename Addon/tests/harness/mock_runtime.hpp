@@ -0,0 +1,118 @@
+#pragma once
+
+// A headless effect runtime holding uniforms and techniques the way ReShade reports them, so the
+// addon's injection code can run outside the game. Besides the per-interface call counters of
+// null_api.hpp it counts the uniform writes separately and keeps the last value of every uniform.
+
+#include "null_api.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Harness
+{
+	struct MockUniform
+	{
+		std::string effect;
+		std::string name;
+		format base_type = format::r32_float;
+		uint32_t rows = 1;         // Vector length, as ReShade reports it
+		uint32_t columns = 1;
+		uint32_t array_length = 0; // 0 when not an array
+		std::vector<std::pair<std::string, std::string>> string_annotations;
+		std::vector<uint32_t> data; // One 32-bit slot per component, bools stored as 0 or 1
+		uint64_t writes = 0;
+
+		float get_float(size_t index = 0) const;
+		int32_t get_int(size_t index = 0) const;
+	};
+
+	struct MockTechnique
+	{
+		std::string effect;
+		std::string name;
+		bool enabled = true;
+	};
+
+	class MockEffectRuntime : public NullEffectRuntime
+	{
+	public:
+		MockEffectRuntime();
+
+		// Returns the index of the new uniform. 'source' adds the annotation the addon binds by.
+		size_t add_uniform(const std::string &effect, const std::string &name, format base_type, uint32_t rows, uint32_t columns = 1, uint32_t array_length = 0, const std::string &source = std::string());
+		size_t add_technique(const std::string &effect, const std::string &name);
+
+		MockUniform *find(const std::string &name);
+		const MockUniform *find(const std::string &name) const;
+		const std::vector<MockUniform> &get_uniforms() const { return uniforms; }
+
+		// set_uniform_value_* calls
+		uint64_t uniform_writes = 0;
+
+		NullDevice device;
+		NullCommandQueue queue;
+		NullCommandList cmd_list;
+
+		// Calls made to the runtime, its device, queue and command list together
+		uint64_t total_calls() const { return calls + device.calls + queue.calls + cmd_list.calls; }
+
+		command_queue *get_command_queue() override;
+
+		void enumerate_uniform_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_uniform_variable variable, void *user_data), void *user_data) override;
+		effect_uniform_variable find_uniform_variable(const char *effect_name, const char *variable_name) const override;
+		void get_uniform_variable_type(effect_uniform_variable variable, format *out_base_type, uint32_t *out_rows = nullptr, uint32_t *out_columns = nullptr, uint32_t *out_array_length = nullptr) const override;
+		void get_uniform_variable_name(effect_uniform_variable variable, char *name, size_t *name_size) const override;
+		void get_uniform_variable_effect_name(effect_uniform_variable variable, char *effect_name, size_t *effect_name_size) const override;
+		bool get_annotation_string_from_uniform_variable(effect_uniform_variable variable, const char *name, char *value, size_t *value_size) const override;
+
+		void get_uniform_value_bool(effect_uniform_variable variable, bool *values, size_t count, size_t array_index = 0) const override;
+		void get_uniform_value_float(effect_uniform_variable variable, float *values, size_t count, size_t array_index = 0) const override;
+		void get_uniform_value_int(effect_uniform_variable variable, int32_t *values, size_t count, size_t array_index = 0) const override;
+		void get_uniform_value_uint(effect_uniform_variable variable, uint32_t *values, size_t count, size_t array_index = 0) const override;
+		void set_uniform_value_bool(effect_uniform_variable variable, const bool *values, size_t count, size_t array_index = 0) override;
+		void set_uniform_value_float(effect_uniform_variable variable, const float *values, size_t count, size_t array_index = 0) override;
+		void set_uniform_value_int(effect_uniform_variable variable, const int32_t *values, size_t count, size_t array_index = 0) override;
+		void set_uniform_value_uint(effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index = 0) override;
+
+		void enumerate_techniques(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_technique technique, void *user_data), void *user_data) override;
+		effect_technique find_technique(const char *effect_name, const char *technique_name) override;
+		void get_technique_name(effect_technique technique, char *name, size_t *name_size) const override;
+		void get_technique_effect_name(effect_technique technique, char *effect_name, size_t *effect_name_size) const override;
+		bool get_technique_state(effect_technique technique) const override;
+		void set_technique_state(effect_technique technique, bool enabled) override;
+
+		bool get_preprocessor_definition(const char *name, char *value, size_t *value_size) const override;
+		void set_preprocessor_definition(const char *name, const char *value) override;
+
+	private:
+		MockUniform *get(effect_uniform_variable variable);
+		const MockUniform *get(effect_uniform_variable variable) const;
+		void write(effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index);
+		void read(effect_uniform_variable variable, uint32_t *values, size_t count, size_t array_index) const;
+
+		std::vector<MockUniform> uniforms;
+		std::vector<MockTechnique> techniques;
+		std::vector<std::pair<std::string, std::string>> definitions;
+	};
+
+	// Declares the uniforms of the shipped PulseV_Volumetrics.fx (read from PULSEV_SHADER_DIR): its own
+	// and gtav.fxh's, plus the weathers.fxh layer uniforms of every weather, or the packed layer table
+	// with 'packed_layers'. 'extra_effects' more effects declare the annotated ones again, standing in
+	// for other effects that read the same values.
+	void populate_pulsev_effect(MockEffectRuntime &runtime, bool packed_layers = false, uint32_t extra_effects = 0);
+
+	struct EffectPass
+	{
+		std::string name;
+		std::string shader;                // PixelShader or ComputeShader
+		std::string render_target;         // Empty when drawing to the back buffer
+		std::vector<std::string> textures; // Read by the shader, itself or through the functions it calls
+	};
+
+	// The passes of 'technique' in the shipped PulseV_Volumetrics.fx, in the order the runtime records
+	// them, with the preprocessor conditions evaluated for 'definitions' on top of the file's defaults
+	std::vector<EffectPass> read_technique_passes(const std::string &technique, const std::vector<std::pair<std::string, std::string>> &definitions = {});
+}
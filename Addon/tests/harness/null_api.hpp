@@ -0,0 +1,243 @@
+#pragma once
+
+// Stand-ins for ReShade's device, command list, command queue, swap chain and effect runtime. Every method
+// accepts its call, counts it and returns a zero value; the mocks in mock_runtime.hpp override
+// the ones a test needs to observe.
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <reshade.hpp>
+
+namespace Harness
+{
+	using namespace reshade::api;
+	namespace api = reshade::api;
+
+	template <typename Base>
+	struct NullObject : Base
+	{
+		// Every call made through the interface, from any thread
+		mutable std::atomic<uint64_t> calls = 0;
+		// Keyed by the address of the type's guid, see pulsev_compat.hpp
+		std::map<const uint8_t *, uint64_t> private_data;
+
+		uint64_t get_native() const override { ++calls; return 0; }
+
+		void get_private_data(const uint8_t guid[16], uint64_t *data) const override
+		{
+			++calls;
+			const auto it = private_data.find(guid);
+			*data = it != private_data.end() ? it->second : 0;
+		}
+
+		void set_private_data(const uint8_t guid[16], const uint64_t data) override
+		{
+			++calls;
+			if (data != 0)
+				private_data[guid] = data;
+			else
+				private_data.erase(guid);
+		}
+	};
+
+	template <typename Base>
+	struct NullDeviceObject : NullObject<Base>
+	{
+		device *owner = nullptr;
+
+		device *get_device() override { ++this->calls; return owner; }
+	};
+
+	struct NullDevice : NullObject<device>
+	{
+		device_api get_api() const override { ++calls; return {}; }
+		bool check_capability(device_caps capability) const override { ++calls; return {}; }
+		bool check_format_support(format format, resource_usage usage) const override { ++calls; return {}; }
+		bool create_sampler(const sampler_desc &desc, sampler *out_sampler) override { ++calls; return {}; }
+		void destroy_sampler(sampler sampler) override { ++calls; }
+		bool create_resource(const resource_desc &desc, const subresource_data *initial_data, resource_usage initial_state, resource *out_resource, void **shared_handle = nullptr) override { ++calls; return {}; }
+		void destroy_resource(resource resource) override { ++calls; }
+		resource_desc get_resource_desc(resource resource) const override { ++calls; return {}; }
+		bool create_resource_view(resource resource, resource_usage usage_type, const resource_view_desc &desc, resource_view *out_view) override { ++calls; return {}; }
+		void destroy_resource_view(resource_view view) override { ++calls; }
+		resource get_resource_from_view(resource_view view) const override { ++calls; return {}; }
+		resource_view_desc get_resource_view_desc(resource_view view) const override { ++calls; return {}; }
+		bool map_buffer_region(resource resource, uint64_t offset, uint64_t size, map_access access, void **out_data) override { ++calls; return {}; }
+		void unmap_buffer_region(resource resource) override { ++calls; }
+		bool map_texture_region(resource resource, uint32_t subresource, const subresource_box *box, map_access access, subresource_data *out_data) override { ++calls; return {}; }
+		void unmap_texture_region(resource resource, uint32_t subresource) override { ++calls; }
+		void update_buffer_region(const void *data, resource resource, uint64_t offset, uint64_t size) override { ++calls; }
+		void update_texture_region(const subresource_data &data, resource resource, uint32_t subresource, const subresource_box *box = nullptr) override { ++calls; }
+		bool create_pipeline(pipeline_layout layout, uint32_t subobject_count, const pipeline_subobject *subobjects, pipeline *out_pipeline) override { ++calls; return {}; }
+		void destroy_pipeline(pipeline pipeline) override { ++calls; }
+		bool create_pipeline_layout(uint32_t param_count, const pipeline_layout_param *params, pipeline_layout *out_layout) override { ++calls; return {}; }
+		void destroy_pipeline_layout(pipeline_layout layout) override { ++calls; }
+		bool allocate_descriptor_tables(uint32_t count, pipeline_layout layout, uint32_t param, descriptor_table *out_tables) override { ++calls; return {}; }
+		void free_descriptor_tables(uint32_t count, const descriptor_table *tables) override { ++calls; }
+		void get_descriptor_heap_offset(descriptor_table table, uint32_t binding, uint32_t array_offset, descriptor_heap *out_heap, uint32_t *out_offset) const override { ++calls; }
+		void copy_descriptor_tables(uint32_t count, const descriptor_table_copy *copies) override { ++calls; }
+		void update_descriptor_tables(uint32_t count, const descriptor_table_update *updates) override { ++calls; }
+		bool create_query_heap(query_type type, uint32_t count, query_heap *out_heap) override { ++calls; return {}; }
+		void destroy_query_heap(query_heap heap) override { ++calls; }
+		bool get_query_heap_results(query_heap heap, uint32_t first, uint32_t count, void *results, uint32_t stride) override { ++calls; return {}; }
+		void set_resource_name(resource resource, const char *name) override { ++calls; }
+		void set_resource_view_name(resource_view view, const char *name) override { ++calls; }
+		bool create_fence(uint64_t initial_value, fence_flags flags, fence *out_fence, void **shared_handle = nullptr) override { ++calls; return {}; }
+		void destroy_fence(fence fence) override { ++calls; }
+		uint64_t get_completed_fence_value(fence fence) const override { ++calls; return {}; }
+		bool wait(fence fence, uint64_t value, uint64_t timeout = UINT64_MAX) override { ++calls; return {}; }
+		bool signal(fence fence, uint64_t value) override { ++calls; return {}; }
+		bool get_property(device_properties property, void *data) const override { ++calls; return {}; }
+		uint64_t get_resource_view_gpu_address(resource_view view) const override { ++calls; return {}; }
+		void get_acceleration_structure_size(acceleration_structure_type type, acceleration_structure_build_flags flags, uint32_t input_count, const acceleration_structure_build_input *inputs, uint64_t *out_size, uint64_t *out_build_scratch_size, uint64_t *out_update_scratch_size) const override { ++calls; }
+		bool get_pipeline_shader_group_handles(pipeline pipeline, uint32_t first, uint32_t count, void *out_handles) override { ++calls; return {}; }
+	};
+
+	struct NullCommandList : NullDeviceObject<command_list>
+	{
+		void barrier(uint32_t count, const resource *resources, const resource_usage *old_states, const resource_usage *new_states) override { ++calls; }
+		void begin_render_pass(uint32_t count, const render_pass_render_target_desc *rts, const render_pass_depth_stencil_desc *ds = nullptr) override { ++calls; }
+		void end_render_pass() override { ++calls; }
+		void bind_render_targets_and_depth_stencil(uint32_t count, const resource_view *rtvs, resource_view dsv = { 0 }) override { ++calls; }
+		void bind_pipeline(pipeline_stage stages, pipeline pipeline) override { ++calls; }
+		void bind_pipeline_states(uint32_t count, const dynamic_state *states, const uint32_t *values) override { ++calls; }
+		void bind_viewports(uint32_t first, uint32_t count, const viewport *viewports) override { ++calls; }
+		void bind_scissor_rects(uint32_t first, uint32_t count, const rect *rects) override { ++calls; }
+		void push_constants(shader_stage stages, pipeline_layout layout, uint32_t param, uint32_t first, uint32_t count, const void *values) override { ++calls; }
+		void push_descriptors(shader_stage stages, pipeline_layout layout, uint32_t param, const descriptor_table_update &update) override { ++calls; }
+		void bind_descriptor_tables(shader_stage stages, pipeline_layout layout, uint32_t first, uint32_t count, const descriptor_table *tables) override { ++calls; }
+		void bind_index_buffer(resource buffer, uint64_t offset, uint32_t index_size) override { ++calls; }
+		void bind_vertex_buffers(uint32_t first, uint32_t count, const resource *buffers, const uint64_t *offsets, const uint32_t *strides) override { ++calls; }
+		void bind_stream_output_buffers(uint32_t first, uint32_t count, const api::resource *buffers, const uint64_t *offsets, const uint64_t *max_sizes, const api::resource *counter_buffers, const uint64_t *counter_offsets) override { ++calls; }
+		void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance) override { ++calls; }
+		void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance) override { ++calls; }
+		void dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) override { ++calls; }
+		void draw_or_dispatch_indirect(indirect_command type, resource buffer, uint64_t offset, uint32_t draw_count, uint32_t stride) override { ++calls; }
+		void copy_resource(resource source, resource dest) override { ++calls; }
+		void copy_buffer_region(resource source, uint64_t source_offset, resource dest, uint64_t dest_offset, uint64_t size) override { ++calls; }
+		void copy_buffer_to_texture(resource source, uint64_t source_offset, uint32_t row_length, uint32_t slice_height, resource dest, uint32_t dest_subresource, const subresource_box *dest_box = nullptr) override { ++calls; }
+		void copy_texture_region(resource source, uint32_t source_subresource, const subresource_box *source_box, resource dest, uint32_t dest_subresource, const subresource_box *dest_box, filter_mode filter = filter_mode::min_mag_mip_point) override { ++calls; }
+		void copy_texture_to_buffer(resource source, uint32_t source_subresource, const subresource_box *source_box, resource dest, uint64_t dest_offset, uint32_t row_length = 0, uint32_t slice_height = 0) override { ++calls; }
+		void resolve_texture_region(resource source, uint32_t source_subresource, const subresource_box *source_box, resource dest, uint32_t dest_subresource, uint32_t dest_x, uint32_t dest_y, uint32_t dest_z, format format) override { ++calls; }
+		void clear_depth_stencil_view(resource_view dsv, const float *depth, const uint8_t *stencil, uint32_t rect_count = 0, const rect *rects = nullptr) override { ++calls; }
+		void clear_render_target_view(resource_view rtv, const float color[4], uint32_t rect_count = 0, const rect *rects = nullptr) override { ++calls; }
+		void clear_unordered_access_view_uint(resource_view uav, const uint32_t values[4], uint32_t rect_count = 0, const rect *rects = nullptr) override { ++calls; }
+		void clear_unordered_access_view_float(resource_view uav, const   float values[4], uint32_t rect_count = 0, const rect *rects = nullptr) override { ++calls; }
+		void generate_mipmaps(resource_view srv) override { ++calls; }
+		void begin_query(query_heap heap, query_type type, uint32_t index) override { ++calls; }
+		void end_query(query_heap heap, query_type type, uint32_t index) override { ++calls; }
+		void copy_query_heap_results(query_heap heap, query_type type, uint32_t first, uint32_t count, resource dest, uint64_t dest_offset, uint32_t stride) override { ++calls; }
+		void begin_debug_event(const char *label, const float color[4] = nullptr) override { ++calls; }
+		void end_debug_event() override { ++calls; }
+		void insert_debug_marker(const char *label, const float color[4] = nullptr) override { ++calls; }
+		void dispatch_mesh(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) override { ++calls; }
+		void dispatch_rays(resource raygen, uint64_t raygen_offset, uint64_t raygen_size, resource miss, uint64_t miss_offset, uint64_t miss_size, uint64_t miss_stride, resource hit_group, uint64_t hit_group_offset, uint64_t hit_group_size, uint64_t hit_group_stride, resource callable, uint64_t callable_offset, uint64_t callable_size, uint64_t callable_stride, uint32_t width, uint32_t height, uint32_t depth) override { ++calls; }
+		void copy_acceleration_structure(resource_view source, resource_view dest, acceleration_structure_copy_mode mode) override { ++calls; }
+		void build_acceleration_structure(acceleration_structure_type type, acceleration_structure_build_flags flags, uint32_t input_count, const acceleration_structure_build_input *inputs, api::resource scratch, uint64_t scratch_offset, resource_view source, resource_view dest, acceleration_structure_build_mode mode) override { ++calls; }
+		void query_acceleration_structures(uint32_t count, const resource_view *acceleration_structures, query_heap heap, query_type type, uint32_t first) override { ++calls; }
+	};
+
+	struct NullCommandQueue : NullDeviceObject<command_queue>
+	{
+		command_queue_type get_type() const override { ++calls; return {}; }
+		void wait_idle() const override { ++calls; }
+		void flush_immediate_command_list() const override { ++calls; }
+		command_list *get_immediate_command_list() override { ++calls; return {}; }
+		void begin_debug_event(const char *label, const float color[4] = nullptr) override { ++calls; }
+		void end_debug_event() override { ++calls; }
+		void insert_debug_marker(const char *label, const float color[4] = nullptr) override { ++calls; }
+		bool wait(fence fence, uint64_t value) override { ++calls; return {}; }
+		bool signal(fence fence, uint64_t value) override { ++calls; return {}; }
+		uint64_t get_timestamp_frequency() const override { ++calls; return {}; }
+	};
+
+	struct NullSwapchain : NullDeviceObject<swapchain>
+	{
+		void *get_hwnd() const override { ++calls; return {}; }
+		resource get_back_buffer(uint32_t index) override { ++calls; return {}; }
+		uint32_t get_back_buffer_count() const override { ++calls; return {}; }
+		uint32_t get_current_back_buffer_index() const override { ++calls; return {}; }
+		bool check_color_space_support(color_space color_space) const override { ++calls; return {}; }
+		color_space get_color_space() const override { ++calls; return {}; }
+	};
+
+	struct NullEffectRuntime : NullDeviceObject<effect_runtime>
+	{
+		void *get_hwnd() const override { ++calls; return {}; }
+		resource get_back_buffer(uint32_t index) override { ++calls; return {}; }
+		uint32_t get_back_buffer_count() const override { ++calls; return {}; }
+		uint32_t get_current_back_buffer_index() const override { ++calls; return {}; }
+		command_queue *get_command_queue() override { ++calls; return {}; }
+		void render_effects(command_list *cmd_list, resource_view rtv, resource_view rtv_srgb) override { ++calls; }
+		bool capture_screenshot(void *pixels) override { ++calls; return {}; }
+		void get_screenshot_width_and_height(uint32_t *out_width, uint32_t *out_height) const override { ++calls; }
+		bool is_key_down(uint32_t keycode) const override { ++calls; return {}; }
+		bool is_key_pressed(uint32_t keycode) const override { ++calls; return {}; }
+		bool is_key_released(uint32_t keycode) const override { ++calls; return {}; }
+		bool is_mouse_button_down(uint32_t button) const override { ++calls; return {}; }
+		bool is_mouse_button_pressed(uint32_t button) const override { ++calls; return {}; }
+		bool is_mouse_button_released(uint32_t button) const override { ++calls; return {}; }
+		void get_mouse_cursor_position(uint32_t *out_x, uint32_t *out_y, int16_t *out_wheel_delta = nullptr) const override { ++calls; }
+		void enumerate_uniform_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_uniform_variable variable, void *user_data), void *user_data) override { ++calls; }
+		effect_uniform_variable find_uniform_variable(const char *effect_name, const char *variable_name) const override { ++calls; return {}; }
+		void get_uniform_variable_type(effect_uniform_variable variable, format *out_base_type, uint32_t *out_rows = nullptr, uint32_t *out_columns = nullptr, uint32_t *out_array_length = nullptr) const override { ++calls; }
+		void get_uniform_variable_name(effect_uniform_variable variable, char *name, size_t *name_size) const override { ++calls; }
+		bool get_annotation_bool_from_uniform_variable(effect_uniform_variable variable, const char *name, bool *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_float_from_uniform_variable(effect_uniform_variable variable, const char *name, float *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_int_from_uniform_variable(effect_uniform_variable variable, const char *name, int32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_uint_from_uniform_variable(effect_uniform_variable variable, const char *name, uint32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_string_from_uniform_variable(effect_uniform_variable variable, const char *name, char *value, size_t *value_size) const override { ++calls; return {}; }
+		void get_uniform_value_bool(effect_uniform_variable variable, bool *values, size_t count, size_t array_index = 0) const override { ++calls; }
+		void get_uniform_value_float(effect_uniform_variable variable, float *values, size_t count, size_t array_index = 0) const override { ++calls; }
+		void get_uniform_value_int(effect_uniform_variable variable, int32_t *values, size_t count, size_t array_index = 0) const override { ++calls; }
+		void get_uniform_value_uint(effect_uniform_variable variable, uint32_t *values, size_t count, size_t array_index = 0) const override { ++calls; }
+		void set_uniform_value_bool(effect_uniform_variable variable, const bool *values, size_t count, size_t array_index = 0) override { ++calls; }
+		void set_uniform_value_float(effect_uniform_variable variable, const float *values, size_t count, size_t array_index = 0) override { ++calls; }
+		void set_uniform_value_int(effect_uniform_variable variable, const int32_t *values, size_t count, size_t array_index = 0) override { ++calls; }
+		void set_uniform_value_uint(effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index = 0) override { ++calls; }
+		void enumerate_texture_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_texture_variable variable, void *user_data), void *user_data) override { ++calls; }
+		effect_texture_variable find_texture_variable(const char *effect_name, const char *variable_name) const override { ++calls; return {}; }
+		void get_texture_variable_name(effect_texture_variable variable, char *name, size_t *name_size) const override { ++calls; }
+		bool get_annotation_bool_from_texture_variable(effect_texture_variable variable, const char *name, bool *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_float_from_texture_variable(effect_texture_variable variable, const char *name, float *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_int_from_texture_variable(effect_texture_variable variable, const char *name, int32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_uint_from_texture_variable(effect_texture_variable variable, const char *name, uint32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_string_from_texture_variable(effect_texture_variable variable, const char *name, char *value, size_t *value_size) const override { ++calls; return {}; }
+		void update_texture(effect_texture_variable variable, const uint32_t width, const uint32_t height, const void *pixels) override { ++calls; }
+		void get_texture_binding(effect_texture_variable variable, resource_view *out_srv, resource_view *out_srv_srgb) const override { ++calls; }
+		void update_texture_bindings(const char *semantic, resource_view srv, resource_view srv_srgb) override { ++calls; }
+		void enumerate_techniques(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_technique technique, void *user_data), void *user_data) override { ++calls; }
+		effect_technique find_technique(const char *effect_name, const char *technique_name) override { ++calls; return {}; }
+		void get_technique_name(effect_technique technique, char *name, size_t *name_size) const override { ++calls; }
+		bool get_annotation_bool_from_technique(effect_technique technique, const char *name, bool *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_float_from_technique(effect_technique technique, const char *name, float *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_int_from_technique(effect_technique technique, const char *name, int32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_uint_from_technique(effect_technique technique, const char *name, uint32_t *values, size_t count, size_t array_index = 0) const override { ++calls; return {}; }
+		bool get_annotation_string_from_technique(effect_technique technique, const char *name, char *value, size_t *value_size) const override { ++calls; return {}; }
+		bool get_technique_state(effect_technique technique) const override { ++calls; return {}; }
+		void set_technique_state(effect_technique technique, bool enabled) override { ++calls; }
+		bool get_preprocessor_definition(const char *name, char *value, size_t *value_size) const override { ++calls; return {}; }
+		void set_preprocessor_definition(const char *name, const char *value) override { ++calls; }
+		void render_technique(effect_technique technique, command_list *cmd_list, resource_view rtv, resource_view rtv_srgb = { 0 }) override { ++calls; }
+		bool get_effects_state() const override { ++calls; return {}; }
+		void set_effects_state(bool enabled) override { ++calls; }
+		void get_current_preset_path(char *path, size_t *path_size) const override { ++calls; }
+		void set_current_preset_path(const char *path) override { ++calls; }
+		void reorder_techniques(size_t count, const effect_technique *techniques) override { ++calls; }
+		void block_input_next_frame() override { ++calls; }
+		uint32_t last_key_pressed() const override { ++calls; return {}; }
+		uint32_t last_key_released() const override { ++calls; return {}; }
+		void get_uniform_variable_effect_name(effect_uniform_variable variable, char *effect_name, size_t *effect_name_size) const override { ++calls; }
+		void get_texture_variable_effect_name(effect_texture_variable variable, char *effect_name, size_t *effect_name_size) const override { ++calls; }
+		void get_technique_effect_name(effect_technique technique, char *effect_name, size_t *effect_name_size) const override { ++calls; }
+		void save_current_preset() const override { ++calls; }
+		bool get_preprocessor_definition_for_effect(const char *effect_name, const char *name, char *value, size_t *value_size) const override { ++calls; return {}; }
+		void set_preprocessor_definition_for_effect(const char *effect_name, const char *name, const char *value) override { ++calls; }
+		bool open_overlay(bool open, input_source source) override { ++calls; return {}; }
+		void set_color_space(color_space color_space) override { ++calls; }
+		void reset_uniform_value(effect_uniform_variable variable) override { ++calls; }
+		void reload_effect_next_frame(const char *effect_name) override { ++calls; }
+		void export_current_preset(const char *path) const override { ++calls; }
+	};
+}
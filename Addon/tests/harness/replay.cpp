@@ -0,0 +1,46 @@
+#include "replay.hpp"
+#include "data_reader.hpp"
+#include "injection.hpp"
+#include "mock_runtime.hpp"
+#include "temporal.hpp"
+#include "trace_source.hpp"
+
+Harness::ReplayResult Harness::replay_trace(const std::string &trace_path, const ReplayOptions &options)
+{
+	ReplayResult result;
+
+	Trace::ReplayDataSource source(trace_path, options.realtime);
+	if (!source.is_open())
+		return result;
+
+	MockEffectRuntime runtime;
+	populate_pulsev_effect(runtime, options.packed_layers);
+
+	UniformCapture::Writer capture;
+	if (!options.capture_path.empty() && !capture.open(options.capture_path, options.max_frames))
+		return result;
+
+	// Frame indices and jitter start over as in a newly loaded addon
+	Temporal::configure();
+
+	pv::clouds::CloudsState clouds;
+	clouds.rt = &runtime;
+	clouds.has_runtime = true;
+
+	DataReader::register_data_reader(nullptr, &source);
+
+	while (!source.finished() && (options.max_frames == 0 || result.frames < options.max_frames))
+	{
+		DataReader::step();
+		Injection::inject_frame(&runtime, clouds, source.tick_seconds(), capture);
+		result.frames++;
+	}
+
+	DataReader::unregister_data_reader(nullptr);
+	capture.close();
+
+	result.ok = true;
+	result.ticks = source.tick_count();
+	result.uniform_writes = runtime.uniform_writes;
+	return result;
+}
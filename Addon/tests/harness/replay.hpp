@@ -0,0 +1,28 @@
+#pragma once
+
+// Headless replay of a recorded trace: every tick goes through the reader and the uniform injection
+// into a mock runtime declaring the shipped effect's uniforms, as the addon does once per frame
+
+#include <cstdint>
+#include <string>
+
+namespace Harness
+{
+	struct ReplayOptions
+	{
+		std::string capture_path;   // Writes the injected values of every frame when set
+		uint32_t max_frames = 0;    // 0 replays the whole trace
+		bool packed_layers = false; // Declares cloudPackedLayers instead of the per-weather layer uniforms
+		bool realtime = false;      // At the recorded pace instead of as fast as possible
+	};
+
+	struct ReplayResult
+	{
+		bool ok = false;
+		uint32_t frames = 0;
+		uint64_t ticks = 0;
+		uint64_t uniform_writes = 0;
+	};
+
+	ReplayResult replay_trace(const std::string &trace_path, const ReplayOptions &options);
+}
@@ -0,0 +1,168 @@
+#include "reshade_host.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+static std::mutex host_mutex;
+static std::map<std::pair<std::string, std::string>, std::string> config;
+static std::vector<Harness::LogLine> log_lines;
+static std::vector<std::pair<reshade::addon_event, void *>> events;
+
+void Harness::set_config(const std::string &section, const std::string &key, const std::string &value)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	config[{ section, key }] = value;
+}
+
+void Harness::clear_config()
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	config.clear();
+}
+
+const std::vector<Harness::LogLine> &Harness::get_log()
+{
+	return log_lines;
+}
+
+void Harness::clear_log()
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	log_lines.clear();
+}
+
+size_t Harness::count_log(const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	return std::count_if(log_lines.begin(), log_lines.end(), [&text](const LogLine &line) { return line.message.find(text) != std::string::npos; });
+}
+
+std::vector<void *> Harness::get_event_callbacks(reshade::addon_event ev)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	std::vector<void *> callbacks;
+	for (const auto &event : events)
+	{
+		if (event.first == ev)
+			callbacks.push_back(event.second);
+	}
+	return callbacks;
+}
+
+/**
+* Exports
+**/
+
+extern "C" void ReShadeLogMessage(HMODULE, int level, const char *message)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	log_lines.push_back({ level, message });
+}
+
+extern "C" void ReShadeGetBasePath(char *path, size_t *path_size)
+{
+	static const char base[] = ".";
+	if (path == nullptr)
+	{
+		*path_size = sizeof(base);
+		return;
+	}
+	const size_t length = std::min(*path_size, sizeof(base));
+	std::memcpy(path, base, length);
+	*path_size = length;
+}
+
+extern "C" bool ReShadeGetConfigValue(HMODULE, reshade::api::effect_runtime *, const char *section, const char *key, char *value, size_t *value_size)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	const auto it = config.find({ section != nullptr ? section : "", key });
+	if (it == config.end())
+		return false;
+
+	if (value == nullptr)
+	{
+		*value_size = it->second.size() + 1;
+		return true;
+	}
+
+	const size_t length = std::min(it->second.size(), *value_size - 1);
+	std::memcpy(value, it->second.data(), length);
+	value[length] = '\0';
+	*value_size = length + 1;
+	return true;
+}
+
+extern "C" void ReShadeSetConfigValue(HMODULE, reshade::api::effect_runtime *, const char *section, const char *key, const char *value)
+{
+	Harness::set_config(section != nullptr ? section : "", key, value != nullptr ? value : "");
+}
+
+extern "C" void ReShadeSetConfigArray(HMODULE, reshade::api::effect_runtime *, const char *section, const char *key, const char *value, size_t value_size)
+{
+	Harness::set_config(section != nullptr ? section : "", key, std::string(value, value_size));
+}
+
+extern "C" bool ReShadeRegisterAddon(HMODULE, uint32_t)
+{
+	return true;
+}
+
+extern "C" void ReShadeUnregisterAddon(HMODULE)
+{
+}
+
+extern "C" void ReShadeRegisterEvent(reshade::addon_event ev, void *callback)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	events.emplace_back(ev, callback);
+}
+
+extern "C" void ReShadeRegisterEventForAddon(HMODULE, reshade::addon_event ev, void *callback)
+{
+	ReShadeRegisterEvent(ev, callback);
+}
+
+extern "C" void ReShadeUnregisterEvent(reshade::addon_event ev, void *callback)
+{
+	std::lock_guard<std::mutex> lock(host_mutex);
+	const auto it = std::find(events.begin(), events.end(), std::make_pair(ev, callback));
+	if (it != events.end())
+		events.erase(it);
+}
+
+extern "C" void ReShadeUnregisterEventForAddon(HMODULE, reshade::addon_event ev, void *callback)
+{
+	ReShadeUnregisterEvent(ev, callback);
+}
+
+extern "C" void ReShadeRegisterOverlay(const char *, void(*)(reshade::api::effect_runtime *))
+{
+}
+
+extern "C" void ReShadeRegisterOverlayForAddon(HMODULE, const char *, void(*)(reshade::api::effect_runtime *))
+{
+}
+
+extern "C" void ReShadeUnregisterOverlay(const char *, void(*)(reshade::api::effect_runtime *))
+{
+}
+
+extern "C" void ReShadeUnregisterOverlayForAddon(HMODULE, const char *, void(*)(reshade::api::effect_runtime *))
+{
+}
+
+extern "C" bool ReShadeCreateEffectRuntime(reshade::api::device_api, void *, void *, void *, const char *, reshade::api::effect_runtime **out_runtime)
+{
+	*out_runtime = nullptr;
+	return false;
+}
+
+extern "C" void ReShadeDestroyEffectRuntime(reshade::api::effect_runtime *)
+{
+}
+
+extern "C" void ReShadeUpdateAndPresentEffectRuntime(reshade::api::effect_runtime *)
+{
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// The ReShade side of the exports the addon imports when built with RESHADE_API_LIBRARY: an
+// in-memory config, a captured log and the registered event callbacks.
+
+#include <reshade.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Harness
+{
+	struct LogLine
+	{
+		int level;
+		std::string message;
+	};
+
+	void set_config(const std::string &section, const std::string &key, const std::string &value);
+	void clear_config();
+
+	const std::vector<LogLine> &get_log();
+	void clear_log();
+	// Number of logged lines containing 'text'
+	size_t count_log(const std::string &text);
+
+	// Callbacks registered for 'ev', in registration order
+	std::vector<void *> get_event_callbacks(reshade::addon_event ev);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// A DataSource whose values the test sets directly, laid out like the state a trace replays
+
+#include "trace_source.hpp"
+
+#include <string>
+
+namespace Harness
+{
+	struct ScriptedSource : DataSource
+	{
+		Trace::State state;
+		void(*script)() = nullptr;
+		uint64_t updates = 0;
+
+		ScriptedSource()
+		{
+			state.resolution = { { 1920, 1080 } };
+			state.cam_fov = 50.0f;
+			state.cam_near_clip = 0.15f;
+			state.cam_far_clip = 10000.0f;
+			state.time = 12.0f;
+			state.weather_frame.floats["sun_hdr"] = 1.0f;
+			state.weather_frame.colors["sun_color"] = { { 1.0f, 0.9f, 0.8f, 1.0f } };
+		}
+
+		const std::string_view get_region_name(int region) override { return "GLOBAL"; }
+		const std::string_view get_weather_name(int weather) override { return "CLEAR"; }
+		const bool get_depth_reversed() override { return state.depth_reversed; }
+		const UInt2 get_resolution() override { return state.resolution; }
+		const Float3 get_cam_pos() override { return state.cam_pos; }
+		const Float3 get_cam_rot() override { return state.cam_rot; }
+		const float get_cam_fov() override { return state.cam_fov; }
+		const float get_cam_near_clip() override { return state.cam_near_clip; }
+		const float get_cam_far_clip() override { return state.cam_far_clip; }
+		const float get_time() override { return state.time; }
+		const float get_time_scale() override { return state.time_scale; }
+		const int get_region(const Float3 &pos) override { return state.region; }
+		const int get_weather_from() override { return state.weather_from; }
+		const int get_weather_to() override { return state.weather_to; }
+		const float get_weather_transition() override { return state.weather_transition; }
+		const TimeCycle::WeatherFrame get_weather_frame(TimeCycle::RegionalWeather &from, TimeCycle::RegionalWeather &to, float time, float transition_progress) override { return state.weather_frame; }
+		const bool get_aurora_visibility() override { return state.aurora_visibility; }
+		const Float3 get_moon_dir() override { return state.moon_dir; }
+		void load_timecycle() override {}
+		void wait(DWORD time) override {}
+		void update() override { updates++; }
+		void register_script(HMODULE hModule, void(*entry)()) override { script = entry; }
+		void unregister_script(HMODULE hModule) override { script = nullptr; }
+	};
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+// A device and command list that keep just enough state to observe the addon's GPU work: timestamp
+// queries are written with the command list's clock and become readable a set number of frames
+// later, the way a GPU running behind the CPU returns them, and resources and views are handles
+// to the descriptions they were created with. The resource and view calls may come from several
+// threads at once.
+
+#include "mock_runtime.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Harness
+{
+	struct StubDevice : NullDevice
+	{
+		device_api api = device_api::vulkan;
+		// Whether multisampled depth-stencils can be resolved
+		bool resolve_depth_stencil = false;
+
+		// Frame of the CPU, advanced by the test
+		uint64_t frame = 0;
+		// Frames after which a written query can be read back
+		uint64_t latency = 1;
+
+		uint32_t heaps_created = 0;
+		uint32_t heaps_destroyed = 0;
+		uint32_t result_reads = 0;
+
+		std::vector<uint64_t> query_values;
+		std::vector<uint64_t> query_frames; // Frame each query was last written in, UINT64_MAX before that
+
+		// Created through the device, not counting those the test added itself
+		uint32_t resources_created = 0;
+		uint32_t resources_destroyed = 0;
+		uint32_t views_created = 0;
+		uint32_t views_destroyed = 0;
+
+		// Guards the resources, views and their counters
+		mutable std::mutex mutex;
+		std::unordered_map<uint64_t, resource_desc> resources;
+		std::unordered_map<uint64_t, resource> views;
+		uint64_t next_handle = 0x1000;
+
+		// A resource the application created, which the addon did not see being created
+		resource add_resource(const resource_desc &desc)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			const resource resource = { next_handle += 0x10 };
+			resources.emplace(resource.handle, desc);
+			return resource;
+		}
+		resource_view add_view(resource resource)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			const resource_view view = { next_handle += 0x10 };
+			views.emplace(view.handle, resource);
+			return view;
+		}
+
+		device_api get_api() const override { ++calls; return api; }
+		bool check_capability(device_caps capability) const override { ++calls; return capability == device_caps::resolve_depth_stencil && resolve_depth_stencil; }
+
+		bool create_resource(const resource_desc &desc, const subresource_data *initial_data, resource_usage initial_state, resource *out_resource, void **shared_handle = nullptr) override
+		{
+			++calls;
+			*out_resource = add_resource(desc);
+			const std::lock_guard<std::mutex> lock(mutex);
+			resources_created++;
+			return true;
+		}
+		void destroy_resource(resource resource) override
+		{
+			++calls;
+			if (resource == 0)
+				return;
+			const std::lock_guard<std::mutex> lock(mutex);
+			resources_destroyed++;
+			resources.erase(resource.handle);
+		}
+		resource_desc get_resource_desc(resource resource) const override
+		{
+			++calls;
+			const std::lock_guard<std::mutex> lock(mutex);
+			const auto it = resources.find(resource.handle);
+			return it != resources.end() ? it->second : resource_desc {};
+		}
+
+		bool create_resource_view(resource resource, resource_usage usage_type, const resource_view_desc &desc, resource_view *out_view) override
+		{
+			++calls;
+			*out_view = add_view(resource);
+			const std::lock_guard<std::mutex> lock(mutex);
+			views_created++;
+			return true;
+		}
+		void destroy_resource_view(resource_view view) override
+		{
+			++calls;
+			if (view == 0)
+				return;
+			const std::lock_guard<std::mutex> lock(mutex);
+			views_destroyed++;
+			views.erase(view.handle);
+		}
+		resource get_resource_from_view(resource_view view) const override
+		{
+			++calls;
+			const std::lock_guard<std::mutex> lock(mutex);
+			const auto it = views.find(view.handle);
+			return it != views.end() ? it->second : resource { 0 };
+		}
+
+		bool create_query_heap(query_type type, uint32_t count, query_heap *out_heap) override
+		{
+			++calls;
+			query_values.assign(count, 0);
+			query_frames.assign(count, UINT64_MAX);
+			heaps_created++;
+			*out_heap = { heaps_created };
+			return true;
+		}
+
+		void destroy_query_heap(query_heap heap) override
+		{
+			++calls;
+			heaps_destroyed++;
+		}
+
+		bool get_query_heap_results(query_heap heap, uint32_t first, uint32_t count, void *results, uint32_t stride) override
+		{
+			++calls;
+			result_reads++;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				if (i >= query_frames.size() || query_frames[i] == UINT64_MAX || query_frames[i] + latency > frame)
+					return false;
+			}
+			for (uint32_t i = 0; i < count; ++i)
+				*reinterpret_cast<uint64_t *>(static_cast<uint8_t *>(results) + i * stride) = query_values[first + i];
+			return true;
+		}
+	};
+
+	struct StubCommandList : NullCommandList
+	{
+		// GPU ticks, what the next timestamp query writes
+		uint64_t clock = 0;
+		// Indices of the timestamp queries written, in order
+		std::vector<uint32_t> queries;
+
+		void end_query(query_heap heap, query_type type, uint32_t index) override
+		{
+			++calls;
+			StubDevice *const device = static_cast<StubDevice *>(owner);
+			device->query_values[index] = clock;
+			device->query_frames[index] = device->frame;
+			queries.push_back(index);
+		}
+	};
+
+	struct StubCommandQueue : NullCommandQueue
+	{
+		uint64_t frequency = 1000000;
+
+		command_queue_type get_type() const override { ++calls; return command_queue_type::graphics | command_queue_type::compute | command_queue_type::copy; }
+		uint64_t get_timestamp_frequency() const override { ++calls; return frequency; }
+	};
+
+	struct StubSwapchain : NullSwapchain
+	{
+		resource back_buffer = { 0 };
+
+		resource get_back_buffer(uint32_t index) override { ++calls; return back_buffer; }
+		uint32_t get_back_buffer_count() const override { ++calls; return 1; }
+	};
+
+	// The mock effect runtime on top of the stub device, presenting to a swap chain of the given size
+	class StubEffectRuntime : public MockEffectRuntime
+	{
+	public:
+		StubEffectRuntime(uint32_t width = 1920, uint32_t height = 1080) : width(width), height(height)
+		{
+			owner = &stub_device;
+			stub_queue.owner = &stub_device;
+			stub_cmd_list.owner = &stub_device;
+			stub_swapchain.owner = &stub_device;
+
+			stub_swapchain.back_buffer = stub_device.add_resource(resource_desc(width, height, 1, 1, format::r8g8b8a8_unorm, 1, memory_heap::gpu_only, resource_usage::render_target));
+		}
+
+		StubDevice stub_device;
+		StubCommandQueue stub_queue;
+		StubCommandList stub_cmd_list;
+		StubSwapchain stub_swapchain;
+
+		uint32_t width;
+		uint32_t height;
+
+		command_queue *get_command_queue() override { ++calls; return &stub_queue; }
+
+		void get_screenshot_width_and_height(uint32_t *out_width, uint32_t *out_height) const override
+		{
+			++calls;
+			*out_width = width;
+			*out_height = height;
+		}
+	};
+}
@@ -0,0 +1,103 @@
+// Replays a trace recorded with [PULSEV] RecordTrace without the game, and optionally checks the
+// injected uniforms against a golden capture (from an earlier replay or [PULSEV] CaptureUniforms).
+//
+// pulsev_replay <trace> [--capture <path>] [--golden <path>] [--tolerances <ini>] [--frames <n>] [--packed] [--realtime]
+//
+//   --capture     writes the injected values of every frame, in the format of [PULSEV] CaptureUniforms
+//   --golden      diffs the replay against this capture and reports the first diverging frame
+//   --tolerances  [Tolerance] section of per-uniform tolerances for the diff, replay_tolerances.ini
+//                 next to this file ignores the values driven by the wall clock and the RNG
+//   --frames      stops after n frames instead of at the end of the trace
+//   --packed      declares cloudPackedLayers instead of the per-weather layer uniforms
+//   --realtime    replays at the recorded pace instead of as fast as possible
+//
+// Exits with 0 on success or a match, 1 on a mismatch and 2 on bad arguments or unreadable files.
+
+#include "replay.hpp"
+#include "uniform_capture.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+static int usage()
+{
+	std::fprintf(stderr, "usage: pulsev_replay <trace> [--capture <path>] [--golden <path>] [--tolerances <ini>] [--frames <n>] [--packed] [--realtime]\n");
+	return 2;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string trace_path;
+	std::string golden_path;
+	std::string tolerances_path;
+	Harness::ReplayOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *const arg = argv[i];
+		const bool has_value = i + 1 < argc;
+
+		if (std::strcmp(arg, "--capture") == 0 && has_value)
+			options.capture_path = argv[++i];
+		else if (std::strcmp(arg, "--golden") == 0 && has_value)
+			golden_path = argv[++i];
+		else if (std::strcmp(arg, "--tolerances") == 0 && has_value)
+			tolerances_path = argv[++i];
+		else if (std::strcmp(arg, "--frames") == 0 && has_value)
+			options.max_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(arg, "--packed") == 0)
+			options.packed_layers = true;
+		else if (std::strcmp(arg, "--realtime") == 0)
+			options.realtime = true;
+		else if (arg[0] != '-' && trace_path.empty())
+			trace_path = arg;
+		else
+			return usage();
+	}
+
+	if (trace_path.empty())
+		return usage();
+
+	UniformCapture::Tolerances tolerances;
+	if (!tolerances_path.empty() && !tolerances.load(tolerances_path))
+	{
+		std::fprintf(stderr, "Failed to read tolerances %s\n", tolerances_path.c_str());
+		return 2;
+	}
+
+	// A diff needs a capture of this run, kept next to the temporary files when not asked for
+	const bool temporary_capture = !golden_path.empty() && options.capture_path.empty();
+	if (temporary_capture)
+		options.capture_path = (std::filesystem::temp_directory_path() / "pulsev_replay_capture.pvuc").string();
+
+	const Harness::ReplayResult replay = Harness::replay_trace(trace_path, options);
+	if (!replay.ok)
+	{
+		std::fprintf(stderr, "Failed to replay %s\n", trace_path.c_str());
+		return 2;
+	}
+
+	std::printf("Replayed %u frames (%llu ticks), %llu uniform writes\n", replay.frames,
+		(unsigned long long)replay.ticks, (unsigned long long)replay.uniform_writes);
+
+	if (golden_path.empty())
+		return 0;
+
+	const UniformCapture::DiffResult result = UniformCapture::diff(golden_path, options.capture_path, tolerances);
+
+	if (temporary_capture)
+	{
+		std::error_code ec;
+		std::filesystem::remove(options.capture_path, ec);
+	}
+
+	std::printf("%s\n", result.message.c_str());
+
+	if (!result.ok)
+		return 2;
+
+	return result.match ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+#include <gtest/gtest.h>
+
+#include "depth_host.hpp"
+#include "reshade_host.hpp"
+#include "stub_device.hpp"
+
+#include <atomic>
+#include <initializer_list>
+#include <thread>
+
+namespace
+{
+	struct DrawnDepthStencil
+	{
+		resource_view dsv;
+		uint32_t drawcalls;
+		uint32_t vertices_per_draw;
+	};
+
+	class DepthTest : public ::testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			// The module's settings are static, so start every test from the same ones. Locking stops
+			// the statistics of every other depth-stencil, the tests of the selection leave it off.
+			Harness::set_config("DEPTH", "LockAfterFrames", "0");
+			s_fingerprint = {};
+			s_locked_depth_stencil.store(0);
+
+			on_init_device(&runtime.stub_device);
+			on_init_command_queue(&runtime.stub_queue);
+			on_init_command_list(&runtime.stub_cmd_list);
+			on_init_depth_swapchain(&runtime.stub_swapchain, false);
+			on_init_effect_runtime(&runtime);
+		}
+
+		void TearDown() override
+		{
+			on_destroy_effect_runtime(&runtime);
+			on_destroy_command_list(&runtime.stub_cmd_list);
+			on_destroy_command_queue(&runtime.stub_queue);
+			on_destroy_device(&runtime.stub_device);
+			Harness::clear_config();
+		}
+
+		// A depth-stencil of the game, returns the view it is bound with
+		resource_view add_depth_stencil(uint32_t width, uint32_t height, format format = format::d32_float, uint16_t samples = 1, uint16_t layers = 1)
+		{
+			const resource depth_stencil = runtime.stub_device.add_resource(resource_desc(width, height, layers, 1, format, samples, memory_heap::gpu_only, resource_usage::depth_stencil | resource_usage::copy_source));
+			return runtime.stub_device.add_view(depth_stencil);
+		}
+		resource_view add_depth_stencil()
+		{
+			return add_depth_stencil(runtime.width, runtime.height);
+		}
+
+		resource resource_of(resource_view dsv) const
+		{
+			return runtime.stub_device.get_resource_from_view(dsv);
+		}
+
+		// Records and executes the draw calls of one frame, presents it and renders the effects
+		void frame(std::initializer_list<DrawnDepthStencil> drawn)
+		{
+			command_list *const cmd_list = &runtime.stub_cmd_list;
+			for (const DrawnDepthStencil &target : drawn)
+			{
+				on_bind_depth_stencil(cmd_list, 0, nullptr, target.dsv);
+				for (uint32_t i = 0; i < target.drawcalls; ++i)
+					on_draw(cmd_list, target.vertices_per_draw, 1, 0, 0);
+			}
+			on_bind_depth_stencil(cmd_list, 0, nullptr, { 0 });
+
+			on_execute_primary(&runtime.stub_queue, cmd_list);
+			on_reset(cmd_list);
+			on_present(&runtime.stub_queue, &runtime.stub_swapchain, nullptr, nullptr, 0, nullptr);
+
+			on_begin_render_effects(&runtime, cmd_list, { 0 }, { 0 });
+			on_finish_render_effects(&runtime, cmd_list, { 0 }, { 0 });
+		}
+		void frames(uint32_t count, std::initializer_list<DrawnDepthStencil> drawn)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				frame(drawn);
+		}
+
+		generic_depth_device_data &device_data() const
+		{
+			const device &base = runtime.stub_device;
+			return *base.get_private_data<generic_depth_device_data>();
+		}
+
+		resource selected() const
+		{
+			const effect_runtime &base = runtime;
+			return base.get_private_data<generic_depth_data>()->selected_depth_stencil;
+		}
+
+		Harness::StubEffectRuntime runtime;
+	};
+}
+
+// GTA V draws its scene depth in one or two fullscreen passes (see the heuristic in 'on_begin_render_effects')
+TEST_F(DepthTest, SelectsTheSceneDepthStencil)
+{
+	const resource_view scene = add_depth_stencil();
+	const resource_view shadows = add_depth_stencil(2048, 2048);
+
+	// New depth-stencils are not selected the frame they first appear
+	frames(2, { { scene, 2, 6 }, { shadows, 2, 6 } });
+	EXPECT_EQ(selected(), 0u);
+
+	frame({ { scene, 2, 6 }, { shadows, 2, 6 } });
+	EXPECT_EQ(selected(), resource_of(scene));
+}
+
+TEST_F(DepthTest, KeepsTheSelectionWhileItStillQualifies)
+{
+	const resource_view first = add_depth_stencil();
+	const resource_view second = add_depth_stencil();
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 } });
+	ASSERT_EQ(selected(), resource_of(first));
+
+	// The other one winning a few frames is not enough to switch
+	frames(2, { { first, 1, 6 }, { second, 2, 6 } });
+	EXPECT_EQ(selected(), resource_of(first));
+
+	// Winning for longer is
+	frames(40, { { first, 1, 6 }, { second, 2, 6 } });
+	EXPECT_EQ(selected(), resource_of(second));
+}
+
+TEST_F(DepthTest, DropsASelectionNotDrawnToThisFrame)
+{
+	const resource_view first = add_depth_stencil();
+	const resource_view second = add_depth_stencil();
+	const resource_view shadows = add_depth_stencil(2048, 2048);
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 }, { shadows, 50, 300 } });
+	ASSERT_EQ(selected(), resource_of(first));
+
+	frame({ { second, 1, 6 }, { shadows, 50, 300 } });
+	EXPECT_EQ(selected(), resource_of(second));
+}
+
+TEST_F(DepthTest, DropsASelectionThatNoLongerLooksLikeTheScene)
+{
+	const resource_view first = add_depth_stencil();
+	const resource_view second = add_depth_stencil();
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 } });
+	ASSERT_EQ(selected(), resource_of(first));
+
+	frame({ { first, 3, 6 }, { second, 1, 6 } });
+	EXPECT_EQ(selected(), resource_of(second));
+}
+
+TEST_F(DepthTest, DropsASelectionThatIsFilteredOut)
+{
+	const resource_view first = add_depth_stencil(runtime.width, runtime.height, format::d24_unorm_s8_uint);
+	const resource_view second = add_depth_stencil(runtime.width, runtime.height, format::d32_float);
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 } });
+	ASSERT_EQ(selected(), resource_of(first));
+
+	// Only 32-bit float depth
+	s_format_filtering = 5;
+	frame({ { first, 2, 6 }, { second, 1, 6 } });
+	s_format_filtering = 0;
+	EXPECT_EQ(selected(), resource_of(second));
+}
+
+// Switching depth-stencils returns the backup texture of the previous one to the pool, from where the
+// next one of the same description picks it up instead of creating another
+TEST_F(DepthTest, ReusesAPooledBackupTexture)
+{
+	const resource_view first = add_depth_stencil();
+	const resource_view second = add_depth_stencil();
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 } });
+	ASSERT_EQ(selected(), resource_of(first));
+	EXPECT_EQ(runtime.stub_device.resources_created, 1u);
+
+	frames(40, { { first, 1, 6 }, { second, 2, 6 } });
+	ASSERT_EQ(selected(), resource_of(second));
+	EXPECT_EQ(runtime.stub_device.resources_created, 1u);
+	EXPECT_EQ(device_data().backup_pool_hits, 1u);
+}
+
+// Array layers are not part of the pool's hash, a texture with a different number must not be reused
+TEST_F(DepthTest, CreatesABackupTextureForADifferentDescription)
+{
+	const resource_view first = add_depth_stencil();
+	const resource_view second = add_depth_stencil(runtime.width, runtime.height, format::d32_float, 1, 2);
+
+	frames(40, { { first, 2, 6 }, { second, 1, 6 } });
+	ASSERT_EQ(selected(), resource_of(first));
+
+	frames(40, { { first, 1, 6 }, { second, 2, 6 } });
+	ASSERT_EQ(selected(), resource_of(second));
+	EXPECT_EQ(runtime.stub_device.resources_created, 2u);
+	EXPECT_EQ(device_data().backup_pool_hits, 0u);
+
+	const std::vector<depth_stencil_backup> &backups = device_data().depth_stencil_backups;
+	const auto backup = std::find_if(backups.begin(), backups.end(), [this, second](const depth_stencil_backup &backup) { return backup.depth_stencil_resource == resource_of(second); });
+	ASSERT_NE(backup, backups.end());
+	EXPECT_EQ(runtime.stub_device.get_resource_desc(backup->backup_texture).texture.depth_or_layers, 2u);
+}
+
+// Without locking the fingerprint is saved when a depth-stencil is selected
+TEST_F(DepthTest, SavesTheFingerprintOfTheSelection)
+{
+	const resource_view scene = add_depth_stencil();
+	const resource_view shadows = add_depth_stencil(2048, 2048);
+	frames(3, { { scene, 2, 6 }, { shadows, 50, 300 } });
+	ASSERT_EQ(selected(), resource_of(scene));
+
+	uint32_t value = 0;
+	ASSERT_TRUE(reshade::get_config_value(nullptr, "DEPTH", "FingerprintFormat", value));
+	EXPECT_EQ(value, static_cast<uint32_t>(format::d32_float));
+	ASSERT_TRUE(reshade::get_config_value(nullptr, "DEPTH", "FingerprintWidthRatio", value));
+	EXPECT_EQ(value, 1000u);
+	ASSERT_TRUE(reshade::get_config_value(nullptr, "DEPTH", "FingerprintDrawCalls", value));
+	EXPECT_EQ(value, 2u);
+	ASSERT_TRUE(reshade::get_config_value(nullptr, "DEPTH", "FingerprintVertices", value));
+	EXPECT_EQ(value, 12u);
+}
+
+// A depth-stencil created looking like the saved one skips the grace period of new ones
+TEST_F(DepthTest, SelectsADepthStencilMatchingTheFingerprintRightAway)
+{
+	const resource_view scene = add_depth_stencil();
+	const resource_view shadows = add_depth_stencil(2048, 2048);
+	frames(3, { { scene, 2, 6 }, { shadows, 50, 300 } });
+	ASSERT_EQ(selected(), resource_of(scene));
+
+	// The game recreates its depth-stencil, after a resize for example
+	const resource_desc desc = runtime.stub_device.get_resource_desc(resource_of(scene));
+	const resource_view recreated = add_depth_stencil();
+	on_init_resource(&runtime.stub_device, desc, nullptr, resource_usage::depth_stencil_write, resource_of(recreated));
+	on_destroy_resource(&runtime.stub_device, resource_of(scene));
+
+	frame({ { recreated, 2, 6 }, { shadows, 50, 300 } });
+	EXPECT_EQ(selected(), resource_of(recreated));
+}
+
+TEST_F(DepthTest, IgnoresASwapchainOfAnUnknownDevice)
+{
+	Harness::StubDevice device;
+	Harness::StubSwapchain swapchain;
+	swapchain.owner = &device;
+
+	on_init_depth_swapchain(&swapchain, false);
+	EXPECT_EQ(static_cast<const reshade::api::device &>(device).get_private_data<generic_depth_device_data>(), nullptr);
+}
+
+// In the game present, the effects and the destruction of resources can each run on a thread of its
+// own. The effects read the snapshot present publishes without holding the lock, so hammer all three
+// at once: a snapshot must never change while it is held, must come from a single present, and
+// the selection must settle on the scene once the churn stops.
+TEST_F(DepthTest, SnapshotHoldsUpUnderConcurrentPresentDestroyAndEffects)
+{
+	constexpr uint32_t EFFECT_PASSES = 3000;
+
+	const resource_view scene = add_depth_stencil();
+	// Drawn to the same number of times every frame, a different number each frame
+	const resource_view first_marker = add_depth_stencil(1024, 1024);
+	const resource_view second_marker = add_depth_stencil(512, 512);
+
+	Harness::StubCommandList effects_cmd_list;
+	effects_cmd_list.owner = &runtime.stub_device;
+	on_init_command_list(&effects_cmd_list);
+
+	std::atomic<bool> stop = false;
+	std::atomic<uint32_t> presents = 0;
+	std::atomic<uint64_t> transient_view = 0;
+
+	// The game's render thread
+	std::thread present([&]() {
+		command_list *const cmd_list = &runtime.stub_cmd_list;
+		for (uint32_t frame = 0; !stop; ++frame)
+		{
+			const uint32_t marker_draws = 10 + frame % 7;
+			const resource_view transient = { transient_view.load() };
+
+			// The scene is drawn to whichever depth-stencil the game currently has
+			on_bind_depth_stencil(cmd_list, 0, nullptr, transient != 0 ? transient : scene);
+			for (uint32_t i = 0; i < 2; ++i)
+				on_draw(cmd_list, 6, 1, 0, 0);
+			for (const resource_view marker : { first_marker, second_marker })
+			{
+				on_bind_depth_stencil(cmd_list, 0, nullptr, marker);
+				for (uint32_t i = 0; i < marker_draws; ++i)
+					on_draw(cmd_list, 300, 1, 0, 0);
+			}
+			on_bind_depth_stencil(cmd_list, 0, nullptr, { 0 });
+
+			on_execute_primary(&runtime.stub_queue, cmd_list);
+			on_reset(cmd_list);
+			on_present(&runtime.stub_queue, &runtime.stub_swapchain, nullptr, nullptr, 0, nullptr);
+			presents++;
+
+			// The effects of a frame run once per present, leave them room to
+			std::this_thread::yield();
+		}
+	});
+
+	// A thread of the game recreating its scene depth-stencil over and over, as if it was resized
+	std::thread churn([&]() {
+		const auto wait_presents = [&](uint32_t count) {
+			for (const uint32_t until = presents + count; presents < until && !stop;)
+				std::this_thread::yield();
+		};
+
+		const resource_desc desc(runtime.width, runtime.height, 1, 1, format::d32_float, 1, memory_heap::gpu_only, resource_usage::depth_stencil | resource_usage::copy_source);
+		for (uint32_t lifetime = 1; !stop; lifetime = lifetime % 40 + 3)
+		{
+			const resource transient = runtime.stub_device.add_resource(desc);
+			on_init_resource(&runtime.stub_device, desc, nullptr, resource_usage::depth_stencil_write, transient);
+			transient_view = runtime.stub_device.add_view(transient).handle;
+			wait_presents(lifetime);
+
+			transient_view = 0;
+			on_destroy_resource(&runtime.stub_device, transient);
+			wait_presents(lifetime % 5);
+		}
+	});
+
+	// ReShade rendering the effects
+	uint32_t torn = 0, changed_while_held = 0, went_back = 0;
+	uint64_t last_frame_index = 0;
+	for (uint32_t pass = 0; pass < EFFECT_PASSES; ++pass)
+	{
+		on_begin_render_effects(&runtime, &effects_cmd_list, { 0 }, { 0 });
+
+		const depth_stencil_snapshot &snapshot = device_data().acquire_snapshot();
+		const uint64_t frame_index = snapshot.frame_index;
+		const std::vector<depth_stencil_candidate> held = snapshot.candidates;
+
+		uint32_t marker_draws[2] = {};
+		for (const depth_stencil_candidate &candidate : held)
+		{
+			if (candidate.last_used_in_frame != frame_index)
+				continue;
+			if (candidate.depth_stencil == resource_of(first_marker))
+				marker_draws[0] = candidate.total_stats.drawcalls;
+			if (candidate.depth_stencil == resource_of(second_marker))
+				marker_draws[1] = candidate.total_stats.drawcalls;
+		}
+		if (marker_draws[0] != marker_draws[1])
+			torn++;
+		if (frame_index < last_frame_index)
+			went_back++;
+		last_frame_index = frame_index;
+
+		// Give present a chance to pick the slot up for writing if it wrongly could
+		for (int i = 0; i < 10; ++i)
+			std::this_thread::yield();
+
+		const bool same = snapshot.frame_index == frame_index && std::equal(held.begin(), held.end(), snapshot.candidates.begin(), snapshot.candidates.end(),
+			[](const depth_stencil_candidate &a, const depth_stencil_candidate &b) { return a.depth_stencil == b.depth_stencil && a.total_stats.drawcalls == b.total_stats.drawcalls && a.last_used_in_frame == b.last_used_in_frame; });
+		if (!same)
+			changed_while_held++;
+		device_data().release_snapshot(snapshot);
+
+		on_finish_render_effects(&runtime, &effects_cmd_list, { 0 }, { 0 });
+	}
+
+	stop = true;
+	present.join();
+	churn.join();
+
+	EXPECT_GT(presents, 0u);
+	EXPECT_EQ(torn, 0u);
+	EXPECT_EQ(changed_while_held, 0u);
+	EXPECT_EQ(went_back, 0u);
+	// Depth-stencils were destroyed while the effects had them selected
+	EXPECT_GT(device_data().retire_count, 0u);
+	for (const depth_stencil_snapshot &slot : device_data().snapshots)
+		EXPECT_EQ(slot.readers, 0u);
+
+	// Only the scene looks like one from here on
+	frames(40, { { scene, 2, 6 }, { first_marker, 10, 300 }, { second_marker, 10, 300 } });
+	EXPECT_EQ(selected(), resource_of(scene));
+
+	on_destroy_command_list(&effects_cmd_list);
+}
@@ -0,0 +1,265 @@
+#include <gtest/gtest.h>
+
+#include "depth_pyramid.hpp"
+#include "mock_runtime.hpp"
+
+#include <map>
+#include <random>
+
+using Harness::DepthBuffer;
+using Harness::DepthLevel;
+
+namespace
+{
+	struct Screen
+	{
+		uint32_t width;
+		uint32_t height;
+		float render_scale;
+	};
+
+	// Sizes whose levels are not exact halvings of each other, and the default RENDER_SCALE
+	const Screen SCREENS[] = {
+		{ 1920, 1080, 0.5f }, { 1920, 1080, 1.0f },
+		{ 1366, 768, 0.5f }, { 1366, 768, 1.0f },
+		{ 1365, 767, 0.5f }, { 1600, 900, 0.75f },
+		{ 2560, 1080, 0.5f }, { 3840, 2160, 0.5f },
+	};
+
+	constexpr float NEAR_CLIP = 0.15f;
+	constexpr float FAR_CLIP = 10000.0f;
+
+	// The game's depth buffer for a screen, random depths with some sky
+	DepthBuffer depth_buffer(const Screen &screen, uint32_t seed, bool reversed = false)
+	{
+		DepthBuffer buffer = { screen.width, screen.height, std::vector<float>(screen.width * screen.height), reversed };
+
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+		for (float &value : buffer.depth)
+		{
+			value = depth(rng) < 0.1f ? 1.0f : depth(rng);
+			if (reversed)
+				value = 1.0f - value;
+		}
+		return buffer;
+	}
+
+	// Scene depth of one pixel as the passes without the prepass compute it, over the far clip
+	float scene_depth(const DepthBuffer &buffer, uint32_t x, uint32_t y)
+	{
+		float depth = buffer.depth[y * buffer.width + x];
+		if (buffer.reversed)
+			depth = 1.0f - depth;
+		return depth < 1.0f ? NEAR_CLIP / (FAR_CLIP + depth * (NEAR_CLIP - FAR_CLIP)) : 1.0f;
+	}
+
+	// LinearDepthTexture of a screen, filled with random nearest and farthest depths and some sky
+	DepthLevel linear_depth(const Screen &screen, uint32_t seed)
+	{
+		DepthLevel level(static_cast<uint32_t>(screen.width * screen.render_scale), static_cast<uint32_t>(screen.height * screen.render_scale));
+
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+		for (size_t i = 0; i < level.nearest.size(); ++i)
+		{
+			const float a = depth(rng), b = depth(rng);
+			const bool sky = depth(rng) < 0.1f;
+			level.nearest[i] = sky ? 1.0f : std::min(a, b);
+			level.farthest[i] = sky ? 1.0f : std::max(a, b);
+		}
+		return level;
+	}
+}
+
+TEST(DepthPyramidTest, LinearDepthIsTheSceneDepthOverTheFarClip)
+{
+	// One texel at half scale over four pixels, one of them sky
+	for (const bool reversed : { false, true })
+	{
+		DepthBuffer buffer = { 2, 2, { 0.0f, 0.5f, 1.0f, 0.9f }, reversed };
+		if (reversed)
+			for (float &depth : buffer.depth)
+				depth = 1.0f - depth;
+
+		const DepthLevel level = Harness::linearize_depth(buffer, 2, 2, 0.5f, NEAR_CLIP, FAR_CLIP);
+		ASSERT_EQ(level.width, 1u);
+		ASSERT_EQ(level.height, 1u);
+		EXPECT_FLOAT_EQ(level.nearest[0], NEAR_CLIP / FAR_CLIP);
+		EXPECT_FLOAT_EQ(level.farthest[0], 1.0f);
+	}
+}
+
+// The low resolution march reads the nearest depth of the texel its pixel samples, the aurora the
+// farthest. Both must hold the depth of every pixel of the back buffer that samples the texel.
+TEST(DepthPyramidTest, LinearDepthBoundsEveryPixelUnderItsTexel)
+{
+	for (const Screen &screen : SCREENS)
+	{
+		SCOPED_TRACE(testing::Message() << screen.width << "x" << screen.height << " at " << screen.render_scale);
+
+		const DepthBuffer buffer = depth_buffer(screen, screen.width + screen.height, screen.width % 2 != 0);
+		const DepthLevel level = Harness::linearize_depth(buffer, screen.width, screen.height, screen.render_scale, NEAR_CLIP, FAR_CLIP);
+		EXPECT_EQ(level.width, Harness::linear_depth_size(screen.width, screen.render_scale));
+		EXPECT_EQ(level.height, Harness::linear_depth_size(screen.height, screen.render_scale));
+
+		uint32_t unbounded = 0;
+		for (uint32_t y = 0; y < buffer.height; ++y)
+		{
+			for (uint32_t x = 0; x < buffer.width; ++x)
+			{
+				const float depth = scene_depth(buffer, x, y);
+				const size_t t = level.sample((x + 0.5f) / buffer.width, (y + 0.5f) / buffer.height);
+				if (level.nearest[t] > depth * (1.0f + 1e-6f) || level.farthest[t] < depth * (1.0f - 1e-6f))
+					unbounded++;
+			}
+		}
+		EXPECT_EQ(unbounded, 0u);
+	}
+}
+
+// hiZOccluded skips a cloud pixel from the tile it samples, which is only safe if that tile's range
+// holds the depth of the pixel
+TEST(DepthPyramidTest, EveryLevelBoundsTheDepthUnderIt)
+{
+	for (const Screen &screen : SCREENS)
+	{
+		SCOPED_TRACE(testing::Message() << screen.width << "x" << screen.height << " at " << screen.render_scale);
+
+		const DepthLevel source = linear_depth(screen, screen.width * screen.height);
+		const std::vector<DepthLevel> levels = Harness::build_hiz_pyramid(source, screen.width, screen.height);
+		ASSERT_EQ(levels.size(), std::size(Harness::HIZ_DIVISORS));
+
+		for (size_t l = 0; l < levels.size(); ++l)
+		{
+			const DepthLevel &level = levels[l];
+			EXPECT_EQ(level.width, screen.width / Harness::HIZ_DIVISORS[l]);
+			EXPECT_EQ(level.height, screen.height / Harness::HIZ_DIVISORS[l]);
+
+			uint32_t unbounded = 0;
+			for (uint32_t y = 0; y < source.height; ++y)
+			{
+				for (uint32_t x = 0; x < source.width; ++x)
+				{
+					const size_t s = source.index(x, y);
+					const size_t t = level.sample((x + 0.5f) / source.width, (y + 0.5f) / source.height);
+					if (level.nearest[t] > source.nearest[s] || level.farthest[t] < source.farthest[s])
+						unbounded++;
+				}
+			}
+			EXPECT_EQ(unbounded, 0u) << "at 1/" << Harness::HIZ_DIVISORS[l];
+		}
+	}
+}
+
+// Near geometry in the last column and row, which a footprint of two texels loses once a level is
+// more than half the size of the next
+TEST(DepthPyramidTest, ReachesTheLastColumnAndRow)
+{
+	const Screen screen = { 1366, 768, 0.5f };
+	DepthLevel source(683, 384);
+	std::fill(source.nearest.begin(), source.nearest.end(), 1.0f);
+	std::fill(source.farthest.begin(), source.farthest.end(), 1.0f);
+
+	const size_t corner = source.index(source.width - 1, source.height - 1);
+	source.nearest[corner] = source.farthest[corner] = 0.01f;
+
+	const DepthLevel tiles = Harness::build_hiz_pyramid(source, screen.width, screen.height).back();
+	const size_t tile = tiles.sample(1.0f - 0.5f / source.width, 1.0f - 0.5f / source.height);
+	EXPECT_FLOAT_EQ(tiles.nearest[tile], 0.01f);
+	EXPECT_FLOAT_EQ(tiles.farthest[tile], 1.0f);
+}
+
+// When every level halves the one before it, the tiles are exactly the 16x16 blocks of the prepass
+// and no neighbouring texels widen them
+TEST(DepthPyramidTest, IsExactWhenTheLevelsHalve)
+{
+	const Screen screen = { 2048, 1024, 0.5f };
+	const DepthLevel source = linear_depth(screen, 1);
+	const DepthLevel tiles = Harness::build_hiz_pyramid(source, screen.width, screen.height).back();
+	ASSERT_EQ(tiles.width * 16, source.width);
+	ASSERT_EQ(tiles.height * 16, source.height);
+
+	for (uint32_t ty = 0; ty < tiles.height; ++ty)
+	{
+		for (uint32_t tx = 0; tx < tiles.width; ++tx)
+		{
+			float nearest = 1.0f, farthest = 0.0f;
+			for (uint32_t y = ty * 16; y < (ty + 1) * 16; ++y)
+			{
+				for (uint32_t x = tx * 16; x < (tx + 1) * 16; ++x)
+				{
+					nearest = std::min(nearest, source.nearest[source.index(x, y)]);
+					farthest = std::max(farthest, source.farthest[source.index(x, y)]);
+				}
+			}
+
+			const size_t t = tiles.index(tx, ty);
+			ASSERT_EQ(tiles.nearest[t], nearest) << tx << ", " << ty;
+			ASSERT_EQ(tiles.farthest[t], farthest) << tx << ", " << ty;
+		}
+	}
+}
+
+// Stands in for the command list the runtime records for the clouds technique: its passes run in
+// order on the CPU references, and a pass reading a depth target finds it written earlier that frame
+TEST(DepthPyramidTest, TechniqueWritesTheDepthTargetsBeforeTheyAreRead)
+{
+	const Screen screen = { 1366, 768, 0.5f };
+	const DepthBuffer buffer = depth_buffer(screen, 7);
+	const std::vector<std::pair<std::string, std::string>> definitions = { { "LINEAR_DEPTH_PREPASS", "1" }, { "HIZ_EARLY_OUT", "1" }, { "RENDER_SCALE", "0.5" } };
+
+	for (const char *technique : { "PulseV_VolumetricClouds", "PulseV_VolumetricClouds_DEBUGDEPTHEDGE" })
+	{
+		SCOPED_TRACE(technique);
+
+		const std::vector<Harness::EffectPass> passes = Harness::read_technique_passes(technique, definitions);
+		ASSERT_FALSE(passes.empty());
+
+		std::map<std::string, DepthLevel> targets;
+		uint32_t reads = 0;
+		for (const Harness::EffectPass &pass : passes)
+		{
+			SCOPED_TRACE(pass.name);
+
+			const auto is_depth_target = [](const std::string &texture) { return texture == "LinearDepthTexture" || texture.rfind("HiZ", 0) == 0; };
+			for (const std::string &texture : pass.textures)
+			{
+				if (!is_depth_target(texture))
+					continue;
+				EXPECT_EQ(targets.count(texture), 1u) << texture << " read before it is written";
+				reads++;
+			}
+
+			if (pass.render_target == "LinearDepthTexture")
+				targets[pass.render_target] = Harness::linearize_depth(buffer, screen.width, screen.height, screen.render_scale, NEAR_CLIP, FAR_CLIP);
+			else if (is_depth_target(pass.render_target))
+			{
+				ASSERT_EQ(pass.textures.size(), 1u);
+				const uint32_t divisor = std::stoul(pass.render_target.substr(3));
+				targets[pass.render_target] = Harness::reduce_depth_min_max(targets[pass.textures[0]], screen.width / divisor, screen.height / divisor);
+			}
+		}
+		EXPECT_GT(reads, 0u);
+		ASSERT_EQ(targets.count("LinearDepthTexture"), 1u);
+
+		if (targets.count("HiZ32Texture") != 0)
+		{
+			const DepthLevel tiles = Harness::build_hiz_pyramid(targets["LinearDepthTexture"], screen.width, screen.height).back();
+			EXPECT_EQ(targets["HiZ32Texture"].nearest, tiles.nearest);
+			EXPECT_EQ(targets["HiZ32Texture"].farthest, tiles.farthest);
+		}
+	}
+}
+
+// The prepass changes what the passes read, so the effect keeps sampling the depth buffer directly
+// unless it is turned on
+TEST(DepthPyramidTest, TechniqueReadsTheDepthBufferByDefault)
+{
+	for (const Harness::EffectPass &pass : Harness::read_technique_passes("PulseV_VolumetricClouds"))
+	{
+		SCOPED_TRACE(pass.name);
+		EXPECT_NE(pass.render_target, "LinearDepthTexture");
+		EXPECT_EQ(std::count(pass.textures.begin(), pass.textures.end(), "LinearDepthTexture"), 0);
+	}
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include "gpu_timing.hpp"
+#include "stub_device.hpp"
+
+#include <utility>
+#include <vector>
+
+using reshade::api::effect_technique;
+
+namespace
+{
+	// STATS_WINDOW of gpu_timing.cpp
+	constexpr uint32_t STATS_WINDOW = 60;
+
+	class GpuTimingTest : public ::testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			clouds = { runtime.add_technique("PulseV_Volumetrics.fx", "PulseV_Clouds") + 1 };
+			aurora = { runtime.add_technique("PulseV_Volumetrics.fx", "PulseV_Aurora") + 1 };
+			bloom = { runtime.add_technique("Bloom.fx", "Bloom") + 1 };
+		}
+
+		void TearDown() override
+		{
+			GpuTiming::on_runtime_destroyed(&runtime);
+		}
+
+		// One frame of effects, each technique taking the given GPU microseconds
+		void frame(const std::vector<std::pair<effect_technique, int64_t>> &passes)
+		{
+			runtime.stub_device.frame++;
+			GpuTiming::begin_effects(&runtime, &runtime.stub_cmd_list);
+			for (const auto &[technique, microseconds] : passes)
+			{
+				runtime.stub_cmd_list.clock += microseconds;
+				GpuTiming::on_render_technique(&runtime, technique, &runtime.stub_cmd_list, { 0 }, { 0 });
+			}
+			GpuTiming::finish_effects(&runtime);
+
+			// Idle time between the frames
+			runtime.stub_cmd_list.clock += 5000;
+		}
+
+		void frames(uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				frame({ { clouds, 2000 }, { bloom, 1000 } });
+		}
+
+		Harness::StubEffectRuntime runtime;
+		effect_technique clouds = {};
+		effect_technique aurora = {};
+		effect_technique bloom = {};
+	};
+}
+
+TEST_F(GpuTimingTest, WritesATimestampPerTechniqueIntoTheFrameSlot)
+{
+	frame({ { clouds, 2000 }, { aurora, 500 } });
+	frame({ { clouds, 2000 } });
+
+	const std::vector<uint32_t> &queries = runtime.stub_cmd_list.queries;
+	ASSERT_EQ(queries.size(), 5u);
+	EXPECT_EQ(runtime.stub_device.heaps_created, 1u);
+	EXPECT_EQ(runtime.stub_device.query_values.size(), GpuTiming::FRAMES_IN_FLIGHT * GpuTiming::MAX_TIMESTAMPS);
+
+	// The start of the effects at the slot's first query, the techniques after it
+	const uint32_t slot = queries[0] / GpuTiming::MAX_TIMESTAMPS;
+	EXPECT_EQ(queries[0] % GpuTiming::MAX_TIMESTAMPS, 0u);
+	EXPECT_EQ(queries[1], queries[0] + 1);
+	EXPECT_EQ(queries[2], queries[0] + 2);
+
+	// The next frame writes the next slot of the ring
+	EXPECT_EQ(queries[3], (slot + 1) % GpuTiming::FRAMES_IN_FLIGHT * GpuTiming::MAX_TIMESTAMPS);
+	EXPECT_EQ(queries[4], queries[3] + 1);
+}
+
+TEST_F(GpuTimingTest, StopsAtTheTimestampsOfASlot)
+{
+	std::vector<std::pair<effect_technique, int64_t>> passes(GpuTiming::MAX_TIMESTAMPS + 10, { clouds, 10 });
+	frame(passes);
+
+	EXPECT_EQ(runtime.stub_cmd_list.queries.size(), GpuTiming::MAX_TIMESTAMPS);
+	EXPECT_EQ(runtime.stub_cmd_list.queries.back() % GpuTiming::MAX_TIMESTAMPS, GpuTiming::MAX_TIMESTAMPS - 1);
+}
+
+TEST_F(GpuTimingTest, ReadsASlotBackWhenItComesRound)
+{
+	frames(GpuTiming::FRAMES_IN_FLIGHT);
+	EXPECT_EQ(runtime.stub_device.result_reads, 0u);
+
+	// The first slot is read before it is written again, then one slot per frame
+	frames(1);
+	EXPECT_EQ(runtime.stub_device.result_reads, 1u);
+	frames(3);
+	EXPECT_EQ(runtime.stub_device.result_reads, 4u);
+}
+
+TEST_F(GpuTimingTest, AveragesPulseVTechniquesOverTheWindow)
+{
+	const uint64_t windows = GpuTiming::get_window_count();
+
+	// The first FRAMES_IN_FLIGHT frames are only read back once the ring comes round
+	frames(GpuTiming::FRAMES_IN_FLIGHT + STATS_WINDOW - 1);
+	EXPECT_EQ(GpuTiming::get_window_count(), windows);
+	EXPECT_LT(GpuTiming::get_technique_ms("PulseV_Clouds"), 0.0f);
+
+	frames(1);
+	EXPECT_EQ(GpuTiming::get_window_count(), windows + 1);
+	EXPECT_FLOAT_EQ(GpuTiming::get_technique_ms("PulseV_Clouds"), 2.0f);
+	// Never ran
+	EXPECT_LT(GpuTiming::get_technique_ms("PulseV_Aurora"), 0.0f);
+	// Timed, but not one of the addon's
+	EXPECT_LT(GpuTiming::get_technique_ms("Bloom"), 0.0f);
+}
+
+TEST_F(GpuTimingTest, DropsResultsTheGpuHasNotFinished)
+{
+	const uint64_t windows = GpuTiming::get_window_count();
+
+	// Every slot still in flight when it comes round again
+	runtime.stub_device.latency = GpuTiming::FRAMES_IN_FLIGHT + 1;
+	frames(GpuTiming::FRAMES_IN_FLIGHT + STATS_WINDOW);
+	EXPECT_EQ(runtime.stub_device.result_reads, STATS_WINDOW);
+	EXPECT_EQ(GpuTiming::get_window_count(), windows);
+
+	// Readable again, the dropped frames did not count towards the window
+	runtime.stub_device.latency = 1;
+	frames(STATS_WINDOW - 1);
+	EXPECT_EQ(GpuTiming::get_window_count(), windows);
+	frames(1);
+	EXPECT_EQ(GpuTiming::get_window_count(), windows + 1);
+	EXPECT_FLOAT_EQ(GpuTiming::get_technique_ms("PulseV_Clouds"), 2.0f);
+}
+
+TEST_F(GpuTimingTest, SkipsATimestampThatGoesBackwards)
+{
+	const uint64_t windows = GpuTiming::get_window_count();
+
+	// The aurora's timestamp is earlier than the one before it, the bloom after it is timed from it
+	for (uint32_t i = 0; i < GpuTiming::FRAMES_IN_FLIGHT + STATS_WINDOW; ++i)
+		frame({ { clouds, 2000 }, { aurora, -500 }, { bloom, 1000 } });
+
+	ASSERT_EQ(GpuTiming::get_window_count(), windows + 1);
+	EXPECT_FLOAT_EQ(GpuTiming::get_technique_ms("PulseV_Clouds"), 2.0f);
+	EXPECT_LT(GpuTiming::get_technique_ms("PulseV_Aurora"), 0.0f);
+}
+
+TEST_F(GpuTimingTest, ReloadDiscardsTheSlotsInFlight)
+{
+	frames(GpuTiming::FRAMES_IN_FLIGHT);
+	GpuTiming::on_effects_reloaded(&runtime);
+
+	// Their techniques are gone, the slots are written again before they are read
+	frames(GpuTiming::FRAMES_IN_FLIGHT);
+	EXPECT_EQ(runtime.stub_device.result_reads, 0u);
+	frames(1);
+	EXPECT_EQ(runtime.stub_device.result_reads, 1u);
+}
+
+TEST_F(GpuTimingTest, DestroyingTheRuntimeReleasesTheHeap)
+{
+	frames(2);
+	GpuTiming::on_runtime_destroyed(&runtime);
+	EXPECT_EQ(runtime.stub_device.heaps_destroyed, 1u);
+
+	// A new runtime starts over with a heap of its own
+	frames(1);
+	EXPECT_EQ(runtime.stub_device.heaps_created, 2u);
+}
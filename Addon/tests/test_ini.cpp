@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "util/IniLite.hpp"
+
+TEST(IniTest, TheLastValueOfARepeatedKeyWins)
+{
+	pv::ini::Ini ini;
+	ini.parse("[Keys]\nToggle=1\nReload=2\nToggle=3\n");
+	const pv::ini::Section *const keys = ini.find("Keys");
+	ASSERT_NE(keys, nullptr);
+
+	// Whatever was looked up before
+	EXPECT_EQ(keys->get("Toggle"), "3");
+	EXPECT_EQ(keys->get("Reload"), "2");
+	EXPECT_EQ(keys->get("Toggle"), "3");
+	EXPECT_EQ(keys->get("Reload"), "2");
+	EXPECT_FALSE(keys->has("Missing"));
+}
+
+TEST(IniTest, RepeatedSectionsAreLookedUpAsOne)
+{
+	pv::ini::Ini ini;
+	ini.parse("[Keys]\nToggle=1\nReload=2\n[Other]\nToggle=5\n[Keys]\nToggle=3\n");
+
+	// Every occurrence is still there for whoever rewrites the file
+	ASSERT_EQ(ini.sections().size(), 3u);
+	EXPECT_EQ(ini.sections()[0].count, 2u);
+	EXPECT_EQ(ini.sections()[2].count, 1u);
+
+	const pv::ini::Section *const keys = ini.find("Keys");
+	ASSERT_EQ(keys, &ini.sections()[2]);
+	EXPECT_EQ(keys->get("Toggle"), "3");
+	EXPECT_EQ(keys->get("Reload"), "2");
+	EXPECT_EQ(ini.find("Other")->get("Toggle"), "5");
+	EXPECT_FALSE(ini.find("Other")->has("Reload"));
+}
+
+TEST(IniTest, OnlySemicolonsStartACommentByDefault)
+{
+	pv::ini::Ini ini;
+	ini.parse("[Keys]\nColor=#FF0000 ; red\n");
+	EXPECT_EQ(ini.find("Keys")->get("Color"), "#FF0000");
+
+	pv::ini::Ini presets(pv::ini::PRESET_COMMENTS);
+	presets.parse("[CLEAR_12:00]\ncloudCover=0.5 # more than usual\n# cloudCover=0.9\n");
+	EXPECT_EQ(presets.find("CLEAR_12:00")->get("cloudCover"), "0.5");
+}
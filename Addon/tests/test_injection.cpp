@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include "data_reader.hpp"
+#include "injection.hpp"
+#include "mock_runtime.hpp"
+#include "profiler.hpp"
+#include "scripted_source.hpp"
+
+namespace
+{
+	class InjectionTest : public ::testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			Harness::populate_pulsev_effect(runtime);
+
+			source.state.cam_pos = { { 10.0f, 20.0f, 30.0f } };
+			DataReader::register_data_reader(nullptr, &source);
+			DataReader::step();
+
+			clouds.rt = &runtime;
+			clouds.has_runtime = true;
+		}
+
+		void TearDown() override
+		{
+			DataReader::unregister_data_reader(nullptr);
+		}
+
+		bool frame()
+		{
+			return Injection::inject_frame(&runtime, clouds, now += 1.0 / 60.0, capture);
+		}
+
+		Harness::ScriptedSource source;
+		Harness::MockEffectRuntime runtime;
+		pv::clouds::CloudsState clouds;
+		UniformCapture::Writer capture;
+		double now = 0.0;
+	};
+}
+
+TEST_F(InjectionTest, WritesStagedValuesToAnnotatedUniforms)
+{
+	ASSERT_TRUE(frame());
+
+	EXPECT_EQ(runtime.find("inputEnabled")->get_int(), 1);
+	EXPECT_FLOAT_EQ(runtime.find("inputNearClip")->get_float(), 0.15f);
+	EXPECT_FLOAT_EQ(runtime.find("inputFarClip")->get_float(), 10000.0f);
+	EXPECT_FLOAT_EQ(runtime.find("sunHdr")->get_float(), 1.0f);
+	EXPECT_FLOAT_EQ(runtime.find("sunColor")->get_float(1), 0.9f);
+
+	// Matrices are staged as four float4 rows
+	const Float4x4 &inverse_view = DataReader::get_inv_view_matrix();
+	const Float4 *rows[4] = { &inverse_view.r1, &inverse_view.r2, &inverse_view.r3, &inverse_view.r4 };
+	for (int row = 0; row < 4; ++row)
+	{
+		const Harness::MockUniform *const uniform = runtime.find("inputInverseViewMatrix" + std::to_string(row + 1));
+		for (int i = 0; i < 4; ++i)
+			EXPECT_FLOAT_EQ(uniform->get_float(i), rows[row]->v[i]);
+	}
+}
+
+TEST_F(InjectionTest, CountsEveryUniformWrite)
+{
+	frame();
+
+	const uint64_t writes = runtime.uniform_writes;
+	frame();
+
+	const Injection::Counts &counts = Injection::get_stats().frame;
+	EXPECT_EQ(counts.values_set, runtime.uniform_writes - writes);
+	EXPECT_EQ(counts.variables_scanned, runtime.get_uniforms().size());
+
+	// The cloud globals are written by the preset tick, not through a "source" annotation
+	EXPECT_GT(runtime.find("cloudCover")->writes, 0u);
+	EXPECT_GT(runtime.find("ClearBottomCover")->writes, 0u);
+}
+
+TEST_F(InjectionTest, PackedLayersAreOneWrite)
+{
+	Harness::MockEffectRuntime packed;
+	Harness::populate_pulsev_effect(packed, true);
+	clouds.rt = &packed;
+
+	Injection::inject_frame(&packed, clouds, now += 1.0 / 60.0, capture);
+
+	EXPECT_EQ(packed.find("cloudPackedLayers")->writes, 1u);
+	EXPECT_EQ(packed.find("ClearBottomCover"), nullptr);
+}
+
+// A preset change fades the packed layers in from the last applied preset like the globals
+TEST_F(InjectionTest, PackedLayersBlendFromTheLastAppliedPreset)
+{
+	Harness::MockEffectRuntime packed;
+	Harness::populate_pulsev_effect(packed, true);
+	clouds.rt = &packed;
+
+	clouds.store.globals.autoApply = false;
+	clouds.store.globals.blendSeconds = 2.0f;
+	clouds.last_applied.cloudCover = 0.2f;
+	clouds.last_applied.bottomLayer.cover = 0.2f;
+	pv::clouds::CloudPreset &edited = clouds.store.get_or_create(clouds.edit.weather, clouds.edit.bucket);
+	edited.cloudCover = 0.6f;
+	edited.bottomLayer.cover = 0.6f;
+
+	// Halfway through the blend
+	now += 1.0 / 60.0;
+	clouds.last_change_time = now - 1.0;
+	Injection::inject_frame(&packed, clouds, now, capture);
+
+	constexpr size_t cover = offsetof(pv::clouds::CloudLayer, cover) / sizeof(float);
+	constexpr size_t to_bottom = 2 * pv::clouds::kPackedFloat4sPerLayer * 4;
+	const Harness::MockUniform *const layers = packed.find("cloudPackedLayers");
+	EXPECT_NEAR(packed.find("cloudCover")->get_float(), 0.4f, 1e-6f);
+	EXPECT_NEAR(layers->get_float(cover), 0.4f, 1e-6f);
+	EXPECT_NEAR(layers->get_float(to_bottom + cover), 0.4f, 1e-6f);
+
+	// And the edited preset once it is over
+	now += 1.0;
+	Injection::inject_frame(&packed, clouds, now, capture);
+	EXPECT_FLOAT_EQ(layers->get_float(cover), 0.6f);
+	EXPECT_FLOAT_EQ(clouds.last_applied.bottomLayer.cover, 0.6f);
+}
+
+// After the first frames have discovered the uniforms and filled the caches, a frame on the render
+// thread (the profiler collect included) makes no heap allocation, with or without the packed layers
+// and several effects. The reader's update runs on the script thread and is not counted.
+TEST_F(InjectionTest, SteadyStateFramesDoNotAllocate)
+{
+	for (const bool packed_layers : { false, true })
+	{
+		Harness::MockEffectRuntime effects;
+		Harness::populate_pulsev_effect(effects, packed_layers, 3);
+		clouds.rt = &effects;
+		clouds.ucache = {};
+
+		for (int i = 0; i < 8; ++i)
+		{
+			Profiler::collect();
+			Injection::inject_frame(&effects, clouds, now += 1.0 / 60.0, capture);
+		}
+
+		uint64_t allocations = 0;
+		for (int i = 0; i < 60; ++i)
+		{
+			source.state.cam_pos.v[0] += 0.5f;
+			DataReader::step();
+
+			const uint64_t before = Profiler::get_thread_allocations();
+			Profiler::collect();
+			Injection::inject_frame(&effects, clouds, now += 1.0 / 60.0, capture);
+			allocations += Profiler::get_thread_allocations() - before;
+		}
+
+		EXPECT_EQ(allocations, 0u) << (packed_layers ? "packed layers" : "per-weather layers");
+	}
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "march_budget.hpp"
+
+using namespace pv::clouds;
+
+namespace
+{
+	// A slab from 1000 to 2000 meters with these effective covers
+	LayerSlab slab(float cover_bottom, float cover_top = 0.0f)
+	{
+		LayerSlab s;
+		s.cover_bottom = cover_bottom;
+		s.cover_top = cover_top;
+		s.bottom = 1000.0f;
+		s.top = 2000.0f;
+		s.valid = true;
+		return s;
+	}
+
+	// Effective cover that gives 'content' (0..1) for the budget
+	float cover_for(float content)
+	{
+		return kMinCover + content * content * (kFullCover - kMinCover);
+	}
+
+	constexpr float FOV = 60.0f;
+	constexpr float HALF_FOV = FOV * 0.5f;
+	constexpr float INSIDE = 1500.0f;
+	constexpr float BELOW = 500.0f;
+	constexpr float ABOVE = 2500.0f;
+}
+
+TEST(MarchBudget, NothingToRenderAtMinCover)
+{
+	for (const float cover : { 0.0f, kMinCover })
+	{
+		const MarchBudget budget = compute_march_budget(slab(cover, cover), INSIDE, 0.0f, FOV);
+		EXPECT_FLOAT_EQ(budget.sample_scale, kMinSampleScale);
+		EXPECT_EQ(budget.light_steps, kMinLightSteps);
+	}
+}
+
+TEST(MarchBudget, EverySampleFromFullCover)
+{
+	for (const float cover : { kFullCover, 0.6f, 1.0f })
+	{
+		const MarchBudget budget = compute_march_budget(slab(cover), INSIDE, 0.0f, FOV);
+		EXPECT_FLOAT_EQ(budget.sample_scale, 1.0f);
+		EXPECT_EQ(budget.light_steps, kMaxLightSteps);
+	}
+
+	// The denser of the two layers decides
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(0.0f, kFullCover), INSIDE, 0.0f, FOV).sample_scale, 1.0f);
+}
+
+TEST(MarchBudget, ScalesWithTheSquareRootOfCover)
+{
+	const MarchBudget budget = compute_march_budget(slab(cover_for(0.5f)), INSIDE, 0.0f, FOV);
+	EXPECT_NEAR(budget.sample_scale, kMinSampleScale + (1.0f - kMinSampleScale) * 0.5f, 1e-5f);
+}
+
+TEST(MarchBudget, LightStepsRoundToNearest)
+{
+	// kMinLightSteps + content * (kMaxLightSteps - kMinLightSteps), rounded
+	EXPECT_EQ(compute_march_budget(slab(cover_for(0.24f)), INSIDE, 0.0f, FOV).light_steps, 2);
+	EXPECT_EQ(compute_march_budget(slab(cover_for(0.26f)), INSIDE, 0.0f, FOV).light_steps, 3);
+	EXPECT_EQ(compute_march_budget(slab(cover_for(0.74f)), INSIDE, 0.0f, FOV).light_steps, 3);
+	EXPECT_EQ(compute_march_budget(slab(cover_for(0.76f)), INSIDE, 0.0f, FOV).light_steps, 4);
+}
+
+TEST(MarchBudget, InsideTheSlabEveryPitchSees)
+{
+	for (const float pitch : { -90.0f, -HALF_FOV, 0.0f, HALF_FOV, 90.0f })
+		EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), INSIDE, pitch, FOV).sample_scale, 1.0f);
+}
+
+TEST(MarchBudget, BelowTheSlabLookingDown)
+{
+	// The top of the view at the horizon: nothing reaches the slab
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), BELOW, -HALF_FOV, FOV).sample_scale, kMinSampleScale);
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), BELOW, -90.0f, FOV).sample_scale, kMinSampleScale);
+
+	// An eighth of the view above the horizon is half of the visibility ramp
+	const float eighth = -HALF_FOV + FOV / 8.0f;
+	EXPECT_NEAR(compute_march_budget(slab(1.0f), BELOW, eighth, FOV).sample_scale, kMinSampleScale + (1.0f - kMinSampleScale) * 0.5f, 1e-5f);
+
+	// From a quarter of the view every sample
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), BELOW, -HALF_FOV + FOV / 4.0f, FOV).sample_scale, 1.0f);
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), BELOW, 0.0f, FOV).sample_scale, 1.0f);
+}
+
+TEST(MarchBudget, AboveTheSlabLookingUp)
+{
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), ABOVE, HALF_FOV, FOV).sample_scale, kMinSampleScale);
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), ABOVE, 90.0f, FOV).sample_scale, kMinSampleScale);
+
+	const float eighth = HALF_FOV - FOV / 8.0f;
+	EXPECT_NEAR(compute_march_budget(slab(1.0f), ABOVE, eighth, FOV).sample_scale, kMinSampleScale + (1.0f - kMinSampleScale) * 0.5f, 1e-5f);
+
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), ABOVE, 0.0f, FOV).sample_scale, 1.0f);
+	EXPECT_FLOAT_EQ(compute_march_budget(slab(1.0f), ABOVE, -90.0f, FOV).sample_scale, 1.0f);
+}
+
+TEST(MarchBudget, SlabBlendsTheLayers)
+{
+	CloudPreset from;
+	from.cloudCover = 1.0f;
+	from.cloudHeightOffset = 0.0f;
+	from.bottomLayer.cover = 0.2f;
+	from.bottomLayer.bottom = 1000.0f;
+	from.bottomLayer.top = 1500.0f;
+	from.topLayer.cover = 0.0f;
+	from.topLayer.bottom = 3000.0f;
+	from.topLayer.top = 3050.0f;
+
+	CloudPreset to = from;
+	to.cloudCover = 0.5f;
+	to.cloudHeightOffset = 200.0f;
+	to.bottomLayer.cover = 0.6f;
+
+	const LayerSlab s = layer_slab(from, to, 0.5f);
+	EXPECT_TRUE(s.valid);
+	EXPECT_FLOAT_EQ(s.cover_bottom, 0.75f * 0.4f);
+	EXPECT_FLOAT_EQ(s.cover_top, 0.0f);
+	EXPECT_FLOAT_EQ(s.bottom, 1100.0f);
+	// The top layer is thinner than the effect's minimum layer height
+	EXPECT_FLOAT_EQ(s.top, 3100.0f + 100.0f);
+}
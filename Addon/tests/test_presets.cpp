@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+
+#include "cloud_presets.hpp"
+#include "preset_writer.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <regex>
+#include <sstream>
+
+using namespace pv::clouds;
+
+namespace
+{
+	using LayerValues = std::array<float, 44>;
+
+	// The weather names of the macro invocations
+	const std::map<std::string, Weather> WEATHER_NAMES = {
+		{ "Clear", Weather::CLEAR }, { "ExtraSunny", Weather::EXTRASUNNY }, { "Clouds", Weather::CLOUDS },
+		{ "Overcast", Weather::OVERCAST }, { "Rain", Weather::RAIN }, { "Clearing", Weather::CLEARING },
+		{ "Thunder", Weather::THUNDER }, { "Smog", Weather::SMOG }, { "Foggy", Weather::FOGGY },
+		{ "Snow", Weather::SNOW }, { "SnowLight", Weather::SNOWLIGHT }, { "Blizzard", Weather::BLIZZARD },
+		{ "Halloween", Weather::HALLOWEEN },
+	};
+
+	std::string shipped_weathers()
+	{
+		std::ifstream file(std::string(PULSEV_SHADER_DIR) + "/weathers.fxh", std::ios::binary);
+		std::ostringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	// The std::regex importer parse_weathers_fxh replaced, kept as the reference for what it must read
+	std::map<Weather, LayerValues> regex_import(const std::string &text)
+	{
+		std::map<Weather, LayerValues> out;
+
+		const std::regex call_re(R"(CLOUD_LAYER_PRESET\s*\(\s*([A-Za-z_]\w*)\s*,([\s\S]*?)\))");
+		const std::regex cmt_re(R"(\/\/[^\n\r]*)");
+		const std::regex num_re(R"([+-]?(?:\d+\.\d*|\.\d+|\d+))");
+
+		for (auto it = std::sregex_iterator(text.begin(), text.end(), call_re); it != std::sregex_iterator(); ++it)
+		{
+			const auto weather = WEATHER_NAMES.find((*it)[1].str());
+			if (weather == WEATHER_NAMES.end())
+				continue;
+
+			const std::string args = std::regex_replace((*it)[2].str(), cmt_re, std::string());
+			std::vector<float> nums;
+			for (auto jt = std::sregex_iterator(args.begin(), args.end(), num_re); jt != std::sregex_iterator(); ++jt)
+				nums.push_back(std::strtof(jt->str().c_str(), nullptr));
+			if (nums.size() != 44)
+				continue;
+
+			std::copy(nums.begin(), nums.end(), out[weather->second].begin());
+		}
+
+		return out;
+	}
+
+	// The macro's arguments of one layer, in the order of its parameters
+	std::array<float, 22> layer_values(const CloudLayer &layer)
+	{
+		return {
+			layer.scale, layer.detailScale, layer.stretch, layer.baseCurl, layer.detailCurl, layer.baseCurlScale,
+			layer.detailCurlScale, layer.smoothness, layer.softness, layer.bottom, layer.top, layer.cover,
+			layer.extinction, layer.ambientAmount, layer.absorption, layer.luminance, layer.sunLightPower, layer.moonLightPower,
+			layer.skyLightPower, layer.bottomDensity, layer.middleDensity, layer.topDensity,
+		};
+	}
+
+	LayerValues preset_values(const CloudPreset &preset)
+	{
+		LayerValues values;
+		const std::array<float, 22> bottom = layer_values(preset.bottomLayer), top = layer_values(preset.topLayer);
+		std::copy(bottom.begin(), bottom.end(), values.begin());
+		std::copy(top.begin(), top.end(), values.begin() + 22);
+		return values;
+	}
+}
+
+// Every preset of the shipped weathers.fxh, imported exactly as the std::regex importer did, at every hour
+TEST(PresetsTest, ImportsTheShippedWeathersLikeTheRegexImporter)
+{
+	const std::map<Weather, LayerValues> golden = regex_import(shipped_weathers());
+	ASSERT_EQ(golden.size(), WEATHER_NAMES.size());
+
+	PresetStore store;
+	ASSERT_TRUE(store.load_from_weathers_file(PULSEV_SHADER_DIR));
+
+	for (const auto &[weather, values] : golden)
+	{
+		for (int h = 0; h < 24; ++h)
+		{
+			const CloudPreset *const preset = store.try_get(weather, TimeBucket { h, 0 });
+			ASSERT_NE(preset, nullptr) << PresetStore::make_key(weather, TimeBucket { h, 0 });
+
+			// Bit for bit, so that a saved preset does not change by importing it again
+			const LayerValues imported = preset_values(*preset);
+			EXPECT_EQ(std::memcmp(imported.data(), values.data(), sizeof(values)), 0) << PresetStore::make_key(weather, TimeBucket { h, 0 });
+		}
+	}
+}
+
+// Weathers the file has no preset for take that of a similar one
+TEST(PresetsTest, FillsTheWeathersWithoutAPreset)
+{
+	PresetStore store;
+	ASSERT_TRUE(store.load_from_weathers_file(PULSEV_SHADER_DIR));
+	EXPECT_EQ(store.map.size(), static_cast<size_t>(Weather::COUNT) * 24);
+
+	for (const auto &[weather, like] : { std::pair(Weather::XMAS, Weather::SNOW), std::pair(Weather::NEUTRAL, Weather::CLEAR) })
+	{
+		const CloudPreset *const preset = store.try_get(weather, TimeBucket { 12, 0 });
+		ASSERT_NE(preset, nullptr);
+		EXPECT_EQ(preset_values(*preset), preset_values(*store.try_get(like, TimeBucket { 12, 0 })));
+	}
+}
+
+// A save that fails, because something holds the file for a moment, is written once it can be
+TEST(PresetsTest, RetriesASaveThatFailed)
+{
+	// A file where the presets' folder should be makes the write fail
+	const std::filesystem::path blocker = std::filesystem::temp_directory_path() / "pulsev_test_presets";
+	const std::string path = (blocker / "PulseV_Clouds.ini").string();
+	std::error_code ec;
+	std::filesystem::remove_all(blocker, ec);
+	std::ofstream(blocker).put('\n');
+
+	PresetWriter writer;
+	CloudPreset rain;
+	rain.cloudCover = 0.75f;
+	writer.enqueue_one(path, PresetStore::make_key(Weather::RAIN, TimeBucket { 12, 0 }), rain);
+	writer.flush();
+	EXPECT_TRUE(writer.last_failed());
+	EXPECT_TRUE(writer.busy());
+
+	// The failed save is still queued next to one made after it
+	std::filesystem::remove(blocker);
+	CloudPreset clear;
+	clear.cloudCover = 0.5f;
+	writer.enqueue_one(path, PresetStore::make_key(Weather::CLEAR, TimeBucket { 12, 0 }), clear);
+	writer.flush();
+	writer.stop();
+	EXPECT_FALSE(writer.last_failed());
+
+	PresetStore store;
+	ASSERT_TRUE(store.load(path));
+	ASSERT_NE(store.try_get(Weather::RAIN, TimeBucket { 12, 0 }), nullptr);
+	EXPECT_EQ(store.try_get(Weather::RAIN, TimeBucket { 12, 0 })->cloudCover, 0.75f);
+	ASSERT_NE(store.try_get(Weather::CLEAR, TimeBucket { 12, 0 }), nullptr);
+	EXPECT_EQ(store.try_get(Weather::CLEAR, TimeBucket { 12, 0 })->cloudCover, 0.5f);
+	std::filesystem::remove_all(blocker, ec);
+}
+
+// A preset whose section the file has twice is read back with the values it was saved with
+TEST(PresetsTest, SavesIntoARepeatedSection)
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "pulsev_test_repeated.ini";
+	std::ofstream(path) << "[RAIN_12:00]\ncloudCover=0.1\ncloudScale=2\n\n[CLEAR_12:00]\ncloudCover=0.2\n\n[RAIN_12:00]\ncloudCover=0.3\n";
+
+	PresetStore store;
+	ASSERT_TRUE(store.load(path.string()));
+	EXPECT_EQ(store.try_get(Weather::RAIN, TimeBucket { 12, 0 })->cloudCover, 0.3f);
+	EXPECT_EQ(store.try_get(Weather::RAIN, TimeBucket { 12, 0 })->cloudScale, 2.0f);
+
+	PresetWriter writer;
+	writer.mark_clean(store);
+	CloudPreset rain = *store.try_get(Weather::RAIN, TimeBucket { 12, 0 });
+	rain.cloudCover = 0.75f;
+	rain.cloudScale = 4.0f;
+	writer.enqueue_one(path.string(), PresetStore::make_key(Weather::RAIN, TimeBucket { 12, 0 }), rain);
+	writer.stop();
+	EXPECT_FALSE(writer.last_failed());
+
+	ASSERT_TRUE(store.load(path.string()));
+	EXPECT_EQ(store.try_get(Weather::RAIN, TimeBucket { 12, 0 })->cloudCover, 0.75f);
+	EXPECT_EQ(store.try_get(Weather::RAIN, TimeBucket { 12, 0 })->cloudScale, 4.0f);
+	EXPECT_EQ(store.try_get(Weather::CLEAR, TimeBucket { 12, 0 })->cloudCover, 0.2f);
+
+	// Keys missing from both go into the last one only
+	std::ifstream file(path);
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	EXPECT_EQ(text.find("cloudStretch="), text.rfind("cloudStretch="));
+	EXPECT_GT(text.find("cloudStretch="), text.rfind("[RAIN_12:00]"));
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "quality_controller.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using QualityController::Controller;
+
+namespace
+{
+	// Clouds time of a scene costing 'full_ms' at the preset's quality: proportional to the samples
+	// marched, with a deterministic +-'noise' relative jitter
+	struct Scene
+	{
+		float full_ms;
+		float noise = 0.0f;
+		uint32_t seed = 1;
+
+		float measure(const Controller &controller)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const float jitter = ((seed >> 8) / float(1 << 24)) * 2.0f - 1.0f;
+			return full_ms * controller.quality_scale() * (1.0f + noise * jitter);
+		}
+	};
+
+	// Levels after each of 'steps' measurements
+	std::vector<float> run(Controller &controller, Scene &scene, float budget_ms, int steps)
+	{
+		std::vector<float> levels;
+		for (int i = 0; i < steps; ++i)
+		{
+			controller.step(scene.measure(controller), budget_ms);
+			levels.push_back(controller.level);
+		}
+		return levels;
+	}
+
+	// Times the level changed direction
+	int reversals(const std::vector<float> &levels)
+	{
+		int count = 0;
+		int direction = 0;
+		for (size_t i = 1; i < levels.size(); ++i)
+		{
+			const int d = (levels[i] > levels[i - 1]) - (levels[i] < levels[i - 1]);
+			count += d != 0 && direction != 0 && d != direction;
+			direction = d != 0 ? d : direction;
+		}
+		return count;
+	}
+}
+
+TEST(QualityController, ConvergesToTheBudgetWithoutOscillating)
+{
+	struct Case { float full_ms, budget_ms, noise; };
+
+	for (const Case &c : { Case { 4.0f, 2.0f, 0.0f }, Case { 4.0f, 2.0f, 0.03f }, Case { 2.5f, 2.0f, 0.05f }, Case { 10.0f, 3.0f, 0.05f } })
+	{
+		Controller controller;
+		Scene scene { c.full_ms, c.noise };
+
+		run(controller, scene, c.budget_ms, 60);
+		const std::vector<float> settled = run(controller, scene, c.budget_ms, 300);
+
+		EXPECT_EQ(reversals(settled), 0) << c.full_ms << " ms scene, " << c.budget_ms << " ms budget";
+
+		const float cost = c.full_ms * controller.quality_scale();
+		EXPECT_LE(cost, c.budget_ms * QualityController::UPPER_BAND * (1.0f + c.noise));
+		EXPECT_GE(cost, c.budget_ms * QualityController::LOWER_BAND * (1.0f - c.noise));
+	}
+}
+
+TEST(QualityController, KeepsFullQualityUnderBudget)
+{
+	Controller controller;
+	Scene scene { 1.5f, 0.05f };
+
+	const std::vector<float> levels = run(controller, scene, 2.0f, 200);
+	EXPECT_TRUE(std::all_of(levels.begin(), levels.end(), [](float level) { return level == 1.0f; }));
+	EXPECT_FLOAT_EQ(controller.quality_scale(), 1.0f);
+	EXPECT_FLOAT_EQ(controller.distance_scale(), 1.0f);
+}
+
+TEST(QualityController, FollowsALoadChange)
+{
+	Controller controller;
+	Scene scene { 2.0f, 0.02f };
+
+	run(controller, scene, 2.5f, 50);
+	EXPECT_FLOAT_EQ(controller.level, 1.0f);
+
+	// A heavier scene is brought back within the budget in a few measurements
+	scene.full_ms = 6.0f;
+	run(controller, scene, 2.5f, 10);
+	EXPECT_LE(scene.full_ms * controller.quality_scale(), 2.5f * QualityController::UPPER_BAND * 1.02f);
+	EXPECT_LT(controller.level, 0.5f);
+
+	// And full quality comes back once it is light again, held back by the ceiling for a while
+	scene.full_ms = 2.0f;
+	run(controller, scene, 2.5f, 150);
+	EXPECT_FLOAT_EQ(controller.level, 1.0f);
+}
+
+TEST(QualityController, StopsAtTheLowestLevel)
+{
+	Controller controller;
+	Scene scene { 40.0f };
+
+	run(controller, scene, 2.0f, 50);
+	EXPECT_FLOAT_EQ(controller.level, 0.0f);
+	EXPECT_FLOAT_EQ(controller.quality_scale(), QualityController::MIN_QUALITY_SCALE);
+	EXPECT_FLOAT_EQ(controller.distance_scale(), QualityController::MIN_DISTANCE_SCALE);
+}
+
+TEST(QualityController, OvershootingStepUpLowersTheCeiling)
+{
+	Controller controller;
+	controller.level = 0.5f;
+	controller.ceiling = 0.5f;
+
+	// Under budget: steps up to the ceiling
+	EXPECT_TRUE(controller.step(1.0f, 2.0f));
+	EXPECT_FLOAT_EQ(controller.level, 0.51f);
+
+	// Over budget right after: steps down and does not retry that level for a while
+	EXPECT_TRUE(controller.step(2.4f, 2.0f));
+	EXPECT_FLOAT_EQ(controller.ceiling, 0.46f);
+	EXPECT_FLOAT_EQ(controller.level, 0.41f);
+}
@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+
+#include "data_reader.hpp"
+#include "injection.hpp"
+#include "mock_runtime.hpp"
+#include "reshade_host.hpp"
+#include "scripted_source.hpp"
+#include "temporal.hpp"
+
+#include <cmath>
+#include <set>
+
+namespace
+{
+	struct Vector4
+	{
+		float v[4];
+	};
+
+	// mul(v, m) of the effect, 'm' being the four float4 row uniforms named 'name'1..4
+	Vector4 mul(const Vector4 &v, const Harness::MockEffectRuntime &runtime, const std::string &name)
+	{
+		Vector4 result = {};
+		for (int k = 0; k < 4; ++k)
+		{
+			const Harness::MockUniform *const row = runtime.find(name + std::to_string(k + 1));
+			for (int c = 0; c < 4; ++c)
+				result.v[c] += v.v[k] * row->get_float(c);
+		}
+		return result;
+	}
+
+	// cameraRay(uv) of the effect, the point 'distance' meters along it
+	Vector4 point_along_ray(const Harness::MockEffectRuntime &runtime, float u, float v, float distance)
+	{
+		Vector4 view = mul({ { (1.0f - u) * 2.0f - 1.0f, v * 2.0f - 1.0f, 1.0f, 1.0f } }, runtime, "inputInverseProjectionMatrix");
+		for (int i = 0; i < 3; ++i)
+			view.v[i] /= view.v[3];
+
+		const Vector4 world = mul(view, runtime, "inputInverseViewMatrix");
+		const float length = std::sqrt(world.v[0] * world.v[0] + world.v[1] * world.v[1] + world.v[2] * world.v[2]);
+
+		Vector4 point = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		for (int i = 0; i < 3; ++i)
+		{
+			const float origin = runtime.find("inputInverseViewMatrix" + std::to_string(i + 1))->get_float(3);
+			point.v[i] = origin + world.v[i] / length * distance;
+		}
+		return point;
+	}
+
+	class ReprojectionTest : public ::testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			Harness::populate_pulsev_effect(runtime);
+
+			source.state.cam_pos = { { 100.0f, 200.0f, 50.0f } };
+			source.state.cam_rot = { { 10.0f, 0.0f, 30.0f } };
+			DataReader::register_data_reader(nullptr, &source);
+			DataReader::step();
+		}
+
+		void TearDown() override
+		{
+			DataReader::unregister_data_reader(nullptr);
+		}
+
+		void frame()
+		{
+			DataReader::step();
+			Injection::inject_frame(&runtime, clouds, now += 1.0 / 60.0, capture);
+		}
+
+		Harness::ScriptedSource source;
+		Harness::MockEffectRuntime runtime;
+		pv::clouds::CloudsState clouds;
+		UniformCapture::Writer capture;
+		double now = 0.0;
+	};
+}
+
+TEST(Temporal, HaltonSequence)
+{
+	EXPECT_FLOAT_EQ(Temporal::halton(1, 2), 0.5f);
+	EXPECT_FLOAT_EQ(Temporal::halton(2, 2), 0.25f);
+	EXPECT_FLOAT_EQ(Temporal::halton(3, 2), 0.75f);
+	EXPECT_FLOAT_EQ(Temporal::halton(1, 3), 1.0f / 3.0f);
+	EXPECT_FLOAT_EQ(Temporal::halton(2, 3), 2.0f / 3.0f);
+	EXPECT_FLOAT_EQ(Temporal::halton(4, 3), 4.0f / 9.0f);
+}
+
+TEST(Temporal, JitterCyclesThroughDistinctSubPixelOffsets)
+{
+	std::set<std::pair<float, float>> offsets;
+	const Float4x4 identity = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+	for (uint32_t i = 0; i < Temporal::JITTER_PHASES; ++i)
+	{
+		const Temporal::Frame &frame = Temporal::update({}, {}, {}, identity, identity);
+		EXPECT_GE(frame.jitter.v[0], -0.5f);
+		EXPECT_LT(frame.jitter.v[0], 0.5f);
+		EXPECT_GE(frame.jitter.v[1], -0.5f);
+		EXPECT_LT(frame.jitter.v[1], 0.5f);
+		offsets.insert({ frame.jitter.v[0], frame.jitter.v[1] });
+	}
+
+	EXPECT_EQ(offsets.size(), Temporal::JITTER_PHASES);
+}
+
+TEST(Temporal, InterleaveVisitsEveryCellOncePerCycle)
+{
+	const Float4x4 identity = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+	for (const int pixels : { 4, 16 })
+	{
+		Harness::set_config("PULSEV", "CloudInterleave", std::to_string(pixels));
+		Temporal::configure();
+
+		// Changing the pattern drops the history
+		EXPECT_TRUE(Temporal::update({}, {}, {}, identity, identity).camera_cut);
+
+		const int size = pixels == 16 ? 4 : 2;
+		std::set<std::pair<float, float>> cells;
+		std::pair<float, float> previous = { -1.0f, -1.0f };
+
+		for (int i = 0; i < pixels; ++i)
+		{
+			const Temporal::Frame &frame = Temporal::update({}, {}, {}, identity, identity);
+			EXPECT_EQ(frame.interleave_size, size);
+			EXPECT_FALSE(frame.camera_cut);
+
+			const std::pair<float, float> cell = { frame.interleave_offset.v[0], frame.interleave_offset.v[1] };
+			EXPECT_LT(cell.first, (float)size);
+			EXPECT_LT(cell.second, (float)size);
+			EXPECT_NE(cell, previous);
+			cells.insert(cell);
+			previous = cell;
+		}
+
+		EXPECT_EQ(cells.size(), (size_t)pixels);
+	}
+
+	Harness::clear_config();
+	Temporal::configure();
+}
+
+TEST(Temporal, CameraCutThresholds)
+{
+	EXPECT_FALSE(Temporal::is_camera_cut({ { 9.9f, 0.0f, 0.0f } }, {}));
+	EXPECT_TRUE(Temporal::is_camera_cut({ { 10.1f, 0.0f, 0.0f } }, {}));
+	EXPECT_TRUE(Temporal::is_camera_cut({ { 6.0f, 6.0f, 6.0f } }, {}));
+
+	EXPECT_FALSE(Temporal::is_camera_cut({}, { { 0.0f, 0.0f, 29.0f } }));
+	EXPECT_TRUE(Temporal::is_camera_cut({}, { { 0.0f, 0.0f, 31.0f } }));
+	EXPECT_TRUE(Temporal::is_camera_cut({}, { { -31.0f, 0.0f, 0.0f } }));
+
+	// Heading wrapping from 359 to 1 degree is a small turn
+	EXPECT_FALSE(Temporal::is_camera_cut({}, { { 0.0f, 0.0f, 358.0f } }));
+	EXPECT_FALSE(Temporal::is_camera_cut({}, { { 0.0f, 0.0f, -358.0f } }));
+}
+
+TEST(Temporal, MultiplyAppliesTheLeftMatrixFirst)
+{
+	const Float4x4 translation = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 2, 3, 1 } };
+	const Float4x4 scale = { { 2, 0, 0, 0 }, { 0, 3, 0, 0 }, { 0, 0, 4, 0 }, { 0, 0, 0, 1 } };
+
+	const Float4x4 product = Temporal::multiply(translation, scale);
+	EXPECT_FLOAT_EQ(product.r1.v[0], 2.0f);
+	EXPECT_FLOAT_EQ(product.r2.v[1], 3.0f);
+	EXPECT_FLOAT_EQ(product.r3.v[2], 4.0f);
+	// Translated first, then scaled
+	EXPECT_FLOAT_EQ(product.r4.v[0], 2.0f);
+	EXPECT_FLOAT_EQ(product.r4.v[1], 6.0f);
+	EXPECT_FLOAT_EQ(product.r4.v[2], 12.0f);
+	EXPECT_FLOAT_EQ(product.r4.v[3], 1.0f);
+}
+
+// What reprojectClouds does in the effect: a point seen through 'uv' last frame must land back on
+// 'uv' through the previous view projection, with w negative in front of the camera
+TEST_F(ReprojectionTest, StaticCameraMapsBackToTheSamePixel)
+{
+	frame();
+
+	for (const float v : { 0.1f, 0.5f, 0.9f })
+	{
+		for (const float u : { 0.1f, 0.5f, 0.9f })
+		{
+			const Vector4 clip = mul(point_along_ray(runtime, u, v, 300.0f), runtime, "inputPreviousViewProjection");
+			ASSERT_LT(clip.v[3], 0.0f);
+			EXPECT_NEAR(1.0f - (clip.v[0] / clip.v[3] + 1.0f) * 0.5f, u, 1e-3f);
+			EXPECT_NEAR((clip.v[1] / clip.v[3] + 1.0f) * 0.5f, v, 1e-3f);
+
+			// Behind the camera is rejected
+			const Vector4 behind = mul(point_along_ray(runtime, u, v, -300.0f), runtime, "inputPreviousViewProjection");
+			EXPECT_GT(behind.v[3], 0.0f);
+		}
+	}
+}
+
+TEST_F(ReprojectionTest, MovedCameraMapsBackToThePreviousPixel)
+{
+	frame();
+
+	Vector4 points[3][3];
+	const float uvs[3] = { 0.2f, 0.5f, 0.8f };
+	for (int y = 0; y < 3; ++y)
+	{
+		for (int x = 0; x < 3; ++x)
+			points[y][x] = point_along_ray(runtime, uvs[x], uvs[y], 500.0f);
+	}
+
+	// A move small enough not to be a camera cut
+	source.state.cam_pos = { { 103.0f, 198.0f, 51.0f } };
+	source.state.cam_rot = { { 12.0f, 0.0f, 34.0f } };
+	frame();
+	ASSERT_EQ(runtime.find("inputCameraCut")->get_int(), 0);
+
+	for (int y = 0; y < 3; ++y)
+	{
+		for (int x = 0; x < 3; ++x)
+		{
+			const Vector4 clip = mul(points[y][x], runtime, "inputPreviousViewProjection");
+			ASSERT_LT(clip.v[3], 0.0f);
+			EXPECT_NEAR(1.0f - (clip.v[0] / clip.v[3] + 1.0f) * 0.5f, uvs[x], 1e-3f);
+			EXPECT_NEAR((clip.v[1] / clip.v[3] + 1.0f) * 0.5f, uvs[y], 1e-3f);
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include "data_reader.hpp"
+#include "scripted_source.hpp"
+#include "trace_source.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace
+{
+	class TraceTest : public ::testing::Test
+	{
+	protected:
+		void TearDown() override
+		{
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+		}
+
+		// Records 'ticks' updates of the reader, the camera moving one meter and the clock one minute per tick
+		void record(int ticks, std::chrono::milliseconds interval = {})
+		{
+			Trace::RecordingDataSource recording(&game, path);
+			ASSERT_TRUE(recording.is_open());
+
+			DataReader::register_data_reader(nullptr, &recording);
+			for (int i = 0; i < ticks; ++i)
+			{
+				game.state.cam_pos = { { (float)i, 2.0f * i, 50.0f } };
+				game.state.time = 12.0f + i / 60.0f;
+				game.state.weather_transition = i / (float)ticks;
+				std::this_thread::sleep_for(interval);
+				DataReader::step();
+			}
+			DataReader::unregister_data_reader(nullptr);
+		}
+
+		const std::string path = (std::filesystem::temp_directory_path() / "pulsev_test_trace.pvtr").string();
+		Harness::ScriptedSource game;
+	};
+}
+
+TEST_F(TraceTest, ReplayFeedsTheReaderTheRecordedValues)
+{
+	record(10);
+
+	Trace::ReplayDataSource replay(path, false);
+	ASSERT_TRUE(replay.is_open());
+
+	DataReader::register_data_reader(nullptr, &replay);
+	for (int i = 0; i < 10; ++i)
+	{
+		ASSERT_FALSE(replay.finished());
+		DataReader::step();
+
+		EXPECT_FLOAT_EQ(DataReader::get_camera_pos().v[0], (float)i);
+		EXPECT_FLOAT_EQ(DataReader::get_camera_pos().v[1], 2.0f * i);
+		EXPECT_FLOAT_EQ(DataReader::get_weather_transition(), i / 10.0f);
+		EXPECT_FLOAT_EQ(DataReader::get_far_clip(), 10000.0f);
+	}
+	DataReader::unregister_data_reader(nullptr);
+
+	EXPECT_TRUE(replay.finished());
+	EXPECT_EQ(replay.tick_count(), 10u);
+}
+
+TEST_F(TraceTest, HostedRealtimeReplayFollowsTheRecordedClock)
+{
+	record(3, std::chrono::milliseconds(40));
+
+	Harness::ScriptedSource host;
+	Trace::ReplayDataSource replay(path, true, &host);
+	ASSERT_TRUE(replay.is_open());
+
+	// The game calls update faster than the recording ticked, the values are held
+	replay.update();
+	replay.update();
+	EXPECT_EQ(replay.tick_count(), 1u);
+	EXPECT_EQ(host.updates, 2u);
+
+	// And slower, the ticks it missed are applied at once without stalling it
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	replay.update();
+	EXPECT_EQ(replay.tick_count(), 3u);
+	EXPECT_TRUE(replay.finished());
+	EXPECT_FLOAT_EQ(replay.get_cam_pos().v[0], 2.0f);
+}
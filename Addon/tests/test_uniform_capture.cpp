@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "data_reader.hpp"
+#include "injection.hpp"
+#include "mock_runtime.hpp"
+#include "replay.hpp"
+#include "scripted_source.hpp"
+#include "trace_source.hpp"
+#include "uniform_capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	class UniformCaptureTest : public ::testing::Test
+	{
+	protected:
+		void TearDown() override
+		{
+			std::error_code ec;
+			for (const std::string &path : { golden, candidate, trace })
+				std::filesystem::remove(path, ec);
+		}
+
+		// Writes 'frames' frames holding 'value' under "value"
+		void write(const std::string &path, uint32_t frames, float value)
+		{
+			UniformCapture::Writer writer;
+			ASSERT_TRUE(writer.open(path, 0));
+			for (uint32_t i = 0; i < frames; ++i)
+			{
+				writer.begin_frame();
+				writer.record("value", UniformType(value));
+				writer.end_frame();
+			}
+		}
+
+		static std::string temp(const char *name)
+		{
+			return (std::filesystem::temp_directory_path() / name).string();
+		}
+
+		const std::string golden = temp("pulsev_test_golden.pvuc");
+		const std::string candidate = temp("pulsev_test_candidate.pvuc");
+		const std::string trace = temp("pulsev_test_capture_trace.pvtr");
+		UniformCapture::Tolerances tolerances;
+	};
+}
+
+TEST_F(UniformCaptureTest, MatchesWithinTolerance)
+{
+	write(golden, 3, 1.0f);
+	write(candidate, 3, 1.05f);
+
+	tolerances.fallback = 0.1f;
+	const UniformCapture::DiffResult result = UniformCapture::diff(golden, candidate, tolerances);
+	EXPECT_TRUE(result.ok);
+	EXPECT_TRUE(result.match);
+	EXPECT_EQ(result.frames_compared, 3u);
+
+	tolerances.by_name["value"] = 0.01f;
+	const UniformCapture::DiffResult tight = UniformCapture::diff(golden, candidate, tolerances);
+	EXPECT_FALSE(tight.match);
+	EXPECT_EQ(tight.first_frame, 0u);
+	EXPECT_EQ(tight.uniform, "value");
+}
+
+TEST_F(UniformCaptureTest, DifferentFrameCountsDoNotMatch)
+{
+	write(golden, 3, 1.0f);
+	write(candidate, 2, 1.0f);
+
+	const UniformCapture::DiffResult shorter = UniformCapture::diff(golden, candidate, tolerances);
+	EXPECT_TRUE(shorter.ok);
+	EXPECT_FALSE(shorter.match);
+	EXPECT_EQ(shorter.first_frame, 2u);
+
+	const UniformCapture::DiffResult longer = UniformCapture::diff(candidate, golden, tolerances);
+	EXPECT_FALSE(longer.match);
+	EXPECT_EQ(longer.first_frame, 2u);
+}
+
+TEST_F(UniformCaptureTest, RejectsValuesOfTheWrongSize)
+{
+	write(golden, 1, 1.0f);
+
+	// The same frame with the float's byte count patched to 2
+	std::ifstream in(golden, std::ios::binary);
+	std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	const size_t name = bytes.find("value");
+	ASSERT_NE(name, std::string::npos);
+	const uint16_t size = 2;
+	std::memcpy(&bytes[name + 5 + 1], &size, sizeof(size));
+	bytes.resize(name + 5 + 1 + sizeof(size) + size);
+	std::ofstream(candidate, std::ios::binary).write(bytes.data(), (std::streamsize)bytes.size());
+
+	std::vector<UniformCapture::Frame> frames;
+	EXPECT_TRUE(UniformCapture::read_capture(golden, frames));
+	EXPECT_FALSE(UniformCapture::read_capture(candidate, frames));
+	EXPECT_FALSE(UniformCapture::diff(golden, candidate, tolerances).ok);
+}
+
+TEST_F(UniformCaptureTest, HoldsTheCloudPresetWrites)
+{
+	Harness::ScriptedSource source;
+	Harness::MockEffectRuntime runtime;
+	Harness::populate_pulsev_effect(runtime);
+	DataReader::register_data_reader(nullptr, &source);
+	DataReader::step();
+
+	pv::clouds::CloudsState clouds;
+	clouds.rt = &runtime;
+	clouds.has_runtime = true;
+
+	UniformCapture::Writer writer;
+	ASSERT_TRUE(writer.open(golden, 1));
+	Injection::inject_frame(&runtime, clouds, 1.0, writer);
+	writer.close();
+	DataReader::unregister_data_reader(nullptr);
+
+	std::vector<UniformCapture::Frame> frames;
+	ASSERT_TRUE(UniformCapture::read_capture(golden, frames));
+	ASSERT_EQ(frames.size(), 1u);
+
+	const auto find = [&frames](const std::string &name) {
+		const auto &entries = frames[0].entries;
+		const auto it = std::find_if(entries.begin(), entries.end(), [&name](const UniformCapture::Entry &entry) { return entry.name == name; });
+		return it != entries.end() ? &*it : nullptr;
+	};
+
+	const UniformCapture::Entry *const cover = find("cloudCover");
+	ASSERT_NE(cover, nullptr);
+	EXPECT_EQ(cover->type, UniformCapture::FLOAT_ARRAY_TYPE);
+	EXPECT_EQ(cover->bytes.size(), sizeof(float));
+	EXPECT_NE(find("near_clip"), nullptr);
+}
+
+TEST_F(UniformCaptureTest, ReplayMatchesItsGolden)
+{
+	Harness::ScriptedSource game;
+	{
+		Trace::RecordingDataSource recording(&game, trace);
+		DataReader::register_data_reader(nullptr, &recording);
+		for (int i = 0; i < 20; ++i)
+		{
+			game.state.cam_pos = { { (float)i, 0.0f, 50.0f } };
+			game.state.time = 12.0f + i / 60.0f;
+			DataReader::step();
+		}
+		DataReader::unregister_data_reader(nullptr);
+	}
+
+	ASSERT_TRUE(tolerances.load(PULSEV_TESTS_DIR "/replay_tolerances.ini"));
+
+	Harness::ReplayOptions options;
+	options.capture_path = golden;
+	ASSERT_EQ(Harness::replay_trace(trace, options).frames, 20u);
+	options.capture_path = candidate;
+	ASSERT_EQ(Harness::replay_trace(trace, options).frames, 20u);
+
+	const UniformCapture::DiffResult result = UniformCapture::diff(golden, candidate, tolerances);
+	EXPECT_TRUE(result.match) << result.message;
+
+	// A replay cut short diverges at the first frame it did not reach
+	options.max_frames = 15;
+	Harness::replay_trace(trace, options);
+	const UniformCapture::DiffResult cut = UniformCapture::diff(golden, candidate, tolerances);
+	EXPECT_FALSE(cut.match);
+	EXPECT_EQ(cut.first_frame, 15u);
+}
@@ -0,0 +1,682 @@
+#include "trace_source.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <thread>
+#include <type_traits>
+
+namespace Trace
+{
+	/**
+	* Encoding
+	**/
+
+	template <typename T>
+	static void append(std::string &out, const T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+
+		out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	static void append_string(std::string &out, std::string_view value)
+	{
+		const uint16_t size = static_cast<uint16_t>(std::min<size_t>(value.size(), UINT16_MAX));
+
+		append(out, size);
+		out.append(value.data(), size);
+	}
+
+	template <typename T>
+	static std::string encode(const T &value)
+	{
+		std::string out;
+		append(out, value);
+		return out;
+	}
+
+	static std::string encode_frame(const TimeCycle::WeatherFrame &frame)
+	{
+		std::string out;
+
+		append(out, static_cast<uint32_t>(frame.floats.size()));
+		for (const auto &[name, value] : frame.floats)
+		{
+			append_string(out, name);
+			append(out, value);
+		}
+
+		append(out, static_cast<uint32_t>(frame.colors.size()));
+		for (const auto &[name, value] : frame.colors)
+		{
+			append_string(out, name);
+			append(out, value);
+		}
+
+		return out;
+	}
+
+	struct Reader
+	{
+		const std::vector<char> &buffer;
+		size_t &cursor;
+		bool ok = true;
+
+		template <typename T>
+		T read()
+		{
+			T value = {};
+
+			if (!ok || cursor + sizeof(T) > buffer.size())
+			{
+				ok = false;
+				return value;
+			}
+
+			std::memcpy(&value, buffer.data() + cursor, sizeof(T));
+			cursor += sizeof(T);
+
+			return value;
+		}
+
+		std::string read_string()
+		{
+			const uint16_t size = read<uint16_t>();
+
+			if (!ok || cursor + size > buffer.size())
+			{
+				ok = false;
+				return {};
+			}
+
+			std::string value(buffer.data() + cursor, size);
+			cursor += size;
+
+			return value;
+		}
+
+		TimeCycle::WeatherFrame read_frame()
+		{
+			TimeCycle::WeatherFrame frame;
+
+			for (uint32_t i = 0, count = read<uint32_t>(); ok && i < count; i++)
+			{
+				std::string name = read_string();
+				frame.floats[name] = read<float>();
+			}
+
+			for (uint32_t i = 0, count = read<uint32_t>(); ok && i < count; i++)
+			{
+				std::string name = read_string();
+				frame.colors[name] = read<Float4>();
+			}
+
+			return frame;
+		}
+	};
+
+	/**
+	* Recording
+	**/
+
+	RecordingDataSource::RecordingDataSource(DataSource *inner, const std::string &path) :
+		inner(inner), start(std::chrono::steady_clock::now())
+	{
+		std::error_code ec;
+		const std::filesystem::path target(path);
+
+		if (target.has_parent_path())
+		{
+			std::filesystem::create_directories(target.parent_path(), ec);
+		}
+
+		file.open(target, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			reshade::log::message(reshade::log::level::error, ("Failed to open trace " + path + " for recording").c_str());
+			return;
+		}
+
+		file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+		file.write(reinterpret_cast<const char *>(&TRACE_VERSION), sizeof(TRACE_VERSION));
+
+		reshade::log::message(reshade::log::level::info, ("Recording game data to " + path).c_str());
+	}
+
+	RecordingDataSource::~RecordingDataSource()
+	{
+		if (file.is_open())
+		{
+			file.close();
+			reshade::log::message(reshade::log::level::info, std::format("Recorded {} ticks of game data", ticks).c_str());
+		}
+	}
+
+	void RecordingDataSource::put(Field field, const std::string &payload)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		std::string &last = last_written[static_cast<size_t>(field)];
+
+		if (field != Field::Tick && last == payload)
+		{
+			return;
+		}
+
+		file.put(static_cast<char>(field));
+		file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+		last = payload;
+	}
+
+	// Names are keyed by id and written once each, so they skip the same-as-last check in put()
+	void RecordingDataSource::put_name(Field field, int id, std::string_view name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &written = field == Field::RegionName ? region_names_written : weather_names_written;
+
+		if (!file.is_open() || !written.insert(id).second)
+		{
+			return;
+		}
+
+		std::string payload = encode(static_cast<int32_t>(id));
+		append_string(payload, name);
+
+		file.put(static_cast<char>(field));
+		file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+	}
+
+	const bool RecordingDataSource::get_depth_reversed()
+	{
+		const bool value = inner->get_depth_reversed();
+		put(Field::DepthReversed, encode(static_cast<uint8_t>(value)));
+		return value;
+	}
+
+	const std::string_view RecordingDataSource::get_region_name(int region)
+	{
+		const std::string_view value = inner->get_region_name(region);
+		put_name(Field::RegionName, region, value);
+		return value;
+	}
+
+	const std::string_view RecordingDataSource::get_weather_name(int weather)
+	{
+		const std::string_view value = inner->get_weather_name(weather);
+		put_name(Field::WeatherName, weather, value);
+		return value;
+	}
+
+	const UInt2 RecordingDataSource::get_resolution()
+	{
+		const UInt2 value = inner->get_resolution();
+		put(Field::Resolution, encode(value));
+		return value;
+	}
+
+	const Float3 RecordingDataSource::get_cam_pos()
+	{
+		const Float3 value = inner->get_cam_pos();
+		put(Field::CamPos, encode(value));
+		return value;
+	}
+
+	const Float3 RecordingDataSource::get_cam_rot()
+	{
+		const Float3 value = inner->get_cam_rot();
+		put(Field::CamRot, encode(value));
+		return value;
+	}
+
+	const float RecordingDataSource::get_cam_fov()
+	{
+		const float value = inner->get_cam_fov();
+		put(Field::CamFov, encode(value));
+		return value;
+	}
+
+	const float RecordingDataSource::get_cam_near_clip()
+	{
+		const float value = inner->get_cam_near_clip();
+		put(Field::CamNearClip, encode(value));
+		return value;
+	}
+
+	const float RecordingDataSource::get_cam_far_clip()
+	{
+		const float value = inner->get_cam_far_clip();
+		put(Field::CamFarClip, encode(value));
+		return value;
+	}
+
+	const float RecordingDataSource::get_time()
+	{
+		const float value = inner->get_time();
+		put(Field::Time, encode(value));
+		return value;
+	}
+
+	const float RecordingDataSource::get_time_scale()
+	{
+		const float value = inner->get_time_scale();
+		put(Field::TimeScale, encode(value));
+		return value;
+	}
+
+	const int RecordingDataSource::get_region(const Float3 &pos)
+	{
+		const int value = inner->get_region(pos);
+		put(Field::Region, encode(static_cast<int32_t>(value)));
+		return value;
+	}
+
+	const int RecordingDataSource::get_weather_from()
+	{
+		const int value = inner->get_weather_from();
+		put(Field::WeatherFrom, encode(static_cast<int32_t>(value)));
+		return value;
+	}
+
+	const int RecordingDataSource::get_weather_to()
+	{
+		const int value = inner->get_weather_to();
+		put(Field::WeatherTo, encode(static_cast<int32_t>(value)));
+		return value;
+	}
+
+	const float RecordingDataSource::get_weather_transition()
+	{
+		const float value = inner->get_weather_transition();
+		put(Field::WeatherTransition, encode(value));
+		return value;
+	}
+
+	const TimeCycle::WeatherFrame RecordingDataSource::get_weather_frame(TimeCycle::RegionalWeather &from, TimeCycle::RegionalWeather &to, float time, float transition_progress)
+	{
+		const TimeCycle::WeatherFrame value = inner->get_weather_frame(from, to, time, transition_progress);
+		put(Field::WeatherFrame, encode_frame(value));
+		return value;
+	}
+
+	const bool RecordingDataSource::get_aurora_visibility()
+	{
+		const bool value = inner->get_aurora_visibility();
+		put(Field::AuroraVisibility, encode(static_cast<uint8_t>(value)));
+		return value;
+	}
+
+	const Float3 RecordingDataSource::get_moon_dir()
+	{
+		const Float3 value = inner->get_moon_dir();
+		put(Field::MoonDir, encode(value));
+		return value;
+	}
+
+	void RecordingDataSource::load_timecycle()
+	{
+		inner->load_timecycle();
+	}
+
+	void RecordingDataSource::wait(DWORD time)
+	{
+		inner->wait(time);
+	}
+
+	void RecordingDataSource::update()
+	{
+		const int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		put(Field::Tick, encode(elapsed_ns));
+		ticks++;
+
+		inner->update();
+	}
+
+	void RecordingDataSource::register_script(HMODULE hModule, void(*entry)())
+	{
+		inner->register_script(hModule, entry);
+	}
+
+	void RecordingDataSource::unregister_script(HMODULE hModule)
+	{
+		inner->unregister_script(hModule);
+	}
+
+	/**
+	* Replay
+	**/
+
+	ReplayDataSource::ReplayDataSource(const std::string &path, bool realtime, DataSource *host) :
+		host(host), realtime(realtime)
+	{
+		std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+
+		if (!file)
+		{
+			reshade::log::message(reshade::log::level::error, ("Failed to open trace " + path + " for replay").c_str());
+			return;
+		}
+
+		const std::streamoff size = file.tellg();
+
+		if (size < static_cast<std::streamoff>(sizeof(TRACE_MAGIC) + sizeof(TRACE_VERSION)))
+		{
+			reshade::log::message(reshade::log::level::error, ("Trace " + path + " is empty").c_str());
+			return;
+		}
+
+		buffer.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(buffer.data(), size);
+
+		Reader reader { buffer, cursor };
+		char magic[sizeof(TRACE_MAGIC)];
+
+		for (char &c : magic)
+		{
+			c = reader.read<char>();
+		}
+
+		const uint32_t version = reader.read<uint32_t>();
+
+		if (!file || std::memcmp(magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || version != TRACE_VERSION)
+		{
+			reshade::log::message(reshade::log::level::error, ("Trace " + path + " is not a supported PulseV trace").c_str());
+			buffer.clear();
+			cursor = 0;
+			return;
+		}
+
+		// Values queried before the first update (depth_reversed at startup) precede the first Tick
+		apply_until_tick();
+
+		reshade::log::message(reshade::log::level::info, ("Replaying game data from " + path).c_str());
+	}
+
+	bool ReplayDataSource::apply_until_tick()
+	{
+		Reader reader { buffer, cursor };
+
+		while (cursor < buffer.size() && static_cast<Field>(buffer[cursor]) != Field::Tick)
+		{
+			const size_t record = cursor;
+			const Field field = static_cast<Field>(reader.read<uint8_t>());
+
+			switch (field)
+			{
+			case Field::DepthReversed: state.depth_reversed = reader.read<uint8_t>() != 0; break;
+			case Field::Resolution: state.resolution = reader.read<UInt2>(); break;
+			case Field::CamPos: state.cam_pos = reader.read<Float3>(); break;
+			case Field::CamRot: state.cam_rot = reader.read<Float3>(); break;
+			case Field::CamFov: state.cam_fov = reader.read<float>(); break;
+			case Field::CamNearClip: state.cam_near_clip = reader.read<float>(); break;
+			case Field::CamFarClip: state.cam_far_clip = reader.read<float>(); break;
+			case Field::Time: state.time = reader.read<float>(); break;
+			case Field::TimeScale: state.time_scale = reader.read<float>(); break;
+			case Field::Region: state.region = reader.read<int32_t>(); break;
+			case Field::WeatherFrom: state.weather_from = reader.read<int32_t>(); break;
+			case Field::WeatherTo: state.weather_to = reader.read<int32_t>(); break;
+			case Field::WeatherTransition: state.weather_transition = reader.read<float>(); break;
+			case Field::WeatherFrame: state.weather_frame = reader.read_frame(); break;
+			case Field::AuroraVisibility: state.aurora_visibility = reader.read<uint8_t>() != 0; break;
+			case Field::MoonDir: state.moon_dir = reader.read<Float3>(); break;
+			case Field::RegionName:
+			{
+				const int32_t id = reader.read<int32_t>();
+				state.region_names[id] = reader.read_string();
+				break;
+			}
+			case Field::WeatherName:
+			{
+				const int32_t id = reader.read<int32_t>();
+				state.weather_names[id] = reader.read_string();
+				break;
+			}
+			default:
+				reader.ok = false;
+				break;
+			}
+
+			if (!reader.ok)
+			{
+				reshade::log::message(reshade::log::level::error, std::format("Malformed trace record at offset {}, replay stopped", record).c_str());
+				cursor = buffer.size();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const bool ReplayDataSource::get_depth_reversed()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.depth_reversed;
+	}
+
+	const std::string_view ReplayDataSource::get_region_name(int region)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = state.region_names.find(region);
+		return it != state.region_names.end() ? std::string_view(it->second) : std::string_view();
+	}
+
+	const std::string_view ReplayDataSource::get_weather_name(int weather)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = state.weather_names.find(weather);
+		return it != state.weather_names.end() ? std::string_view(it->second) : std::string_view();
+	}
+
+	const UInt2 ReplayDataSource::get_resolution()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.resolution;
+	}
+
+	const Float3 ReplayDataSource::get_cam_pos()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.cam_pos;
+	}
+
+	const Float3 ReplayDataSource::get_cam_rot()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.cam_rot;
+	}
+
+	const float ReplayDataSource::get_cam_fov()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.cam_fov;
+	}
+
+	const float ReplayDataSource::get_cam_near_clip()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.cam_near_clip;
+	}
+
+	const float ReplayDataSource::get_cam_far_clip()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.cam_far_clip;
+	}
+
+	const float ReplayDataSource::get_time()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.time;
+	}
+
+	const float ReplayDataSource::get_time_scale()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.time_scale;
+	}
+
+	const int ReplayDataSource::get_region(const Float3 &pos)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.region;
+	}
+
+	const int ReplayDataSource::get_weather_from()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.weather_from;
+	}
+
+	const int ReplayDataSource::get_weather_to()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.weather_to;
+	}
+
+	const float ReplayDataSource::get_weather_transition()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.weather_transition;
+	}
+
+	// The recorded frame is returned as is, so replay does not need the timecycle files
+	const TimeCycle::WeatherFrame ReplayDataSource::get_weather_frame(TimeCycle::RegionalWeather &from, TimeCycle::RegionalWeather &to, float time, float transition_progress)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.weather_frame;
+	}
+
+	const bool ReplayDataSource::get_aurora_visibility()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.aurora_visibility;
+	}
+
+	const Float3 ReplayDataSource::get_moon_dir()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return state.moon_dir;
+	}
+
+	void ReplayDataSource::load_timecycle()
+	{
+	}
+
+	void ReplayDataSource::wait(DWORD time)
+	{
+		if (host != nullptr)
+		{
+			host->wait(time);
+		}
+	}
+
+	// Consumes the Tick record at the cursor and the values following it
+	bool ReplayDataSource::apply_tick()
+	{
+		Reader reader { buffer, cursor };
+		reader.read<uint8_t>(); // Tick
+		tick_time_ns = reader.read<int64_t>();
+
+		if (!reader.ok)
+		{
+			cursor = buffer.size();
+			return false;
+		}
+
+		ticks++;
+
+		return apply_until_tick();
+	}
+
+	// Recorded time of the Tick record at the cursor
+	int64_t ReplayDataSource::next_tick_time() const
+	{
+		int64_t time = 0;
+
+		if (cursor + 1 + sizeof(time) <= buffer.size())
+		{
+			std::memcpy(&time, buffer.data() + cursor + 1, sizeof(time));
+		}
+
+		return time;
+	}
+
+	// Advances to the next recorded tick, or as fast as update() is called when not realtime.
+	// In realtime mode without a host this sleeps until the tick's recorded time. With a host the
+	// game paces update() and must not be stalled, so every tick due by now is applied at once and
+	// the values are held while the game runs ahead of the recording.
+	void ReplayDataSource::update()
+	{
+		if (host != nullptr)
+		{
+			host->update();
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if (cursor >= buffer.size())
+		{
+			if (!reported_end && !buffer.empty())
+			{
+				reported_end = true;
+				reshade::log::message(reshade::log::level::info, std::format("Trace replay finished after {} ticks, holding the last values", ticks).c_str());
+			}
+			return;
+		}
+
+		// The recording's clock starts with the first update, not when the trace was loaded
+		if (ticks == 0)
+		{
+			start = std::chrono::steady_clock::now() - std::chrono::nanoseconds(next_tick_time());
+		}
+
+		if (!realtime)
+		{
+			apply_tick();
+			return;
+		}
+
+		if (host != nullptr)
+		{
+			const int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			while (cursor < buffer.size() && next_tick_time() <= elapsed_ns)
+			{
+				apply_tick();
+			}
+			return;
+		}
+
+		const auto due = start + std::chrono::nanoseconds(next_tick_time());
+
+		lock.unlock();
+		std::this_thread::sleep_until(due);
+		lock.lock();
+
+		apply_tick();
+	}
+
+	void ReplayDataSource::register_script(HMODULE hModule, void(*entry)())
+	{
+		if (host != nullptr)
+		{
+			host->register_script(hModule, entry);
+		}
+	}
+
+	void ReplayDataSource::unregister_script(HMODULE hModule)
+	{
+		if (host != nullptr)
+		{
+			host->unregister_script(hModule);
+		}
+	}
+}
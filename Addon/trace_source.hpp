@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "game_data_source.hpp"
+
+// Binary traces of every game value a DataSource hands to the reader.
+//
+// A trace starts with TRACE_MAGIC and TRACE_VERSION, followed by records of
+// [uint8 field][payload]. A Tick record (int64 nanoseconds since recording started)
+// opens each update() and the values queried during that tick follow it.
+// A value is only written when it differs from the last one written for its field,
+// so a still camera or a steady weather costs nothing per tick.
+namespace Trace
+{
+	constexpr char TRACE_MAGIC[4] = { 'P', 'V', 'T', 'R' };
+	constexpr uint32_t TRACE_VERSION = 1;
+
+	enum class Field : uint8_t
+	{
+		Tick,
+		DepthReversed,
+		Resolution,
+		CamPos,
+		CamRot,
+		CamFov,
+		CamNearClip,
+		CamFarClip,
+		Time,
+		TimeScale,
+		Region,
+		WeatherFrom,
+		WeatherTo,
+		WeatherTransition,
+		WeatherFrame,
+		AuroraVisibility,
+		MoonDir,
+		RegionName,
+		WeatherName,
+		Count
+	};
+
+	// Last known value of every field, as seen by the reader
+	struct State
+	{
+		bool depth_reversed = false;
+		UInt2 resolution = {};
+		Float3 cam_pos = {};
+		Float3 cam_rot = {};
+		float cam_fov = 0.0f;
+		float cam_near_clip = 0.0f;
+		float cam_far_clip = 0.0f;
+		float time = 0.0f;
+		float time_scale = 1.0f;
+		int region = 0;
+		int weather_from = 0;
+		int weather_to = 0;
+		float weather_transition = 0.0f;
+		TimeCycle::WeatherFrame weather_frame;
+		bool aurora_visibility = false;
+		Float3 moon_dir = {};
+		std::unordered_map<int, std::string> region_names;
+		std::unordered_map<int, std::string> weather_names;
+	};
+
+	// Wraps another source, forwards every call to it and appends the results to a trace file
+	struct RecordingDataSource : DataSource
+	{
+		RecordingDataSource(DataSource *inner, const std::string &path);
+		~RecordingDataSource();
+
+		bool is_open() const { return file.is_open(); }
+
+		const bool get_depth_reversed() override;
+		const std::string_view get_region_name(int region) override;
+		const std::string_view get_weather_name(int weather) override;
+		const UInt2 get_resolution() override;
+		const Float3 get_cam_pos() override;
+		const Float3 get_cam_rot() override;
+		const float get_cam_fov() override;
+		const float get_cam_near_clip() override;
+		const float get_cam_far_clip() override;
+		const float get_time() override;
+		const float get_time_scale() override;
+		const int get_region(const Float3 &pos) override;
+		const int get_weather_from() override;
+		const int get_weather_to() override;
+		const float get_weather_transition() override;
+		const TimeCycle::WeatherFrame get_weather_frame(TimeCycle::RegionalWeather &from, TimeCycle::RegionalWeather &to, float time, float transition_progress) override;
+		const bool get_aurora_visibility() override;
+		const Float3 get_moon_dir() override;
+		void load_timecycle() override;
+		void wait(DWORD time) override;
+		void update() override;
+		void register_script(HMODULE hModule, void(*entry)()) override;
+		void unregister_script(HMODULE hModule) override;
+
+	private:
+		void put(Field field, const std::string &payload);
+		void put_name(Field field, int id, std::string_view name);
+
+		DataSource *inner;
+		std::ofstream file;
+		std::mutex mutex; // update() and fast_update() query from different threads
+		std::chrono::steady_clock::time_point start;
+		std::array<std::string, static_cast<size_t>(Field::Count)> last_written;
+		std::unordered_set<int> region_names_written;
+		std::unordered_set<int> weather_names_written;
+		uint64_t ticks = 0;
+	};
+
+	// Feeds a recorded trace back, one tick per update(), or at the recorded pace when realtime.
+	// With a host source the script still runs inside the game (register_script and wait go to the host),
+	// without one the caller drives the reader itself (DataReader::step, as the headless replay does).
+	struct ReplayDataSource : DataSource
+	{
+		ReplayDataSource(const std::string &path, bool realtime, DataSource *host = nullptr);
+
+		bool is_open() const { return !buffer.empty(); }
+		bool finished() const { return cursor >= buffer.size(); }
+		uint64_t tick_count() const { return ticks; }
+		// Recorded time of the last applied tick
+		double tick_seconds() const { return tick_time_ns / 1e9; }
+
+		const bool get_depth_reversed() override;
+		const std::string_view get_region_name(int region) override;
+		const std::string_view get_weather_name(int weather) override;
+		const UInt2 get_resolution() override;
+		const Float3 get_cam_pos() override;
+		const Float3 get_cam_rot() override;
+		const float get_cam_fov() override;
+		const float get_cam_near_clip() override;
+		const float get_cam_far_clip() override;
+		const float get_time() override;
+		const float get_time_scale() override;
+		const int get_region(const Float3 &pos) override;
+		const int get_weather_from() override;
+		const int get_weather_to() override;
+		const float get_weather_transition() override;
+		const TimeCycle::WeatherFrame get_weather_frame(TimeCycle::RegionalWeather &from, TimeCycle::RegionalWeather &to, float time, float transition_progress) override;
+		const bool get_aurora_visibility() override;
+		const Float3 get_moon_dir() override;
+		void load_timecycle() override;
+		void wait(DWORD time) override;
+		void update() override;
+		void register_script(HMODULE hModule, void(*entry)()) override;
+		void unregister_script(HMODULE hModule) override;
+
+	private:
+		// Applies records up to (not including) the next Tick, returns false on a malformed record
+		bool apply_until_tick();
+		bool apply_tick();
+		int64_t next_tick_time() const;
+
+		DataSource *host;
+		bool realtime;
+		std::vector<char> buffer;
+		size_t cursor = 0;
+		std::mutex mutex;
+		State state;
+		int64_t tick_time_ns = 0;
+		std::chrono::steady_clock::time_point start;
+		uint64_t ticks = 0;
+		bool reported_end = false;
+	};
+}
@@ -0,0 +1,414 @@
+#include "uniform_capture.hpp"
+#include "util/IniLite.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <utility>
+
+namespace UniformCapture
+{
+	template <typename T>
+	static void append(std::string &out, const T &value)
+	{
+		out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	/**
+	* Writer
+	**/
+
+	bool Writer::open(const std::string &path, uint32_t max_frames)
+	{
+		close();
+
+		std::error_code ec;
+		const std::filesystem::path target(path);
+
+		if (target.has_parent_path())
+		{
+			std::filesystem::create_directories(target.parent_path(), ec);
+		}
+
+		file.open(target, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			reshade::log::message(reshade::log::level::error, ("Failed to open " + path + " for uniform capture").c_str());
+			return false;
+		}
+
+		file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+		file.write(reinterpret_cast<const char *>(&CAPTURE_VERSION), sizeof(CAPTURE_VERSION));
+
+		this->path = path;
+		this->max_frames = max_frames;
+		frames = 0;
+
+		reshade::log::message(reshade::log::level::info, ("Capturing uniforms to " + path).c_str());
+
+		return true;
+	}
+
+	void Writer::close()
+	{
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		file.close();
+		in_frame = false;
+
+		reshade::log::message(reshade::log::level::info, std::format("Captured {} frames of uniforms to {}", frames, path).c_str());
+	}
+
+	void Writer::begin_frame()
+	{
+		block.clear();
+		recorded.clear();
+		count = 0;
+		in_frame = file.is_open() && !is_full();
+	}
+
+	// Writes the entry header, false when the entry is not to be recorded
+	bool Writer::begin_entry(std::string_view name, uint8_t type, size_t byte_count)
+	{
+		if (!in_frame || byte_count > UINT16_MAX || !recorded.emplace(name).second)
+		{
+			return false;
+		}
+
+		const uint16_t name_size = static_cast<uint16_t>(std::min<size_t>(name.size(), UINT16_MAX));
+
+		append(block, name_size);
+		block.append(name.data(), name_size);
+		append(block, type);
+		append(block, static_cast<uint16_t>(byte_count));
+
+		count++;
+
+		return true;
+	}
+
+	void Writer::record(std::string_view name, const UniformType &value)
+	{
+		std::visit([&](const auto &v) {
+			if (begin_entry(name, static_cast<uint8_t>(value.index()), sizeof(v)))
+			{
+				append(block, v);
+			}
+		}, value);
+	}
+
+	void Writer::record_floats(std::string_view name, const float *values, size_t count)
+	{
+		if (begin_entry(name, FLOAT_ARRAY_TYPE, count * sizeof(float)))
+		{
+			block.append(reinterpret_cast<const char *>(values), count * sizeof(float));
+		}
+	}
+
+	void Writer::end_frame()
+	{
+		if (!in_frame)
+		{
+			return;
+		}
+
+		in_frame = false;
+
+		file.write(reinterpret_cast<const char *>(&frames), sizeof(frames));
+		file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		file.write(block.data(), static_cast<std::streamsize>(block.size()));
+		frames++;
+	}
+
+	/**
+	* Tolerances
+	**/
+
+	bool Tolerances::load(const std::string &path)
+	{
+		pv::ini::Ini ini;
+
+		if (!ini.load(path))
+		{
+			return false;
+		}
+
+		// In file order, so that a tolerance given again, even in another [Tolerance] section, wins
+		for (const pv::ini::Section &section : ini.sections())
+		{
+			if (section.name != "Tolerance")
+			{
+				continue;
+			}
+
+			for (uint32_t i = 0; i < section.count; i++)
+			{
+				const pv::ini::Entry &entry = section.entries[i];
+				float value = 0.0f;
+
+				if (!pv::ini::parse_float(entry.value, value))
+				{
+					continue;
+				}
+
+				if (entry.key == "default")
+				{
+					fallback = value;
+				}
+				else
+				{
+					by_name[std::string(entry.key)] = value;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	float Tolerances::get(const std::string &name) const
+	{
+		const auto it = by_name.find(name);
+		return it != by_name.end() ? it->second : fallback;
+	}
+
+	/**
+	* Reading & diffing
+	**/
+
+	template <size_t... I>
+	static size_t alternative_size(size_t index, std::index_sequence<I...>)
+	{
+		constexpr size_t sizes[] = { sizeof(std::variant_alternative_t<I, UniformType>)... };
+		return sizes[index];
+	}
+
+	// Whether 'byte_count' is the size of a value of 'type'
+	static bool valid_size(uint8_t type, size_t byte_count)
+	{
+		if (type == FLOAT_ARRAY_TYPE)
+		{
+			return byte_count != 0 && byte_count % sizeof(float) == 0;
+		}
+
+		return type < std::variant_size_v<UniformType> &&
+			byte_count == alternative_size(type, std::make_index_sequence<std::variant_size_v<UniformType>>());
+	}
+
+	bool read_capture(const std::string &path, std::vector<Frame> &frames)
+	{
+		std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		const std::streamoff size = file.tellg();
+		std::vector<char> buffer(static_cast<size_t>(std::max<std::streamoff>(size, 0)));
+
+		file.seekg(0);
+		file.read(buffer.data(), size);
+
+		size_t cursor = 0;
+		bool ok = static_cast<bool>(file);
+
+		const auto read = [&](void *out, size_t bytes) {
+			if (!ok || cursor + bytes > buffer.size())
+			{
+				ok = false;
+				return;
+			}
+
+			std::memcpy(out, buffer.data() + cursor, bytes);
+			cursor += bytes;
+		};
+
+		char magic[sizeof(CAPTURE_MAGIC)] = {};
+		uint32_t version = 0;
+
+		read(magic, sizeof(magic));
+		read(&version, sizeof(version));
+
+		if (!ok || std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0 || version != CAPTURE_VERSION)
+		{
+			return false;
+		}
+
+		frames.clear();
+
+		while (ok && cursor < buffer.size())
+		{
+			Frame &frame = frames.emplace_back();
+			uint32_t count = 0;
+
+			read(&frame.index, sizeof(frame.index));
+			read(&count, sizeof(count));
+
+			for (uint32_t i = 0; ok && i < count; i++)
+			{
+				Entry &entry = frame.entries.emplace_back();
+				uint16_t name_size = 0;
+				uint16_t byte_count = 0;
+
+				read(&name_size, sizeof(name_size));
+				entry.name.resize(name_size);
+				read(entry.name.data(), name_size);
+				read(&entry.type, sizeof(entry.type));
+				read(&byte_count, sizeof(byte_count));
+				entry.bytes.resize(byte_count);
+				read(entry.bytes.data(), byte_count);
+
+				ok = ok && valid_size(entry.type, byte_count);
+			}
+		}
+
+		return ok;
+	}
+
+	// Largest per-component difference, bool and int compare as integers and everything else as floats
+	static float max_difference(const Entry &a, const Entry &b)
+	{
+		if (a.type == 0)
+		{
+			return a.bytes[0] != b.bytes[0] ? 1.0f : 0.0f;
+		}
+
+		if (a.type == 1)
+		{
+			int32_t va = 0;
+			int32_t vb = 0;
+			std::memcpy(&va, a.bytes.data(), sizeof(va));
+			std::memcpy(&vb, b.bytes.data(), sizeof(vb));
+			return static_cast<float>(std::abs(static_cast<int64_t>(va) - vb));
+		}
+
+		float result = 0.0f;
+
+		for (size_t i = 0; i + sizeof(float) <= a.bytes.size(); i += sizeof(float))
+		{
+			float va = 0.0f;
+			float vb = 0.0f;
+			std::memcpy(&va, a.bytes.data() + i, sizeof(va));
+			std::memcpy(&vb, b.bytes.data() + i, sizeof(vb));
+
+			// Bit-identical values (including NaNs) are never a difference
+			if (std::memcmp(&va, &vb, sizeof(float)) == 0)
+			{
+				continue;
+			}
+
+			const float d = std::fabs(va - vb);
+			result = std::isnan(d) ? INFINITY : std::max(result, d);
+		}
+
+		return result;
+	}
+
+	DiffResult diff(const std::string &golden_path, const std::string &candidate_path, const Tolerances &tolerances)
+	{
+		DiffResult result;
+		std::vector<Frame> golden;
+		std::vector<Frame> candidate;
+
+		if (!read_capture(golden_path, golden))
+		{
+			result.message = "Could not read golden capture " + golden_path;
+			return result;
+		}
+
+		if (!read_capture(candidate_path, candidate))
+		{
+			result.message = "Could not read capture " + candidate_path;
+			return result;
+		}
+
+		result.ok = true;
+
+		const size_t frames = std::min(golden.size(), candidate.size());
+
+		for (size_t f = 0; f < frames; f++)
+		{
+			const Frame &expected = golden[f];
+			std::unordered_map<std::string_view, const Entry *> actual;
+
+			for (const Entry &entry : candidate[f].entries)
+			{
+				actual[entry.name] = &entry;
+			}
+
+			for (const Entry &entry : expected.entries)
+			{
+				const float tolerance = tolerances.get(entry.name);
+
+				if (std::isinf(tolerance))
+				{
+					continue;
+				}
+
+				const auto it = actual.find(entry.name);
+				std::string problem;
+
+				if (it == actual.end())
+				{
+					problem = "missing";
+				}
+				else if (it->second->type != entry.type || it->second->bytes.size() != entry.bytes.size())
+				{
+					problem = "changed type";
+				}
+				else if (const float difference = max_difference(entry, *it->second); difference > tolerance)
+				{
+					problem = std::format("differs by {} (tolerance {})", difference, tolerance);
+				}
+
+				if (!problem.empty())
+				{
+					result.first_frame = expected.index;
+					result.uniform = entry.name;
+					result.message = std::format("Frame {}: uniform '{}' {}", expected.index, entry.name, problem);
+					result.frames_compared = static_cast<uint32_t>(f + 1);
+					return result;
+				}
+
+				actual.erase(entry.name);
+			}
+
+			// Whatever is left was written now but not in the golden run
+			for (const auto &[name, entry] : actual)
+			{
+				if (std::isinf(tolerances.get(entry->name)))
+				{
+					continue;
+				}
+
+				result.first_frame = expected.index;
+				result.uniform = entry->name;
+				result.message = std::format("Frame {}: uniform '{}' is not in the golden capture", expected.index, entry->name);
+				result.frames_compared = static_cast<uint32_t>(f + 1);
+				return result;
+			}
+
+			result.frames_compared = static_cast<uint32_t>(f + 1);
+		}
+
+		// A run that stopped early, or ran longer, diverges at the first frame only one of them has
+		if (golden.size() != candidate.size())
+		{
+			const Frame &extra = golden.size() > candidate.size() ? golden[frames] : candidate[frames];
+
+			result.first_frame = extra.index;
+			result.message = std::format("Frame {}: golden has {} frames, capture has {}", extra.index, golden.size(), candidate.size());
+			return result;
+		}
+
+		result.match = true;
+		result.message = std::format("{} frames match", result.frames_compared);
+
+		return result;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "types.hpp"
+
+// Captures of the uniform values the addon writes each frame, and a diff against a golden capture.
+//
+// A capture starts with CAPTURE_MAGIC and CAPTURE_VERSION, followed by one block per frame:
+// [uint32 frame][uint32 count] then 'count' entries of
+// [uint16 name length][name][uint8 type][uint16 byte count][bytes].
+// The type is the UniformType index of the value, or FLOAT_ARRAY_TYPE for the raw floats pv::clouds
+// writes. Names are the "source" annotations the values were bound to, or the uniform names for
+// the values pv::clouds writes.
+namespace UniformCapture
+{
+	constexpr char CAPTURE_MAGIC[4] = { 'P', 'V', 'U', 'C' };
+	constexpr uint32_t CAPTURE_VERSION = 2;
+	constexpr uint8_t FLOAT_ARRAY_TYPE = 0xFF;
+
+	struct Entry
+	{
+		std::string name;
+		uint8_t type = 0;
+		std::vector<uint8_t> bytes;
+	};
+
+	struct Frame
+	{
+		uint32_t index = 0;
+		std::vector<Entry> entries;
+	};
+
+	class Writer
+	{
+	public:
+		~Writer() { close(); }
+
+		// 'max_frames' of 0 keeps capturing until close()
+		bool open(const std::string &path, uint32_t max_frames);
+		void close();
+		bool is_open() const { return file.is_open(); }
+		bool is_full() const { return max_frames != 0 && frames >= max_frames; }
+		const std::string &get_path() const { return path; }
+
+		void begin_frame();
+		// Values bound to the same name more than once per frame (several effects) are kept once
+		void record(std::string_view name, const UniformType &value);
+		void record_floats(std::string_view name, const float *values, size_t count);
+		void end_frame();
+
+	private:
+		bool begin_entry(std::string_view name, uint8_t type, size_t byte_count);
+
+		std::ofstream file;
+		std::string path;
+		std::string block;
+		std::unordered_set<std::string> recorded;
+		uint32_t count = 0;
+		uint32_t frames = 0;
+		uint32_t max_frames = 0;
+		bool in_frame = false;
+	};
+
+	// Absolute per-component tolerance by uniform name, 'default' applies to everything else.
+	// Loaded from the [Tolerance] section of an INI, "inf" ignores a uniform entirely.
+	struct Tolerances
+	{
+		float fallback = 0.0f;
+		std::unordered_map<std::string, float> by_name;
+
+		bool load(const std::string &path);
+		float get(const std::string &name) const;
+	};
+
+	struct DiffResult
+	{
+		bool ok = false;       // Both captures could be read
+		bool match = false;    // Both captures have the same frames, every one within tolerance
+		uint32_t frames_compared = 0;
+		uint32_t first_frame = 0; // First diverging frame when not matching
+		std::string uniform;
+		std::string message;
+	};
+
+	// Fails on a malformed capture, including values whose size does not match their type
+	bool read_capture(const std::string &path, std::vector<Frame> &frames);
+	DiffResult diff(const std::string &golden_path, const std::string &candidate_path, const Tolerances &tolerances);
+}
@@ -1,53 +1,134 @@
 #pragma once
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 #include <fstream>
-#include <sstream>
-#include <cctype>
-#include <cstdlib>
+#include <charconv>
+#include <cstdint>
+#include <algorithm>
 
 namespace pv::ini {
 
-struct Section {
-  std::unordered_map<std::string,std::string> kv;
-  float  get_float(const char* k, float d=0) const { auto it=kv.find(k); return it==kv.end()? d : std::strtof(it->second.c_str(), nullptr); }
-  bool   get_bool(const char* k, bool d=false) const { auto it=kv.find(k); if(it==kv.end()) return d; auto v=it->second; for(auto&c:v)c=(char)std::toupper((unsigned char)c); return v=="1"||v=="TRUE"||v=="YES"; }
-  int    get_vk(const char* k, int d) const { auto it=kv.find(k); if(it==kv.end()) return d; if (it->second.rfind("VK_",0)==0) return d; return (int)std::strtoul(it->second.c_str(),nullptr,0); }
-  void   set_float(const char* k, float v){ kv[k]=std::to_string(v);} 
-  void   set_bool(const char* k, bool v){ kv[k]= v?"true":"false";} 
-  void   set_vk(const char* k, int v){ kv[k]=std::to_string(v);} 
+// The whole file is read into one buffer and every name/value is a string_view into it,
+// so loading does no per-key allocation. Sections and keys keep file order.
+// A comment runs from any of the comment characters to the end of the line, wherever it
+// starts. Only ';' by default; the preset files also allow '#' (see PRESET_COMMENTS).
+// A key given twice takes its last value, and a section given twice is looked up as one:
+// sections() still lists every occurrence, but find() and get() see them merged.
+
+inline std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front()==' ' || s.front()=='\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back()==' ' || s.back()=='\t' || s.back()=='\r')) s.remove_suffix(1);
+  return s;
+}
+
+inline bool parse_float(std::string_view s, float& out) {
+  if (!s.empty() && s.front()=='+') s.remove_prefix(1);
+  const auto r = std::from_chars(s.data(), s.data()+s.size(), out);
+  return r.ec==std::errc() && r.ptr!=s.data();
+}
+
+struct Entry {
+  std::string_view key, value;
 };
 
-struct Ini {
-  std::unordered_map<std::string,Section> sections;
-  Section& operator[](const std::string& s){ return sections[s]; }
+struct Section {
+  std::string_view name;
+  const Entry* entries = nullptr; uint32_t count = 0;
+  size_t begin = 0, end = 0;   // byte range in the source, from the header line up to the next header
+  const Section* previous = nullptr; // the occurrence of the same section before this one, if any
 
-  static std::string trim(const std::string& s) {
-    size_t a = s.find_first_not_of(" \t"); if (a==std::string::npos) return "";
-    size_t b = s.find_last_not_of(" \t"); return s.substr(a, b-a+1);
+  // The last value of 'k' in this occurrence of the section or the ones before it
+  std::string_view get(std::string_view k) const {
+    for (const Section* s = this; s; s = s->previous) {
+      for (uint32_t i = s->count; i-- > 0;) if (s->entries[i].key==k) return s->entries[i].value;
+    }
+    return {};
   }
+  bool   has(std::string_view k) const { return get(k).data()!=nullptr; }
+  float  get_float(std::string_view k, float d=0) const { float v; return parse_float(get(k), v)? v : d; }
+  bool   get_bool(std::string_view k, bool d=false) const {
+    const auto v=get(k); if (v.empty()) return d;
+    auto eq=[&](const char* s){ return v.size()==std::char_traits<char>::length(s) && std::equal(v.begin(), v.end(), s, [](char a, char b){ return (a>='a'&&a<='z'? a-32 : a)==b; }); };
+    return v=="1" || eq("TRUE") || eq("YES");
+  }
+  int    get_vk(std::string_view k, int d) const {
+    auto v=get(k); if (v.empty() || v.rfind("VK_",0)==0) return d;
+    int base=10; if (v.size()>2 && v[0]=='0' && (v[1]=='x'||v[1]=='X')) { v.remove_prefix(2); base=16; }
+    unsigned long r=0; const auto res=std::from_chars(v.data(), v.data()+v.size(), r, base);
+    return res.ec==std::errc()? (int)r : d;
+  }
+};
 
-  bool load(const std::string& path){
-    std::ifstream f(path); if(!f) return false; std::string line, cur=""; 
-    while(std::getline(f,line)){
-      if (!line.empty() && (line.back()=='\r')) line.pop_back();
-      auto sc = line.find(';'); if (sc!=std::string::npos) line=line.substr(0,sc);
-      line = trim(line); if(line.empty()) continue;
-      if(line.front()=='[' && line.back()==']'){ cur = line.substr(1,line.size()-2); continue; }
-      auto eq=line.find('='); if(eq==std::string::npos) continue; auto k=trim(line.substr(0,eq)); auto v=trim(line.substr(eq+1)); sections[cur].kv[k]=v;
-    }
+// Comment characters of PulseV_Clouds.ini, which has always accepted both
+inline constexpr std::string_view PRESET_COMMENTS = ";#";
+
+class Ini {
+public:
+  explicit Ini(std::string_view comment_chars = ";") : comments(comment_chars) {}
+  Ini(const Ini&) = delete;
+  Ini& operator=(const Ini&) = delete;
+
+  bool load(const std::string& path) {
+    std::ifstream f(path, std::ios::binary|std::ios::ate); if(!f) return false;
+    const std::streamoff size = f.tellg(); if (size<0) return false;
+    std::string text((size_t)size, '\0');
+    f.seekg(0); f.read(text.data(), size); if(!f) return false;
+    parse(std::move(text));
     return true;
   }
-  bool save(const std::string& path) const{
-    std::ofstream f(path, std::ios::trunc); if(!f) return false;
-    for(const auto& it : sections){
-      const auto& sec = it.first; const auto& kv = it.second.kv;
-      f << '[' << sec << "]\n";
-      for(const auto& kvp : kv) f << kvp.first << '=' << kvp.second << "\n";
-      f << "\n";
+
+  // Keys before the first header land in a section with an empty name
+  void parse(std::string text) {
+    buffer = std::move(text); secs.clear(); entries.clear();
+    const std::string_view src(buffer);
+    const size_t lines = (size_t)std::count(src.begin(), src.end(), '\n') + 1;
+    entries.reserve(lines);
+    secs.reserve((size_t)std::count(src.begin(), src.end(), '[') + 1);
+
+    size_t pos = 0;
+    while (pos < src.size()) {
+      size_t nl = src.find('\n', pos); if (nl==std::string_view::npos) nl = src.size();
+      std::string_view line = src.substr(pos, nl-pos);
+      const size_t c = line.find_first_of(comments); if (c!=std::string_view::npos) line = line.substr(0, c);
+      line = trim(line);
+      if (line.size()>=2 && line.front()=='[' && line.back()==']') {
+        if (!secs.empty()) secs.back().end = pos;
+        Section s; s.name = trim(line.substr(1, line.size()-2)); s.begin = pos;
+        secs.push_back(s);
+      }
+      else if (const size_t eq = line.find('='); eq!=std::string_view::npos) {
+        if (secs.empty()) { Section s; s.begin = 0; secs.push_back(s); }
+        entries.push_back({ trim(line.substr(0, eq)), trim(line.substr(eq+1)) });
+        ++secs.back().count;
+      }
+      pos = nl+1;
+    }
+    if (!secs.empty()) secs.back().end = src.size();
+
+    // Entries are final now, so the sections can point straight into them, in file order like the entries
+    const Entry* next = entries.data();
+    for (size_t i = 0; i < secs.size(); ++i) {
+      secs[i].entries = next; next += secs[i].count;
+      for (size_t j = i; j-- > 0;) if (secs[j].name==secs[i].name) { secs[i].previous = &secs[j]; break; }
     }
-    return true;
   }
+
+  const std::vector<Section>& sections() const { return secs; }
+  std::string_view source() const { return buffer; }
+  size_t offset_of(std::string_view v) const { return (size_t)(v.data() - buffer.data()); }
+
+  // The last occurrence of the section, which looks up keys through the earlier ones as well
+  const Section* find(std::string_view name) const {
+    for (size_t i = secs.size(); i-- > 0;) if (secs[i].name==name) return &secs[i];
+    return nullptr;
+  }
+
+private:
+  std::string_view comments;
+  std::string buffer;
+  std::vector<Section> secs;
+  std::vector<Entry> entries;
 };
 
 } // namespace pv::ini
@@ -0,0 +1,19 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace pv {
+
+// Hash for containers keyed by std::string that are searched with a string_view or a C string,
+// so a lookup on a per-frame path does not build (and allocate) a temporary std::string.
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+};
+
+template <typename T>
+using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+} // namespace pv
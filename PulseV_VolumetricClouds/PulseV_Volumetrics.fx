@@ -121,6 +121,32 @@ void tex2Dstore(storage2D a, uint2 b, float4 c)
 #define SOFT_EDGE 0
 #endif
 
+#ifndef PACKED_LAYERS
+#define PACKED_LAYERS 0
+#endif
+
+// Linearizes the scene depth once per frame at render scale for the passes that read it. Off by
+// default because it changes the image: the low resolution march and the aurora take the nearest
+// and farthest depth under each render scale texel instead of the depth at its center, and the
+// depth edge detector works at render scale
+#ifndef LINEAR_DEPTH_PREPASS
+#define LINEAR_DEPTH_PREPASS 0
+#endif
+
+#ifndef HIZ_EARLY_OUT
+#define HIZ_EARLY_OUT 0
+#endif
+
+// Marches one low resolution pixel per interleave block each frame, as sequenced by the addon
+// ([PULSEV] CloudInterleave), and reprojects the others from the previous frames
+#ifndef CLOUD_INTERLEAVE
+#define CLOUD_INTERLEAVE 0
+#endif
+
+#if HIZ_EARLY_OUT && !LINEAR_DEPTH_PREPASS
+#error "HIZ_EARLY_OUT is built from the linear depth prepass, set LINEAR_DEPTH_PREPASS to 1"
+#endif
+
 #define NOISE_W 256
 #define NOISE_H NOISE_W
 #define NOISE_D NOISE_W
@@ -150,6 +176,11 @@ void tex2Dstore(storage2D a, uint2 b, float4 c)
 
 static const bool RENDER_LOW = RENDER_SCALE < 1.0;
 static const float RENDER_WIDTH = 1.0 / RENDER_SCALE;
+#if LINEAR_DEPTH_PREPASS
+static const float DEPTH_TEXEL = RENDER_WIDTH;
+#else
+static const float DEPTH_TEXEL = 1.0;
+#endif
 
 static const int GAUSSIAN_SAMPLE_COUNT = 17;
 static const float GAUSSIAN_WEIGHT = 1.0 / GAUSSIAN_SAMPLE_COUNT;
@@ -247,6 +278,54 @@ uniform float inputAuroraVisibility <
 uniform float inputTimeOfDay <
     string source = "time_of_day";
 >;
+// Set below 1 by the addon's adaptive quality controller to hold a GPU time budget
+uniform float inputQualityScale <
+    string source = "quality_scale";
+> = 1.0;
+uniform float inputDistanceScale <
+    string source = "distance_scale";
+> = 1.0;
+// Recommended by the addon from the layer covers and the view, sparse or out-of-view clouds march less
+uniform float inputMarchSampleScale <
+    string source = "march_sample_scale";
+> = 1.0;
+uniform int inputMarchLightSteps <
+    string source = "march_light_steps";
+> = CLOUD_LIGHT_SAMPLES;
+// Faded to 0 by the addon while a pass has nothing to draw, the pass is skipped at 0
+uniform float inputAuroraGate <
+    string source = "aurora_gate";
+> = 1.0;
+uniform float inputCloudsGate <
+    string source = "clouds_gate";
+> = 1.0;
+uniform int inputFrameIndex <
+    string source = "frame_index";
+>;
+uniform int inputInterleaveSize <
+    string source = "interleave_size";
+> = 1;
+uniform float2 inputInterleaveOffset <
+    string source = "interleave_offset";
+>;
+uniform float2 inputJitter <
+    string source = "jitter";
+>;
+uniform bool inputCameraCut <
+    string source = "camera_cut";
+> = true;
+uniform float4 inputPreviousViewProjection1 <
+    string source = "previous_view_projection__r1";
+>;
+uniform float4 inputPreviousViewProjection2 <
+    string source = "previous_view_projection__r2";
+>;
+uniform float4 inputPreviousViewProjection3 <
+    string source = "previous_view_projection__r3";
+>;
+uniform float4 inputPreviousViewProjection4 <
+    string source = "previous_view_projection__r4";
+>;
 
 // ============================================================================ 
 //                              RESHADE UNIFORMS
@@ -677,6 +756,24 @@ sampler2D CloudsLowResSampler
     MipFilter = LINEAR;
 };
 
+#if CLOUD_INTERLEAVE
+texture CloudsLowHistoryTexture
+{
+    Width = BUFFER_WIDTH * RENDER_SCALE;
+    Height = BUFFER_HEIGHT * RENDER_SCALE;
+    Format = RGBA8;
+};
+
+sampler2D CloudsLowHistorySampler
+{
+    Texture = CloudsLowHistoryTexture;
+
+    MagFilter = LINEAR;
+    MinFilter = LINEAR;
+    MipFilter = LINEAR;
+};
+#endif
+
 texture AuroraTexture
 {
     Width = BUFFER_WIDTH * RENDER_SCALE;
@@ -693,6 +790,93 @@ sampler2D AuroraSampler
     MipFilter = LINEAR;
 };
 
+// Scene depth linearized once per frame at render scale: x = nearest, y = farthest
+// (both divided by the far clip, sky is exactly 1.0)
+texture LinearDepthTexture
+{
+    Width = BUFFER_WIDTH * RENDER_SCALE;
+    Height = BUFFER_HEIGHT * RENDER_SCALE;
+    Format = RG16F;
+};
+
+sampler2D LinearDepthSampler
+{
+    Texture = LinearDepthTexture;
+
+    MagFilter = POINT;
+    MinFilter = POINT;
+    MipFilter = POINT;
+};
+
+#if HIZ_EARLY_OUT
+// Min/max pyramid over LinearDepthTexture, one level per halving down to 1/32 of the screen.
+// The sizes are mirrored by the CPU reference in tests/harness/depth_pyramid.hpp
+texture HiZ4Texture
+{
+    Width = BUFFER_WIDTH / 4;
+    Height = BUFFER_HEIGHT / 4;
+    Format = RG16F;
+};
+
+sampler2D HiZ4Sampler
+{
+    Texture = HiZ4Texture;
+
+    MagFilter = POINT;
+    MinFilter = POINT;
+    MipFilter = POINT;
+};
+
+texture HiZ8Texture
+{
+    Width = BUFFER_WIDTH / 8;
+    Height = BUFFER_HEIGHT / 8;
+    Format = RG16F;
+};
+
+sampler2D HiZ8Sampler
+{
+    Texture = HiZ8Texture;
+
+    MagFilter = POINT;
+    MinFilter = POINT;
+    MipFilter = POINT;
+};
+
+texture HiZ16Texture
+{
+    Width = BUFFER_WIDTH / 16;
+    Height = BUFFER_HEIGHT / 16;
+    Format = RG16F;
+};
+
+sampler2D HiZ16Sampler
+{
+    Texture = HiZ16Texture;
+
+    MagFilter = POINT;
+    MinFilter = POINT;
+    MipFilter = POINT;
+};
+
+texture HiZ32Texture
+{
+    Width = BUFFER_WIDTH / 32;
+    Height = BUFFER_HEIGHT / 32;
+    Format = RG16F;
+};
+
+sampler2D HiZ32Sampler
+{
+    Texture = HiZ32Texture;
+
+    MagFilter = POINT;
+    MinFilter = POINT;
+    MipFilter = POINT;
+};
+
+#endif
+
 texture CloudsIntermediateTexture
 {
     Width = BUFFER_WIDTH;
@@ -862,6 +1046,17 @@ float4x4 inverseProjectionMatrix()
     );
 }
 
+// World position to the previous frame's clip space
+float4x4 previousViewProjectionMatrix()
+{
+    return float4x4(
+        inputPreviousViewProjection1,
+        inputPreviousViewProjection2,
+        inputPreviousViewProjection3,
+        inputPreviousViewProjection4
+    );
+}
+
 // ============================================================================ 
 //                          HELPER FUNCTIONS
 // ============================================================================
@@ -896,6 +1091,7 @@ Ray cameraRay(float2 uv)
 //                      LAYER PARAMETERS STRUCTURE
 // ============================================================================
 
+#if !PACKED_LAYERS
 LayerParameters getWeather(int weatherType, int layerIndex)
 {
     LayerParameters params;
@@ -1053,6 +1249,45 @@ LayerParameters getWeather(int weatherType, int layerIndex)
     
     return params;
 }
+#else
+LayerParameters unpackLayer(int index)
+{
+    LayerParameters params;
+    int base = index * PACKED_LAYER_FLOAT4S;
+    
+    float4 p0 = cloudPackedLayers[base + 0];
+    float4 p1 = cloudPackedLayers[base + 1];
+    float4 p2 = cloudPackedLayers[base + 2];
+    float4 p3 = cloudPackedLayers[base + 3];
+    float4 p4 = cloudPackedLayers[base + 4];
+    float4 p5 = cloudPackedLayers[base + 5];
+    
+    params.scale = p0.x;
+    params.detailScale = p0.y;
+    params.stretch = p0.z;
+    params.baseCurl = p0.w;
+    params.detailCurl = p1.x;
+    params.baseCurlScale = p1.y;
+    params.detailCurlScale = p1.z;
+    params.smoothness = p1.w;
+    params.softness = p2.x;
+    params.bottom = p2.y + cloudHeightOffset;
+    params.top = p2.z + cloudHeightOffset;
+    params.cover = p2.w;
+    params.extinction = p3.x;
+    params.ambientAmount = p3.y;
+    params.absorption = p3.z;
+    params.luminance = p3.w;
+    params.sunLightPower = p4.x;
+    params.moonLightPower = p4.y;
+    params.skyLightPower = p4.z;
+    params.bottomDensity = p4.w;
+    params.middleDensity = p5.x;
+    params.topDensity = p5.y;
+    
+    return params;
+}
+#endif
 
 LayerParameters mixLayerParams(LayerParameters fromParams, LayerParameters toParams, float ratio)
 {
@@ -1086,6 +1321,17 @@ LayerParameters mixLayerParams(LayerParameters fromParams, LayerParameters toPar
 
 LayerParameters getWeatherParams(int layerIndex)
 {
+#if PACKED_LAYERS
+    // 0/1 = from bottom/top, 2/3 = to bottom/top
+    float blend = cloudPackedLayers[PACKED_LAYER_BLEND].x;
+    
+    if (blend == 0.0)
+    {
+        return unpackLayer(layerIndex);
+    }
+    
+    return mixLayerParams(unpackLayer(layerIndex), unpackLayer(layerIndex + 2), blend);
+#else
     if (inputWeatherTransition == 0.0)
     {
         return getWeather(inputWeatherFrom, layerIndex);
@@ -1096,6 +1342,7 @@ LayerParameters getWeatherParams(int layerIndex)
     }
     
     return mixLayerParams(getWeather(inputWeatherFrom, layerIndex), getWeather(inputWeatherTo, layerIndex), inputWeatherTransition);
+#endif
 };
 
 float3 cloudExtents(float inBottom, float inTop)
@@ -1159,14 +1406,26 @@ float phase(float g, float cos_theta)
     return lerp(heyey, 1.0, 0.1);
 }
 
+int getLightSteps()
+{
+    return clamp(inputMarchLightSteps, 1, CLOUD_LIGHT_SAMPLES);
+}
+
 float cloudLightMarch(float3 pos, LayerParameters layer, float3 lightDirection, float stepSize, float absorption, float altitude, float altitudeDensity)
 {
     float transmittance = 1.0;
     float density = 0.0;
     float3 currentPos = pos;
     
+    const int steps = getLightSteps();
+    
     for (int i = 0; i < CLOUD_LIGHT_SAMPLES; ++i)
     {
+        if (i >= steps)
+        {
+            break;
+        }
+        
         currentPos += lightDirection * stepSize;
         density += cloudDensity(currentPos, layer, altitude, altitudeDensity) * stepSize;
     }
@@ -1197,11 +1456,60 @@ float rawDepth(float2 uv)
     return depth;
 }
 
+float rawDepthTexel(int2 texel)
+{
+    float depth = tex2Dfetch(ReShade::DepthBuffer, texel).r;
+    
+    if (inputDepthReversed)
+    {
+        depth = 1.0 - depth;
+    }
+    
+    return depth;
+}
+
 float linearDepth(float2 uv, float near, float far)
 {
     return depthToLinear(rawDepth(uv), near, far);
 }
 
+float linearToDepth(float depth, float near, float far)
+{
+    return (near * far / depth - far) / (near - far);
+}
+
+// Nearest and farthest scene depth covered by one render scale texel
+float2 linearDepthMinMax(float2 uv)
+{
+#if LINEAR_DEPTH_PREPASS
+    return tex2Dlod(LinearDepthSampler, float4(uv, 0.0, 0.0)).xy * inputFarClip;
+#else
+    return linearDepth(uv, inputNearClip, inputFarClip).xx;
+#endif
+}
+
+#if HIZ_EARLY_OUT
+// True when every pixel of the 1/32 tile hits geometry before a ray could climb to 'cloudBase'.
+// No ray reaches the base in less than the vertical gap to it, so those pixels would march
+// only below the clouds and end up fully transparent anyway.
+bool hiZOccluded(float2 uv, float cloudBase)
+{
+    const float tileFar = tex2Dlod(HiZ32Sampler, float4(uv, 0.0, 0.0)).y * inputFarClip;
+    
+    return tileFar < cloudBase - worldPosition().y;
+}
+#endif
+
+// Depth in the edge detector's own near/far range
+float edgeLinearDepth(float2 uv, float near, float far)
+{
+#if LINEAR_DEPTH_PREPASS
+    return depthToLinear(linearToDepth(linearDepthMinMax(uv).x, inputNearClip, inputFarClip), near, far);
+#else
+    return linearDepth(uv, near, far);
+#endif
+}
+
 float3 depthPreview(float depth)
 {
     const float far = inputFarClip;
@@ -1216,21 +1524,22 @@ float4 depthNormal(float2 uv)
 {
     float near = 0.001;
     float far = cloudDepthEdgeFar;
-    float3 offset = float3(BUFFER_PIXEL_SIZE, 0.0);
+    float3 offset = float3(BUFFER_PIXEL_SIZE * DEPTH_TEXEL, 0.0);
     float2 posNorth = uv - offset.zy;
     float2 posEast = uv + offset.xz;
 
-    float depth = linearDepth(uv, near, far);
+    float depth = edgeLinearDepth(uv, near, far);
     float3 vertCenter = float3(uv - 0.5, 1) * depth;
-    float3 vertNorth = float3(posNorth - 0.5, 1) * linearDepth(posNorth, near, far);
-    float3 vertEast = float3(posEast - 0.5, 1) * linearDepth(posEast, near, far);
+    float3 vertNorth = float3(posNorth - 0.5, 1) * edgeLinearDepth(posNorth, near, far);
+    float3 vertEast = float3(posEast - 0.5, 1) * edgeLinearDepth(posEast, near, far);
 
     return float4(normalize(cross(vertCenter - vertNorth, vertCenter - vertEast)), depth);
 }
 
 float depthEdge(float2 uv, float width)
 {
-    float3 pole = float3(-1.0, 0.0, 1.0) * RENDER_WIDTH * width;
+    // Closer than one depth texel would only ever land on the same prepass sample
+    float3 pole = float3(-1.0, 0.0, 1.0) * max(RENDER_WIDTH * width, DEPTH_TEXEL);
     float dpos = 0.0;
     
     const float kernel[9] =
@@ -1390,9 +1699,9 @@ float4 renderAurora(float2 uv)
 {
     const float renderDistance = 10000.0;
     const float jitter = blueNoise(uv);
-    const float depth = rawDepth(uv);
+    const float depth = linearDepthMinMax(uv).y;
     
-    if (depth < 1.0)
+    if (depth < inputFarClip)
     {
         return 0.0;
     }
@@ -1463,15 +1772,23 @@ float4 renderAurora(float2 uv)
 //                      MAIN RENDER FUNCTION
 // ============================================================================
 
-float4 renderClouds(float2 uv, LayerParameters bottomLayer, LayerParameters topLayer, int samples)
+float4 renderClouds(float2 uv, float depth, LayerParameters bottomLayer, LayerParameters topLayer, int samples)
 {
     const float jitter = blueNoise(uv) * cloudJitter;
     const float range = inputFarClip - inputNearClip;
-    const float depth = linearDepth(uv, inputNearClip, inputFarClip);
     const float3 extents = cloudExtents(bottomLayer.bottom, topLayer.top);
     const float height = extents.x;
     const float thickness = extents.z;
-    const float far = min(cloudRenderDistance, depth);
+    const float renderDistance = cloudRenderDistance * inputDistanceScale;
+    const float far = min(renderDistance, depth);
+    
+#if HIZ_EARLY_OUT
+    if (hiZOccluded(uv, bottomLayer.bottom))
+    {
+        return float4(tex2D(ReShade::BackBuffer, uv).rgb, 0.0);
+    }
+#endif
+
     const float sunAbsorption = 0.9 * cloudAbsorption;
     const float moonAbsorption = 0.75 * cloudAbsorption;
     const float skyAbsorption = 0.3 * cloudAbsorption;
@@ -1496,15 +1813,15 @@ float4 renderClouds(float2 uv, LayerParameters bottomLayer, LayerParameters topL
     {
         enter = 0.0;
         exit = far;
-        fullExit = cloudRenderDistance;
+        fullExit = renderDistance;
     }
     
     float minDistance = max(0.0, enter);
     float maxDistance = min(far, exit);
 
     float marchDistance = maxDistance - minDistance;
-    float stepSize = (min(cloudRenderDistance, fullExit) - minDistance) / float(samples);
-    float lightStepSize = thickness * cloudLightStepFactor / float(CLOUD_LIGHT_SAMPLES);
+    float stepSize = (min(renderDistance, fullExit) - minDistance) / float(samples);
+    float lightStepSize = thickness * cloudLightStepFactor / float(getLightSteps());
 
     float3 pos = ray.origin + ray.direction * (minDistance + jitter * stepSize);
 
@@ -1751,6 +2068,82 @@ float4 denoise(sampler2D tex, float2 uv, float2 size, float sigma, float strengt
 //                      SHADER ENTRY POINTS
 // ============================================================================
 
+// Source texels under the target texel at 'fragcoord', the first in .xy and the last in .zw. The
+// targets are whole fractions of the screen, so one is rarely exactly half the size of its source:
+// the footprint runs from floor(t * ratio) to ceil((t + 1) * ratio) with the actual size ratio,
+// which covers every source texel (tests/harness/depth_pyramid.hpp mirrors this on the CPU)
+int4 texelFootprint(float4 fragcoord, int2 sourceSize, float2 targetSize)
+{
+    const float2 ratio = float2(sourceSize) / targetSize;
+    const int2 first = int2(floor((fragcoord.xy - 0.5) * ratio));
+    const int2 last = min(int2(ceil((fragcoord.xy + 0.5) * ratio)), sourceSize) - 1;
+    
+    return int4(first, last);
+}
+
+float4 PS_LinearDepth(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    const int4 footprint = texelFootprint(fragcoord, tex2Dsize(ReShade::DepthBuffer, 0), float2(int(BUFFER_WIDTH * RENDER_SCALE), int(BUFFER_HEIGHT * RENDER_SCALE)));
+    const float invFar = 1.0 / max(inputFarClip, EPSILON);
+    
+    float2 result = float2(1.0, 0.0);
+    
+    for (int y = footprint.y; y <= footprint.w; y++)
+    {
+        for (int x = footprint.x; x <= footprint.z; x++)
+        {
+            const float depth = rawDepthTexel(int2(x, y));
+            const float scene = depth < 1.0 ? saturate(depthToLinear(depth, inputNearClip, inputFarClip) * invFar) : 1.0;
+            
+            result = float2(min(result.x, scene), max(result.y, scene));
+        }
+    }
+    
+    return float4(result, 0.0, 0.0);
+}
+
+#if HIZ_EARLY_OUT
+// Nearest and farthest of the source texels under the target texel at 'fragcoord'
+float4 reduceDepthMinMax(sampler2D source, float4 fragcoord, float2 targetSize)
+{
+    const int4 footprint = texelFootprint(fragcoord, tex2Dsize(source, 0), targetSize);
+    
+    float2 result = float2(1.0, 0.0);
+    
+    for (int y = footprint.y; y <= footprint.w; y++)
+    {
+        for (int x = footprint.x; x <= footprint.z; x++)
+        {
+            const float2 depth = tex2Dfetch(source, int2(x, y)).xy;
+            
+            result = float2(min(result.x, depth.x), max(result.y, depth.y));
+        }
+    }
+    
+    return float4(result, 0.0, 0.0);
+}
+
+float4 PS_HiZ4(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    return reduceDepthMinMax(LinearDepthSampler, fragcoord, float2(BUFFER_WIDTH / 4, BUFFER_HEIGHT / 4));
+}
+
+float4 PS_HiZ8(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    return reduceDepthMinMax(HiZ4Sampler, fragcoord, float2(BUFFER_WIDTH / 8, BUFFER_HEIGHT / 8));
+}
+
+float4 PS_HiZ16(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    return reduceDepthMinMax(HiZ8Sampler, fragcoord, float2(BUFFER_WIDTH / 16, BUFFER_HEIGHT / 16));
+}
+
+float4 PS_HiZ32(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    return reduceDepthMinMax(HiZ16Sampler, fragcoord, float2(BUFFER_WIDTH / 32, BUFFER_HEIGHT / 32));
+}
+#endif
+
 float4 PS_Aurora(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
 {
     if (!inputEnabled)
@@ -1758,7 +2151,12 @@ float4 PS_Aurora(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Targ
         discard;
     }
     
-    float visibility = auroraAmount();
+    if (inputAuroraGate <= 0.0)
+    {
+        return 0.0;
+    }
+    
+    float visibility = auroraAmount() * inputAuroraGate;
     float4 output = 0.0;
     
     if (visibility > 0.0)
@@ -1788,6 +2186,42 @@ int getQualityPresetSamples()
     return 64;
 }
 
+#if CLOUD_INTERLEAVE
+// Where the clouds seen through 'uv' were on screen last frame, outside [0, 1] when they were not.
+// Clouds have no single depth, the base of the bottom layer (or the render distance for rays that
+// never reach it) stands in for it, which is exact for rotation and close enough for the small
+// moves that are not camera cuts.
+float2 reprojectClouds(float2 uv)
+{
+    const Ray ray = cameraRay(uv);
+    const float base = max(getWeatherParams(0).bottom, 0.0);
+    float reach = cloudRenderDistance * inputDistanceScale;
+    const float enter = (base - ray.origin.y) / ray.direction.y;
+    
+    if (enter > 0.0)
+    {
+        reach = min(enter, reach);
+    }
+    
+    const float4 clip = mul(float4(ray.origin + ray.direction * reach, 1.0), previousViewProjectionMatrix());
+    
+    // The previous view looks down -z, so w (the negated view depth) is negative in front of the camera
+    if (clip.w >= 0.0)
+    {
+        return -1.0;
+    }
+    
+    const float2 ndc = clip.xy / clip.w;
+    
+    return float2(1.0 - (ndc.x + 1.0) * 0.5, (ndc.y + 1.0) * 0.5);
+}
+#endif
+
+int getCloudSamples()
+{
+    return max(int(float(getQualityPresetSamples()) * inputQualityScale * inputMarchSampleScale), 32);
+}
+
 float4 PS_VolumetricCloudsLow(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
 {
     if (!inputEnabled)
@@ -1795,9 +2229,40 @@ float4 PS_VolumetricCloudsLow(float4 fragcoord : SV_Position, float2 uv : TexCoo
         discard;
     }
     
-    return renderClouds(uv, getWeatherParams(0), getWeatherParams(1), getQualityPresetSamples());
+    if (inputCloudsGate <= 0.0)
+    {
+        return 0.0;
+    }
+    
+#if CLOUD_INTERLEAVE
+    const int2 cell = int2(fragcoord.xy) % max(inputInterleaveSize, 1);
+    
+    if (!inputCameraCut && any(cell != int2(inputInterleaveOffset)))
+    {
+        const float2 previous = reprojectClouds(uv);
+        
+        if (all(previous >= 0.0) && all(previous <= 1.0))
+        {
+            return tex2Dlod(CloudsLowHistorySampler, float4(previous, 0.0, 0.0));
+        }
+    }
+    
+    // Marched pixels sample a different spot of themselves every frame
+    const float2 marchUV = uv + inputJitter * RENDER_WIDTH / BUFFER_SCREEN_SIZE;
+#else
+    const float2 marchUV = uv;
+#endif
+    
+    return renderClouds(marchUV, linearDepthMinMax(marchUV).x, getWeatherParams(0), getWeatherParams(1), getCloudSamples());
 }
 
+#if CLOUD_INTERLEAVE
+float4 PS_CloudsLowHistory(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
+{
+    return tex2Dlod(CloudsLowResSampler, float4(uv, 0.0, 0.0));
+}
+#endif
+
 float4 PS_VolumetricCloudsIntermediate(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
 {
     if (!inputEnabled)
@@ -1805,6 +2270,11 @@ float4 PS_VolumetricCloudsIntermediate(float4 fragcoord : SV_Position, float2 uv
         discard;
     }
     
+    if (inputCloudsGate <= 0.0)
+    {
+        return 0.0;
+    }
+    
     float4 clouds = 0.0;
     float edge = 0.0;
     
@@ -1815,7 +2285,7 @@ float4 PS_VolumetricCloudsIntermediate(float4 fragcoord : SV_Position, float2 uv
     
     if (!RENDER_LOW || edge > 0.0)
     {
-        clouds = renderClouds(uv, getWeatherParams(0), getWeatherParams(1), getQualityPresetSamples());
+        clouds = renderClouds(uv, linearDepth(uv, inputNearClip, inputFarClip), getWeatherParams(0), getWeatherParams(1), getCloudSamples());
     }
     else
     {
@@ -1847,7 +2317,7 @@ float4 PS_VolumetricClouds(float4 fragcoord : SV_Position, float2 uv : TexCoord)
     
     float mask = uiMask(uv);
     
-    if (mask < 0.001)
+    if (mask < 0.001 || inputCloudsGate <= 0.0)
     {
         return back;
     }
@@ -1861,7 +2331,7 @@ float4 PS_VolumetricClouds(float4 fragcoord : SV_Position, float2 uv : TexCoord)
         clouds = tex2D(CloudsIntermediateSampler, uv);
     }
     
-    return float4(lerp(back.rgb, clouds.rgb, clouds.a * uiMask(uv)), 1.0);
+    return float4(lerp(back.rgb, clouds.rgb, clouds.a * mask * inputCloudsGate), 1.0);
 }
 
 float4 PS_Debug(float4 fragcoord : SV_Position, float2 uv : TexCoord) : SV_Target
@@ -1968,6 +2438,45 @@ technique PulseV_VolumetricClouds <
     string ui_tooltip = "Main volumetric clouds shader";
 >
 {
+#if LINEAR_DEPTH_PREPASS
+    pass linear_depth
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_LinearDepth;
+        RenderTarget = LinearDepthTexture;
+    }
+
+#endif
+#if HIZ_EARLY_OUT
+    pass hiz_4
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_HiZ4;
+        RenderTarget = HiZ4Texture;
+    }
+
+    pass hiz_8
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_HiZ8;
+        RenderTarget = HiZ8Texture;
+    }
+
+    pass hiz_16
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_HiZ16;
+        RenderTarget = HiZ16Texture;
+    }
+
+    pass hiz_32
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_HiZ32;
+        RenderTarget = HiZ32Texture;
+    }
+
+#endif
     pass aurora
     {
         VertexShader = PostProcessVS;
@@ -1984,6 +2493,15 @@ technique PulseV_VolumetricClouds <
         RenderTarget = CloudsLowResTexture;
     }
 
+#if CLOUD_INTERLEAVE
+    pass clouds_low_history
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_CloudsLowHistory;
+        RenderTarget = CloudsLowHistoryTexture;
+    }
+
+#endif
     pass clouds_intermediate
     {
         VertexShader = PostProcessVS;
@@ -2031,6 +2549,15 @@ technique PulseV_VolumetricClouds_DEBUGDEPTHEDGE <
     bool enabled = false;
 >
 {
+#if LINEAR_DEPTH_PREPASS
+    pass linear_depth
+    {
+        VertexShader = PostProcessVS;
+        PixelShader = PS_LinearDepth;
+        RenderTarget = LinearDepthTexture;
+    }
+
+#endif
     pass debug
     {
         VertexShader = PostProcessVS;